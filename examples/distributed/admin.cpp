@@ -29,6 +29,8 @@ static std::string g_log_level = "info";
 static std::string g_ssg_file;
 static std::string g_endpoint;
 static uint16_t    g_provider_id = 0;
+static uint64_t    g_from_iteration = 0;
+static bool        g_migrate = false;
 
 static void parse_command_line(int argc, char** argv);
 static uint32_t get_credentials_from_ssg_file();
@@ -61,12 +63,15 @@ int main(int argc, char** argv) {
         } else if(g_operation == "destroy") {
             admin.destroyDistributedPipeline(g_ssg_file, g_provider_id, g_pipeline, g_token);
             spdlog::info("Destroyed pipeline {}", g_pipeline);
+        } else if(g_operation == "update") {
+            admin.updateDistributedPipeline(g_ssg_file, g_provider_id, g_pipeline, g_config, g_from_iteration, g_token);
+            spdlog::info("Updated pipeline {}", g_pipeline);
         } else if(g_operation == "shutdown") {
             admin.shutdownGroup(g_ssg_file);
             spdlog::info("Service shut down");
         } else if(g_operation == "leave") {
             if(!g_endpoint.empty()) {
-                admin.makeServerLeave(g_endpoint, g_provider_id);
+                admin.makeServerLeave(g_endpoint, g_provider_id, g_migrate);
             }
         }
 
@@ -96,7 +101,9 @@ void parse_command_line(int argc, char** argv) {
         TCLAP::ValueArg<std::string> ssgFileArg("s","ssg-file","SSG file name", false, "","string");
         TCLAP::ValueArg<std::string> endpoint("e", "endpoint", "Server to contact", false, "", "string");
         TCLAP::ValueArg<uint16_t> providerId("p", "provider-id", "Provider id", false, 0, "int");
-        std::vector<std::string> options = { "create", "destroy", "shutdown", "leave" };
+        TCLAP::ValueArg<uint64_t> fromIteration("i", "from-iteration", "First iteration using an updated configuration", false, 0, "int");
+        TCLAP::SwitchArg migrateArg("m", "migrate", "Migrate the server's data when leaving", false);
+        std::vector<std::string> options = { "create", "destroy", "update", "shutdown", "leave" };
         TCLAP::ValuesConstraint<std::string> allowedOptions(options);
         TCLAP::ValueArg<std::string> operationArg("x","exec","Operation to execute",true,"create",&allowedOptions);
         cmd.add(addressArg);
@@ -110,6 +117,8 @@ void parse_command_line(int argc, char** argv) {
         cmd.add(ssgFileArg);
         cmd.add(providerId);
         cmd.add(endpoint);
+        cmd.add(fromIteration);
+        cmd.add(migrateArg);
         cmd.parse(argc, argv);
         g_address = addressArg.getValue();
         g_library = libraryArg.getValue();
@@ -123,6 +132,8 @@ void parse_command_line(int argc, char** argv) {
         g_ssg_file = ssgFileArg.getValue();
         g_provider_id = providerId.getValue();
         g_endpoint = endpoint.getValue();
+        g_from_iteration = fromIteration.getValue();
+        g_migrate = migrateArg.getValue();
     } catch(TCLAP::ArgException &e) {
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         exit(-1);
@@ -8,6 +8,8 @@
 #include <spdlog/spdlog.h>
 #include <tclap/CmdLine.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <ssg.h>
 #include <mpi.h>
 #ifdef COLZA_ENABLE_DRC
@@ -23,6 +25,7 @@ static std::string g_pipeline;
 static std::string g_log_level = "info";
 static std::string g_ssg_file;
 static uint64_t    g_num_iterations = 10;
+static uint16_t    g_num_providers = 1;
 static uint64_t    g_wait_between_iterations = 2;
 static bool        g_no_stage = false;
 static bool        g_no_exec = false;
@@ -59,10 +62,13 @@ int main(int argc, char** argv) {
         // Initialize a Client
         colza::Client client(engine);
 
-        // Open distributed pipeline from provider 0
+        // Open distributed pipeline from providers 0 to g_num_providers-1
+        std::vector<uint16_t> provider_ids(g_num_providers);
+        for(uint16_t i = 0; i < g_num_providers; i++)
+            provider_ids[i] = i;
         colza::DistributedPipelineHandle pipeline =
             client.makeDistributedPipelineHandle(
-                &comm, g_ssg_file, 0, g_pipeline);
+                &comm, g_ssg_file, provider_ids, g_pipeline);
 
         // start iteration
         for(uint64_t iteration = 0; iteration < g_num_iterations; iteration++) {
@@ -138,6 +144,7 @@ void parse_command_line(int argc, char** argv) {
         TCLAP::ValueArg<std::string> ssgFileArg("s","ssg-file","SSG file name", true, "","string");
         TCLAP::ValueArg<unsigned> waitVal("w","wait","Wait time between iterations", false, 2, "int");
         TCLAP::ValueArg<unsigned> numIterations("i","iterations","Number of iterations", false, 10, "int");
+        TCLAP::ValueArg<uint16_t> numProviders("n","num-providers","Number of providers per server", false, 1, "int");
         TCLAP::SwitchArg noStage("","no-stage","Do not stage any data", false);
         TCLAP::SwitchArg noExecute("","no-execute","Do not execute the pipeline", false);
         cmd.add(addressArg);
@@ -148,6 +155,7 @@ void parse_command_line(int argc, char** argv) {
         cmd.add(noExecute);
         cmd.add(waitVal);
         cmd.add(numIterations);
+        cmd.add(numProviders);
         cmd.parse(argc, argv);
         g_address = addressArg.getValue();
         g_pipeline = pipelineArg.getValue();
@@ -157,6 +165,7 @@ void parse_command_line(int argc, char** argv) {
         g_no_exec = noExecute.getValue();
         g_num_iterations = numIterations.getValue();
         g_wait_between_iterations = waitVal.getValue();
+        g_num_providers = std::max<uint16_t>(1, numProviders.getValue());
     } catch(TCLAP::ArgException &e) {
         std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
         exit(-1);
@@ -7,6 +7,8 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <mpi.h>
 #include <ssg-mpi.h>
 #include <spdlog/spdlog.h>
@@ -22,6 +24,7 @@ namespace tl = thallium;
 
 static std::string g_address        = "na+sm";
 static int         g_num_threads    = 0;
+static int         g_num_providers  = 1;
 static std::string g_log_level      = "info";
 static std::string g_ssg_file       = "";
 static std::string g_config_file    = "";
@@ -129,20 +132,32 @@ int main(int argc, char** argv) {
                               std::istreambuf_iterator<char>());
     }
 
-    // create ESs
-    std::vector<tl::managed<tl::xstream>> colza_xstreams;
-    tl::managed<tl::pool> managed_colza_pool = tl::pool::create(tl::pool::access::mpmc);
-    for(int i=0; i < g_num_threads; i++) {
-        colza_xstreams.push_back(
-            tl::xstream::create(tl::scheduler::predef::basic_wait, *managed_colza_pool));
+    // create one pool and its ESs per provider; a single provider with
+    // no thread of its own runs in the main pool, but several providers
+    // need their own pools (and at least one ES each) so that a provider
+    // blocked in a collective does not hold back the others
+    int num_threads = g_num_threads;
+    if(num_threads == 0 && g_num_providers > 1) {
+        spdlog::warn("Using 1 thread per provider since there are {} providers",
+                     g_num_providers);
+        num_threads = 1;
     }
-    tl::pool colza_pool;
-    if(g_num_threads == 0) {
-        colza_pool = *managed_colza_pool;
-    } else {
-        colza_pool = tl::xstream::self().get_main_pools(1)[0];
+    std::vector<tl::managed<tl::xstream>> colza_xstreams;
+    std::vector<tl::managed<tl::pool>> managed_colza_pools;
+    std::vector<tl::pool> colza_pools;
+    for(int p=0; p < g_num_providers; p++) {
+        if(num_threads == 0) {
+            colza_pools.push_back(tl::xstream::self().get_main_pools(1)[0]);
+            continue;
+        }
+        managed_colza_pools.push_back(tl::pool::create(tl::pool::access::mpmc));
+        colza_pools.push_back(*managed_colza_pools.back());
+        for(int i=0; i < num_threads; i++) {
+            colza_xstreams.push_back(
+                tl::xstream::create(tl::scheduler::predef::basic_wait, colza_pools.back()));
+        }
     }
-    engine.push_finalize_callback([&colza_xstreams, &colza_pool](){
+    engine.push_finalize_callback([&colza_xstreams](){
         spdlog::trace("Joining Colza xstreams");
         for(auto& es : colza_xstreams) {
             es->make_thread([]() {
@@ -157,7 +172,13 @@ int main(int argc, char** argv) {
         spdlog::trace("Colza xstreams joined");
     });
 
-    colza::Provider provider(engine, gid, g_join, mona, 0, config, colza_pool);
+    // providers share the SSG group and MoNA instance,
+    // but each has its own pool and pipelines
+    std::vector<std::unique_ptr<colza::Provider>> providers;
+    for(int p=0; p < g_num_providers; p++) {
+        providers.emplace_back(new colza::Provider(
+            engine, gid, g_join, mona, p, config, colza_pools[p]));
+    }
 
     // Add a callback to rewrite the SSG file when the group membership changes
     ssg_group_add_membership_update_callback(
@@ -180,7 +201,9 @@ void parse_command_line(int argc, char** argv) {
     try {
         TCLAP::CmdLine cmd("Spawns a Colza daemon", ' ', "0.1");
         TCLAP::ValueArg<std::string> addressArg("a","address","Address or protocol (e.g. ofi+tcp)", true,"","string");
-        TCLAP::ValueArg<int> numThreads("t","num-threads", "Number of threads for RPC handlers", false, 0, "int");
+        TCLAP::ValueArg<int> numThreads("t","num-threads", "Number of threads for RPC handlers (per provider, "
+                "at least 1 if there are several providers)", false, 0, "int");
+        TCLAP::ValueArg<int> numProviders("n","num-providers", "Number of providers (shards) in this process", false, 1, "int");
         TCLAP::ValueArg<std::string> logLevel("v","verbose",
                 "Log level (trace, debug, info, warning, error, critical, off)", false, "info", "string");
         TCLAP::ValueArg<std::string> ssgFile("s", "ssg-file", "SSG file name", false, "", "string");
@@ -190,6 +213,7 @@ void parse_command_line(int argc, char** argv) {
         TCLAP::ValueArg<int64_t> drc("d","drc-credential-id", "DRC credential ID, if already setup", false, -1, "int");
         cmd.add(addressArg);
         cmd.add(numThreads);
+        cmd.add(numProviders);
         cmd.add(logLevel);
         cmd.add(ssgFile);
         cmd.add(configFile);
@@ -199,6 +223,7 @@ void parse_command_line(int argc, char** argv) {
         cmd.parse(argc, argv);
         g_address        = addressArg.getValue();
         g_num_threads    = numThreads.getValue();
+        g_num_providers  = std::max(1, numProviders.getValue());
         g_log_level      = logLevel.getValue();
         g_ssg_file       = ssgFile.getValue();
         g_config_file    = configFile.getValue();
@@ -38,8 +38,7 @@ colza::RequestResult<int32_t> DummyPipeline::execute(
 
 colza::RequestResult<int32_t> DummyPipeline::cleanup(
         uint64_t iteration) {
-    std::lock_guard<tl::mutex> g(m_datasets_mtx);
-    m_datasets.erase(iteration);
+    m_store.erase(iteration);
     auto result = colza::RequestResult<int32_t>();
     result.value() = 0;
     return result;
@@ -56,38 +55,13 @@ colza::RequestResult<int32_t> DummyPipeline::stage(
         const thallium::bulk& data) {
     colza::RequestResult<int32_t> result;
     result.value() = 0;
-    {
-        std::lock_guard<tl::mutex> g(m_datasets_mtx);
-        if(m_datasets.count(iteration) != 0
-        && m_datasets[iteration].count(dataset_name) != 0
-        && m_datasets[iteration][dataset_name].count(block_id) != 0) {
-            result.error() = "Block already exists for provided iteration, name, and id";
-            result.success() = false;
-            return result;
-        }
-    }
-    DataBlock block;
-    block.dimensions = dimensions;
-    block.offsets    = offsets;
-    block.type       = type;
-    block.data.resize(data.size());
-
     try {
-        std::vector<std::pair<void*, size_t>> segments = {
-            std::make_pair<void*, size_t>(block.data.data(), block.data.size())
-        };
-        auto local_bulk = m_engine.expose(segments, tl::bulk_mode::write_only);
-        auto origin_ep = m_engine.lookup(sender_addr);
-        data.on(origin_ep) >> local_bulk;
+        m_store.stage(m_engine, sender_addr, dataset_name, iteration,
+                      block_id, dimensions, offsets, type, data);
     } catch(const std::exception& ex) {
         result.success() = false;
         result.error() = ex.what();
     }
-
-    if(result.success()) {
-        std::lock_guard<tl::mutex> g(m_datasets_mtx);
-        m_datasets[iteration][dataset_name][block_id] = std::move(block);
-    }
     return result;
 }
 
@@ -97,6 +71,42 @@ colza::RequestResult<int32_t> DummyPipeline::destroy() {
     return result;
 }
 
+colza::RequestResult<int32_t> DummyPipeline::reconfigure(const json& config) {
+    spdlog::trace("Pipeline reconfigured with {}", config.dump());
+    m_config = config;
+    colza::RequestResult<int32_t> result;
+    result.value() = 0;
+    return result;
+}
+
+colza::RequestResult<int32_t> DummyPipeline::reset() {
+    m_store.clear();
+    colza::RequestResult<int32_t> result;
+    result.value() = 0;
+    return result;
+}
+
+std::vector<colza::ExportedBlock> DummyPipeline::exportBlocks() {
+    std::vector<colza::ExportedBlock> blocks;
+    for(auto iteration : m_store.iterations()) {
+        for(auto& block : m_store.blocks(iteration)) {
+            colza::ExportedBlock exported;
+            exported.dataset_name = *block->dataset_name;
+            exported.iteration    = iteration;
+            exported.block_id     = block->block_id;
+            exported.dimensions   = block->dimensions;
+            exported.offsets      = block->offsets;
+            exported.type         = block->type;
+            std::vector<std::pair<void*, size_t>> segments = {
+                std::pair<void*, size_t>(block->data, block->size)
+            };
+            exported.data = m_engine.expose(segments, tl::bulk_mode::read_only);
+            blocks.push_back(std::move(exported));
+        }
+    }
+    return blocks;
+}
+
 std::unique_ptr<colza::Backend> DummyPipeline::create(const colza::PipelineFactoryArgs& args) {
     return std::unique_ptr<colza::Backend>(new DummyPipeline(args));
 }
@@ -8,26 +8,11 @@
 
 #include <thallium.hpp>
 #include <colza/Backend.hpp>
+#include <colza/BlockStore.hpp>
 
 using json = nlohmann::json;
 namespace tl = thallium;
 
-struct DataBlock {
-
-    std::vector<char>    data;
-    std::vector<size_t>  dimensions;
-    std::vector<int64_t> offsets;
-    colza::Type          type;
-
-    DataBlock()                            = default;
-    DataBlock(DataBlock&&)                 = default;
-    DataBlock(const DataBlock&)            = default;
-    DataBlock& operator=(DataBlock&&)      = default;
-    DataBlock& operator=(const DataBlock&) = default;
-    ~DataBlock()                           = default;
-
-};
-
 /**
  * Dummy implementation of an colza Backend.
  */
@@ -35,17 +20,10 @@ class DummyPipeline : public colza::Backend {
 
     protected:
 
-    tl::engine     m_engine;
-    ssg_group_id_t m_gid;
-    json           m_config;
-    std::map<uint64_t,         // iteration
-        std::map<std::string,  // dataset name
-            std::map<uint64_t, // block id
-                     DataBlock
-                    >
-                >
-            > m_datasets;
-    tl::mutex m_datasets_mtx;
+    tl::engine        m_engine;
+    ssg_group_id_t    m_gid;
+    json              m_config;
+    colza::BlockStore m_store;
 
     public:
 
@@ -146,6 +124,22 @@ class DummyPipeline : public colza::Backend {
      */
     colza::RequestResult<int32_t> destroy() override;
 
+    /**
+     * @brief Replaces the pipeline's configuration.
+     */
+    colza::RequestResult<int32_t> reconfigure(const json& config) override;
+
+    /**
+     * @brief Erases all the data blocks so the instance can be recycled.
+     */
+    colza::RequestResult<int32_t> reset() override;
+
+    /**
+     * @brief Exposes all the blocks held by the pipeline so that
+     * they can be migrated to other servers.
+     */
+    std::vector<colza::ExportedBlock> exportBlocks() override;
+
     /**
      * @brief Static factory function used by the PipelineFactory to
      * create a DummyPipeline.
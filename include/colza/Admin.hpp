@@ -84,6 +84,10 @@ class Admin {
      * @brief Creates a pipeline on the target provider.
      * The config string must be a JSON object acceptable
      * by the desired backend's creation function.
+     * Pipelines created this way on several servers agree on the
+     * context of their Communicators only if all the servers create
+     * their pipelines in the same order; createDistributedPipeline
+     * does not have this restriction.
      *
      * @param address Address of the target provider.
      * @param provider_id Provider id.
@@ -159,12 +163,82 @@ class Admin {
                          const std::string& pipeline_name,
                          const std::string& token="") const;
 
+    /**
+     * @brief Updates the configuration of an existing pipeline
+     * without destroying it. The new configuration is applied
+     * between iterations: immediately if the pipeline is inactive
+     * and from_iteration is 0, otherwise when the pipeline starts
+     * its next iteration whose number is >= from_iteration. If the
+     * pipeline then rejects the configuration, the configuration is
+     * dropped and starting that iteration fails with the error.
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param name Name of the pipeline.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updatePipeline(const std::string& address,
+                        uint16_t provider_id,
+                        const std::string& name,
+                        const std::string& config,
+                        uint64_t from_iteration = 0,
+                        const std::string& token="") const;
+
+    /**
+     * @brief Updates the configuration of an existing pipeline
+     * without destroying it (see above).
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param name Name of the pipeline.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updatePipeline(const std::string& address,
+                        uint16_t provider_id,
+                        const std::string& name,
+                        const char* config,
+                        uint64_t from_iteration = 0,
+                        const std::string& token="") const {
+        return updatePipeline(address, provider_id, name, std::string(config), from_iteration, token);
+    }
+
+    /**
+     * @brief Updates the configuration of an existing pipeline
+     * without destroying it (see above).
+     *
+     * @param address Address of the target provider.
+     * @param provider_id Provider id.
+     * @param name Name of the pipeline.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updatePipeline(const std::string& address,
+                        uint16_t provider_id,
+                        const std::string& name,
+                        const json& config,
+                        uint64_t from_iteration = 0,
+                        const std::string& token="") const {
+        return updatePipeline(address, provider_id, name, config.dump(), from_iteration, token);
+    }
+
     /**
      * @brief Creates a pipeline on the target providers
      * listed in an SSG group file.
      * The config string must be a JSON object acceptable
      * by the desired backend's creation function.
      *
+     * The request is sent only to the first member of the group,
+     * which propagates it along a spanning tree and aggregates the
+     * results. If creation fails on any member, the pipeline is
+     * destroyed on the members where it had been created. The first
+     * member also picks the context of the pipeline's Communicators,
+     * which all the members then use.
+     *
      * @param ssg_file SSG file listing providers.
      * @param provider_id Provider id.
      * @param name Name of the pipeline.
@@ -231,6 +305,8 @@ class Admin {
 
     /**
      * @brief Destroys an open pipeline in the providers listed in the SSG group.
+     * Like createDistributedPipeline, the request is propagated by the
+     * servers along a spanning tree.
      *
      * @param ssg_file SSG file containing addresses of providers.
      * @param provider_id Provider id.
@@ -241,6 +317,71 @@ class Admin {
                          const std::string& pipeline_name,
                          const std::string& token="") const;
 
+    /**
+     * @brief Updates the configuration of a pipeline on all the
+     * providers listed in the SSG group. To make sure all the servers
+     * switch to the new configuration at the same iteration, provide
+     * a from_iteration greater than the iteration currently running.
+     * Like createDistributedPipeline, the update is all-or-nothing: if
+     * it fails on any member, the members where it succeeded restore
+     * the configuration they had.
+     *
+     * @param ssg_file SSG file containing addresses of providers.
+     * @param provider_id Provider id.
+     * @param pipeline_name Name of the pipeline to update.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updateDistributedPipeline(const std::string& ssg_file,
+                         uint16_t provider_id,
+                         const std::string& pipeline_name,
+                         const std::string& config,
+                         uint64_t from_iteration = 0,
+                         const std::string& token="") const;
+
+    /**
+     * @brief Updates the configuration of a pipeline on all the
+     * providers listed in the SSG group (see above).
+     *
+     * @param ssg_file SSG file containing addresses of providers.
+     * @param provider_id Provider id.
+     * @param pipeline_name Name of the pipeline to update.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updateDistributedPipeline(const std::string& ssg_file,
+                         uint16_t provider_id,
+                         const std::string& pipeline_name,
+                         const char* config,
+                         uint64_t from_iteration = 0,
+                         const std::string& token="") const {
+        return updateDistributedPipeline(ssg_file, provider_id, pipeline_name,
+                                         std::string(config), from_iteration, token);
+    }
+
+    /**
+     * @brief Updates the configuration of a pipeline on all the
+     * providers listed in the SSG group (see above).
+     *
+     * @param ssg_file SSG file containing addresses of providers.
+     * @param provider_id Provider id.
+     * @param pipeline_name Name of the pipeline to update.
+     * @param config New JSON configuration for the pipeline.
+     * @param from_iteration First iteration to use the new configuration.
+     * @param token Security token
+     */
+    void updateDistributedPipeline(const std::string& ssg_file,
+                         uint16_t provider_id,
+                         const std::string& pipeline_name,
+                         const json& config,
+                         uint64_t from_iteration = 0,
+                         const std::string& token="") const {
+        return updateDistributedPipeline(ssg_file, provider_id, pipeline_name,
+                                         config.dump(), from_iteration, token);
+    }
+
     /**
      * @brief Shutdown all the members of the SSG group.
      *
@@ -261,10 +402,16 @@ class Admin {
      * @brief Request the server to leave the group and shutdown
      * by calling the "leave" RPC of a provider.
      *
+     * If migrate is true, the blocks held by the server's pipelines
+     * are moved to the remaining servers before it leaves, and blocks
+     * staged to it during the on-going iteration are forwarded to them.
+     *
      * @param address Address of the server.
      * @param provider_id Provider id of the provider.
+     * @param migrate Whether to migrate the server's data.
      */
-    void makeServerLeave(const std::string& address, uint16_t provider_id) const;
+    void makeServerLeave(const std::string& address, uint16_t provider_id,
+                         bool migrate = false) const;
 
     /**
      * @brief Request a set of servers, represented by their rank
@@ -273,11 +420,13 @@ class Admin {
      * @param ssg_file SSG group file name.
      * @param ranks Ranks to shutdown.
      * @param provider_id Provider id.
+     * @param migrate Whether to migrate the servers' data.
      */
     void makeServersLeave(
         const std::string& ssg_file,
         const std::vector<int>& ranks,
-        uint16_t provider_id) const;
+        uint16_t provider_id,
+        bool migrate = false) const;
 
     private:
 
@@ -7,15 +7,22 @@
 #define __COLZA_BACKEND_HPP
 
 #include <colza/RequestResult.hpp>
+#include <colza/ErrorCodes.hpp>
 #include <colza/Types.hpp>
 
 #include <ssg.h>
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <thallium.hpp>
 #include <mona.h>
+#include <colza/BlockGeometry.hpp>
+#include <colza/BlockStore.hpp>
+#include <colza/Communicator.hpp>
+#include <colza/GroupView.hpp>
 
 /**
  * @brief Helper class to register backend types into the backend factory.
@@ -25,6 +32,29 @@ class __ColzaBackendRegistration;
 
 namespace colza {
 
+/**
+ * @brief Description of a block held by a pipeline, used when
+ * the block has to be moved to another server. The data field is
+ * a bulk handle exposing the block's memory in read-only mode; the
+ * backend must keep this memory valid until the pipeline is destroyed.
+ */
+struct ExportedBlock {
+    std::string          dataset_name;
+    uint64_t             iteration;
+    uint64_t             block_id;
+    std::vector<size_t>  dimensions;
+    std::vector<int64_t> offsets;
+    Type                 type;
+    thallium::bulk       data;
+};
+
+/**
+ * @brief Function through which Backend::fetch hands a block over to
+ * the provider, which pushes it into the client's buffer. The data
+ * only needs to remain valid for the duration of the call.
+ */
+typedef std::function<RequestResult<int32_t>(const BlockInfo&, const void*)> FetchCallback;
+
 /**
  * @brief Interface for pipeline backends. To build a new backend,
  * implement a class MyBackend that inherits from Backend, and put
@@ -81,6 +111,38 @@ class Backend {
         mona_instance_t mona,
         const std::vector<na_addr_t>& addresses) = 0;
 
+    /**
+     * @brief Notifies the pipeline of a new view of the group. It is
+     * called after updateMonaAddresses (whose addresses are those of
+     * the view, in rank order) when the pipeline is created and every
+     * time the membership changes. The view's deltas (joined, left,
+     * rank_map) can be used to update communication structures
+     * incrementally; they are empty in the first view a pipeline gets.
+     * The default implementation ignores the view.
+     *
+     * @param view New view of the group.
+     */
+    virtual void updateGroupView(const GroupView& view) {
+        (void)view;
+    }
+
+    /**
+     * @brief Hands the pipeline a Communicator built by the provider
+     * from the group's MoNA addresses. It is called after
+     * updateMonaAddresses, every time the membership changes. The
+     * Communicators of a pipeline share a context that the provider
+     * assigns to the pipeline when it is created, so their collectives
+     * never mix with those of other pipelines of the process. The
+     * pipeline's own collectives should not be issued
+     * concurrently on it: parts of a pipeline that need to do so use
+     * Communicator::derive. The default implementation ignores it.
+     *
+     * @param comm Communicator.
+     */
+    virtual void updateCommunicator(const Communicator& comm) {
+        (void)comm;
+    }
+
     /**
      * @brief Tells the pipeline that the given iteration is starting.
      * This function should be called before stage/execute/cleanup can
@@ -125,6 +187,37 @@ class Backend {
             const Type& type,
             const thallium::bulk& data) = 0;
 
+    /**
+     * @brief Stages a block that is already in the memory of this
+     * process and shared with other consumers, such as the stages of
+     * a composite pipeline. The pipeline may keep the pointer for as
+     * long as it needs the block, but must not modify the block. The
+     * default implementation reports that the backend cannot share
+     * blocks, in which case callers fall back to stage.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param block_id Block id
+     * @param block Block
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> stageShared(
+            const std::string& dataset_name,
+            uint64_t iteration,
+            uint64_t block_id,
+            const BlockStore::BlockPtr& block) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)block_id;
+        (void)block;
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support shared blocks";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
     /**
      * @brief Execute the pipeline on a specific iteration of data.
      *
@@ -153,8 +246,197 @@ class Backend {
      */
     virtual RequestResult<int32_t> destroy() = 0;
 
+    /**
+     * @brief Apply a new JSON configuration to the pipeline without
+     * destroying it. The provider only calls this function between
+     * iterations (never while the pipeline is active), so backends do
+     * not need to synchronize it with stage/execute/cleanup.
+     * The default implementation reports that live reconfiguration
+     * is not supported by the backend.
+     *
+     * @param config New configuration.
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> reconfigure(const nlohmann::json& config) {
+        (void)config;
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support reconfiguration";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
+    /**
+     * @brief Brings a destroyed pipeline back to a reusable state, so
+     * that the provider can keep the instance in its pool of prewarmed
+     * backends and hand it over to a future pipeline of the same type
+     * (calling reconfigure with the new pipeline's configuration).
+     * Implementations should release all the data associated with
+     * previous iterations but keep expensive resources. The default
+     * implementation reports that instances cannot be recycled.
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> reset() {
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support being reset";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
+    /**
+     * @brief Returns the blocks (staged or retained across iterations)
+     * held by this pipeline, so that the provider can migrate them to
+     * other servers when leaving the group. Once they are migrated, the
+     * provider calls cleanup on their past iterations, and aborts then
+     * starts again the active iteration, which the pipeline still
+     * executes (taking part in its collective operations) without them.
+     * The default implementation returns no block, i.e. the pipeline's
+     * data is not migrated.
+     *
+     * @return a vector of ExportedBlock.
+     */
+    virtual std::vector<ExportedBlock> exportBlocks() {
+        return {};
+    }
+
+    /**
+     * @brief Looks up a block (staged, or derived from the staged data
+     * by execute) and hands it over to the provider by calling push
+     * once, returning push's result. Backends decide which names they
+     * serve besides those of the staged datasets. Fetching may happen
+     * at any time, including while other iterations are being staged
+     * or executed, so implementations must protect their data until
+     * push returns. The default implementation reports that blocks
+     * cannot be fetched from the backend.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param block_id Block id
+     * @param push Function to call with the block
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> fetch(const std::string& dataset_name,
+                                         uint64_t iteration,
+                                         uint64_t block_id,
+                                         const FetchCallback& push) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)block_id;
+        (void)push;
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support fetching blocks";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
+    /**
+     * @brief Hands the provider each block of the dataset (staged, or
+     * derived by execute) that intersects the region, by calling push
+     * once per block and stopping at the first failure. The provider
+     * extracts the intersection and pushes it to the client, so push
+     * expects whole blocks. Having no block intersecting the region is
+     * not an error. The default implementation reports that regions
+     * cannot be queried from the backend.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param region Region of the global index space
+     * @param push Function to call with each block
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> query(const std::string& dataset_name,
+                                         uint64_t iteration,
+                                         const Box& region,
+                                         const FetchCallback& push) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)region;
+        (void)push;
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support region queries";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
+    /**
+     * @brief Returns at most max_boxes boxes covering the blocks of the
+     * dataset held by this pipeline, which clients use to send region
+     * queries only to the servers that may hold matching data. The
+     * default implementation reports that the backend cannot summarize
+     * its blocks, and clients then always query it.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param max_boxes Maximum number of boxes
+     * @param boxes Resulting boxes
+     *
+     * @return a RequestResult containing an error code.
+     */
+    virtual RequestResult<int32_t> summarize(const std::string& dataset_name,
+                                             uint64_t iteration,
+                                             size_t max_boxes,
+                                             std::vector<Box>& boxes) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)max_boxes;
+        (void)boxes;
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = "Backend does not support summarizing its blocks";
+        result.value() = (int32_t)ErrorCode::NOT_SUPPORTED;
+        return result;
+    }
+
+    /**
+     * @brief Hash used by the provider to find the new owner of a
+     * block when migrating it. It matches the default HashFunction of
+     * DistributedPipelineHandle (the block id); blocks of clients that
+     * set their own HashFunction are not migrated.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param block_id Block id
+     *
+     * @return a hash value.
+     */
+    virtual uint64_t placementHash(const std::string& dataset_name,
+                                   uint64_t iteration,
+                                   uint64_t block_id) const {
+        (void)dataset_name;
+        (void)iteration;
+        return block_id;
+    }
+
 };
 
+/**
+ * @brief Hands a shared block to a pipeline with Backend::stageShared
+ * or, if the backend does not support shared blocks, exposes the block
+ * and stages it from this process with Backend::stage.
+ *
+ * @param backend Pipeline
+ * @param engine Engine used to expose the block
+ * @param dataset_name Dataset name
+ * @param iteration Iteration
+ * @param block_id Block id
+ * @param block Block
+ *
+ * @return the result of stageShared or stage.
+ */
+RequestResult<int32_t> StageSharedBlock(Backend& backend,
+                                        const thallium::engine& engine,
+                                        const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const BlockStore::BlockPtr& block);
+
 /**
  * @brief Arguments required by a pipeline to be constructed.
  */
@@ -164,7 +446,11 @@ struct PipelineFactoryArgs {
 
     ssg_group_id_t   gid;
     thallium::engine engine;
+    thallium::pool   pool;
     json             config;
+    // number of execution streams serving pool, to size the backend's
+    // parallel work (0 if unknown, see TaskRuntime)
+    size_t           concurrency = 0;
 };
 
 /**
@@ -0,0 +1,115 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_BLOCK_CATALOG_HPP
+#define __COLZA_BLOCK_CATALOG_HPP
+
+#include <colza/BlockGeometry.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief A BlockCatalog records the boxes covered by the blocks a
+ * server holds, per iteration and dataset, and finds the blocks that
+ * intersect a region without scanning all of them.
+ *
+ * The blocks of each (iteration, dataset) pair are indexed with a
+ * uniform grid whose cells have the extents of the first block
+ * inserted, which suits the regular decompositions of simulations:
+ * a block is registered in the few cells it overlaps, and a lookup
+ * only visits the cells overlapping the region. Blocks much larger
+ * than a cell, or with a different number of dimensions, are kept
+ * aside and always tested.
+ *
+ * The catalog is built incrementally as blocks are inserted. It is
+ * not thread-safe: callers protect it with the lock of the data it
+ * describes.
+ */
+class BlockCatalog {
+
+    public:
+
+    BlockCatalog();
+
+    BlockCatalog(BlockCatalog&&);
+
+    BlockCatalog& operator=(BlockCatalog&&);
+
+    ~BlockCatalog();
+
+    /**
+     * @brief Records a block, replacing the box of the block with the
+     * same id if there is one.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param block_id Block id
+     * @param box Box covered by the block
+     */
+    void insert(const std::string& dataset_name,
+                uint64_t iteration,
+                uint64_t block_id,
+                const Box& box);
+
+    /**
+     * @brief Forgets a block.
+     *
+     * @return whether the block was in the catalog.
+     */
+    bool erase(const std::string& dataset_name,
+               uint64_t iteration,
+               uint64_t block_id);
+
+    /**
+     * @brief Forgets all the blocks of an iteration.
+     */
+    void erase(uint64_t iteration);
+
+    /**
+     * @brief Forgets all the blocks.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the ids of the blocks of the dataset that intersect
+     * the region, in increasing order.
+     */
+    std::vector<uint64_t> find(const std::string& dataset_name,
+                               uint64_t iteration,
+                               const Box& region) const;
+
+    /**
+     * @brief Returns at most max_boxes boxes covering all the blocks of
+     * the dataset (the boxes of the blocks themselves if there are few
+     * enough, otherwise the bounding boxes of groups of neighboring
+     * blocks), to be shared with other processes so that they can tell
+     * whether this server may hold data in a region.
+     */
+    std::vector<Box> summary(const std::string& dataset_name,
+                             uint64_t iteration,
+                             size_t max_boxes) const;
+
+    /**
+     * @brief Number of blocks of the dataset in the catalog.
+     */
+    size_t count(const std::string& dataset_name, uint64_t iteration) const;
+
+    private:
+
+    struct Index;
+
+    std::map<uint64_t, std::unordered_map<std::string, std::unique_ptr<Index>>> m_indices;
+
+    const Index* index(const std::string& dataset_name, uint64_t iteration) const;
+};
+
+}
+
+#endif
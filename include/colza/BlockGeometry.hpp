@@ -0,0 +1,221 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_BLOCK_GEOMETRY_HPP
+#define __COLZA_BLOCK_GEOMETRY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief A Box is an N-dimensional region of a global index space,
+ * from lower (inclusive) to upper (exclusive) in each dimension.
+ *
+ * Blocks staged into Colza are described by their dimensions and
+ * offsets; the block then covers Box::FromBlock(dimensions, offsets)
+ * and its data is stored in row-major order (the last dimension
+ * varies fastest).
+ */
+struct Box {
+
+    std::vector<int64_t> lower;
+    std::vector<int64_t> upper;
+
+    Box() = default;
+
+    Box(std::vector<int64_t> lo, std::vector<int64_t> up)
+    : lower(std::move(lo))
+    , upper(std::move(up)) {}
+
+    static Box FromBlock(const std::vector<size_t>& dimensions,
+                         const std::vector<int64_t>& offsets) {
+        Box box;
+        box.lower.resize(dimensions.size(), 0);
+        box.upper.resize(dimensions.size(), 0);
+        for(size_t d = 0; d < dimensions.size(); d++) {
+            box.lower[d] = d < offsets.size() ? offsets[d] : 0;
+            box.upper[d] = box.lower[d] + (int64_t)dimensions[d];
+        }
+        return box;
+    }
+
+    size_t ndims() const {
+        return lower.size();
+    }
+
+    bool empty() const {
+        for(size_t d = 0; d < ndims(); d++)
+            if(upper[d] <= lower[d]) return true;
+        return ndims() == 0;
+    }
+
+    size_t volume() const {
+        if(empty()) return 0;
+        size_t v = 1;
+        for(size_t d = 0; d < ndims(); d++)
+            v *= (size_t)(upper[d] - lower[d]);
+        return v;
+    }
+
+    std::vector<size_t> extents() const {
+        std::vector<size_t> e(ndims());
+        for(size_t d = 0; d < ndims(); d++)
+            e[d] = upper[d] > lower[d] ? (size_t)(upper[d] - lower[d]) : 0;
+        return e;
+    }
+
+    /**
+     * @brief Returns the intersection of two boxes (empty if they
+     * don't intersect or have different numbers of dimensions).
+     */
+    Box intersect(const Box& other) const {
+        if(other.ndims() != ndims()) return Box();
+        Box box;
+        box.lower.resize(ndims());
+        box.upper.resize(ndims());
+        for(size_t d = 0; d < ndims(); d++) {
+            box.lower[d] = std::max(lower[d], other.lower[d]);
+            box.upper[d] = std::min(upper[d], other.upper[d]);
+        }
+        return box;
+    }
+
+    bool intersects(const Box& other) const {
+        return !intersect(other).empty();
+    }
+
+    bool contains(const Box& other) const {
+        if(other.ndims() != ndims()) return false;
+        for(size_t d = 0; d < ndims(); d++)
+            if(other.lower[d] < lower[d] || other.upper[d] > upper[d]) return false;
+        return true;
+    }
+
+    /**
+     * @brief Returns the box extended by width cells on every side.
+     */
+    Box grow(int64_t width) const {
+        Box box = *this;
+        for(size_t d = 0; d < ndims(); d++) {
+            box.lower[d] -= width;
+            box.upper[d] += width;
+        }
+        return box;
+    }
+
+    bool operator==(const Box& other) const {
+        return lower == other.lower && upper == other.upper;
+    }
+
+    bool operator!=(const Box& other) const {
+        return !(*this == other);
+    }
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & lower;
+        a & upper;
+    }
+};
+
+/**
+ * @brief Calls f(src_offset, dst_offset, run_size) for each contiguous
+ * run of the region in a buffer covering src_box and in a buffer
+ * covering dst_box (both in row-major order), with offsets and sizes
+ * in bytes. The region must be contained in both boxes. Trailing
+ * dimensions are merged into a single run when they span the full
+ * width of both buffers.
+ *
+ * @param src_box Box covered by the source buffer.
+ * @param dst_box Box covered by the destination buffer.
+ * @param region Region to iterate over.
+ * @param element_size Size of an element in bytes.
+ * @param f Function called for each run.
+ */
+template<typename F>
+void ForEachRun(const Box& src_box, const Box& dst_box,
+                const Box& region, size_t element_size, F&& f) {
+    if(region.empty()) return;
+    const size_t n = region.ndims();
+    const auto src_ext = src_box.extents();
+    const auto dst_ext = dst_box.extents();
+    const auto reg_ext = region.extents();
+    // find how many trailing dimensions can be copied as one run
+    size_t run = element_size;
+    size_t first_inner = n;
+    while(first_inner > 0) {
+        size_t d = first_inner - 1;
+        run *= reg_ext[d];
+        first_inner = d;
+        if(reg_ext[d] != src_ext[d] || reg_ext[d] != dst_ext[d])
+            break;
+    }
+    // strides (in bytes) of each dimension in both buffers
+    std::vector<size_t> src_stride(n), dst_stride(n);
+    size_t ss = element_size, ds = element_size;
+    for(size_t d = n; d-- > 0;) {
+        src_stride[d] = ss;
+        dst_stride[d] = ds;
+        ss *= src_ext[d];
+        ds *= dst_ext[d];
+    }
+    size_t src_base = 0, dst_base = 0;
+    for(size_t d = 0; d < n; d++) {
+        src_base += (size_t)(region.lower[d] - src_box.lower[d])*src_stride[d];
+        dst_base += (size_t)(region.lower[d] - dst_box.lower[d])*dst_stride[d];
+    }
+    // iterate over the outer dimensions (0 .. first_inner-1)
+    std::vector<size_t> idx(first_inner, 0);
+    while(true) {
+        size_t so = src_base, doff = dst_base;
+        for(size_t d = 0; d < first_inner; d++) {
+            so   += idx[d]*src_stride[d];
+            doff += idx[d]*dst_stride[d];
+        }
+        f(so, doff, run);
+        size_t d = first_inner;
+        while(d > 0) {
+            d -= 1;
+            if(++idx[d] < reg_ext[d]) break;
+            idx[d] = 0;
+            if(d == 0) return;
+        }
+        if(first_inner == 0) return;
+    }
+}
+
+/**
+ * @brief Copies the elements of region from a buffer covering src_box
+ * to a buffer covering dst_box (both in row-major order). The region
+ * must be contained in both boxes. Contiguous runs are copied with a
+ * single memcpy (see ForEachRun), so packing a face into a contiguous
+ * buffer (dst_box == region) or unpacking it never copies more than
+ * the region.
+ *
+ * @param src Source buffer.
+ * @param src_box Box covered by the source buffer.
+ * @param dst Destination buffer.
+ * @param dst_box Box covered by the destination buffer.
+ * @param region Region to copy.
+ * @param element_size Size of an element in bytes.
+ */
+inline void CopyRegion(const void* src, const Box& src_box,
+                       void* dst, const Box& dst_box,
+                       const Box& region, size_t element_size) {
+    auto in  = static_cast<const char*>(src);
+    auto out = static_cast<char*>(dst);
+    ForEachRun(src_box, dst_box, region, element_size,
+        [in, out](size_t src_offset, size_t dst_offset, size_t size) {
+            std::memcpy(out + dst_offset, in + src_offset, size);
+        });
+}
+
+}
+
+#endif
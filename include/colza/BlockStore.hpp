@@ -0,0 +1,236 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_BLOCK_STORE_HPP
+#define __COLZA_BLOCK_STORE_HPP
+
+#include <colza/Types.hpp>
+#include <thallium.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace colza {
+
+namespace tl = thallium;
+
+/**
+ * @brief A BlockStore holds the blocks staged into a backend, by
+ * iteration, dataset, and block id.
+ *
+ * Dataset names are interned into small integer ids, and the blocks
+ * of an iteration are indexed by flat (open addressing) hash tables
+ * keyed by (dataset id, block id). The tables are split into shards,
+ * each with its own lock, so that concurrent stage RPCs only contend
+ * when their blocks hash to the same shard, and no lock is held while
+ * a block is pulled from its sender. The payloads are carved out of
+ * large, cache-line aligned chunks owned by the iteration, so that
+ * erasing an iteration only unlinks it from the store, whatever the
+ * number of its blocks.
+ *
+ * Blocks are handed out as BlockPtrs, which keep the memory of their
+ * iteration alive: a block found before its iteration is erased remains
+ * valid until the last BlockPtr to it is released.
+ *
+ * All the member functions are thread-safe.
+ */
+class BlockStore {
+
+    public:
+
+    typedef uint32_t DatasetId;
+
+    /**
+     * @brief Block held by a BlockStore. The block is not modified
+     * once it has been stored.
+     */
+    struct Block {
+
+        DatasetId            dataset = 0;
+        const std::string*   dataset_name = nullptr;
+        uint64_t             block_id = 0;
+        std::vector<size_t>  dimensions;
+        std::vector<int64_t> offsets;
+        Type                 type = Type::UINT8;
+        char*                data = nullptr;
+        size_t               size = 0;
+
+        /**
+         * @brief Number of elements in the block.
+         */
+        size_t count() const {
+            size_t c = 1;
+            for(auto d : dimensions) c *= d;
+            return c;
+        }
+    };
+
+    typedef std::shared_ptr<const Block> BlockPtr;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param num_shards Number of shards of each iteration (rounded
+     * up to a power of 2).
+     * @param chunk_size Size of the chunks payloads are carved from.
+     * Payloads larger than a quarter of a chunk get their own chunk.
+     */
+    BlockStore(size_t num_shards = 16, size_t chunk_size = 4*1024*1024);
+
+    BlockStore(const BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    ~BlockStore();
+
+    /**
+     * @brief Returns the id of a dataset name, assigning one if the
+     * name has never been seen. Ids are never reused.
+     */
+    DatasetId intern(const std::string& dataset_name);
+
+    /**
+     * @brief Pulls a block from its sender directly into the store.
+     *
+     * @param engine Engine used to pull the block
+     * @param sender_addr Address of the sender
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param block_id Block id
+     * @param dimensions Dimensions of the block
+     * @param offsets Offsets of the block
+     * @param type Type of the elements
+     * @param data Bulk handle of the sender's block
+     *
+     * @return the stored block. Throws a colza::Exception if a block
+     * with the same iteration, name, and id is stored or being stored,
+     * or if the transfer fails (the block is then not stored).
+     */
+    BlockPtr stage(const tl::engine& engine,
+                   const std::string& sender_addr,
+                   const std::string& dataset_name,
+                   uint64_t iteration,
+                   uint64_t block_id,
+                   const std::vector<size_t>& dimensions,
+                   const std::vector<int64_t>& offsets,
+                   const Type& type,
+                   const tl::bulk& data);
+
+    /**
+     * @brief Pulls a block into memory owned by the returned BlockPtr
+     * alone, outside of any store, for blocks that several consumers
+     * link into their own stores. Throws like stage.
+     */
+    static BlockPtr Pull(const tl::engine& engine,
+                         const std::string& sender_addr,
+                         const std::string& dataset_name,
+                         uint64_t block_id,
+                         const std::vector<size_t>& dimensions,
+                         const std::vector<int64_t>& offsets,
+                         const Type& type,
+                         const tl::bulk& data);
+
+    /**
+     * @brief Copies a block into the store. Same as stage, for blocks
+     * that are already in memory.
+     */
+    BlockPtr insert(const std::string& dataset_name,
+                    uint64_t iteration,
+                    uint64_t block_id,
+                    const std::vector<size_t>& dimensions,
+                    const std::vector<int64_t>& offsets,
+                    const Type& type,
+                    const void* data,
+                    size_t size);
+
+    /**
+     * @brief Stores a block of another store (or any block kept alive
+     * by a BlockPtr) under the given iteration, name, and id, without
+     * copying its payload, which remains alive as long as this store
+     * refers to it. Throws like stage if the block already exists.
+     */
+    BlockPtr link(const std::string& dataset_name,
+                  uint64_t iteration,
+                  uint64_t block_id,
+                  const BlockPtr& block);
+
+    /**
+     * @brief Returns a block, or a null BlockPtr if it is not stored.
+     */
+    BlockPtr find(const std::string& dataset_name,
+                  uint64_t iteration,
+                  uint64_t block_id) const;
+
+    /**
+     * @brief Returns the blocks of an iteration, sorted by dataset
+     * name and block id.
+     */
+    std::vector<BlockPtr> blocks(uint64_t iteration) const;
+
+    /**
+     * @brief Returns the blocks of a dataset, sorted by block id.
+     */
+    std::vector<BlockPtr> blocks(const std::string& dataset_name,
+                                 uint64_t iteration) const;
+
+    /**
+     * @brief Returns the names of the datasets that have blocks in
+     * the iteration, sorted.
+     */
+    std::vector<std::string> datasets(uint64_t iteration) const;
+
+    /**
+     * @brief Returns the iterations that have not been erased, sorted.
+     */
+    std::vector<uint64_t> iterations() const;
+
+    /**
+     * @brief Erases all the blocks of an iteration. Their memory is
+     * released once no BlockPtr refers to them.
+     */
+    void erase(uint64_t iteration);
+
+    /**
+     * @brief Erases all the blocks.
+     */
+    void clear();
+
+    private:
+
+    struct Names;
+    struct Iteration;
+
+    struct Reservation {
+        std::shared_ptr<Iteration> iteration;
+        Block*                     block = nullptr;
+    };
+
+    size_t                                         m_num_shards;
+    size_t                                         m_chunk_size;
+    std::shared_ptr<Names>                         m_names;
+    std::map<uint64_t, std::shared_ptr<Iteration>> m_iterations;
+    mutable tl::mutex                              m_iterations_mtx;
+
+    std::shared_ptr<Iteration> iteration(uint64_t iteration) const;
+
+    Reservation reserve(const std::string& dataset_name,
+                        uint64_t iteration,
+                        uint64_t block_id,
+                        const std::vector<size_t>& dimensions,
+                        const std::vector<int64_t>& offsets,
+                        const Type& type,
+                        size_t size);
+
+    void publish(const Reservation& r, const BlockPtr& owner = nullptr);
+
+    void discard(const Reservation& r);
+
+    std::vector<BlockPtr> collect(uint64_t iteration, const DatasetId* dataset) const;
+};
+
+}
+
+#endif
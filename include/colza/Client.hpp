@@ -11,6 +11,7 @@
 #include <colza/DistributedPipelineHandle.hpp>
 #include <thallium.hpp>
 #include <memory>
+#include <vector>
 
 namespace colza {
 
@@ -115,6 +116,28 @@ class Client {
             const std::string& pipeline_name,
             bool check = true) const;
 
+    /**
+     * @brief Creates a handle to multiple remote pipelines, each
+     * server of the SSG group running several providers (shards).
+     * Data will be distributed across all the (server, provider_id)
+     * pairs. You may set "check" to false if you know for sure that
+     * the corresponding pipeline exists.
+     *
+     * @param comm communicator gathering all clients
+     * @param ssg_group_file SSG group gathering all pipelines
+     * @param provider_ids Provider ids to use on each server
+     * @param pipeline_name Pipeline name
+     * @param check Checks if the Pipeline exists by issuing an RPC.
+     *
+     * @return a DistributedPipelineHandle instance.
+     */
+    DistributedPipelineHandle makeDistributedPipelineHandle(
+            const ClientCommunicator* comm,
+            const std::string& ssg_group_file,
+            const std::vector<uint16_t>& provider_ids,
+            const std::string& pipeline_name,
+            bool check = true) const;
+
     /**
      * @brief Checks that the Client instance is valid.
      */
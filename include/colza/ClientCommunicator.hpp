@@ -6,6 +6,9 @@
 #ifndef __COLZA_CLIENT_COMMUNICATOR_HPP
 #define __COLZA_CLIENT_COMMUNICATOR_HPP
 
+#include <cstdint>
+#include <vector>
+
 namespace colza {
 
 /**
@@ -28,6 +31,23 @@ class ClientCommunicator {
 
     virtual void bcast(void* buffer, int bytes, int root) const = 0;
 
+    /**
+     * @brief Replaces values, on all the processes, by the element-wise
+     * sum of the values of all the processes. The default implementation
+     * has each process broadcast its values in turn.
+     */
+    virtual void allreduceSum(uint64_t* values, int count) const {
+        std::vector<uint64_t> sum(values, values + count);
+        std::vector<uint64_t> other(count);
+        for(int root = 0; root < size(); root++) {
+            if(root == rank()) other.assign(values, values + count);
+            bcast(other.data(), count*sizeof(uint64_t), root);
+            if(root == rank()) continue;
+            for(int i = 0; i < count; i++) sum[i] += other[i];
+        }
+        for(int i = 0; i < count; i++) values[i] = sum[i];
+    }
+
 };
 
 }
@@ -0,0 +1,335 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_COMMUNICATOR_HPP
+#define __COLZA_COMMUNICATOR_HPP
+
+#include <thallium.hpp>
+#include <mona.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <colza/Types.hpp>
+#include <colza/Exception.hpp>
+
+namespace colza {
+
+namespace tl = thallium;
+
+class CommunicatorImpl;
+class CommunicatorRequestImpl;
+
+/**
+ * @brief The Communicator class provides collective communication
+ * primitives among the servers of a Colza group, on top of MoNA.
+ * It is built by the provider from the MoNA addresses of the group
+ * and handed to each pipeline via Backend::updateCommunicator.
+ *
+ * Ranks follow the order of the addresses provided by the provider,
+ * i.e. the ranks of the corresponding GroupView. As with MPI
+ * communicators, collective operations must be called in the same
+ * order by all the members, and the communicator should not be shared
+ * by pipelines that issue collectives concurrently. Non-blocking
+ * operations reserve their slot in that order when they are posted.
+ *
+ * Communicators built over the same MoNA instance, e.g. those of the
+ * pipelines of all the providers of a process, tell their messages
+ * apart by a context identifier, which the provider assigns to each
+ * pipeline when it is created. Communicators with different contexts
+ * can therefore issue collectives concurrently.
+ *
+ * At most MAX_PENDING operations of a communicator are in progress at
+ * any time: posting (or calling) another one waits for the operation
+ * posted MAX_PENDING operations earlier to complete. Collectives whose
+ * algorithm would need more than MAX_STEPS rounds of messages throw a
+ * colza::Exception with ErrorCode::OTHER_ERROR on all the members
+ * before sending anything.
+ *
+ * All the functions throw a colza::Exception with ErrorCode::MONA_ERROR
+ * if a communication fails.
+ */
+class Communicator {
+
+    public:
+
+    /**
+     * @brief Largest context identifier.
+     */
+    static constexpr uint32_t MAX_CONTEXT = 0xFF;
+
+    /**
+     * @brief Maximum number of communicators derived (directly or not)
+     * from a communicator.
+     */
+    static constexpr uint32_t MAX_DERIVED = 7;
+
+    /**
+     * @brief Maximum number of operations in progress.
+     */
+    static constexpr uint32_t MAX_PENDING = 128;
+
+    /**
+     * @brief Maximum number of rounds of messages of a collective.
+     */
+    static constexpr uint32_t MAX_STEPS = 0x1FFF;
+
+    /**
+     * @brief Reduction operations.
+     */
+    enum class ReduceOp : uint32_t {
+        SUM,
+        PROD,
+        MIN,
+        MAX
+    };
+
+    /**
+     * @brief Algorithms for allreduce-like operations. AUTO selects
+     * recursive doubling for small messages, Rabenseifner's algorithm
+     * (recursive halving reduce-scatter followed by a recursive doubling
+     * allgather) for large messages when the size of the communicator
+     * is a power of two, and a ring otherwise.
+     */
+    enum class Algorithm : uint32_t {
+        AUTO,
+        RING,
+        RECURSIVE_DOUBLING,
+        RABENSEIFNER
+    };
+
+    /**
+     * @brief Handle to an on-going non-blocking collective operation.
+     * If the handle is destroyed before being waited on, the destructor
+     * of the last copy waits for the operation to complete.
+     */
+    class Request {
+
+        friend class Communicator;
+
+        public:
+
+        Request();
+        Request(const Request&);
+        Request(Request&&);
+        Request& operator=(const Request&);
+        Request& operator=(Request&&);
+        ~Request();
+
+        /**
+         * @brief Wait for the operation to complete. Rethrows the
+         * exception raised by the operation, if any.
+         */
+        void wait() const;
+
+        /**
+         * @brief Test whether the operation has completed.
+         */
+        bool completed() const;
+
+        /**
+         * @brief Checks if the Request is valid.
+         */
+        operator bool() const;
+
+        private:
+
+        std::shared_ptr<CommunicatorRequestImpl> self;
+
+        Request(const std::shared_ptr<CommunicatorRequestImpl>& impl);
+    };
+
+    /**
+     * @brief Constructor. The resulting Communicator will be invalid.
+     */
+    Communicator();
+
+    /**
+     * @brief Constructor.
+     *
+     * @param mona MoNA instance.
+     * @param addresses MoNA addresses of the members, in rank order.
+     * The addresses are duplicated, so the caller keeps ownership.
+     * @param pool Pool in which to run non-blocking operations.
+     * @param context Context identifier, at most MAX_CONTEXT and the
+     * same on all the members. Communicators of this process that
+     * issue collectives concurrently should have different contexts,
+     * except for context 0, which is shared by all the communicators
+     * created without one.
+     */
+    Communicator(mona_instance_t mona,
+                 const std::vector<na_addr_t>& addresses,
+                 const tl::pool& pool,
+                 uint32_t context = 0);
+
+    /**
+     * @brief Copy-constructor. Copies share the same underlying
+     * communicator (and the same ordering of collective operations).
+     */
+    Communicator(const Communicator&);
+
+    /**
+     * @brief Move-constructor.
+     */
+    Communicator(Communicator&&);
+
+    /**
+     * @brief Copy-assignment operator.
+     */
+    Communicator& operator=(const Communicator&);
+
+    /**
+     * @brief Move-assignment operator.
+     */
+    Communicator& operator=(Communicator&&);
+
+    /**
+     * @brief Destructor.
+     */
+    ~Communicator();
+
+    /**
+     * @brief Checks if the Communicator instance is valid.
+     */
+    operator bool() const;
+
+    /**
+     * @brief Returns a new communicator over the same members, with
+     * its own ordering of collective operations (e.g. for the parts of
+     * a pipeline that issue collectives concurrently). Communicators
+     * are told apart by the order in which they are derived, so all
+     * the members should derive them in the same order. Throws a
+     * colza::Exception with ErrorCode::OTHER_ERROR if more than
+     * MAX_DERIVED communicators are derived from the same communicator
+     * or from the communicators derived from it.
+     *
+     * @param name Name of the derived communicator, used in errors.
+     */
+    Communicator derive(const std::string& name) const;
+
+    /**
+     * @brief Number of members in the communicator.
+     */
+    int size() const;
+
+    /**
+     * @brief Rank of the calling process.
+     */
+    int rank() const;
+
+    /**
+     * @brief Blocks until all the members have called barrier.
+     */
+    void barrier() const;
+
+    /**
+     * @brief Broadcasts bytes from the root to all the members.
+     */
+    void bcast(void* buffer, size_t bytes, int root) const;
+
+    /**
+     * @brief Reduces count elements of the given type from all the
+     * members into recvbuf on the root. recvbuf is only used on the root.
+     * sendbuf and recvbuf may be the same buffer.
+     */
+    void reduce(const void* sendbuf, void* recvbuf, size_t count,
+                Type type, ReduceOp op, int root) const;
+
+    /**
+     * @brief Reduces count elements of the given type from all the
+     * members and distributes the result to all of them.
+     * sendbuf and recvbuf may be the same buffer.
+     */
+    void allreduce(const void* sendbuf, void* recvbuf, size_t count,
+                   Type type, ReduceOp op,
+                   Algorithm algorithm = Algorithm::AUTO) const;
+
+    /**
+     * @brief Gathers bytes from each member into recvbuf, which must
+     * be able to hold size()*bytes bytes, ordered by rank.
+     */
+    void allgather(const void* sendbuf, size_t bytes, void* recvbuf) const;
+
+    /**
+     * @brief Reduces the sum(counts) elements of sendbuf across members
+     * and scatters the result, rank i receiving counts[i] elements
+     * (starting at offset counts[0]+...+counts[i-1]) in recvbuf.
+     */
+    void reduceScatter(const void* sendbuf, void* recvbuf,
+                       const std::vector<size_t>& counts,
+                       Type type, ReduceOp op) const;
+
+    /**
+     * @brief All-to-all exchange of variable amounts of data. Counts
+     * and displacements are expressed in bytes and indexed by rank.
+     */
+    void alltoallv(const void* sendbuf,
+                   const std::vector<size_t>& sendcounts,
+                   const std::vector<size_t>& sdispls,
+                   void* recvbuf,
+                   const std::vector<size_t>& recvcounts,
+                   const std::vector<size_t>& rdispls) const;
+
+    /**
+     * @brief Sparse exchange with a set of neighbors. Each member sends
+     * sendcounts[i] bytes (at sdispls[i] in sendbuf) to neighbors[i] and
+     * receives recvcounts[i] bytes (at rdispls[i] in recvbuf) from it.
+     * The neighbor relation must be symmetric and both sides must agree
+     * on the sizes; empty messages are skipped. All the messages are
+     * posted at once using non-blocking MoNA operations. Although only
+     * neighbors communicate, all the members must call this function
+     * (possibly with no neighbor) to keep collectives ordered.
+     */
+    void neighborExchange(const std::vector<int>& neighbors,
+                          const void* sendbuf,
+                          const std::vector<size_t>& sendcounts,
+                          const std::vector<size_t>& sdispls,
+                          void* recvbuf,
+                          const std::vector<size_t>& recvcounts,
+                          const std::vector<size_t>& rdispls) const;
+
+    /**
+     * @brief Non-blocking versions of the above operations. The buffers
+     * (and vectors) must remain valid until the request completes.
+     */
+    Request ibarrier() const;
+
+    Request ibcast(void* buffer, size_t bytes, int root) const;
+
+    Request ireduce(const void* sendbuf, void* recvbuf, size_t count,
+                    Type type, ReduceOp op, int root) const;
+
+    Request iallreduce(const void* sendbuf, void* recvbuf, size_t count,
+                       Type type, ReduceOp op,
+                       Algorithm algorithm = Algorithm::AUTO) const;
+
+    Request iallgather(const void* sendbuf, size_t bytes, void* recvbuf) const;
+
+    Request ireduceScatter(const void* sendbuf, void* recvbuf,
+                           const std::vector<size_t>& counts,
+                           Type type, ReduceOp op) const;
+
+    Request ialltoallv(const void* sendbuf,
+                       const std::vector<size_t>& sendcounts,
+                       const std::vector<size_t>& sdispls,
+                       void* recvbuf,
+                       const std::vector<size_t>& recvcounts,
+                       const std::vector<size_t>& rdispls) const;
+
+    Request ineighborExchange(const std::vector<int>& neighbors,
+                              const void* sendbuf,
+                              const std::vector<size_t>& sendcounts,
+                              const std::vector<size_t>& sdispls,
+                              void* recvbuf,
+                              const std::vector<size_t>& recvcounts,
+                              const std::vector<size_t>& rdispls) const;
+
+    private:
+
+    std::shared_ptr<CommunicatorImpl> self;
+};
+
+}
+
+#endif
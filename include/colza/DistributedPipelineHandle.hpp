@@ -9,6 +9,7 @@
 #include <mpi.h>
 #include <thallium.hpp>
 #include <colza/Types.hpp>
+#include <colza/BlockGeometry.hpp>
 #include <colza/AsyncRequest.hpp>
 #include <colza/PipelineHandle.hpp>
 
@@ -88,21 +89,69 @@ class DistributedPipelineHandle {
 
     /**
      * @brief Set the HashFunction that the DistributedPipelineHandle
-     * will use to select the server to send data to.
+     * will use to select the server to send data to. Servers cannot
+     * place blocks with a custom HashFunction, so they do not migrate
+     * the blocks of iterations started through this handle when they
+     * leave the group.
      *
      * @param hash HashFunction
      */
     void setHashFunction(const HashFunction& hash);
 
+    /**
+     * @brief Retrieves from all the servers a summary (a few boxes) of
+     * where their blocks of a dataset lie at an iteration, so that
+     * subsequent region queries on this dataset and iteration are only
+     * sent to the servers whose blocks may intersect the region.
+     * Servers whose backend cannot summarize its blocks are always
+     * queried. The summary is not updated automatically: it should be
+     * loaded once the blocks of the iteration are staged (and again if
+     * they change), and forgotten with clearCatalog.
+     *
+     * @param dataset_name Dataset name
+     * @param iteration Iteration
+     * @param max_boxes Maximum number of boxes per server
+     */
+    void loadCatalog(const std::string& dataset_name,
+                     uint64_t iteration,
+                     size_t max_boxes = 16);
+
+    /**
+     * @brief Forgets the summaries loaded with loadCatalog.
+     */
+    void clearCatalog();
+
     /**
      * @brief Start the pipeline on a given iteration.
      * This function is not marked const since it can lead to the
-     * distributed pipeline reconfiguring itself.
+     * distributed pipeline reconfiguring itself. This is a collective
+     * operation: each process starts the pipelines of a subset of the
+     * servers, and all the processes throw the same exception if the
+     * iteration could not be started on one of them, in which case it
+     * is aborted on the others.
      *
      * @param iteration Iteration to start.
      */
     void start(uint64_t iteration);
 
+    /**
+     * @brief Start the pipeline on a given iteration, and tell each
+     * server how many blocks it will receive, so that it executes the
+     * iteration by itself as soon as its last block has been staged,
+     * instead of waiting for execute. This is a collective operation
+     * in which each process passes the dataset name and block id of the
+     * blocks it will stage through this handle (with the current
+     * HashFunction). The processes then call wait to get the outcome
+     * of the execution.
+     *
+     * @param iteration Iteration to start.
+     * @param blocks (Dataset name, block id) of the blocks of this process.
+     * @param autoCleanup Whether servers cleanup the iteration after execution.
+     */
+    void start(uint64_t iteration,
+               const std::vector<std::pair<std::string, uint64_t>>& blocks,
+               bool autoCleanup = false);
+
     /**
      * @brief Stage some data into the pipeline using a bulk handle.
      *
@@ -151,9 +200,175 @@ class DistributedPipelineHandle {
                int32_t* result = nullptr,
                AsyncRequest* req = nullptr) const;
 
+    /**
+     * @brief Stage some data, with a single transfer, into this pipeline
+     * and into other pipelines of the same provider (the provider that stage would send the block to). The provider pulls
+     * the block once and the pipelines that support it share its memory.
+     * The block is staged into all the pipelines or, on error, possibly
+     * into only some of them.
+     *
+     * @param[in] other_pipelines Names of the other pipelines
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] dimensions Dimensions
+     * @param[in] offsets Offsets
+     * @param[in] type Type
+     * @param[in] data Data as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void stageShared(const std::vector<std::string>& other_pipelines,
+                     const std::string& dataset_name,
+                     uint64_t iteration,
+                     uint64_t block_id,
+                     const std::vector<size_t>& dimensions,
+                     const std::vector<int64_t>& offsets,
+                     const Type& type,
+                     const thallium::bulk& data,
+                     const std::string& origin_addr = "",
+                     int32_t* result = nullptr,
+                     AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Stage some local data into this pipeline and into other
+     * pipelines of the same provider (the provider that stage would send the block to).
+     *
+     * @param[in] other_pipelines Names of the other pipelines
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] dimensions Dimensions
+     * @param[in] offsets Offsets
+     * @param[in] type Type
+     * @param[in] data Local data
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void stageShared(const std::vector<std::string>& other_pipelines,
+                     const std::string& dataset_name,
+                     uint64_t iteration,
+                     uint64_t block_id,
+                     const std::vector<size_t>& dimensions,
+                     const std::vector<int64_t>& offsets,
+                     const Type& type,
+                     const void* data,
+                     int32_t* result = nullptr,
+                     AsyncRequest* req = nullptr) const;
+
+
+    /**
+     * @brief Fetch a block (staged, or derived by the pipeline) into
+     * memory exposed by a bulk handle, from the server selected by the
+     * HashFunction.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] data Destination as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] info Description of the block
+     * @param[out] req Asynchronous request
+     */
+    void fetch(const std::string& dataset_name,
+               uint64_t iteration,
+               uint64_t block_id,
+               const thallium::bulk& data,
+               const std::string& origin_addr = "",
+               BlockInfo* info = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Fetch a block (staged, or derived by the pipeline) into a
+     * local buffer, from the server selected by the HashFunction.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] buffer Destination buffer
+     * @param[in] size Size of the buffer
+     * @param[out] info Description of the block
+     * @param[out] req Asynchronous request
+     */
+    void fetch(const std::string& dataset_name,
+               uint64_t iteration,
+               uint64_t block_id,
+               void* buffer,
+               size_t size,
+               BlockInfo* info = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Fetch a batch of blocks, sending a single RPC to each
+     * of the servers selected by the HashFunction, concurrently.
+     * Failures to fetch individual blocks are reported in the requests
+     * instead of being thrown. The requests must remain valid until the
+     * asynchronous request has completed.
+     *
+     * @param[in,out] requests Blocks to fetch
+     * @param[out] req Asynchronous request
+     */
+    void fetch(std::vector<FetchRequest>& requests,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Query a region of a dataset into memory exposed by a
+     * bulk handle, sending the query to all the servers concurrently.
+     * Each server extracts the parts of its blocks that intersect the
+     * region and pushes them to their place in the bulk handle, which
+     * covers the region in row-major order. Elements not covered by any
+     * block are left untouched.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] region Region of the global index space
+     * @param[in] type Type of the dataset
+     * @param[in] data Destination as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void query(const std::string& dataset_name,
+               uint64_t iteration,
+               const Box& region,
+               const Type& type,
+               const thallium::bulk& data,
+               const std::string& origin_addr = "",
+               int32_t* result = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Query a region of a dataset into a local buffer covering
+     * the region in row-major order (see above). Rather than pushing
+     * each contiguous run to its place, each server assembles the parts
+     * of its blocks and pushes them to their place with a single
+     * transfer when they form a contiguous run of the buffer. Otherwise
+     * it pushes them packed together with a single transfer, and they
+     * are scattered into the buffer by the client.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] region Region of the global index space
+     * @param[in] type Type of the dataset
+     * @param[in] buffer Destination buffer
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void query(const std::string& dataset_name,
+               uint64_t iteration,
+               const Box& region,
+               const Type& type,
+               void* buffer,
+               int32_t* result = nullptr,
+               AsyncRequest* req = nullptr) const;
 
     /**
-     * @brief Execute the pipeline on a given iteration.
+     * @brief Execute the pipeline on a given iteration. This is a
+     * collective operation: each process asks a subset of the servers
+     * to execute, and all the processes get the same outcome (the
+     * first error reported, if any). With req, the outcome is shared
+     * when waiting on req, which all the processes must then do.
      *
      * @param iteration Iteration of data on which to execute.
      * @param result Result.
@@ -166,7 +381,9 @@ class DistributedPipelineHandle {
                  AsyncRequest* req = nullptr) const;
 
     /**
-     * @brief Cleanup the pipeline on a given iteration.
+     * @brief Cleanup the pipeline on a given iteration. This is a
+     * collective operation, with the same outcome on all the processes
+     * (see execute).
      *
      * @param iteration Iteration to cleanup.
      * @param result Result.
@@ -176,6 +393,21 @@ class DistributedPipelineHandle {
                  int32_t* result = nullptr,
                  AsyncRequest* req = nullptr) const;
 
+    /**
+     * @brief Wait for all the servers to have executed an iteration
+     * started with blocks (see start). This is a collective operation,
+     * but contrary to execute it does not synchronize the processes
+     * first: each process waits for a subset of the servers, and all
+     * the processes get the same outcome (see execute).
+     *
+     * @param iteration Iteration.
+     * @param result Result.
+     * @param req Asynchronous request.
+     */
+    void wait(uint64_t iteration,
+              int32_t* result = nullptr,
+              AsyncRequest* req = nullptr) const;
+
     private:
 
     /**
@@ -186,6 +418,10 @@ class DistributedPipelineHandle {
      */
     DistributedPipelineHandle(const std::shared_ptr<DistributedPipelineHandleImpl>& impl);
 
+    void startIteration(uint64_t iteration,
+                        const std::vector<std::pair<std::string, uint64_t>>* blocks,
+                        bool autoCleanup);
+
     std::shared_ptr<DistributedPipelineHandleImpl> self;
 };
 
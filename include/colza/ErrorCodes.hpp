@@ -26,6 +26,9 @@ enum class ErrorCode : int32_t {
     MONA_ERROR              = -12,
     PIPELINE_CREATE_ERROR   = -13,
     INVALID_GROUP_HASH      = -14,
+    NOT_SUPPORTED           = -15,
+    BLOCK_NOT_FOUND         = -16,
+    BUFFER_TOO_SMALL        = -17,
     OTHER_ERROR             = -255
 };
 
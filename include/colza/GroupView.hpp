@@ -0,0 +1,89 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_GROUP_VIEW_HPP
+#define __COLZA_GROUP_VIEW_HPP
+
+#include <ssg.h>
+#include <mona.h>
+#include <cstdint>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief A GroupView is a versioned snapshot of the membership of the
+ * group, as seen by a server. Members are ordered by their SSG rank,
+ * i.e. the order in which clients and admins see the servers, so ranks
+ * are the same on all the servers whose view has the same hash,
+ * whatever the order in which they observed the membership events.
+ * When members leave or join, the remaining members keep their relative
+ * order. A member only appears in a view once its MoNA address has been
+ * resolved, so a view may lag behind the SSG group; its hash then
+ * differs from the hash of the group computed by clients.
+ *
+ * Each view also describes how it differs from the previous version,
+ * so that backends can update their communication structures (rings,
+ * trees, etc.) incrementally.
+ */
+struct GroupView {
+
+    /**
+     * @brief Version of the view, incremented on each membership change.
+     */
+    uint64_t version = 0;
+
+    /**
+     * @brief Hash of the members of the view (see ComputeGroupHash).
+     */
+    uint64_t hash = 0;
+
+    /**
+     * @brief Member id of each rank.
+     */
+    std::vector<ssg_member_id_t> member_ids;
+
+    /**
+     * @brief MoNA address of each rank.
+     */
+    std::vector<na_addr_t> addresses;
+
+    /**
+     * @brief Members that joined since the previous version.
+     */
+    std::vector<ssg_member_id_t> joined;
+
+    /**
+     * @brief Members that left since the previous version.
+     */
+    std::vector<ssg_member_id_t> left;
+
+    /**
+     * @brief For each rank in the previous version, its rank in this
+     * version, or -1 if the member left. Empty if there is no previous
+     * version (e.g. in the first view a pipeline receives).
+     */
+    std::vector<int> rank_map;
+
+    /**
+     * @brief Number of members.
+     */
+    size_t size() const {
+        return member_ids.size();
+    }
+
+    /**
+     * @brief Rank of the given member, or -1 if it is not in the view.
+     */
+    int rankOf(ssg_member_id_t member_id) const {
+        for(size_t i = 0; i < member_ids.size(); i++)
+            if(member_ids[i] == member_id) return (int)i;
+        return -1;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_HALO_EXCHANGE_HPP
+#define __COLZA_HALO_EXCHANGE_HPP
+
+#include <colza/BlockGeometry.hpp>
+#include <colza/Communicator.hpp>
+#include <colza/Types.hpp>
+#include <memory>
+#include <vector>
+
+namespace colza {
+
+class HaloExchangeImpl;
+
+/**
+ * @brief The HaloExchange class fills the ghost layers of the blocks
+ * staged on the servers of a group with the cells owned by neighboring
+ * blocks, for stencil-style analyses.
+ *
+ * It is built collectively from the boxes of the blocks staged on each
+ * server (e.g. Box::FromBlock(dimensions, offsets)) and a ghost width.
+ * The boxes are gathered across the group once to build the neighbor
+ * map; each call to exchange then only communicates with neighbors.
+ *
+ * The data of local block i must be laid out in row-major order over
+ * ghostedBox(i), i.e. its box grown by the ghost width on every side.
+ * Ghost cells that are not covered by any block (e.g. at the boundary
+ * of the global domain) are left untouched.
+ */
+class HaloExchange {
+
+    public:
+
+    /**
+     * @brief Constructor. The resulting HaloExchange will be invalid.
+     */
+    HaloExchange();
+
+    /**
+     * @brief Builds the neighbor map. This is a collective operation
+     * over the communicator; all the members must call it with the same
+     * width and type (possibly with no block).
+     *
+     * @param comm Communicator.
+     * @param boxes Boxes of the blocks staged locally.
+     * @param width Width of the ghost layers, in cells.
+     * @param type Type of the elements.
+     */
+    HaloExchange(const Communicator& comm,
+                 const std::vector<Box>& boxes,
+                 size_t width,
+                 Type type);
+
+    HaloExchange(const HaloExchange&);
+    HaloExchange(HaloExchange&&);
+    HaloExchange& operator=(const HaloExchange&);
+    HaloExchange& operator=(HaloExchange&&);
+    ~HaloExchange();
+
+    /**
+     * @brief Checks if the HaloExchange instance is valid.
+     */
+    operator bool() const;
+
+    /**
+     * @brief Width of the ghost layers.
+     */
+    size_t width() const;
+
+    /**
+     * @brief Box covered by the buffer of local block i.
+     */
+    Box ghostedBox(size_t i) const;
+
+    /**
+     * @brief Ranks of the servers owning a block adjacent to (or within
+     * the ghost width of) one of the local blocks.
+     */
+    std::vector<int> neighbors() const;
+
+    /**
+     * @brief Exchanges the ghost layers. This is a collective operation.
+     * Faces are packed directly from the blocks into a send buffer (only
+     * the cells to send are copied), exchanged with non-blocking MoNA
+     * messages, and unpacked into the ghost cells. Ghost cells coming
+     * from other local blocks are copied directly.
+     *
+     * @param data Buffer of each local block, covering ghostedBox(i).
+     */
+    void exchange(const std::vector<void*>& data) const;
+
+    private:
+
+    std::shared_ptr<HaloExchangeImpl> self;
+};
+
+}
+
+#endif
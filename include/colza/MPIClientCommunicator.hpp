@@ -42,6 +42,10 @@ class MPIClientCommunicator : public ClientCommunicator {
         MPI_Bcast(buffer, bytes, MPI_BYTE, root, m_comm);
     }
 
+    void allreduceSum(uint64_t* values, int count) const override {
+        MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_UINT64_T, MPI_SUM, m_comm);
+    }
+
 };
 
 }
@@ -12,6 +12,7 @@
 #include <nlohmann/json.hpp>
 #include <colza/Client.hpp>
 #include <colza/Types.hpp>
+#include <colza/BlockGeometry.hpp>
 #include <colza/Exception.hpp>
 #include <colza/AsyncRequest.hpp>
 
@@ -82,6 +83,20 @@ class PipelineHandle {
      */
     void start(uint64_t iteration) const;
 
+    /**
+     * @brief Tell the pipeline that an iteration is starting, and that
+     * it should execute it by itself as soon as expected_blocks blocks
+     * have been staged into it. The outcome of the execution is then
+     * obtained with wait (or execute, which also waits for it).
+     *
+     * @param iteration Iteration number
+     * @param expected_blocks Number of blocks the pipeline will receive
+     * @param autoCleanup Whether to cleanup the iteration after execution
+     */
+    void start(uint64_t iteration,
+               uint64_t expected_blocks,
+               bool autoCleanup = false) const;
+
     /**
      * @brief Stage some data into the pipeline using a bulk handle.
      *
@@ -130,6 +145,166 @@ class PipelineHandle {
                int32_t* result = nullptr,
                AsyncRequest* req = nullptr) const;
 
+    /**
+     * @brief Stage some data, with a single transfer, into this pipeline
+     * and into other pipelines of the same provider. The provider pulls
+     * the block once and the pipelines that support it share its memory.
+     * The block is staged into all the pipelines or, on error, possibly
+     * into only some of them.
+     *
+     * @param[in] other_pipelines Names of the other pipelines
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] dimensions Dimensions
+     * @param[in] offsets Offsets
+     * @param[in] type Type
+     * @param[in] data Data as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void stageShared(const std::vector<std::string>& other_pipelines,
+                     const std::string& dataset_name,
+                     uint64_t iteration,
+                     uint64_t block_id,
+                     const std::vector<size_t>& dimensions,
+                     const std::vector<int64_t>& offsets,
+                     const Type& type,
+                     const thallium::bulk& data,
+                     const std::string& origin_addr = "",
+                     int32_t* result = nullptr,
+                     AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Stage some local data into this pipeline and into other
+     * pipelines of the same provider.
+     *
+     * @param[in] other_pipelines Names of the other pipelines
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] dimensions Dimensions
+     * @param[in] offsets Offsets
+     * @param[in] type Type
+     * @param[in] data Local data
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void stageShared(const std::vector<std::string>& other_pipelines,
+                     const std::string& dataset_name,
+                     uint64_t iteration,
+                     uint64_t block_id,
+                     const std::vector<size_t>& dimensions,
+                     const std::vector<int64_t>& offsets,
+                     const Type& type,
+                     const void* data,
+                     int32_t* result = nullptr,
+                     AsyncRequest* req = nullptr) const;
+
+
+    /**
+     * @brief Fetch a block (staged, or derived by the pipeline) into
+     * memory exposed by a bulk handle. The server pushes the block into
+     * the bulk handle, which must be writable and large enough to hold it.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] data Destination as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] info Description of the block
+     * @param[out] req Asynchronous request
+     */
+    void fetch(const std::string& dataset_name,
+               uint64_t iteration,
+               uint64_t block_id,
+               const thallium::bulk& data,
+               const std::string& origin_addr = "",
+               BlockInfo* info = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Fetch a block (staged, or derived by the pipeline) into
+     * a local buffer.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] block_id Block id
+     * @param[in] buffer Destination buffer
+     * @param[in] size Size of the buffer
+     * @param[out] info Description of the block
+     * @param[out] req Asynchronous request
+     */
+    void fetch(const std::string& dataset_name,
+               uint64_t iteration,
+               uint64_t block_id,
+               void* buffer,
+               size_t size,
+               BlockInfo* info = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Fetch a batch of blocks with a single RPC. Failures to
+     * fetch individual blocks are reported in the requests instead of
+     * being thrown. The requests must remain valid until the
+     * asynchronous request has completed.
+     *
+     * @param[in,out] requests Blocks to fetch
+     * @param[out] req Asynchronous request
+     */
+    void fetch(std::vector<FetchRequest>& requests,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Query a region of a dataset into memory exposed by a
+     * bulk handle. Each server extracts the parts of its blocks that
+     * intersect the region and pushes them to their place in the bulk
+     * handle, which covers the region in row-major order. Elements not
+     * covered by any block are left untouched.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] region Region of the global index space
+     * @param[in] type Type of the dataset
+     * @param[in] data Destination as bulk handle
+     * @param[in] origin_addr Address of the bulk handle ("" if this process)
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void query(const std::string& dataset_name,
+               uint64_t iteration,
+               const Box& region,
+               const Type& type,
+               const thallium::bulk& data,
+               const std::string& origin_addr = "",
+               int32_t* result = nullptr,
+               AsyncRequest* req = nullptr) const;
+
+    /**
+     * @brief Query a region of a dataset into a local buffer covering
+     * the region in row-major order (see above). Rather than pushing
+     * each contiguous run to its place, the server assembles the parts
+     * of its blocks and pushes them to their place with a single
+     * transfer when they form a contiguous run of the buffer. Otherwise
+     * it pushes them packed together with a single transfer, and they
+     * are scattered into the buffer by the client.
+     *
+     * @param[in] dataset_name Dataset name
+     * @param[in] iteration Iteration
+     * @param[in] region Region of the global index space
+     * @param[in] type Type of the dataset
+     * @param[in] buffer Destination buffer
+     * @param[out] result Result
+     * @param[out] req Asynchronous request
+     */
+    void query(const std::string& dataset_name,
+               uint64_t iteration,
+               const Box& region,
+               const Type& type,
+               void* buffer,
+               int32_t* result = nullptr,
+               AsyncRequest* req = nullptr) const;
 
     /**
      * @brief Execute the pipeline on a given iteration.
@@ -144,6 +319,18 @@ class PipelineHandle {
                  bool autoCleanup = false,
                  AsyncRequest* req = nullptr) const;
 
+    /**
+     * @brief Wait for the execution of an iteration started with
+     * expected blocks (see start).
+     *
+     * @param iteration Iteration
+     * @param result Result of the execution.
+     * @param req Asynchronous request.
+     */
+    void wait(uint64_t iteration,
+              int32_t* result = nullptr,
+              AsyncRequest* req = nullptr) const;
+
     /**
      * @brief Cleanup the pipeline on a given iteration.
      *
@@ -165,6 +352,24 @@ class PipelineHandle {
      */
     PipelineHandle(const std::shared_ptr<PipelineHandleImpl>& impl);
 
+    /**
+     * @brief Query a region of a dataset into a local buffer, exposed
+     * together with a temporary buffer of the given capacity. The server
+     * pushes the parts of its blocks intersecting the region straight
+     * into the destination buffer if they form a contiguous run of it,
+     * and otherwise packs them into the temporary buffer, from which
+     * they are scattered into the destination buffer. The query is sent
+     * again with a larger temporary buffer if the capacity is too small.
+     */
+    void queryPacked(const std::string& dataset_name,
+                     uint64_t iteration,
+                     const Box& region,
+                     const Type& type,
+                     void* buffer,
+                     size_t capacity,
+                     int32_t* result,
+                     AsyncRequest* req) const;
+
     std::shared_ptr<PipelineHandleImpl> self;
 };
 
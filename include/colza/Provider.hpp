@@ -35,7 +35,9 @@ class Provider {
      * @param must_join whether the provider should join the SSG group.
      * @param mona Mona instance.
      * @param provider_id Provider id.
-     * @param config JSON-formatted configuration.
+     * @param config JSON-formatted configuration. Its "task_concurrency"
+     * entry gives the number of execution streams serving the pool, on
+     * which the backends run their parallel work.
      * @param pool Argobots pool to use to handle RPCs.
      */
     Provider(const tl::engine& engine,
@@ -0,0 +1,121 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_REDISTRIBUTION_HPP
+#define __COLZA_REDISTRIBUTION_HPP
+
+#include <colza/BlockGeometry.hpp>
+#include <colza/Communicator.hpp>
+#include <colza/Types.hpp>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief A Decomposition describes how a global domain should be split
+ * into blocks, and which rank of a Communicator owns each block.
+ */
+struct Decomposition {
+
+    std::vector<Box> boxes;  // target blocks
+    std::vector<int> owners; // rank owning each target block
+
+    /**
+     * @brief Splits the domain into one slab per rank along the given
+     * axis. Slab i is owned by rank i.
+     */
+    static Decomposition Slabs(const Box& domain, size_t axis, int num_ranks);
+
+    /**
+     * @brief Splits the domain into a regular grid of bricks, with
+     * splits[d] bricks along dimension d. Bricks are numbered in row-major
+     * order and assigned to ranks in contiguous ranges, so that using
+     * fewer bricks than ranks yields fewer, larger blocks.
+     */
+    static Decomposition Regular(const Box& domain,
+                                 const std::vector<size_t>& splits,
+                                 int num_ranks);
+};
+
+/**
+ * @brief Block staged on the calling server, as passed to Redistribute.
+ * The data is in row-major order and covers box.
+ */
+struct LocalBlock {
+    const void* data = nullptr;
+    Box         box;
+};
+
+/**
+ * @brief Block of the target decomposition owned by the calling server,
+ * as returned by Redistribute.
+ */
+struct RedistributedBlock {
+
+    size_t            index = 0; // index in the target decomposition
+    Box               box;
+    std::vector<char> storage;
+    const void*       source = nullptr;
+
+    /**
+     * @brief Data of the block. If a staged block coincided exactly with
+     * the target block, no copy is made and this points to the caller's
+     * staged data, which must then outlive the RedistributedBlock.
+     */
+    const void* data() const {
+        return source ? source : storage.data();
+    }
+};
+
+/**
+ * @brief Redistributes the blocks staged on the members of the
+ * communicator into the target decomposition. This is a collective
+ * operation: all the members must call it with the same decomposition
+ * and type. Only the sub-regions of staged blocks that overlap a target
+ * block are moved, using one alltoallv to exchange the number of bytes
+ * each server sends to each other, then one to exchange the regions;
+ * overlaps with target blocks owned by the calling server are copied
+ * directly without going through MoNA. Cells of a target block that are not covered by any staged block
+ * are zero.
+ *
+ * @param comm Communicator (e.g. from Backend::updateCommunicator).
+ * @param blocks Blocks staged locally.
+ * @param target Target decomposition.
+ * @param type Type of the elements.
+ *
+ * @return The target blocks owned by the calling server, in the
+ * order of the decomposition.
+ */
+std::vector<RedistributedBlock> Redistribute(const Communicator& comm,
+                                             const std::vector<LocalBlock>& blocks,
+                                             const Decomposition& target,
+                                             Type type);
+
+/**
+ * @brief Same as above, but regions of staged blocks that overlap the
+ * same cells of a target block (e.g. partial sums computed by several
+ * servers for cells they share) are combined with op instead of
+ * overwriting each other. Target blocks are never borrowed from staged
+ * blocks, and cells not covered by any staged block hold the identity
+ * of op (0 for SUM, the lowest value for MAX, etc.).
+ *
+ * @param comm Communicator.
+ * @param blocks Blocks staged locally.
+ * @param target Target decomposition.
+ * @param type Type of the elements.
+ * @param op Operation combining overlapping contributions.
+ *
+ * @return The target blocks owned by the calling server, in the
+ * order of the decomposition.
+ */
+std::vector<RedistributedBlock> Redistribute(const Communicator& comm,
+                                             const std::vector<LocalBlock>& blocks,
+                                             const Decomposition& target,
+                                             Type type,
+                                             Communicator::ReduceOp op);
+
+}
+
+#endif
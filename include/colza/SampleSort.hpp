@@ -0,0 +1,67 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_SAMPLE_SORT_HPP
+#define __COLZA_SAMPLE_SORT_HPP
+
+#include <colza/Communicator.hpp>
+#include <colza/Types.hpp>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief Local input of SampleSort, e.g. a staged 1-D block.
+ * keys points to count elements of the sort type; values, if not null,
+ * points to count records of the value size attached to the keys.
+ */
+struct SortInput {
+    const void* keys   = nullptr;
+    const void* values = nullptr;
+    size_t      count  = 0;
+};
+
+/**
+ * @brief Partition of the globally sorted data held by a server.
+ * Partitions are ordered by rank: every key of rank i is less than or
+ * equal to every key of rank i+1.
+ */
+struct SortedPartition {
+    std::vector<char> keys;   // count elements of the sort type
+    std::vector<char> values; // count records of the value size
+    size_t            count = 0;
+};
+
+/**
+ * @brief Sorts the keys held by all the members of the communicator
+ * (and the values attached to them) using a parallel sample sort.
+ * This is a collective operation: all the members must call it with
+ * the same type and value size.
+ *
+ * Each member sorts its keys with an LSD radix sort on an
+ * order-preserving unsigned representation of the keys (so that all the
+ * numeric types, including floating point ones, are handled the same
+ * way). Regular samples of the sorted keys are gathered on all the members,
+ * which select the same splitters, weighting samples by the number of
+ * keys they represent. Ties are broken by origin, so that duplicated
+ * keys are spread evenly. Keys and values are then exchanged with
+ * alltoallv and the received runs are sorted again.
+ *
+ * @param comm Communicator.
+ * @param inputs Local inputs.
+ * @param type Type of the keys.
+ * @param value_size Size of the values attached to each key, in bytes
+ * (0 if there is no value).
+ *
+ * @return The local partition of the globally sorted data.
+ */
+SortedPartition SampleSort(const Communicator& comm,
+                           const std::vector<SortInput>& inputs,
+                           Type type,
+                           size_t value_size = 0);
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_TASK_RUNTIME_HPP
+#define __COLZA_TASK_RUNTIME_HPP
+
+#include <thallium.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace colza {
+
+namespace tl = thallium;
+
+class TaskRuntime;
+
+/**
+ * @brief A TaskGraph is a set of tasks with dependencies, run by
+ * TaskRuntime::run. A task can only depend on tasks added before it,
+ * so that the graph has no cycle.
+ */
+class TaskGraph {
+
+    friend class TaskRuntime;
+
+    public:
+
+    typedef size_t TaskId;
+
+    /**
+     * @brief Adds a task to the graph.
+     *
+     * @param task Function to run
+     * @param after Tasks that must complete before this one starts
+     *
+     * @return the id of the task. Throws a colza::Exception if a task
+     * of after has not been added to the graph.
+     */
+    TaskId add(std::function<void()> task,
+               const std::vector<TaskId>& after = {});
+
+    /**
+     * @brief Returns the number of tasks in the graph.
+     */
+    size_t size() const {
+        return m_tasks.size();
+    }
+
+    private:
+
+    struct Task {
+        std::function<void()> function;
+        std::vector<TaskId>   successors;
+        size_t                num_predecessors = 0;
+    };
+
+    std::vector<Task> m_tasks;
+};
+
+/**
+ * @brief A TaskRuntime runs the parallel parts of a backend's execute
+ * on an Argobots pool, typically the pool the backend was created with
+ * (PipelineFactoryArgs::pool), so that they use all the execution
+ * streams serving that pool.
+ *
+ * Parallel loops are split into chunks handed out on demand to a few
+ * ULTs, so that an execution stream that is done with its chunks takes
+ * the next ones rather than waiting for the others. The calling ULT
+ * takes part in the work, and may itself be a task of another parallel
+ * loop or task graph.
+ *
+ * If a task throws, no new task is started and the first exception
+ * thrown is rethrown once the running tasks have completed.
+ */
+class TaskRuntime {
+
+    public:
+
+    typedef std::function<void(size_t, size_t)> RangeFunction;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param pool Pool on which to run the tasks
+     * @param concurrency Maximum number of ULTs working on a loop or
+     * graph, normally the number of execution streams serving the pool.
+     * Argobots cannot tell which streams serve a pool, so 0 falls back
+     * to the number of execution streams of the process, which also
+     * counts streams serving other pools.
+     */
+    TaskRuntime(const tl::pool& pool, size_t concurrency = 0);
+
+    /**
+     * @brief Returns the maximum number of ULTs working on a loop or
+     * graph.
+     */
+    size_t concurrency() const {
+        return m_concurrency;
+    }
+
+    /**
+     * @brief Calls body(b, e) on consecutive subranges [b, e) covering
+     * [begin, end), in parallel.
+     *
+     * @param begin Start of the range
+     * @param end End of the range
+     * @param grain Size of the subranges (0 to let the runtime choose)
+     * @param body Function processing a subrange
+     */
+    void parallelFor(size_t begin, size_t end, size_t grain,
+                     const RangeFunction& body) const;
+
+    /**
+     * @brief Calls body(item) on each item in parallel, e.g. on the
+     * blocks of an iteration.
+     */
+    template<typename T, typename F>
+    void parallelFor(const std::vector<T>& items, F&& body) const {
+        parallelFor(0, items.size(), 1, [&items, &body](size_t b, size_t e) {
+            for(size_t i = b; i < e; i++) body(items[i]);
+        });
+    }
+
+    /**
+     * @brief Runs the tasks of a graph in parallel, each task starting
+     * once the tasks it depends on have completed.
+     */
+    void run(const TaskGraph& graph) const;
+
+    private:
+
+    tl::pool m_pool;
+    size_t   m_concurrency;
+};
+
+}
+
+#endif
@@ -6,6 +6,11 @@
 #ifndef __COLZA_TYPES_HPP
 #define __COLZA_TYPES_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace colza {
 
 enum class Type : uint32_t {
@@ -21,6 +26,42 @@ enum class Type : uint32_t {
     FLOAT64
 };
 
+/**
+ * @brief Description of a block returned by a fetch operation.
+ */
+struct BlockInfo {
+    std::vector<size_t>  dimensions;
+    std::vector<int64_t> offsets;
+    Type                 type = Type::UINT8;
+    size_t               size = 0; // in bytes
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & dimensions;
+        a & offsets;
+        a & type;
+        a & size;
+    }
+};
+
+/**
+ * @brief Block to retrieve with a batched fetch, and the buffer in
+ * which to receive it. The info, result, and error fields are filled
+ * in by the fetch: result is 0 if the block was received, otherwise
+ * an ErrorCode (e.g. BUFFER_TOO_SMALL, in which case info still
+ * describes the block).
+ */
+struct FetchRequest {
+    std::string dataset_name;
+    uint64_t    iteration = 0;
+    uint64_t    block_id = 0;
+    void*       buffer = nullptr;
+    size_t      size = 0;
+    BlockInfo   info;
+    int32_t     result = 0;
+    std::string error;
+};
+
 }
 
 #endif
@@ -8,6 +8,7 @@
 #include "colza/RequestResult.hpp"
 
 #include "AdminImpl.hpp"
+#include "SSGUtil.hpp"
 
 #include <ssg.h>
 #include <thallium/serialization/stl/string.hpp>
@@ -18,6 +19,57 @@ namespace colza {
 
 using namespace std::string_literals;
 
+namespace {
+
+/**
+ * @brief Information needed to send a group-wide operation
+ * to the root of the spanning tree formed by the servers.
+ */
+struct GroupRoot {
+    tl::provider_handle ph;
+    uint64_t            group_hash = 0;
+    int32_t             group_size = 0;
+};
+
+GroupRoot getGroupRoot(const tl::engine& engine,
+                       const std::string& ssg_file,
+                       uint16_t provider_id) {
+    ssg_group_id_t gid;
+    int num_addrs = -1;
+    int ret = ssg_group_id_load(ssg_file.c_str(), &num_addrs, &gid);
+    if(ret != SSG_SUCCESS)
+        throw Exception(ErrorCode::SSG_ERROR,
+            "Could not open SSG file "s + ssg_file);
+
+    ret = ssg_group_observe(engine.get_margo_instance(), gid);
+    if(ret != SSG_SUCCESS)
+        throw Exception(ErrorCode::SSG_ERROR,
+            "Could not observe SSG group from "s + ssg_file);
+
+    GroupRoot root;
+    int group_size = 0;
+    ret = ssg_get_group_size(gid, &group_size);
+    if(ret != SSG_SUCCESS || group_size == 0) {
+        ssg_group_unobserve(gid);
+        throw Exception(ErrorCode::SSG_ERROR, "Could not get SSG group size");
+    }
+    root.group_size = group_size;
+    root.group_hash = ComputeGroupHash(gid);
+
+    ssg_member_id_t member_id = SSG_MEMBER_ID_INVALID;
+    ssg_get_group_member_id_from_rank(gid, 0, &member_id);
+    hg_addr_t a = HG_ADDR_NULL;
+    ssg_get_group_member_addr(gid, member_id, &a);
+    // the address is owned by SSG, make our own copy before unobserving
+    auto addr = static_cast<std::string>(tl::endpoint(engine, a, false));
+    ssg_group_unobserve(gid);
+
+    root.ph = tl::provider_handle(engine.lookup(addr), provider_id);
+    return root;
+}
+
+}
+
 Admin::Admin() = default;
 
 Admin::Admin(const tl::engine& engine)
@@ -68,6 +120,21 @@ void Admin::destroyPipeline(const std::string& address,
     }
 }
 
+void Admin::updatePipeline(const std::string& address,
+                           uint16_t provider_id,
+                           const std::string& pipeline_name,
+                           const std::string& pipeline_config,
+                           uint64_t from_iteration,
+                           const std::string& token) const {
+    auto endpoint  = self->m_engine.lookup(address);
+    auto ph        = tl::provider_handle(endpoint, provider_id);
+    RequestResult<int32_t> result = self->m_update_pipeline.on(ph)(
+            token, pipeline_name, pipeline_config, from_iteration);
+    if(not result.success()) {
+        throw Exception((ErrorCode)result.value(), result.error());
+    }
+}
+
 void Admin::createDistributedPipeline(const std::string& ssg_file,
                         uint16_t provider_id,
                         const std::string& name,
@@ -75,73 +142,39 @@ void Admin::createDistributedPipeline(const std::string& ssg_file,
                         const std::string& config,
                         const std::string& library,
                         const std::string& token) const {
-    ssg_group_id_t gid;
-    int num_addrs = -1;
-    int ret = ssg_group_id_load(ssg_file.c_str(), &num_addrs, &gid);
-    if(ret != SSG_SUCCESS)
-        throw Exception(ErrorCode::SSG_ERROR, "Could not open SSG file "s + ssg_file);
-
-    ret = ssg_group_observe(self->m_engine.get_margo_instance(), gid);
-    if(ret != SSG_SUCCESS)
-        throw Exception(ErrorCode::SSG_ERROR, "Could not observe SSG group from "s + ssg_file);
-
-    int group_size = 0;
-    ret = ssg_get_group_size(gid, &group_size);
-    if(ret != SSG_SUCCESS)
-        throw Exception(ErrorCode::SSG_ERROR, "Could not get SSG group size");
-
-    std::vector<tl::managed<tl::thread>> ults;
-    for(int i = 0; i < group_size; i++) {
-        ults.push_back(tl::xstream::self().make_thread(
-                [gid, this, i, provider_id, &name, &type, &config, &library, &token]() {
-            ssg_member_id_t member_id = SSG_MEMBER_ID_INVALID;
-            ssg_get_group_member_id_from_rank(gid, i, &member_id);
-            hg_addr_t a = HG_ADDR_NULL;
-            ssg_get_group_member_addr(gid, member_id, &a);
-            auto e = tl::endpoint(self->m_engine, a, false);
-            createPipeline(static_cast<std::string>(e), provider_id, name, type, config, library, token);
-        }));
-    }
-    for(auto& ult : ults) {
-        ult->join();
+    auto root = getGroupRoot(self->m_engine, ssg_file, provider_id);
+    RequestResult<int32_t> result = self->m_create_dist_pipeline.on(root.ph)(
+            token, name, type, config, library, (uint32_t)0,
+            root.group_hash, 0, root.group_size-1);
+    if(not result.success()) {
+        throw Exception((ErrorCode)result.value(), result.error());
     }
-    ssg_group_unobserve(gid);
 }
 
 void Admin::destroyDistributedPipeline(const std::string& ssg_file,
                          uint16_t provider_id,
                          const std::string& name,
                          const std::string& token) const {
-    ssg_group_id_t gid;
-    int num_addrs = -1;
-    int ret = ssg_group_id_load(ssg_file.c_str(), &num_addrs, &gid);
-    if(ret != SSG_SUCCESS)
-        throw Exception(ErrorCode::SSG_ERROR,
-            "Could not open SSG file "s + ssg_file);
-
-    ret = ssg_group_observe(self->m_engine.get_margo_instance(), gid);
-    if(ret != SSG_SUCCESS)
-        throw Exception(ErrorCode::SSG_ERROR,
-            "Could not observe SSG group from "s + ssg_file);
-
-    int group_size = 0;
-    ssg_get_group_size(gid, &group_size);
-    std::vector<tl::managed<tl::thread>> ults;
-    for(int i = 0; i < group_size; i++) {
-        ults.push_back(tl::xstream::self().make_thread([gid, this, i, provider_id, &name, &token]() {
-            ssg_member_id_t member_id = SSG_MEMBER_ID_INVALID;
-            ssg_get_group_member_id_from_rank(gid, i, &member_id);
-            hg_addr_t a = HG_ADDR_NULL;
-            ssg_get_group_member_addr(gid, member_id, &a);
-            auto e = tl::endpoint(self->m_engine, a, false);
-            destroyPipeline(static_cast<std::string>(e), provider_id, name, token);
-        }));
-    }
-    for(auto& ult : ults) {
-        ult->join();
+    auto root = getGroupRoot(self->m_engine, ssg_file, provider_id);
+    RequestResult<int32_t> result = self->m_destroy_dist_pipeline.on(root.ph)(
+            token, name, root.group_hash, 0, root.group_size-1);
+    if(not result.success()) {
+        throw Exception((ErrorCode)result.value(), result.error());
     }
+}
 
-    ssg_group_unobserve(gid);
+void Admin::updateDistributedPipeline(const std::string& ssg_file,
+                         uint16_t provider_id,
+                         const std::string& name,
+                         const std::string& config,
+                         uint64_t from_iteration,
+                         const std::string& token) const {
+    auto root = getGroupRoot(self->m_engine, ssg_file, provider_id);
+    RequestResult<int32_t> result = self->m_update_dist_pipeline.on(root.ph)(
+            token, name, config, from_iteration, root.group_hash, 0, root.group_size-1);
+    if(not result.success()) {
+        throw Exception((ErrorCode)result.value(), result.error());
+    }
 }
 
 void Admin::shutdownServer(const std::string& address) const {
@@ -182,16 +215,18 @@ void Admin::shutdownGroup(const std::string& ssg_file) const {
     ssg_group_unobserve(gid);
 }
 
-void Admin::makeServerLeave(const std::string& address, uint16_t provider_id) const {
+void Admin::makeServerLeave(const std::string& address, uint16_t provider_id,
+                            bool migrate) const {
     auto ep = self->m_engine.lookup(address);
     auto ph = tl::provider_handle(ep, provider_id);
-    self->m_leave.on(ph)();
+    self->m_leave.on(ph)(migrate);
 }
 
 void Admin::makeServersLeave(
         const std::string& ssg_file,
         const std::vector<int>& ranks,
-        uint16_t provider_id) const {
+        uint16_t provider_id,
+        bool migrate) const {
     ssg_group_id_t gid;
     int num_addrs = -1;
     int ret = ssg_group_id_load(ssg_file.c_str(), &num_addrs, &gid);
@@ -214,7 +249,7 @@ void Admin::makeServersLeave(
         hg_addr_t a = HG_ADDR_NULL;
         ssg_get_group_member_addr(gid, member_id, &a);
         auto ph = tl::provider_handle(self->m_engine, a, provider_id, false);
-        self->m_leave.on(ph)();
+        self->m_leave.on(ph)(migrate);
     }
 
     ssg_group_unobserve(gid);
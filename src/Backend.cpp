@@ -22,4 +22,30 @@ std::unique_ptr<Backend> PipelineFactory::createPipeline(const std::string& back
     return f(args);
 }
 
+RequestResult<int32_t> StageSharedBlock(Backend& backend,
+                                        const tl::engine& engine,
+                                        const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const BlockStore::BlockPtr& block) {
+    auto result = backend.stageShared(dataset_name, iteration, block_id, block);
+    if(result.success() || result.value() != (int32_t)ErrorCode::NOT_SUPPORTED)
+        return result;
+    // the backend pulls the block from this process' memory
+    try {
+        std::vector<std::pair<void*, size_t>> segments = {
+            std::pair<void*, size_t>(block->data, block->size)
+        };
+        auto bulk = engine.expose(segments, tl::bulk_mode::read_only);
+        auto self_addr = static_cast<std::string>(engine.self());
+        return backend.stage(self_addr, dataset_name, iteration, block_id,
+                             block->dimensions, block->offsets, block->type, bulk);
+    } catch(const std::exception& ex) {
+        result.success() = false;
+        result.error() = ex.what();
+        result.value() = (int32_t)ErrorCode::OTHER_ERROR;
+        return result;
+    }
+}
+
 }
@@ -0,0 +1,296 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/BlockCatalog.hpp"
+
+#include <algorithm>
+
+namespace colza {
+
+namespace {
+
+// blocks overlapping more cells than this are not registered in the
+// grid but tested on every lookup
+constexpr size_t MAX_CELLS_PER_BLOCK = 64;
+
+int64_t FloorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// box of the grid cells overlapping box
+Box CellRange(const Box& box, const std::vector<int64_t>& cell) {
+    Box range = box;
+    for(size_t d = 0; d < box.ndims(); d++) {
+        range.lower[d] = FloorDiv(box.lower[d], cell[d]);
+        range.upper[d] = FloorDiv(box.upper[d] - 1, cell[d]) + 1;
+    }
+    return range;
+}
+
+// number of cells in range, saturating above limit
+size_t CellCount(const Box& range, size_t limit) {
+    size_t count = 1;
+    for(auto e : range.extents()) {
+        if(e != 0 && count > limit / e) return limit + 1;
+        count *= e;
+    }
+    return count;
+}
+
+uint64_t CellKey(const std::vector<int64_t>& coords) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(auto c : coords)
+        h ^= (uint64_t)c + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+template<typename F>
+void ForEachCell(const Box& range, F&& f) {
+    if(range.empty()) return;
+    std::vector<int64_t> coords = range.lower;
+    while(true) {
+        f(coords);
+        size_t d = coords.size();
+        while(d > 0) {
+            d -= 1;
+            if(++coords[d] < range.upper[d]) break;
+            coords[d] = range.lower[d];
+            if(d == 0) return;
+        }
+    }
+}
+
+void Enclose(Box& bounds, const Box& box) {
+    if(bounds.ndims() == 0) {
+        bounds = box;
+        return;
+    }
+    for(size_t d = 0; d < box.ndims(); d++) {
+        bounds.lower[d] = std::min(bounds.lower[d], box.lower[d]);
+        bounds.upper[d] = std::max(bounds.upper[d], box.upper[d]);
+    }
+}
+
+}
+
+struct BlockCatalog::Index {
+
+    std::vector<int64_t>                              cell;  // extents of a cell
+    std::vector<uint64_t>                             ids;
+    std::vector<Box>                                  boxes;
+    std::vector<bool>                                 alive;
+    std::unordered_map<uint64_t, size_t>              positions;
+    std::unordered_map<uint64_t, std::vector<size_t>> cells;
+    std::vector<size_t>                               large; // not in the grid
+    Box                                               bounds; // of the grid entries
+    size_t                                            erased = 0;
+
+    void add(uint64_t block_id, const Box& box) {
+        size_t entry = ids.size();
+        ids.push_back(block_id);
+        boxes.push_back(box);
+        alive.push_back(true);
+        positions[block_id] = entry;
+        registerEntry(entry);
+    }
+
+    void registerEntry(size_t entry) {
+        const Box& box = boxes[entry];
+        if(cell.empty() && !box.empty()) {
+            cell.resize(box.ndims());
+            auto ext = box.extents();
+            for(size_t d = 0; d < ext.size(); d++)
+                cell[d] = (int64_t)ext[d];
+        }
+        if(box.empty() || box.ndims() != cell.size()) {
+            large.push_back(entry);
+            return;
+        }
+        auto range = CellRange(box, cell);
+        if(CellCount(range, MAX_CELLS_PER_BLOCK) > MAX_CELLS_PER_BLOCK) {
+            large.push_back(entry);
+            return;
+        }
+        ForEachCell(range, [this, entry](const std::vector<int64_t>& coords) {
+            cells[CellKey(coords)].push_back(entry);
+        });
+        Enclose(bounds, box);
+    }
+
+    bool remove(uint64_t block_id) {
+        auto it = positions.find(block_id);
+        if(it == positions.end()) return false;
+        // entries are only marked as erased, and compacted once they
+        // make up half of the index
+        alive[it->second] = false;
+        positions.erase(it);
+        erased += 1;
+        if(erased > 16 && 2*erased > ids.size())
+            rebuild();
+        return true;
+    }
+
+    void rebuild() {
+        std::vector<uint64_t> old_ids;
+        std::vector<Box>      old_boxes;
+        std::vector<bool>     old_alive;
+        old_ids.swap(ids);
+        old_boxes.swap(boxes);
+        old_alive.swap(alive);
+        positions.clear();
+        cells.clear();
+        large.clear();
+        bounds = Box();
+        erased = 0;
+        for(size_t i = 0; i < old_ids.size(); i++) {
+            if(old_alive[i])
+                add(old_ids[i], old_boxes[i]);
+        }
+    }
+
+    size_t live() const {
+        return ids.size() - erased;
+    }
+
+    std::vector<uint64_t> find(const Box& region) const {
+        std::vector<size_t> candidates = large;
+        bool scanned = false;
+        if(region.ndims() == cell.size() && !cells.empty()) {
+            auto clamped = region.intersect(bounds);
+            if(!clamped.empty()) {
+                auto range = CellRange(clamped, cell);
+                // visiting more cells than there are blocks is slower
+                // than testing all the blocks
+                if(CellCount(range, ids.size()) <= ids.size()) {
+                    ForEachCell(range, [this, &candidates](const std::vector<int64_t>& coords) {
+                        auto it = cells.find(CellKey(coords));
+                        if(it != cells.end())
+                            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+                    });
+                } else {
+                    scanned = true;
+                }
+            }
+        }
+        std::vector<uint64_t> result;
+        auto test = [this, &region, &result](size_t entry) {
+            if(alive[entry] && boxes[entry].intersects(region))
+                result.push_back(ids[entry]);
+        };
+        if(scanned) {
+            for(size_t entry = 0; entry < ids.size(); entry++)
+                test(entry);
+        } else {
+            for(auto entry : candidates)
+                test(entry);
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+};
+
+BlockCatalog::BlockCatalog() = default;
+
+BlockCatalog::BlockCatalog(BlockCatalog&&) = default;
+
+BlockCatalog& BlockCatalog::operator=(BlockCatalog&&) = default;
+
+BlockCatalog::~BlockCatalog() = default;
+
+const BlockCatalog::Index* BlockCatalog::index(const std::string& dataset_name,
+                                               uint64_t iteration) const {
+    auto it = m_indices.find(iteration);
+    if(it == m_indices.end()) return nullptr;
+    auto ds = it->second.find(dataset_name);
+    if(ds == it->second.end()) return nullptr;
+    return ds->second.get();
+}
+
+void BlockCatalog::insert(const std::string& dataset_name,
+                          uint64_t iteration,
+                          uint64_t block_id,
+                          const Box& box) {
+    auto& index = m_indices[iteration][dataset_name];
+    if(!index) index.reset(new Index);
+    index->remove(block_id);
+    index->add(block_id, box);
+}
+
+bool BlockCatalog::erase(const std::string& dataset_name,
+                         uint64_t iteration,
+                         uint64_t block_id) {
+    auto it = m_indices.find(iteration);
+    if(it == m_indices.end()) return false;
+    auto ds = it->second.find(dataset_name);
+    if(ds == it->second.end()) return false;
+    bool found = ds->second->remove(block_id);
+    if(ds->second->live() == 0) {
+        it->second.erase(ds);
+        if(it->second.empty())
+            m_indices.erase(it);
+    }
+    return found;
+}
+
+void BlockCatalog::erase(uint64_t iteration) {
+    m_indices.erase(iteration);
+}
+
+void BlockCatalog::clear() {
+    m_indices.clear();
+}
+
+std::vector<uint64_t> BlockCatalog::find(const std::string& dataset_name,
+                                         uint64_t iteration,
+                                         const Box& region) const {
+    auto idx = index(dataset_name, iteration);
+    if(!idx || region.empty()) return {};
+    return idx->find(region);
+}
+
+std::vector<Box> BlockCatalog::summary(const std::string& dataset_name,
+                                       uint64_t iteration,
+                                       size_t max_boxes) const {
+    std::vector<Box> boxes;
+    auto idx = index(dataset_name, iteration);
+    if(!idx) return boxes;
+    for(size_t i = 0; i < idx->boxes.size(); i++)
+        if(idx->alive[i] && !idx->boxes[i].empty())
+            boxes.push_back(idx->boxes[i]);
+    max_boxes = std::max<size_t>(max_boxes, 1);
+    if(boxes.size() <= max_boxes) return boxes;
+    // blocks sorted in row-major order of their lower corner are
+    // grouped into max_boxes runs of neighbors (a run is also split
+    // where the number of dimensions changes)
+    std::sort(boxes.begin(), boxes.end(), [](const Box& a, const Box& b) {
+        if(a.ndims() != b.ndims()) return a.ndims() < b.ndims();
+        return a.lower < b.lower;
+    });
+    std::vector<Box> result;
+    const size_t n = boxes.size();
+    for(size_t g = 0; g < max_boxes; g++) {
+        size_t begin = g*n/max_boxes, end = (g+1)*n/max_boxes;
+        Box bounds;
+        for(size_t i = begin; i < end; i++) {
+            if(bounds.ndims() != 0 && bounds.ndims() != boxes[i].ndims()) {
+                result.push_back(std::move(bounds));
+                bounds = Box();
+            }
+            Enclose(bounds, boxes[i]);
+        }
+        if(bounds.ndims() != 0)
+            result.push_back(std::move(bounds));
+    }
+    return result;
+}
+
+size_t BlockCatalog::count(const std::string& dataset_name, uint64_t iteration) const {
+    auto idx = index(dataset_name, iteration);
+    return idx ? idx->live() : 0;
+}
+
+}
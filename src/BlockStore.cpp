@@ -0,0 +1,437 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/BlockStore.hpp"
+#include "colza/Exception.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+namespace colza {
+
+namespace {
+
+constexpr size_t CACHE_LINE = 64;
+
+struct FreeDeleter {
+    void operator()(char* p) const { free(p); }
+};
+
+typedef std::unique_ptr<char, FreeDeleter> Memory;
+
+Memory Allocate(size_t size) {
+    void* ptr = nullptr;
+    if(posix_memalign(&ptr, CACHE_LINE, size) != 0)
+        throw std::bad_alloc();
+    return Memory(static_cast<char*>(ptr));
+}
+
+size_t RoundUp(size_t x, size_t alignment) {
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+size_t NextPowerOf2(size_t x) {
+    size_t p = 1;
+    while(p < x) p <<= 1;
+    return p;
+}
+
+uint64_t Hash(BlockStore::DatasetId dataset, uint64_t block_id) {
+    // splitmix64 finalizer
+    uint64_t h = block_id ^ ((uint64_t)dataset << 40) ^ ((uint64_t)dataset >> 24);
+    h += 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+}
+
+struct BlockStore::Names {
+
+    tl::mutex                                  mutex;
+    std::unordered_map<std::string, DatasetId> ids;
+    std::deque<std::string>                    names; // stable addresses
+
+    DatasetId intern(const std::string& name, const std::string** stored) {
+        std::lock_guard<tl::mutex> g(mutex);
+        auto it = ids.find(name);
+        if(it == ids.end()) {
+            it = ids.emplace(name, (DatasetId)names.size()).first;
+            names.push_back(name);
+        }
+        if(stored) *stored = &names[it->second];
+        return it->second;
+    }
+
+    bool lookup(const std::string& name, DatasetId& id) {
+        std::lock_guard<tl::mutex> g(mutex);
+        auto it = ids.find(name);
+        if(it == ids.end()) return false;
+        id = it->second;
+        return true;
+    }
+};
+
+struct BlockStore::Iteration {
+
+    // slots of the flat hash tables, with linear probing; a slot is
+    // empty if its block is null, and a block is only visible once
+    // its data has arrived
+    struct Slot {
+        uint64_t hash = 0;
+        Block*   block = nullptr;
+        bool     ready = false;
+    };
+
+    struct Shard {
+        tl::mutex             mutex;
+        std::vector<Slot>     slots = std::vector<Slot>(16);
+        size_t                used = 0;
+        std::deque<Block>     blocks; // stable addresses
+        std::vector<Block*>   unused; // discarded, to be reused
+        std::vector<Memory>   chunks;
+        std::vector<BlockPtr> linked; // owners of linked payloads
+        char*                 cursor = nullptr;
+        size_t                remaining = 0;
+
+        size_t probe(uint64_t hash, DatasetId dataset, uint64_t block_id) const {
+            const size_t mask = slots.size() - 1;
+            size_t i = hash & mask;
+            while(slots[i].block) {
+                auto& s = slots[i];
+                if(s.hash == hash && s.block->dataset == dataset
+                && s.block->block_id == block_id)
+                    break;
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+        void grow() {
+            std::vector<Slot> old(slots.size()*2);
+            old.swap(slots);
+            const size_t mask = slots.size() - 1;
+            for(auto& s : old) {
+                if(!s.block) continue;
+                size_t i = s.hash & mask;
+                while(slots[i].block) i = (i + 1) & mask;
+                slots[i] = s;
+            }
+        }
+
+        // backward-shift deletion, so that lookups never need tombstones
+        void remove(size_t i) {
+            const size_t mask = slots.size() - 1;
+            size_t j = i;
+            while(true) {
+                slots[i] = Slot();
+                while(true) {
+                    j = (j + 1) & mask;
+                    if(!slots[j].block) return;
+                    size_t k = slots[j].hash & mask;
+                    bool between = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+                    if(!between) break;
+                }
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+
+        char* allocate(size_t size, size_t chunk_size) {
+            if(size == 0) return nullptr;
+            size = RoundUp(size, CACHE_LINE);
+            if(size > chunk_size/4) {
+                chunks.push_back(Allocate(size));
+                return chunks.back().get();
+            }
+            if(remaining < size) {
+                chunks.push_back(Allocate(chunk_size));
+                cursor    = chunks.back().get();
+                remaining = chunk_size;
+            }
+            char* ptr = cursor;
+            cursor    += size;
+            remaining -= size;
+            return ptr;
+        }
+
+        void release(char* ptr, size_t size) {
+            // only the last allocation of the current chunk is given back,
+            // the rest is released with the iteration
+            size = RoundUp(size, CACHE_LINE);
+            if(ptr && ptr + size == cursor) {
+                cursor    -= size;
+                remaining += size;
+            }
+        }
+    };
+
+    std::shared_ptr<Names>   names; // referenced by the blocks
+    std::unique_ptr<Shard[]> shards;
+    size_t                   mask;
+    size_t                   chunk_size;
+
+    Iteration(std::shared_ptr<Names> n, size_t num_shards, size_t chunk)
+    : names(std::move(n))
+    , shards(new Shard[num_shards])
+    , mask(num_shards - 1)
+    , chunk_size(chunk) {}
+
+    Shard& shard(uint64_t hash) {
+        return shards[(hash >> 48) & mask];
+    }
+};
+
+BlockStore::BlockStore(size_t num_shards, size_t chunk_size)
+: m_num_shards(NextPowerOf2(std::max<size_t>(num_shards, 1)))
+, m_chunk_size(std::max(RoundUp(chunk_size, CACHE_LINE), 4*CACHE_LINE))
+, m_names(std::make_shared<Names>()) {}
+
+BlockStore::~BlockStore() = default;
+
+BlockStore::DatasetId BlockStore::intern(const std::string& dataset_name) {
+    return m_names->intern(dataset_name, nullptr);
+}
+
+std::shared_ptr<BlockStore::Iteration> BlockStore::iteration(uint64_t iteration) const {
+    std::lock_guard<tl::mutex> g(m_iterations_mtx);
+    auto it = m_iterations.find(iteration);
+    if(it == m_iterations.end()) return nullptr;
+    return it->second;
+}
+
+BlockStore::Reservation BlockStore::reserve(const std::string& dataset_name,
+                                            uint64_t iteration,
+                                            uint64_t block_id,
+                                            const std::vector<size_t>& dimensions,
+                                            const std::vector<int64_t>& offsets,
+                                            const Type& type,
+                                            size_t size) {
+    Reservation r;
+    {
+        std::lock_guard<tl::mutex> g(m_iterations_mtx);
+        auto& it = m_iterations[iteration];
+        if(!it) it = std::make_shared<Iteration>(m_names, m_num_shards, m_chunk_size);
+        r.iteration = it;
+    }
+    const std::string* name = nullptr;
+    DatasetId dataset = m_names->intern(dataset_name, &name);
+    uint64_t hash = Hash(dataset, block_id);
+    auto& shard = r.iteration->shard(hash);
+    std::lock_guard<tl::mutex> g(shard.mutex);
+    size_t i = shard.probe(hash, dataset, block_id);
+    if(shard.slots[i].block)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Block already exists for provided iteration, name, and id");
+    Block* block = nullptr;
+    if(!shard.unused.empty()) {
+        block = shard.unused.back();
+        shard.unused.pop_back();
+    } else {
+        shard.blocks.emplace_back();
+        block = &shard.blocks.back();
+    }
+    block->dataset      = dataset;
+    block->dataset_name = name;
+    block->block_id     = block_id;
+    block->dimensions   = dimensions;
+    block->offsets      = offsets;
+    block->type         = type;
+    block->size         = size;
+    try {
+        block->data = shard.allocate(size, r.iteration->chunk_size);
+    } catch(...) {
+        shard.unused.push_back(block);
+        throw;
+    }
+    shard.slots[i].hash  = hash;
+    shard.slots[i].block = block;
+    shard.used += 1;
+    if(4*shard.used > 3*shard.slots.size())
+        shard.grow();
+    r.block = block;
+    return r;
+}
+
+void BlockStore::publish(const Reservation& r, const BlockPtr& owner) {
+    uint64_t hash = Hash(r.block->dataset, r.block->block_id);
+    auto& shard = r.iteration->shard(hash);
+    std::lock_guard<tl::mutex> g(shard.mutex);
+    if(owner) {
+        r.block->data = owner->data;
+        r.block->size = owner->size;
+        shard.linked.push_back(owner);
+    }
+    size_t i = shard.probe(hash, r.block->dataset, r.block->block_id);
+    shard.slots[i].ready = true;
+}
+
+void BlockStore::discard(const Reservation& r) {
+    uint64_t hash = Hash(r.block->dataset, r.block->block_id);
+    auto& shard = r.iteration->shard(hash);
+    std::lock_guard<tl::mutex> g(shard.mutex);
+    size_t i = shard.probe(hash, r.block->dataset, r.block->block_id);
+    shard.remove(i);
+    shard.used -= 1;
+    shard.release(r.block->data, r.block->size);
+    r.block->data = nullptr;
+    r.block->size = 0;
+    shard.unused.push_back(r.block);
+}
+
+BlockStore::BlockPtr BlockStore::stage(const tl::engine& engine,
+                                       const std::string& sender_addr,
+                                       const std::string& dataset_name,
+                                       uint64_t iteration,
+                                       uint64_t block_id,
+                                       const std::vector<size_t>& dimensions,
+                                       const std::vector<int64_t>& offsets,
+                                       const Type& type,
+                                       const tl::bulk& data) {
+    auto r = reserve(dataset_name, iteration, block_id, dimensions, offsets, type, data.size());
+    // the block is pulled straight into the store, without holding any lock
+    try {
+        if(r.block->size != 0) {
+            std::vector<std::pair<void*, size_t>> segments = {
+                std::pair<void*, size_t>(r.block->data, r.block->size)
+            };
+            auto local_bulk = engine.expose(segments, tl::bulk_mode::write_only);
+            auto origin_ep = engine.lookup(sender_addr);
+            data.on(origin_ep) >> local_bulk;
+        }
+    } catch(const std::exception& ex) {
+        discard(r);
+        throw Exception(ErrorCode::OTHER_ERROR, ex.what());
+    }
+    publish(r);
+    return BlockPtr(r.iteration, r.block);
+}
+
+BlockStore::BlockPtr BlockStore::Pull(const tl::engine& engine,
+                                      const std::string& sender_addr,
+                                      const std::string& dataset_name,
+                                      uint64_t block_id,
+                                      const std::vector<size_t>& dimensions,
+                                      const std::vector<int64_t>& offsets,
+                                      const Type& type,
+                                      const tl::bulk& data) {
+    // with the smallest chunks, the payload gets an allocation of its
+    // own, released with the last reference to the block
+    BlockStore store(1, 0);
+    return store.stage(engine, sender_addr, dataset_name, 0, block_id,
+                       dimensions, offsets, type, data);
+}
+
+BlockStore::BlockPtr BlockStore::insert(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const std::vector<size_t>& dimensions,
+                                        const std::vector<int64_t>& offsets,
+                                        const Type& type,
+                                        const void* data,
+                                        size_t size) {
+    auto r = reserve(dataset_name, iteration, block_id, dimensions, offsets, type, size);
+    if(size != 0) std::memcpy(r.block->data, data, size);
+    publish(r);
+    return BlockPtr(r.iteration, r.block);
+}
+
+BlockStore::BlockPtr BlockStore::link(const std::string& dataset_name,
+                                      uint64_t iteration,
+                                      uint64_t block_id,
+                                      const BlockPtr& block) {
+    auto r = reserve(dataset_name, iteration, block_id,
+                     block->dimensions, block->offsets, block->type, 0);
+    publish(r, block);
+    return BlockPtr(r.iteration, r.block);
+}
+
+BlockStore::BlockPtr BlockStore::find(const std::string& dataset_name,
+                                      uint64_t iteration,
+                                      uint64_t block_id) const {
+    DatasetId dataset;
+    if(!m_names->lookup(dataset_name, dataset)) return nullptr;
+    auto it = this->iteration(iteration);
+    if(!it) return nullptr;
+    uint64_t hash = Hash(dataset, block_id);
+    auto& shard = it->shard(hash);
+    std::lock_guard<tl::mutex> g(shard.mutex);
+    auto& slot = shard.slots[shard.probe(hash, dataset, block_id)];
+    if(!slot.block || !slot.ready) return nullptr;
+    return BlockPtr(it, slot.block);
+}
+
+std::vector<BlockStore::BlockPtr> BlockStore::collect(uint64_t iteration,
+                                                      const DatasetId* dataset) const {
+    std::vector<BlockPtr> result;
+    auto it = this->iteration(iteration);
+    if(!it) return result;
+    for(size_t s = 0; s <= it->mask; s++) {
+        auto& shard = it->shards[s];
+        std::lock_guard<tl::mutex> g(shard.mutex);
+        for(auto& slot : shard.slots) {
+            if(!slot.block || !slot.ready) continue;
+            if(dataset && slot.block->dataset != *dataset) continue;
+            result.emplace_back(it, slot.block);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const BlockPtr& a, const BlockPtr& b) {
+        if(a->dataset != b->dataset) return *a->dataset_name < *b->dataset_name;
+        return a->block_id < b->block_id;
+    });
+    return result;
+}
+
+std::vector<BlockStore::BlockPtr> BlockStore::blocks(uint64_t iteration) const {
+    return collect(iteration, nullptr);
+}
+
+std::vector<BlockStore::BlockPtr> BlockStore::blocks(const std::string& dataset_name,
+                                                     uint64_t iteration) const {
+    DatasetId dataset;
+    if(!m_names->lookup(dataset_name, dataset)) return {};
+    return collect(iteration, &dataset);
+}
+
+std::vector<std::string> BlockStore::datasets(uint64_t iteration) const {
+    std::vector<std::string> names;
+    for(auto& block : collect(iteration, nullptr)) {
+        if(names.empty() || names.back() != *block->dataset_name)
+            names.push_back(*block->dataset_name);
+    }
+    return names;
+}
+
+std::vector<uint64_t> BlockStore::iterations() const {
+    std::vector<uint64_t> result;
+    std::lock_guard<tl::mutex> g(m_iterations_mtx);
+    for(auto& it : m_iterations) result.push_back(it.first);
+    return result;
+}
+
+void BlockStore::erase(uint64_t iteration) {
+    std::shared_ptr<Iteration> erased;
+    {
+        std::lock_guard<tl::mutex> g(m_iterations_mtx);
+        auto it = m_iterations.find(iteration);
+        if(it == m_iterations.end()) return;
+        erased = std::move(it->second);
+        m_iterations.erase(it);
+    }
+    // the memory is released here, outside of the lock, unless
+    // some blocks are still referenced
+}
+
+void BlockStore::clear() {
+    std::map<uint64_t, std::shared_ptr<Iteration>> erased;
+    std::lock_guard<tl::mutex> g(m_iterations_mtx);
+    erased.swap(m_iterations);
+}
+
+}
@@ -80,6 +80,20 @@ DistributedPipelineHandle Client::makeDistributedPipelineHandle(
         uint16_t provider_id,
         const std::string& pipeline_name,
         bool check) const {
+    return makeDistributedPipelineHandle(comm, ssg_group_file,
+            std::vector<uint16_t>{ provider_id }, pipeline_name, check);
+}
+
+DistributedPipelineHandle Client::makeDistributedPipelineHandle(
+        const ClientCommunicator* comm,
+        const std::string& ssg_group_file,
+        const std::vector<uint16_t>& provider_ids,
+        const std::string& pipeline_name,
+        bool check) const {
+
+    if(provider_ids.empty())
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No provider id provided for distributed pipeline "s + pipeline_name);
 
     std::vector<PipelineHandle> pipelines;
 
@@ -127,8 +141,10 @@ DistributedPipelineHandle Client::makeDistributedPipelineHandle(
             auto addr = tl::endpoint(self->m_engine, a, false);
             strcpy(packed_addresses.data() + i*256, static_cast<std::string>(addr).c_str());
             try {
-                auto pipeline = makePipelineHandle(addr, provider_id, pipeline_name, check);
-                pipelines.push_back(std::move(pipeline));
+                for(auto provider_id : provider_ids) {
+                    auto pipeline = makePipelineHandle(addr, provider_id, pipeline_name, check);
+                    pipelines.push_back(std::move(pipeline));
+                }
             } catch(...) {
                 group_size = -1;
                 comm->bcast(&group_size, sizeof(group_size), 0);
@@ -158,13 +174,18 @@ DistributedPipelineHandle Client::makeDistributedPipelineHandle(
         // create pipelines
         for(int i = 0; i < group_size; i++) {
             char* addr = packed_addresses.data() + i*256;
-            auto pipeline = makePipelineHandle(addr, provider_id, pipeline_name, false);
-            pipelines.push_back(std::move(pipeline));
+            for(auto provider_id : provider_ids) {
+                auto pipeline = makePipelineHandle(addr, provider_id, pipeline_name, false);
+                pipelines.push_back(std::move(pipeline));
+            }
         }
     }
 
     auto impl = std::make_shared<DistributedPipelineHandleImpl>(
-            comm, pipeline_name, self, gid, ssg_group_file, provider_id, std::move(pipelines));
+            comm, pipeline_name, self, gid, ssg_group_file, provider_ids, std::move(pipelines));
+    // only rank 0 observes the group, the others need its hash to start
+    // the pipelines of their own servers
+    comm->bcast(&impl->m_group_hash, sizeof(impl->m_group_hash), 0);
 
     return DistributedPipelineHandle(std::move(impl));
 }
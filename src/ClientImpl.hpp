@@ -23,7 +23,12 @@ class ClientImpl {
     tl::remote_procedure m_check_pipeline;
     tl::remote_procedure m_start;
     tl::remote_procedure m_stage;
+    tl::remote_procedure m_stage_shared;
+    tl::remote_procedure m_fetch;
+    tl::remote_procedure m_query;
+    tl::remote_procedure m_summarize;
     tl::remote_procedure m_execute;
+    tl::remote_procedure m_wait_execution;
     tl::remote_procedure m_cleanup;
     tl::remote_procedure m_abort;
 
@@ -32,7 +37,12 @@ class ClientImpl {
     , m_check_pipeline(m_engine.define("colza_check_pipeline"))
     , m_start(m_engine.define("colza_start"))
     , m_stage(m_engine.define("colza_stage"))
+    , m_stage_shared(m_engine.define("colza_stage_shared"))
+    , m_fetch(m_engine.define("colza_fetch"))
+    , m_query(m_engine.define("colza_query"))
+    , m_summarize(m_engine.define("colza_summarize"))
     , m_execute(m_engine.define("colza_execute"))
+    , m_wait_execution(m_engine.define("colza_wait_execution"))
     , m_cleanup(m_engine.define("colza_cleanup"))
     , m_abort(m_engine.define("colza_abort"))
     {}
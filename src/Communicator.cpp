@@ -0,0 +1,779 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/Communicator.hpp"
+#include "colza/Exception.hpp"
+
+#include "CommunicatorImpl.hpp"
+#include "ReduceOps.hpp"
+#include "TypeSizes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+
+namespace colza {
+
+namespace {
+
+using ReduceOp  = Communicator::ReduceOp;
+using Algorithm = Communicator::Algorithm;
+
+// messages up to this size use latency-optimal algorithms
+constexpr size_t SMALL_MESSAGE_SIZE = 8192;
+// allgathers with a result up to this size use recursive doubling
+constexpr size_t SMALL_ALLGATHER_SIZE = 262144;
+// step used for the tag of the messages undoing the initial folding,
+// the other steps of a collective being below it
+constexpr uint32_t UNFOLD_STEP = Communicator::MAX_STEPS;
+
+bool IsPowerOfTwo(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// throws on all the members alike, before any message is sent, if a
+// collective needs more steps than tags can tell apart
+void CheckSteps(const char* collective, size_t num_steps) {
+    if(num_steps >= UNFOLD_STEP)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            std::string(collective) + " would need " + std::to_string(num_steps)
+            + " rounds of messages, at most " + std::to_string(UNFOLD_STEP - 1)
+            + " are supported");
+}
+
+// offsets (in elements) of nblocks blocks of nearly equal sizes
+std::vector<size_t> EvenBlocks(size_t count, int nblocks) {
+    std::vector<size_t> offsets(nblocks+1);
+    for(int b = 0; b <= nblocks; b++)
+        offsets[b] = (count*b)/nblocks;
+    return offsets;
+}
+
+/**
+ * @brief Algorithms based on recursive doubling/halving need a power
+ * of two number of participants. The first 2*rem ranks are folded in
+ * pairs (even ranks hand their data to the next odd rank and sit out)
+ * so that p2 ranks remain.
+ */
+struct Folding {
+
+    int p2      = 1;
+    int rem     = 0;
+    int newrank = -1;
+
+    Folding(int rank, int size) {
+        while(p2*2 <= size) p2 *= 2;
+        rem = size - p2;
+        if(rank < 2*rem)
+            newrank = (rank % 2 == 0) ? -1 : rank/2;
+        else
+            newrank = rank - rem;
+    }
+
+    int realRank(int r) const {
+        return r < rem ? 2*r + 1 : r + rem;
+    }
+};
+
+void Fold(const CommunicatorImpl& comm, uint32_t seq, const Folding& f,
+          char* acc, char* tmp, size_t count, size_t esize, Type type, ReduceOp op) {
+    int rank = comm.m_rank;
+    if(rank >= 2*f.rem) return;
+    auto tag = CommunicatorImpl::makeTag(seq, 0);
+    if(rank % 2 == 0) {
+        comm.send(acc, count*esize, rank+1, tag);
+    } else {
+        comm.recv(tmp, count*esize, rank-1, tag);
+        ApplyOp(type, op, tmp, acc, count);
+    }
+}
+
+void Unfold(const CommunicatorImpl& comm, uint32_t seq, const Folding& f,
+            char* acc, size_t bytes) {
+    int rank = comm.m_rank;
+    if(rank >= 2*f.rem) return;
+    auto tag = CommunicatorImpl::makeTag(seq, UNFOLD_STEP);
+    if(rank % 2 == 1)
+        comm.send(acc, bytes, rank-1, tag);
+    else
+        comm.recv(acc, bytes, rank+1, tag);
+}
+
+/**
+ * @brief Reduce-scatter by recursive halving among the p2 ranks of the
+ * folding. Block b spans elements [offsets[b], offsets[b+1]). On return,
+ * the calling process (of new rank r) holds the reduced block r in acc.
+ */
+void HalvingReduceScatter(const CommunicatorImpl& comm, uint32_t seq, uint32_t& step,
+                          const Folding& f, const std::vector<size_t>& offsets,
+                          char* acc, char* tmp, size_t esize, Type type, ReduceOp op) {
+    int lo = 0, hi = f.p2;
+    for(int mask = f.p2/2; mask > 0; mask >>= 1, step++) {
+        int partner = f.realRank(f.newrank ^ mask);
+        int mid = (lo + hi)/2;
+        int keep_lo, keep_hi, send_lo, send_hi;
+        if((f.newrank & mask) == 0) {
+            keep_lo = lo;  keep_hi = mid;
+            send_lo = mid; send_hi = hi;
+        } else {
+            keep_lo = mid; keep_hi = hi;
+            send_lo = lo;  send_hi = mid;
+        }
+        size_t keep_count = offsets[keep_hi] - offsets[keep_lo];
+        size_t send_count = offsets[send_hi] - offsets[send_lo];
+        comm.sendrecv(acc + offsets[send_lo]*esize, send_count*esize, partner,
+                      tmp, keep_count*esize, partner,
+                      CommunicatorImpl::makeTag(seq, step));
+        ApplyOp(type, op, tmp, acc + offsets[keep_lo]*esize, keep_count);
+        lo = keep_lo;
+        hi = keep_hi;
+    }
+}
+
+/**
+ * @brief Allgather by recursive doubling among the p2 ranks of the
+ * folding, starting from each process holding the block of its new rank.
+ */
+void DoublingAllgather(const CommunicatorImpl& comm, uint32_t seq, uint32_t& step,
+                       const Folding& f, const std::vector<size_t>& offsets,
+                       char* acc, size_t esize) {
+    int lo = f.newrank, hi = f.newrank + 1;
+    for(int mask = 1; mask < f.p2; mask <<= 1, step++) {
+        int partner = f.realRank(f.newrank ^ mask);
+        int other_lo, other_hi;
+        if((f.newrank & mask) == 0) {
+            other_lo = hi;
+            other_hi = hi + mask;
+        } else {
+            other_lo = lo - mask;
+            other_hi = lo;
+        }
+        comm.sendrecv(acc + offsets[lo]*esize, (offsets[hi] - offsets[lo])*esize, partner,
+                      acc + offsets[other_lo]*esize, (offsets[other_hi] - offsets[other_lo])*esize,
+                      partner, CommunicatorImpl::makeTag(seq, step));
+        lo = std::min(lo, other_lo);
+        hi = std::max(hi, other_hi);
+    }
+}
+
+/**
+ * @brief Ring reduce-scatter. With shift = 1 the process of rank r ends
+ * up with the reduced block r+1 (mod n), with shift = 0 with block r.
+ */
+void RingReduceScatter(const CommunicatorImpl& comm, uint32_t seq,
+                       const std::vector<size_t>& offsets, int shift,
+                       char* acc, char* tmp, size_t esize, Type type, ReduceOp op) {
+    int n = comm.size(), r = comm.m_rank;
+    int right = (r + 1) % n, left = (r - 1 + n) % n;
+    for(int s = 0; s < n-1; s++) {
+        int sb = (r - s - 1 + shift + 2*n) % n;
+        int rb = (r - s - 2 + shift + 2*n) % n;
+        size_t rcount = offsets[rb+1] - offsets[rb];
+        comm.sendrecv(acc + offsets[sb]*esize, (offsets[sb+1] - offsets[sb])*esize, right,
+                      tmp, rcount*esize, left, CommunicatorImpl::makeTag(seq, s));
+        ApplyOp(type, op, tmp, acc + offsets[rb]*esize, rcount);
+    }
+}
+
+/**
+ * @brief Ring allgather of blocks of bytes; the process of rank r
+ * starts with the block (r + shift) mod n.
+ */
+void RingAllgather(const CommunicatorImpl& comm, uint32_t seq, uint32_t first_step,
+                   const std::vector<size_t>& offsets, int shift, char* acc, size_t esize) {
+    int n = comm.size(), r = comm.m_rank;
+    int right = (r + 1) % n, left = (r - 1 + n) % n;
+    for(int s = 0; s < n-1; s++) {
+        int sb = (r + shift - s + n) % n;
+        int rb = (r + shift - s - 1 + n) % n;
+        comm.sendrecv(acc + offsets[sb]*esize, (offsets[sb+1] - offsets[sb])*esize, right,
+                      acc + offsets[rb]*esize, (offsets[rb+1] - offsets[rb])*esize, left,
+                      CommunicatorImpl::makeTag(seq, first_step + s));
+    }
+}
+
+void Barrier(const CommunicatorImpl& comm, uint32_t seq) {
+    int n = comm.size(), r = comm.m_rank;
+    char out = 0, in = 0;
+    uint32_t step = 0;
+    // dissemination barrier
+    for(int k = 1; k < n; k <<= 1, step++) {
+        comm.sendrecv(&out, 1, (r + k) % n, &in, 1, (r - k + n) % n,
+                      CommunicatorImpl::makeTag(seq, step));
+    }
+}
+
+void Bcast(const CommunicatorImpl& comm, uint32_t seq,
+           void* buffer, size_t bytes, int root) {
+    int n = comm.size();
+    if(n == 1 || bytes == 0) return;
+    int vr = (comm.m_rank - root + n) % n;
+    auto tag = CommunicatorImpl::makeTag(seq, 0);
+    // binomial tree
+    int mask = 1;
+    while(mask < n) {
+        if(vr & mask) {
+            comm.recv(buffer, bytes, (vr - mask + root) % n, tag);
+            break;
+        }
+        mask <<= 1;
+    }
+    mask >>= 1;
+    while(mask > 0) {
+        if(vr + mask < n)
+            comm.send(buffer, bytes, (vr + mask + root) % n, tag);
+        mask >>= 1;
+    }
+}
+
+void Reduce(const CommunicatorImpl& comm, uint32_t seq,
+            const void* sendbuf, void* recvbuf, size_t count,
+            Type type, ReduceOp op, int root) {
+    int n = comm.size();
+    size_t esize = ComputeDataSize({1}, type);
+    size_t bytes = count*esize;
+    std::vector<char> acc(bytes), tmp(bytes);
+    if(bytes) std::memcpy(acc.data(), sendbuf, bytes);
+    int vr = (comm.m_rank - root + n) % n;
+    auto tag = CommunicatorImpl::makeTag(seq, 0);
+    // binomial tree, valid for the (commutative) operations provided
+    for(int mask = 1; mask < n && bytes != 0; mask <<= 1) {
+        if(vr & mask) {
+            comm.send(acc.data(), bytes, (vr - mask + root) % n, tag);
+            break;
+        } else if(vr + mask < n) {
+            comm.recv(tmp.data(), bytes, (vr + mask + root) % n, tag);
+            ApplyOp(type, op, tmp.data(), acc.data(), count);
+        }
+    }
+    if(comm.m_rank == root && bytes)
+        std::memcpy(recvbuf, acc.data(), bytes);
+}
+
+void Allreduce(const CommunicatorImpl& comm, uint32_t seq,
+               const void* sendbuf, void* recvbuf, size_t count,
+               Type type, ReduceOp op, Algorithm algorithm) {
+    int n = comm.size();
+    size_t esize = ComputeDataSize({1}, type);
+    size_t bytes = count*esize;
+    char* acc = static_cast<char*>(recvbuf);
+    if(sendbuf != recvbuf && bytes)
+        std::memcpy(acc, sendbuf, bytes);
+    if(n == 1 || count == 0) return;
+
+    Folding f(comm.m_rank, n);
+    if(algorithm == Algorithm::AUTO) {
+        if(bytes <= SMALL_MESSAGE_SIZE)
+            algorithm = Algorithm::RECURSIVE_DOUBLING;
+        else if(IsPowerOfTwo(n))
+            algorithm = Algorithm::RABENSEIFNER;
+        else
+            algorithm = Algorithm::RING;
+    }
+    // blocks would be empty, or the ring would need more steps than tags
+    // can tell apart: fall back to exchanging whole buffers
+    if((algorithm == Algorithm::RING && count < (size_t)n)
+    || (algorithm == Algorithm::RING && 2*(size_t)(n-1) >= UNFOLD_STEP)
+    || (algorithm == Algorithm::RABENSEIFNER && count < (size_t)f.p2))
+        algorithm = Algorithm::RECURSIVE_DOUBLING;
+
+    if(algorithm == Algorithm::RING) {
+        auto offsets = EvenBlocks(count, n);
+        std::vector<char> tmp((offsets[1] + 1)*esize);
+        RingReduceScatter(comm, seq, offsets, 1, acc, tmp.data(), esize, type, op);
+        RingAllgather(comm, seq, n-1, offsets, 1, acc, esize);
+        return;
+    }
+
+    std::vector<char> tmp(bytes);
+    Fold(comm, seq, f, acc, tmp.data(), count, esize, type, op);
+    if(f.newrank != -1) {
+        uint32_t step = 1;
+        if(algorithm == Algorithm::RABENSEIFNER) {
+            auto offsets = EvenBlocks(count, f.p2);
+            HalvingReduceScatter(comm, seq, step, f, offsets, acc, tmp.data(), esize, type, op);
+            DoublingAllgather(comm, seq, step, f, offsets, acc, esize);
+        } else {
+            for(int mask = 1; mask < f.p2; mask <<= 1, step++) {
+                int partner = f.realRank(f.newrank ^ mask);
+                comm.sendrecv(acc, bytes, partner, tmp.data(), bytes, partner,
+                              CommunicatorImpl::makeTag(seq, step));
+                ApplyOp(type, op, tmp.data(), acc, count);
+            }
+        }
+    }
+    Unfold(comm, seq, f, acc, bytes);
+}
+
+void Allgather(const CommunicatorImpl& comm, uint32_t seq,
+               const void* sendbuf, size_t bytes, void* recvbuf) {
+    int n = comm.size(), r = comm.m_rank;
+    char* out = static_cast<char*>(recvbuf);
+    if(out + r*bytes != sendbuf && bytes)
+        std::memcpy(out + r*bytes, sendbuf, bytes);
+    if(n == 1 || bytes == 0) return;
+    if(IsPowerOfTwo(n) && bytes*n <= SMALL_ALLGATHER_SIZE) {
+        Folding f(r, n);
+        uint32_t step = 0;
+        DoublingAllgather(comm, seq, step, f, EvenBlocks(bytes*n, n), out, 1);
+    } else {
+        CheckSteps("allgather", n-1);
+        RingAllgather(comm, seq, 0, EvenBlocks(bytes*n, n), 0, out, 1);
+    }
+}
+
+void ReduceScatter(const CommunicatorImpl& comm, uint32_t seq,
+                   const void* sendbuf, void* recvbuf,
+                   const std::vector<size_t>& counts,
+                   Type type, ReduceOp op) {
+    int n = comm.size(), r = comm.m_rank;
+    if(counts.size() != (size_t)n)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "reduceScatter expects one count per member");
+    size_t esize = ComputeDataSize({1}, type);
+    std::vector<size_t> offsets(n+1, 0);
+    std::partial_sum(counts.begin(), counts.end(), offsets.begin()+1);
+    std::vector<char> acc(offsets[n]*esize);
+    if(!acc.empty())
+        std::memcpy(acc.data(), sendbuf, acc.size());
+    if(n > 1) {
+        size_t max_count = *std::max_element(counts.begin(), counts.end());
+        if(IsPowerOfTwo(n)) {
+            Folding f(r, n);
+            uint32_t step = 0;
+            std::vector<char> tmp(offsets[n]*esize);
+            HalvingReduceScatter(comm, seq, step, f, offsets, acc.data(), tmp.data(), esize, type, op);
+        } else {
+            CheckSteps("reduceScatter", n-1);
+            std::vector<char> tmp(max_count*esize);
+            RingReduceScatter(comm, seq, offsets, 0, acc.data(), tmp.data(), esize, type, op);
+        }
+    }
+    if(counts[r])
+        std::memcpy(recvbuf, acc.data() + offsets[r]*esize, counts[r]*esize);
+}
+
+void Alltoallv(const CommunicatorImpl& comm, uint32_t seq,
+               const void* sendbuf,
+               const std::vector<size_t>& sendcounts,
+               const std::vector<size_t>& sdispls,
+               void* recvbuf,
+               const std::vector<size_t>& recvcounts,
+               const std::vector<size_t>& rdispls) {
+    int n = comm.size(), r = comm.m_rank;
+    if(sendcounts.size() != (size_t)n || sdispls.size() != (size_t)n
+    || recvcounts.size() != (size_t)n || rdispls.size() != (size_t)n)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "alltoallv expects one count and displacement per member");
+    auto in  = static_cast<const char*>(sendbuf);
+    auto out = static_cast<char*>(recvbuf);
+    if(sendcounts[r])
+        std::memmove(out + rdispls[r], in + sdispls[r], sendcounts[r]);
+    // pairwise exchange; each member sends a single message to each
+    // other member, so all the messages can share the same tag
+    auto tag = CommunicatorImpl::makeTag(seq, 0);
+    for(int s = 1; s < n; s++) {
+        int dest = (r + s) % n;
+        int src  = (r - s + n) % n;
+        comm.sendrecv(in + sdispls[dest], sendcounts[dest], dest,
+                      out + rdispls[src], recvcounts[src], src, tag);
+    }
+}
+
+void NeighborExchange(const CommunicatorImpl& comm, uint32_t seq,
+                      const std::vector<int>& neighbors,
+                      const void* sendbuf,
+                      const std::vector<size_t>& sendcounts,
+                      const std::vector<size_t>& sdispls,
+                      void* recvbuf,
+                      const std::vector<size_t>& recvcounts,
+                      const std::vector<size_t>& rdispls) {
+    size_t k = neighbors.size();
+    if(sendcounts.size() != k || sdispls.size() != k
+    || recvcounts.size() != k || rdispls.size() != k)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "neighborExchange expects one count and displacement per neighbor");
+    for(auto p : neighbors)
+        if(p < 0 || p >= comm.size())
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "neighborExchange called with an invalid neighbor rank");
+    auto in  = static_cast<const char*>(sendbuf);
+    auto out = static_cast<char*>(recvbuf);
+    auto tag = CommunicatorImpl::makeTag(seq, 0);
+    std::vector<mona_request_t> reqs;
+    reqs.reserve(2*k);
+    std::exception_ptr ex;
+    try {
+        // post receives first so that incoming messages find their buffer
+        for(size_t i = 0; i < k; i++) {
+            if(neighbors[i] == comm.m_rank || recvcounts[i] == 0) continue;
+            reqs.push_back(comm.irecv(out + rdispls[i], recvcounts[i], neighbors[i], tag));
+        }
+        for(size_t i = 0; i < k; i++) {
+            if(sendcounts[i] == 0) continue;
+            if(neighbors[i] == comm.m_rank) {
+                std::memmove(out + rdispls[i], in + sdispls[i], sendcounts[i]);
+                continue;
+            }
+            reqs.push_back(comm.isend(in + sdispls[i], sendcounts[i], neighbors[i], tag));
+        }
+    } catch(...) {
+        ex = std::current_exception();
+    }
+    // always complete the posted operations, since they reference the buffers
+    for(auto req : reqs) {
+        try {
+            CommunicatorImpl::wait(req);
+        } catch(...) {
+            if(!ex) ex = std::current_exception();
+        }
+    }
+    if(ex) std::rethrow_exception(ex);
+}
+
+/**
+ * @brief Sequence number of a blocking operation, released when the
+ * operation returns.
+ */
+struct PendingOp {
+
+    CommunicatorImpl& comm;
+    uint32_t          seq;
+
+    explicit PendingOp(CommunicatorImpl& c)
+    : comm(c)
+    , seq(c.acquireSeq()) {}
+
+    PendingOp(const PendingOp&) = delete;
+    PendingOp& operator=(const PendingOp&) = delete;
+
+    ~PendingOp() {
+        comm.releaseSeq(seq);
+    }
+};
+
+/**
+ * @brief Reserves a sequence number and runs f(comm, seq) in a ULT,
+ * releasing the sequence number before completing the request.
+ */
+template<typename F>
+std::shared_ptr<CommunicatorRequestImpl> Post(const std::shared_ptr<CommunicatorImpl>& impl, F&& f) {
+    auto req = std::make_shared<CommunicatorRequestImpl>();
+    auto seq = impl->acquireSeq();
+    try {
+        impl->m_pool.make_thread([impl, req, seq, f=std::forward<F>(f)]() {
+            std::exception_ptr ex;
+            try {
+                f(*impl, seq);
+            } catch(...) {
+                ex = std::current_exception();
+            }
+            impl->releaseSeq(seq);
+            req->complete(ex);
+        }, tl::anonymous());
+    } catch(...) {
+        impl->releaseSeq(seq);
+        throw;
+    }
+    return req;
+}
+
+}
+
+#define CHECK_COMMUNICATOR_VALID() \
+    do {\
+        if(not self)\
+            throw Exception(ErrorCode::INVALID_INSTANCE,\
+                "Invalid colza::Communicator object");\
+    } while(0)
+
+Communicator::Request::Request() = default;
+
+Communicator::Request::Request(const std::shared_ptr<CommunicatorRequestImpl>& impl)
+: self(impl) {}
+
+Communicator::Request::Request(const Request&) = default;
+
+Communicator::Request::Request(Request&& other) {
+    self = std::move(other.self);
+    other.self = nullptr;
+}
+
+Communicator::Request& Communicator::Request::operator=(const Request& other) {
+    if(this == &other || self == other.self) return *this;
+    if(self && self.unique()) self->wait();
+    self = other.self;
+    return *this;
+}
+
+Communicator::Request& Communicator::Request::operator=(Request&& other) {
+    if(this == &other || self == other.self) return *this;
+    if(self && self.unique()) self->wait();
+    self = std::move(other.self);
+    other.self = nullptr;
+    return *this;
+}
+
+Communicator::Request::~Request() {
+    if(self && self.unique()) self->wait();
+}
+
+void Communicator::Request::wait() const {
+    if(not self) return;
+    self->wait();
+    if(self->m_exception)
+        std::rethrow_exception(self->m_exception);
+}
+
+bool Communicator::Request::completed() const {
+    if(not self) return true;
+    std::lock_guard<tl::mutex> lock(self->m_mutex);
+    return self->m_completed;
+}
+
+Communicator::Request::operator bool() const {
+    return static_cast<bool>(self);
+}
+
+namespace {
+
+// context identifiers claimed in the process. A std::mutex is used since
+// contexts may be claimed before Argobots is initialized, and the
+// critical sections never block.
+struct ContextRegistry {
+    std::mutex        mtx;
+    std::vector<bool> claimed = std::vector<bool>(Communicator::MAX_CONTEXT + 1, false);
+
+    static ContextRegistry& Get() {
+        static ContextRegistry registry;
+        return registry;
+    }
+};
+
+}
+
+CommunicatorContext::CommunicatorContext() {
+    auto& registry = ContextRegistry::Get();
+    std::lock_guard<std::mutex> lock(registry.mtx);
+    for(uint32_t context = 1; context <= Communicator::MAX_CONTEXT; context++) {
+        if(registry.claimed[context]) continue;
+        registry.claimed[context] = true;
+        m_value = context;
+        return;
+    }
+    throw Exception(ErrorCode::OTHER_ERROR,
+        "All the "s + std::to_string(Communicator::MAX_CONTEXT)
+        + " communicator contexts are in use in this process");
+}
+
+CommunicatorContext::CommunicatorContext(uint32_t value) {
+    if(value == 0 || value > Communicator::MAX_CONTEXT)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Invalid communicator context "s + std::to_string(value));
+    auto& registry = ContextRegistry::Get();
+    std::lock_guard<std::mutex> lock(registry.mtx);
+    if(registry.claimed[value])
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Communicator context "s + std::to_string(value)
+            + " is already in use in this process");
+    registry.claimed[value] = true;
+    m_value = value;
+}
+
+CommunicatorContext::~CommunicatorContext() {
+    if(m_value == 0) return;
+    auto& registry = ContextRegistry::Get();
+    std::lock_guard<std::mutex> lock(registry.mtx);
+    registry.claimed[m_value] = false;
+}
+
+Communicator::Communicator() = default;
+
+Communicator::Communicator(mona_instance_t mona,
+                           const std::vector<na_addr_t>& addresses,
+                           const tl::pool& pool,
+                           uint32_t context)
+: self(std::make_shared<CommunicatorImpl>(mona, addresses, pool, context)) {}
+
+Communicator::Communicator(const Communicator&) = default;
+
+Communicator::Communicator(Communicator&&) = default;
+
+Communicator& Communicator::operator=(const Communicator&) = default;
+
+Communicator& Communicator::operator=(Communicator&&) = default;
+
+Communicator::~Communicator() = default;
+
+Communicator::operator bool() const {
+    return static_cast<bool>(self);
+}
+
+Communicator Communicator::derive(const std::string& name) const {
+    CHECK_COMMUNICATOR_VALID();
+    Communicator derived;
+    derived.self = std::make_shared<CommunicatorImpl>(*self, name);
+    return derived;
+}
+
+int Communicator::size() const {
+    CHECK_COMMUNICATOR_VALID();
+    return self->size();
+}
+
+int Communicator::rank() const {
+    CHECK_COMMUNICATOR_VALID();
+    return self->m_rank;
+}
+
+void Communicator::barrier() const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Barrier(*self, pending.seq);
+}
+
+void Communicator::bcast(void* buffer, size_t bytes, int root) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Bcast(*self, pending.seq, buffer, bytes, root);
+}
+
+void Communicator::reduce(const void* sendbuf, void* recvbuf, size_t count,
+                          Type type, ReduceOp op, int root) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Reduce(*self, pending.seq, sendbuf, recvbuf, count, type, op, root);
+}
+
+void Communicator::allreduce(const void* sendbuf, void* recvbuf, size_t count,
+                             Type type, ReduceOp op, Algorithm algorithm) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Allreduce(*self, pending.seq, sendbuf, recvbuf, count, type, op, algorithm);
+}
+
+void Communicator::allgather(const void* sendbuf, size_t bytes, void* recvbuf) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Allgather(*self, pending.seq, sendbuf, bytes, recvbuf);
+}
+
+void Communicator::reduceScatter(const void* sendbuf, void* recvbuf,
+                                 const std::vector<size_t>& counts,
+                                 Type type, ReduceOp op) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    ReduceScatter(*self, pending.seq, sendbuf, recvbuf, counts, type, op);
+}
+
+void Communicator::alltoallv(const void* sendbuf,
+                             const std::vector<size_t>& sendcounts,
+                             const std::vector<size_t>& sdispls,
+                             void* recvbuf,
+                             const std::vector<size_t>& recvcounts,
+                             const std::vector<size_t>& rdispls) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    Alltoallv(*self, pending.seq, sendbuf, sendcounts, sdispls,
+              recvbuf, recvcounts, rdispls);
+}
+
+void Communicator::neighborExchange(const std::vector<int>& neighbors,
+                                    const void* sendbuf,
+                                    const std::vector<size_t>& sendcounts,
+                                    const std::vector<size_t>& sdispls,
+                                    void* recvbuf,
+                                    const std::vector<size_t>& recvcounts,
+                                    const std::vector<size_t>& rdispls) const {
+    CHECK_COMMUNICATOR_VALID();
+    PendingOp pending(*self);
+    NeighborExchange(*self, pending.seq, neighbors, sendbuf, sendcounts, sdispls,
+                     recvbuf, recvcounts, rdispls);
+}
+
+Communicator::Request Communicator::ibarrier() const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [](const CommunicatorImpl& comm, uint32_t seq) {
+        Barrier(comm, seq);
+    }));
+}
+
+Communicator::Request Communicator::ibcast(void* buffer, size_t bytes, int root) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [buffer, bytes, root]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        Bcast(comm, seq, buffer, bytes, root);
+    }));
+}
+
+Communicator::Request Communicator::ireduce(const void* sendbuf, void* recvbuf, size_t count,
+                                            Type type, ReduceOp op, int root) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [sendbuf, recvbuf, count, type, op, root]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        Reduce(comm, seq, sendbuf, recvbuf, count, type, op, root);
+    }));
+}
+
+Communicator::Request Communicator::iallreduce(const void* sendbuf, void* recvbuf, size_t count,
+                                               Type type, ReduceOp op, Algorithm algorithm) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [sendbuf, recvbuf, count, type, op, algorithm]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        Allreduce(comm, seq, sendbuf, recvbuf, count, type, op, algorithm);
+    }));
+}
+
+Communicator::Request Communicator::iallgather(const void* sendbuf, size_t bytes, void* recvbuf) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [sendbuf, bytes, recvbuf]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        Allgather(comm, seq, sendbuf, bytes, recvbuf);
+    }));
+}
+
+Communicator::Request Communicator::ireduceScatter(const void* sendbuf, void* recvbuf,
+                                                   const std::vector<size_t>& counts,
+                                                   Type type, ReduceOp op) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [sendbuf, recvbuf, counts, type, op]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        ReduceScatter(comm, seq, sendbuf, recvbuf, counts, type, op);
+    }));
+}
+
+Communicator::Request Communicator::ialltoallv(const void* sendbuf,
+                                               const std::vector<size_t>& sendcounts,
+                                               const std::vector<size_t>& sdispls,
+                                               void* recvbuf,
+                                               const std::vector<size_t>& recvcounts,
+                                               const std::vector<size_t>& rdispls) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [sendbuf, sendcounts, sdispls,
+                               recvbuf, recvcounts, rdispls]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        Alltoallv(comm, seq, sendbuf, sendcounts, sdispls,
+                  recvbuf, recvcounts, rdispls);
+    }));
+}
+
+Communicator::Request Communicator::ineighborExchange(const std::vector<int>& neighbors,
+                                                     const void* sendbuf,
+                                                     const std::vector<size_t>& sendcounts,
+                                                     const std::vector<size_t>& sdispls,
+                                                     void* recvbuf,
+                                                     const std::vector<size_t>& recvcounts,
+                                                     const std::vector<size_t>& rdispls) const {
+    CHECK_COMMUNICATOR_VALID();
+    return Request(Post(self, [neighbors, sendbuf, sendcounts, sdispls,
+                               recvbuf, recvcounts, rdispls]
+                              (const CommunicatorImpl& comm, uint32_t seq) {
+        NeighborExchange(comm, seq, neighbors, sendbuf, sendcounts, sdispls,
+                         recvbuf, recvcounts, rdispls);
+    }));
+}
+
+}
@@ -0,0 +1,297 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_COMMUNICATOR_IMPL_H
+#define __COLZA_COMMUNICATOR_IMPL_H
+
+#include "colza/Communicator.hpp"
+#include "colza/Exception.hpp"
+#include "colza/ErrorCodes.hpp"
+
+#include <thallium.hpp>
+#include <mona.h>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace colza {
+
+using namespace std::string_literals;
+namespace tl = thallium;
+
+/**
+ * @brief Claim of a context identifier in the process. The providers
+ * assign an identifier to each pipeline when it is created, so that
+ * all the members of the pipeline agree on it; claims detect a pipeline
+ * being given an identifier already used in the process, since their
+ * messages could not be told apart. Context 0 is never claimed.
+ */
+class CommunicatorContext {
+
+    public:
+
+    /**
+     * @brief Claims the lowest free identifier. Throws a
+     * colza::Exception if all the identifiers are in use.
+     */
+    CommunicatorContext();
+
+    /**
+     * @brief Claims the given identifier. Throws a colza::Exception
+     * if it is out of range or already claimed in the process.
+     */
+    explicit CommunicatorContext(uint32_t value);
+
+    CommunicatorContext(const CommunicatorContext&) = delete;
+    CommunicatorContext& operator=(const CommunicatorContext&) = delete;
+
+    ~CommunicatorContext();
+
+    uint32_t value() const {
+        return m_value;
+    }
+
+    private:
+
+    uint32_t m_value = 0;
+};
+
+class CommunicatorImpl {
+
+    public:
+
+    static constexpr uint32_t SEQ_BITS     = 7;
+    static constexpr uint32_t STEP_BITS    = 13;
+    static constexpr uint32_t DERIVED_BITS = 3;
+
+    static_assert((1u << SEQ_BITS) == Communicator::MAX_PENDING,
+                  "sequence numbers should cover the pending operations");
+    static_assert((1u << STEP_BITS) - 1 == Communicator::MAX_STEPS,
+                  "steps should cover the rounds of a collective");
+    static_assert((1u << DERIVED_BITS) - 1 == Communicator::MAX_DERIVED,
+                  "derived contexts should cover the derived communicators");
+    static_assert(8 + DERIVED_BITS + SEQ_BITS + STEP_BITS == 31,
+                  "tags should fit below the most significant bit");
+
+    mona_instance_t        m_mona = nullptr;
+    std::vector<na_addr_t> m_addresses;
+    int                    m_rank = -1;
+    tl::pool               m_pool;
+    // context identifier in the upper bits, index among the communicators
+    // derived from the same root communicator in the lower DERIVED_BITS
+    uint32_t               m_context = 0;
+    // number of communicators derived from the root communicator,
+    // shared by all the communicators derived from it
+    std::shared_ptr<std::atomic<uint32_t>> m_num_derived;
+
+    tl::mutex              m_seq_mtx;
+    tl::condition_variable m_seq_cv;
+    uint32_t               m_seq = 0;
+    // number of operations that completed with each sequence number
+    std::vector<uint32_t>  m_released;
+
+    CommunicatorImpl(mona_instance_t mona,
+                     const std::vector<na_addr_t>& addresses,
+                     const tl::pool& pool,
+                     uint32_t context)
+    : m_mona(mona)
+    , m_pool(pool)
+    , m_context(context << DERIVED_BITS)
+    , m_num_derived(std::make_shared<std::atomic<uint32_t>>(0))
+    , m_released(Communicator::MAX_PENDING, 0) {
+        if(context > Communicator::MAX_CONTEXT)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Communicator context "s + std::to_string(context)
+                + " is larger than " + std::to_string(Communicator::MAX_CONTEXT));
+        na_addr_t self_addr = NA_ADDR_NULL;
+        if(mona_addr_self(m_mona, &self_addr) != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR, "Could not get address from MoNA");
+        m_addresses.reserve(addresses.size());
+        for(size_t i = 0; i < addresses.size(); i++) {
+            na_addr_t addr = NA_ADDR_NULL;
+            mona_addr_dup(m_mona, addresses[i], &addr);
+            m_addresses.push_back(addr);
+            if(m_rank == -1 && mona_addr_cmp(m_mona, self_addr, addr))
+                m_rank = (int)i;
+        }
+        mona_addr_free(m_mona, self_addr);
+        if(m_rank == -1) {
+            for(auto addr : m_addresses)
+                mona_addr_free(m_mona, addr);
+            throw Exception(ErrorCode::MONA_ERROR,
+                "Calling process is not part of the communicator");
+        }
+    }
+
+    /**
+     * @brief Builds a communicator derived from parent (see
+     * Communicator::derive).
+     */
+    CommunicatorImpl(const CommunicatorImpl& parent, const std::string& name)
+    : m_mona(parent.m_mona)
+    , m_rank(parent.m_rank)
+    , m_pool(parent.m_pool)
+    , m_num_derived(parent.m_num_derived)
+    , m_released(Communicator::MAX_PENDING, 0) {
+        auto index = ++(*m_num_derived);
+        if(index > Communicator::MAX_DERIVED)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Could not derive communicator "s + name + ": at most "
+                + std::to_string(Communicator::MAX_DERIVED)
+                + " communicators can be derived from a communicator");
+        m_context = (parent.m_context & ~Communicator::MAX_DERIVED) | index;
+        m_addresses.reserve(parent.m_addresses.size());
+        for(auto parent_addr : parent.m_addresses) {
+            na_addr_t addr = NA_ADDR_NULL;
+            mona_addr_dup(m_mona, parent_addr, &addr);
+            m_addresses.push_back(addr);
+        }
+    }
+
+    CommunicatorImpl(const CommunicatorImpl&) = delete;
+    CommunicatorImpl& operator=(const CommunicatorImpl&) = delete;
+
+    ~CommunicatorImpl() {
+        for(auto addr : m_addresses)
+            mona_addr_free(m_mona, addr);
+    }
+
+    int size() const {
+        return (int)m_addresses.size();
+    }
+
+    /**
+     * @brief Reserves a sequence number for a collective operation.
+     * Since collectives are called in the same order by all the members,
+     * all the members obtain the same sequence number for a given
+     * operation, which is used to build the tags of its messages.
+     * The upper bits of a sequence number hold the context, so that
+     * communicators with different contexts never produce the same tags.
+     * The lower SEQ_BITS bits count operations and wrap around, so the
+     * operation posted MAX_PENDING operations earlier, which used the
+     * same tags, is waited for. Waiters are served in posting order.
+     * The sequence number should be released when the operation ends.
+     */
+    uint32_t acquireSeq() {
+        std::unique_lock<tl::mutex> lock(m_seq_mtx);
+        uint32_t n = m_seq++;
+        uint32_t slot = n % Communicator::MAX_PENDING;
+        while(m_released[slot] != n / Communicator::MAX_PENDING)
+            m_seq_cv.wait(lock);
+        return (m_context << SEQ_BITS) | slot;
+    }
+
+    void releaseSeq(uint32_t seq) {
+        {
+            std::lock_guard<tl::mutex> lock(m_seq_mtx);
+            // kept modulo the number of times m_seq goes through the slots
+            auto& released = m_released[seq % Communicator::MAX_PENDING];
+            released = (released + 1) & ((1u << (32 - SEQ_BITS)) - 1);
+        }
+        m_seq_cv.notify_all();
+    }
+
+    /**
+     * @brief Builds the tag of the messages sent during the given
+     * step of the collective with the given sequence number.
+     * Tags used by collectives have their most significant bit set,
+     * leaving the rest of the tag space to backends using MoNA directly.
+     * Collectives check their number of steps before sending anything,
+     * so that all the members fail the same way; this is a last resort.
+     */
+    static na_tag_t makeTag(uint32_t seq, uint32_t step) {
+        if(step > Communicator::MAX_STEPS)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Collective step "s + std::to_string(step) + " is out of range");
+        return (na_tag_t)(0x80000000u | (seq << STEP_BITS) | step);
+    }
+
+    void send(const void* buf, size_t size, int dest, na_tag_t tag) const {
+        na_return_t ret = mona_send(m_mona, buf, size, m_addresses[dest], 0, tag);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_send failed with error code "s + std::to_string(ret));
+    }
+
+    void recv(void* buf, size_t size, int src, na_tag_t tag) const {
+        na_size_t actual_size = 0;
+        na_return_t ret = mona_recv(m_mona, buf, size, m_addresses[src], tag, &actual_size);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_recv failed with error code "s + std::to_string(ret));
+    }
+
+    mona_request_t isend(const void* buf, size_t size, int dest, na_tag_t tag) const {
+        mona_request_t req = MONA_REQUEST_NULL;
+        na_return_t ret = mona_isend(m_mona, buf, size, m_addresses[dest], 0, tag, &req);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_isend failed with error code "s + std::to_string(ret));
+        return req;
+    }
+
+    mona_request_t irecv(void* buf, size_t size, int src, na_tag_t tag) const {
+        mona_request_t req = MONA_REQUEST_NULL;
+        na_return_t ret = mona_irecv(m_mona, buf, size, m_addresses[src], tag, nullptr, &req);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_irecv failed with error code "s + std::to_string(ret));
+        return req;
+    }
+
+    static void wait(mona_request_t req) {
+        na_return_t ret = mona_wait(req);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_wait failed with error code "s + std::to_string(ret));
+    }
+
+    /**
+     * @brief Sends to dest and receives from src at the same time.
+     * Empty messages are skipped; both sides always agree on sizes.
+     */
+    void sendrecv(const void* sendbuf, size_t sendsize, int dest,
+                  void* recvbuf, size_t recvsize, int src, na_tag_t tag) const {
+        mona_request_t req = MONA_REQUEST_NULL;
+        if(sendsize != 0)
+            req = isend(sendbuf, sendsize, dest, tag);
+        if(recvsize != 0)
+            recv(recvbuf, recvsize, src, tag);
+        if(req != MONA_REQUEST_NULL)
+            wait(req);
+    }
+};
+
+class CommunicatorRequestImpl {
+
+    public:
+
+    tl::mutex              m_mutex;
+    tl::condition_variable m_cv;
+    bool                   m_completed = false;
+    std::exception_ptr     m_exception;
+
+    void complete(std::exception_ptr ex) {
+        {
+            std::lock_guard<tl::mutex> lock(m_mutex);
+            m_exception = ex;
+            m_completed = true;
+        }
+        m_cv.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<tl::mutex> lock(m_mutex);
+        while(!m_completed)
+            m_cv.wait(lock);
+    }
+};
+
+}
+
+#endif
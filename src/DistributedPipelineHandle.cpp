@@ -13,11 +13,123 @@
 #include "PipelineHandleImpl.hpp"
 #include "TypeSizes.hpp"
 
+#include <thallium/serialization/stl/vector.hpp>
 #include <thallium/serialization/stl/string.hpp>
 #include <thallium/serialization/stl/pair.hpp>
 
+#include <algorithm>
+#include <exception>
+
 namespace colza {
 
+namespace {
+
+// completes once all the requests sent to the servers have completed,
+// rethrowing the first error (results holds the servers' results)
+std::shared_ptr<AsyncRequestImpl> WaitForAll(std::vector<AsyncRequest> server_requests,
+                                             std::shared_ptr<std::vector<int32_t>> results,
+                                             int32_t* result) {
+    auto async_request_impl =
+        std::make_shared<AsyncRequestImpl>(std::vector<tl::async_response>());
+    async_request_impl->m_wait_callback =
+            [result, results, server_requests](AsyncRequestImpl&) {
+                    std::exception_ptr error;
+                    for(auto& r : server_requests) {
+                        try {
+                            r.wait();
+                        } catch(...) {
+                            if(!error) error = std::current_exception();
+                        }
+                    }
+                    if(error) std::rethrow_exception(error);
+                    if(result) *result = 0;
+            };
+    return async_request_impl;
+}
+
+// each process sends the requests of a collective operation to its own
+// subset of the servers, rather than a single process sending them all
+bool IsOwnServer(const ClientCommunicator* comm, size_t index) {
+    return index % (size_t)comm->size() == (size_t)comm->rank();
+}
+
+// result of the first process whose servers reported an error (or
+// success), the same on all the processes; failures are counted with a
+// single value, and found and broadcast only if there are any
+RequestResult<int32_t> ShareResult(const ClientCommunicator* comm,
+                                   const RequestResult<int32_t>& local) {
+    RequestResult<int32_t> shared;
+    shared.value() = 0;
+    uint64_t num_failed = local.success() ? 0 : 1;
+    comm->allreduceSum(&num_failed, 1);
+    if(num_failed == 0) return shared;
+    std::vector<uint64_t> failed(comm->size(), 0);
+    failed[comm->rank()] = local.success() ? 0 : 1;
+    comm->allreduceSum(failed.data(), failed.size());
+    int root = (int)(std::find(failed.begin(), failed.end(), 1) - failed.begin());
+    int32_t code = local.value();
+    uint64_t length = local.error().size();
+    comm->bcast(&code, sizeof(code), root);
+    comm->bcast(&length, sizeof(length), root);
+    std::string error = local.error();
+    error.resize(length);
+    if(length) comm->bcast(&error[0], (int)length, root);
+    shared.success() = false;
+    shared.value()   = code;
+    shared.error()   = std::move(error);
+    return shared;
+}
+
+// first error among the responses, an RPC that could not complete
+// being an error as well, so that the processes always share a result
+RequestResult<int32_t> WaitForResponses(std::vector<tl::async_response>& responses) {
+    RequestResult<int32_t> result;
+    result.value() = 0;
+    for(auto& r : responses) {
+        RequestResult<int32_t> response;
+        try {
+            response = r.wait();
+        } catch(const std::exception& ex) {
+            response.success() = false;
+            response.value()   = (int)ErrorCode::OTHER_ERROR;
+            response.error()   = ex.what();
+        }
+        if(!response.success() && result.success())
+            result = std::move(response);
+    }
+    responses.clear();
+    return result;
+}
+
+// sends an RPC (send(pipeline) returning its async_response) to the
+// servers of this process; waiting on the resulting request, which all
+// the processes must do, shares the first error among them
+template<typename Send>
+std::shared_ptr<AsyncRequestImpl> SendToOwnServers(const DistributedPipelineHandleImpl& impl,
+                                                   Send&& send, int32_t* result) {
+    std::vector<tl::async_response> async_responses;
+    for(size_t i = 0; i < impl.m_pipelines.size(); i++) {
+        if(IsOwnServer(impl.m_comm, i))
+            async_responses.push_back(send(impl.m_pipelines[i]));
+    }
+    auto async_request_impl =
+        std::make_shared<AsyncRequestImpl>(std::move(async_responses));
+    auto comm = impl.m_comm;
+    async_request_impl->m_wait_callback =
+            [result, comm](AsyncRequestImpl& async_request_impl) {
+                    auto response = ShareResult(
+                        comm, WaitForResponses(async_request_impl.m_async_responses));
+                    if(response.success()) {
+                        if(result) *result = response.value();
+                    } else {
+                        throw Exception((ErrorCode)response.value(), response.error());
+                    }
+            };
+    return async_request_impl;
+}
+
+}
+
 DistributedPipelineHandle::DistributedPipelineHandle() = default;
 
 DistributedPipelineHandle::DistributedPipelineHandle(const std::shared_ptr<DistributedPipelineHandleImpl>& impl)
@@ -53,104 +165,151 @@ void DistributedPipelineHandle::setHashFunction(const HashFunction& hash) {
         throw Exception(ErrorCode::INVALID_INSTANCE,
             "Invalid colza::DistributedPipelineHandle object");
     self->m_hash = hash;
+    self->m_custom_hash = true;
 }
 
-void DistributedPipelineHandle::start(uint64_t iteration) {
+void DistributedPipelineHandle::loadCatalog(const std::string& dataset_name,
+           uint64_t iteration,
+           size_t max_boxes) {
     if(not self)
         throw Exception(ErrorCode::INVALID_INSTANCE,
             "Invalid colza::DistributedPipelineHandle object");
-    self->m_comm->barrier();
-    int my_rank = self->m_comm->rank();
-
-    auto& start = self->m_client->m_start;
-    auto& abort = self->m_client->m_abort;
-
-    bool ok = false;
-    bool retry = true;
-    bool first_attempt = true;
-
-    if(my_rank == 0) {
+    auto& rpc = self->m_client->m_summarize;
+    std::vector<tl::async_response> async_responses;
+    for(auto& pipeline : self->m_pipelines) {
+        auto async_response = rpc.on(pipeline.self->m_ph).async(
+            pipeline.self->m_name, dataset_name, iteration, (uint64_t)max_boxes);
+        async_responses.push_back(std::move(async_response));
+    }
+    std::vector<DistributedPipelineHandleImpl::ServerSummary> summaries(async_responses.size());
+    for(size_t i = 0; i < async_responses.size(); i++) {
+        RequestResult<std::vector<Box>> response = async_responses[i].wait();
+        if(response.success()) {
+            summaries[i].known = true;
+            summaries[i].boxes = std::move(response.value());
+        } else {
+            spdlog::trace("Server {} could not summarize dataset {}: {}",
+                          i, dataset_name, response.error());
+        }
+    }
+    self->m_catalogs[std::make_pair(dataset_name, iteration)] = std::move(summaries);
+}
 
-        while(retry) {
+void DistributedPipelineHandle::clearCatalog() {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    self->m_catalogs.clear();
+}
 
-            if(!first_attempt) {
-                spdlog::trace("Updating view of SSG group");
-                auto new_dist_pipeline = Client(self->m_client).makeDistributedPipelineHandle(
-                        self->m_comm, self->m_ssg_group_file, self->m_provider_id,
-                        self->m_name, false);
-                self = std::move(new_dist_pipeline.self);
-            }
+void DistributedPipelineHandle::start(uint64_t iteration) {
+    startIteration(iteration, nullptr, false);
+}
 
-            retry = false;
+void DistributedPipelineHandle::start(uint64_t iteration,
+           const std::vector<std::pair<std::string, uint64_t>>& blocks,
+           bool autoCleanup) {
+    startIteration(iteration, &blocks, autoCleanup);
+}
 
-            const auto group_hash = self->m_group_hash;
-            auto num_pipelines = self->m_pipelines.size();
+void DistributedPipelineHandle::startIteration(uint64_t iteration,
+           const std::vector<std::pair<std::string, uint64_t>>* blocks,
+           bool autoCleanup) {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    const auto* comm = self->m_comm;
+
+    // number of blocks each pipeline will receive from all the processes,
+    // recomputed whenever the view of the group is updated
+    auto count_blocks = [this, blocks, iteration]() {
+        std::vector<uint64_t> counts;
+        if(!blocks) return counts;
+        counts.resize(self->m_pipelines.size(), 0);
+        if(counts.empty()) return counts;
+        for(auto& b : *blocks)
+            counts[self->placementIndex(self->m_hash(b.first, iteration, b.second))] += 1;
+        self->m_comm->allreduceSum(counts.data(), counts.size());
+        return counts;
+    };
 
-            std::vector<PipelineHandle*> started;
-            started.reserve(num_pipelines);
-            ok = true;
-            spdlog::trace("Sending a start command to {} pipelines, with group_hash = {}", num_pipelines, self->m_group_hash);
+    auto& start = self->m_client->m_start;
+    auto& abort = self->m_client->m_abort;
 
-            std::vector<tl::async_response> async_responses;
+    for(int attempt = 0; ; attempt++) {
 
-            for(auto& pipeline : self->m_pipelines) {
-                auto async_response = start.on(pipeline.self->m_ph).async(
-                        group_hash, pipeline.self->m_name, iteration);
-                async_responses.push_back(std::move(async_response));
-            }
+        if(attempt != 0) {
+            // from the second attempt on, slow down querying the file
+            if(attempt > 1)
+                tl::thread::sleep(self->m_client->m_engine, 100);
+            spdlog::trace("Updating view of SSG group");
+            auto new_dist_pipeline = Client(self->m_client).makeDistributedPipelineHandle(
+                    comm, self->m_ssg_group_file, self->m_provider_ids,
+                    self->m_name, false);
+            new_dist_pipeline.self->m_hash = self->m_hash;
+            new_dist_pipeline.self->m_custom_hash = self->m_custom_hash;
+            self = std::move(new_dist_pipeline.self);
+        }
 
-            for(unsigned i = 0; i < async_responses.size(); i++) {
-                auto& a = async_responses[i];
-                auto& p = self->m_pipelines[i];
-                RequestResult<int32_t> result = a.wait();
-                if(!result.success()) {
-                    ok = false;
-                    if((retry == false) && (result.value() == (int)ErrorCode::INVALID_GROUP_HASH)) {
-                        spdlog::warn("Invalid group hash detected, group view needs to be updated");
-                        retry = true;
-                    }
-                } else {
-                    started.push_back(&p);
-                }
+        auto counts = count_blocks();
+        const auto group_hash = self->m_group_hash;
+
+        // each process starts the pipelines of its own servers, and the
+        // processes then agree on the outcome
+        std::vector<size_t> sent;
+        std::vector<tl::async_response> async_responses;
+        for(size_t i = 0; i < self->m_pipelines.size(); i++) {
+            if(!IsOwnServer(comm, i)) continue;
+            auto& pipeline = self->m_pipelines[i];
+            async_responses.push_back(start.on(pipeline.self->m_ph).async(
+                    group_hash, pipeline.self->m_name, iteration,
+                    blocks != nullptr, blocks ? counts[i] : (uint64_t)0, autoCleanup,
+                    self->m_provider_ids, self->m_custom_hash));
+            sent.push_back(i);
+        }
+        spdlog::trace("Sent a start command to {} pipelines, with group_hash = {}",
+                      sent.size(), group_hash);
+
+        RequestResult<int32_t> local;
+        std::vector<size_t> started;
+        for(size_t j = 0; j < async_responses.size(); j++) {
+            RequestResult<int32_t> response;
+            try {
+                response = async_responses[j].wait();
+            } catch(const std::exception& ex) {
+                response.success() = false;
+                response.value()   = (int)ErrorCode::OTHER_ERROR;
+                response.error()   = ex.what();
             }
-
-            async_responses.clear();
-
-            self->m_comm->bcast(&ok, sizeof(ok), 0);
-            if(!ok) { // one RPC failed to be sent, send "abort to the
-                for(auto pipeline : started) {
-                    try {
-                        auto async_response = abort.on(pipeline->self->m_ph).async(pipeline->self->m_name, iteration);
-                        async_responses.push_back(std::move(async_response));
-                    } catch(...) {
-                        spdlog::error("Could not abort iteration on pipeline {} at address {}",
-                                pipeline->self->m_name,
-                                static_cast<std::string>(pipeline->self->m_ph));
-                    }
-                }
-                for(auto& a : async_responses) {
-                    a.wait();
-                }
-                async_responses.clear();
-                if(!first_attempt) {
-                    // if it's the second attempt already, slow down querying the file
-                    tl::thread::sleep(self->m_client->m_engine, 100);
-                }
+            if(response.success())
+                started.push_back(sent[j]);
+            else if(local.success())
+                local = std::move(response);
+        }
+        async_responses.clear();
+
+        auto result = ShareResult(comm, local);
+        if(result.success()) return;
+
+        // the iteration starts on all the servers or on none
+        for(auto i : started) {
+            auto& pipeline = self->m_pipelines[i];
+            try {
+                async_responses.push_back(
+                    abort.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration));
+            } catch(...) {
+                spdlog::error("Could not abort iteration on pipeline {} at address {}",
+                        pipeline.self->m_name,
+                        static_cast<std::string>(pipeline.self->m_ph));
             }
-
-            first_attempt = false;
         }
-
-    } else { // non-0 ranks
-
-        self->m_comm->bcast(&ok, sizeof(ok), 0);
-        while(not ok) {
-            auto new_dist_pipeline = Client(self->m_client).makeDistributedPipelineHandle(
-                self->m_comm, self->m_ssg_group_file, self->m_provider_id,
-                self->m_name, false);
-            self = std::move(new_dist_pipeline.self);
-            self->m_comm->bcast(&ok, sizeof(ok), 0);
+        for(auto& a : async_responses) {
+            try { a.wait(); } catch(...) {}
         }
+
+        if(result.value() != (int)ErrorCode::INVALID_GROUP_HASH)
+            throw Exception((ErrorCode)result.value(), result.error());
+        spdlog::warn("Invalid group hash detected, group view needs to be updated");
     }
 }
 
@@ -171,7 +330,7 @@ void DistributedPipelineHandle::stage(const std::string& dataset_name,
         throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
             "No concrete pipeline attached to colza::DistributedPipelineHandle object");
     auto h = self->m_hash(dataset_name, iteration, block_id);
-    auto i = h % self->m_pipelines.size();
+    auto i = self->placementIndex(h);
     auto pipeline = PipelineHandle(self->m_pipelines[i]);
     pipeline.stage(dataset_name,
                    iteration,
@@ -201,7 +360,7 @@ void DistributedPipelineHandle::stage(const std::string& dataset_name,
         throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
             "No concrete pipeline attached to colza::DistributedPipelineHandle object");
     auto h = self->m_hash(dataset_name, iteration, block_id);
-    auto i = h % self->m_pipelines.size();
+    auto i = self->placementIndex(h);
     auto pipeline = PipelineHandle(self->m_pipelines[i]);
     pipeline.stage(dataset_name,
                    iteration,
@@ -214,47 +373,175 @@ void DistributedPipelineHandle::stage(const std::string& dataset_name,
                    req);
 }
 
-void DistributedPipelineHandle::execute(uint64_t iteration,
-             int32_t* result,
-             bool autoCleanup,
-             AsyncRequest* req) const {
+void DistributedPipelineHandle::stageShared(const std::vector<std::string>& other_pipelines,
+           const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const std::vector<size_t>& dimensions,
+           const std::vector<int64_t>& offsets,
+           const Type& type,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           int32_t* result,
+           AsyncRequest* req) const {
     if(not self)
         throw Exception(ErrorCode::INVALID_INSTANCE,
             "Invalid colza::DistributedPipelineHandle object");
-    self->m_comm->barrier();
     if(self->m_pipelines.size() == 0)
-        return;
-    auto num_pipelines = self->m_pipelines.size();
-    int num_processes = self->m_comm->size();
-    (void)num_processes; // not useful for now
-    int my_rank = self->m_comm->rank();
-    if(my_rank != 0) return;
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    auto h = self->m_hash(dataset_name, iteration, block_id);
+    auto i = self->placementIndex(h);
+    auto pipeline = PipelineHandle(self->m_pipelines[i]);
+    pipeline.stageShared(other_pipelines,
+                         dataset_name,
+                         iteration,
+                         block_id,
+                         dimensions,
+                         offsets,
+                         type,
+                         data,
+                         origin_addr,
+                         result,
+                         req);
+}
 
-    auto& rpc = self->m_client->m_execute;
-    std::vector<uint32_t> results(num_pipelines);
-    std::vector<tl::async_response> async_responses;
+void DistributedPipelineHandle::stageShared(const std::vector<std::string>& other_pipelines,
+           const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const std::vector<size_t>& dimensions,
+           const std::vector<int64_t>& offsets,
+           const Type& type,
+           const void* data,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    auto h = self->m_hash(dataset_name, iteration, block_id);
+    auto i = self->placementIndex(h);
+    auto pipeline = PipelineHandle(self->m_pipelines[i]);
+    pipeline.stageShared(other_pipelines,
+                         dataset_name,
+                         iteration,
+                         block_id,
+                         dimensions,
+                         offsets,
+                         type,
+                         data,
+                         result,
+                         req);
+}
 
-    for(auto& pipeline : self->m_pipelines) {
-        auto async_response = rpc.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration, autoCleanup);
-        async_responses.push_back(std::move(async_response));
+void DistributedPipelineHandle::fetch(const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           BlockInfo* info,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    auto h = self->m_hash(dataset_name, iteration, block_id);
+    auto i = self->placementIndex(h);
+    auto pipeline = PipelineHandle(self->m_pipelines[i]);
+    pipeline.fetch(dataset_name,
+                   iteration,
+                   block_id,
+                   data,
+                   origin_addr,
+                   info,
+                   req);
+}
+
+void DistributedPipelineHandle::fetch(const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           void* buffer,
+           size_t size,
+           BlockInfo* info,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    auto h = self->m_hash(dataset_name, iteration, block_id);
+    auto i = self->placementIndex(h);
+    auto pipeline = PipelineHandle(self->m_pipelines[i]);
+    pipeline.fetch(dataset_name,
+                   iteration,
+                   block_id,
+                   buffer,
+                   size,
+                   info,
+                   req);
+}
+
+void DistributedPipelineHandle::fetch(std::vector<FetchRequest>& requests,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    auto num_pipelines = self->m_pipelines.size();
+
+    // requests are grouped by target server, and each group is
+    // fetched with a single RPC, all the RPCs being sent concurrently
+    using Groups = std::vector<std::vector<FetchRequest>>;
+    using Indices = std::vector<std::vector<size_t>>;
+    auto groups  = std::make_shared<Groups>(num_pipelines);
+    auto indices = std::make_shared<Indices>(num_pipelines);
+    for(size_t i = 0; i < requests.size(); i++) {
+        auto& r = requests[i];
+        auto h = self->m_hash(r.dataset_name, r.iteration, r.block_id);
+        auto t = self->placementIndex(h);
+        (*groups)[t].push_back(r);
+        (*indices)[t].push_back(i);
+    }
+    std::vector<AsyncRequest> group_requests;
+    for(size_t t = 0; t < num_pipelines; t++) {
+        if((*groups)[t].empty()) continue;
+        AsyncRequest group_request;
+        PipelineHandle(self->m_pipelines[t]).fetch((*groups)[t], &group_request);
+        group_requests.push_back(std::move(group_request));
     }
 
     auto async_request_impl =
-        std::make_shared<AsyncRequestImpl>(std::move(async_responses));
+        std::make_shared<AsyncRequestImpl>(std::vector<tl::async_response>());
 
     async_request_impl->m_wait_callback =
-            [result](AsyncRequestImpl& async_request_impl) {
-                    RequestResult<int32_t> response;
-                    for(auto& r : async_request_impl.m_async_responses) {
-                        RequestResult<int32_t> local_response = r.wait();
-                        if(!local_response.success())
-                            response = local_response;
+            [&requests, groups, indices, group_requests](AsyncRequestImpl&) {
+                    // all the requests are waited for before
+                    // reporting the first failure
+                    std::exception_ptr error;
+                    for(auto& r : group_requests) {
+                        try {
+                            r.wait();
+                        } catch(...) {
+                            if(!error) error = std::current_exception();
+                        }
                     }
-                    async_request_impl.m_async_responses.clear();
-                    if(response.success()) {
-                        if(result) *result = response.value();
-                    } else {
-                        throw Exception((ErrorCode)response.value(), response.error());
+                    if(error) std::rethrow_exception(error);
+                    for(size_t t = 0; t < groups->size(); t++) {
+                        for(size_t j = 0; j < (*groups)[t].size(); j++) {
+                            auto& src = (*groups)[t][j];
+                            auto& dst = requests[(*indices)[t][j]];
+                            dst.info   = std::move(src.info);
+                            dst.result = src.result;
+                            dst.error  = std::move(src.error);
+                        }
                     }
             };
     if(req)
@@ -263,48 +550,146 @@ void DistributedPipelineHandle::execute(uint64_t iteration,
         AsyncRequest(std::move(async_request_impl)).wait();
 }
 
-void DistributedPipelineHandle::cleanup(uint64_t iteration,
+void DistributedPipelineHandle::query(const std::string& dataset_name,
+           uint64_t iteration,
+           const Box& region,
+           const Type& type,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    // all the servers that may hold blocks intersecting the region
+    // (all of them, unless a catalog was loaded) are queried concurrently
+    const std::vector<DistributedPipelineHandleImpl::ServerSummary>* summaries = nullptr;
+    auto catalog = self->m_catalogs.find(std::make_pair(dataset_name, iteration));
+    if(catalog != self->m_catalogs.end() && catalog->second.size() == self->m_pipelines.size())
+        summaries = &catalog->second;
+    std::vector<AsyncRequest> server_requests;
+    auto results = std::make_shared<std::vector<int32_t>>(self->m_pipelines.size());
+    for(size_t i = 0; i < self->m_pipelines.size(); i++) {
+        if(summaries && (*summaries)[i].known) {
+            auto& boxes = (*summaries)[i].boxes;
+            bool intersects = std::any_of(boxes.begin(), boxes.end(),
+                [&region](const Box& box) { return box.intersects(region); });
+            if(!intersects) continue;
+        }
+        AsyncRequest server_request;
+        PipelineHandle(self->m_pipelines[i]).query(
+            dataset_name, iteration, region, type, data, origin_addr,
+            &(*results)[i], &server_request);
+        server_requests.push_back(std::move(server_request));
+    }
+    auto async_request_impl = WaitForAll(std::move(server_requests), results, result);
+    if(req)
+        *req = AsyncRequest(std::move(async_request_impl));
+    else
+        AsyncRequest(std::move(async_request_impl)).wait();
+}
+
+void DistributedPipelineHandle::query(const std::string& dataset_name,
+           uint64_t iteration,
+           const Box& region,
+           const Type& type,
+           void* buffer,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    if(self->m_pipelines.size() == 0)
+        throw Exception(ErrorCode::EMPTY_DIST_PIPELINE,
+            "No concrete pipeline attached to colza::DistributedPipelineHandle object");
+    const size_t element_size = ComputeDataSize({}, type);
+    const auto num_pipelines = self->m_pipelines.size();
+    // a server whose parts of the region don't form a contiguous run of
+    // the buffer packs them into a temporary buffer sized from the
+    // catalog if one was loaded, or otherwise holding an equal share of
+    // the region (a server holding more is queried again with a larger
+    // buffer)
+    const std::vector<DistributedPipelineHandleImpl::ServerSummary>* summaries = nullptr;
+    auto catalog = self->m_catalogs.find(std::make_pair(dataset_name, iteration));
+    if(catalog != self->m_catalogs.end() && catalog->second.size() == num_pipelines)
+        summaries = &catalog->second;
+    const size_t share = ((region.volume() + num_pipelines - 1) / num_pipelines)*element_size;
+    std::vector<AsyncRequest> server_requests;
+    auto results = std::make_shared<std::vector<int32_t>>(num_pipelines);
+    for(size_t i = 0; i < num_pipelines; i++) {
+        size_t capacity = share;
+        if(summaries && (*summaries)[i].known) {
+            capacity = 0;
+            for(auto& box : (*summaries)[i].boxes)
+                capacity += box.intersect(region).volume()*element_size;
+            if(capacity == 0) continue;
+        }
+        AsyncRequest server_request;
+        PipelineHandle(self->m_pipelines[i]).queryPacked(
+            dataset_name, iteration, region, type, buffer, capacity,
+            &(*results)[i], &server_request);
+        server_requests.push_back(std::move(server_request));
+    }
+    auto async_request_impl = WaitForAll(std::move(server_requests), results, result);
+    if(req)
+        *req = AsyncRequest(std::move(async_request_impl));
+    else
+        AsyncRequest(std::move(async_request_impl)).wait();
+}
+
+void DistributedPipelineHandle::execute(uint64_t iteration,
              int32_t* result,
+             bool autoCleanup,
              AsyncRequest* req) const {
     if(not self)
         throw Exception(ErrorCode::INVALID_INSTANCE,
             "Invalid colza::DistributedPipelineHandle object");
+    // all the blocks must have been staged before any server executes
     self->m_comm->barrier();
-    if(self->m_pipelines.size() == 0)
-        return;
-    auto num_pipelines = self->m_pipelines.size();
-    int num_processes = self->m_comm->size();
-    (void)num_processes; // not useful for now
-    int my_rank = self->m_comm->rank();
-    if(my_rank != 0) return;
+    auto& rpc = self->m_client->m_execute;
+    auto async_request_impl = SendToOwnServers(*self,
+        [&rpc, iteration, autoCleanup](const PipelineHandle& pipeline) {
+            return rpc.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration, autoCleanup);
+        }, result);
+    if(req)
+        *req = AsyncRequest(std::move(async_request_impl));
+    else
+        AsyncRequest(std::move(async_request_impl)).wait();
+}
 
+void DistributedPipelineHandle::cleanup(uint64_t iteration,
+             int32_t* result,
+             AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    // no process may still be using the iteration
+    self->m_comm->barrier();
     auto& rpc = self->m_client->m_cleanup;
-    std::vector<uint32_t> results(num_pipelines);
-    std::vector<tl::async_response> async_responses;
-
-    for(auto& pipeline : self->m_pipelines) {
-        auto async_response = rpc.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration);
-        async_responses.push_back(std::move(async_response));
-    }
-
-    auto async_request_impl =
-        std::make_shared<AsyncRequestImpl>(std::move(async_responses));
+    auto async_request_impl = SendToOwnServers(*self,
+        [&rpc, iteration](const PipelineHandle& pipeline) {
+            return rpc.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration);
+        }, result);
+    if(req)
+        *req = AsyncRequest(std::move(async_request_impl));
+    else
+        AsyncRequest(std::move(async_request_impl)).wait();
+}
 
-    async_request_impl->m_wait_callback =
-            [result](AsyncRequestImpl& async_request_impl) {
-                    RequestResult<int32_t> response;
-                    for(auto& r : async_request_impl.m_async_responses) {
-                        RequestResult<int32_t> local_response = r.wait();
-                        if(!local_response.success())
-                            response = local_response;
-                    }
-                    async_request_impl.m_async_responses.clear();
-                    if(response.success()) {
-                        if(result) *result = response.value();
-                    } else {
-                        throw Exception((ErrorCode)response.value(), response.error());
-                    }
-            };
+void DistributedPipelineHandle::wait(uint64_t iteration,
+             int32_t* result,
+             AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::DistributedPipelineHandle object");
+    auto& rpc = self->m_client->m_wait_execution;
+    auto async_request_impl = SendToOwnServers(*self,
+        [&rpc, iteration](const PipelineHandle& pipeline) {
+            return rpc.on(pipeline.self->m_ph).async(pipeline.self->m_name, iteration);
+        }, result);
     if(req)
         *req = AsyncRequest(std::move(async_request_impl));
     else
@@ -8,10 +8,12 @@
 
 #include "colza/ClientCommunicator.hpp"
 #include "colza/PipelineHandle.hpp"
+#include "Placement.hpp"
 #include "SSGUtil.hpp"
 #include <ssg.h>
 #include <spdlog/spdlog.h>
 #include <vector>
+#include <map>
 #include <memory>
 
 namespace colza {
@@ -26,12 +28,25 @@ class DistributedPipelineHandleImpl {
     HashFunction                m_hash = [](const std::string&, uint64_t, uint64_t block_id){
         return block_id;
     };
+    // whether m_hash was set by setHashFunction, in which case servers
+    // cannot place blocks as the client does and do not migrate them
+    bool                        m_custom_hash = false;
+    // one handle per (server, provider_id) pair, ordered by server rank
+    // first, then by position of the provider id in m_provider_ids
     std::vector<PipelineHandle> m_pipelines;
-    // SSG info are only valid on rank 0
+    // summaries of the blocks of each server (same order as m_pipelines)
+    // per (dataset, iteration), loaded to route region queries
+    struct ServerSummary {
+        bool             known = false;
+        std::vector<Box> boxes;
+    };
+    std::map<std::pair<std::string, uint64_t>, std::vector<ServerSummary>> m_catalogs;
+    // SSG info are only valid on rank 0, except for the group hash,
+    // which rank 0 broadcasts (see Client::makeDistributedPipelineHandle)
     const std::string           m_ssg_group_file;
     ssg_group_id_t              m_gid;
     uint64_t                    m_group_hash = 0;
-    uint16_t                    m_provider_id;
+    std::vector<uint16_t>       m_provider_ids;
 
     DistributedPipelineHandleImpl(
         const ClientCommunicator* comm,
@@ -39,13 +54,13 @@ class DistributedPipelineHandleImpl {
         const std::shared_ptr<ClientImpl>& client,
         std::string ssg_group_file,
         ssg_group_id_t gid,
-        uint16_t provider_id)
+        std::vector<uint16_t> provider_ids)
     : m_comm(comm)
     , m_name(name)
     , m_client(client)
     , m_ssg_group_file(std::move(ssg_group_file))
     , m_gid(gid)
-    , m_provider_id(provider_id) {
+    , m_provider_ids(std::move(provider_ids)) {
         if(gid != SSG_GROUP_ID_INVALID)
             m_group_hash = ComputeGroupHash(gid);
     }
@@ -56,7 +71,7 @@ class DistributedPipelineHandleImpl {
         const std::shared_ptr<ClientImpl>& client,
         ssg_group_id_t gid,
         std::string ssg_group_file,
-        uint16_t provider_id,
+        std::vector<uint16_t> provider_ids,
         std::vector<PipelineHandle>&& pipelines)
     : m_comm(comm)
     , m_name(name)
@@ -64,11 +79,20 @@ class DistributedPipelineHandleImpl {
     , m_pipelines(std::move(pipelines))
     , m_ssg_group_file(std::move(ssg_group_file))
     , m_gid(gid)
-    , m_provider_id(provider_id) {
+    , m_provider_ids(std::move(provider_ids)) {
         if(gid != SSG_GROUP_ID_INVALID)
             m_group_hash = ComputeGroupHash(gid);
     }
 
+    /**
+     * @brief Index in m_pipelines of the pipeline to which a block
+     * with the given hash is sent (see PlacementIndex).
+     */
+    size_t placementIndex(uint64_t hash) const {
+        auto num_providers = m_provider_ids.size();
+        return PlacementIndex(hash, m_pipelines.size() / num_providers, num_providers);
+    }
+
     ~DistributedPipelineHandleImpl() {
         if(m_gid != SSG_GROUP_ID_INVALID) {
             ssg_group_unobserve(m_gid);
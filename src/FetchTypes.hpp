@@ -0,0 +1,75 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_FETCH_TYPES_H
+#define __COLZA_FETCH_TYPES_H
+
+#include "colza/BlockGeometry.hpp"
+#include "colza/RequestResult.hpp"
+#include "colza/Types.hpp"
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <string>
+
+namespace colza {
+
+/**
+ * @brief Block requested by a colza_fetch RPC, and the region of
+ * the client's bulk handle it should be pushed to.
+ */
+struct FetchKey {
+    std::string dataset_name;
+    uint64_t    iteration = 0;
+    uint64_t    block_id = 0;
+    size_t      offset = 0;   // offset in the bulk handle
+    size_t      capacity = 0; // size available at this offset
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & dataset_name;
+        a & iteration;
+        a & block_id;
+        a & offset;
+        a & capacity;
+    }
+};
+
+/**
+ * @brief Outcome of fetching one block. The info is filled in if the
+ * block was found, even if the buffer was too small for it.
+ */
+struct FetchedBlock {
+    RequestResult<int32_t> result;
+    BlockInfo              info;
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & result;
+        a & info;
+    }
+};
+
+/**
+ * @brief Outcome of a colza_query RPC. In packed mode, boxes are the
+ * intersections of the blocks with the region, in the order in which
+ * they were packed into the client's temporary buffer. They are also
+ * sent if that buffer was too small, so that the client can retry with
+ * a larger one. They are empty if the server pushed its parts straight
+ * to their place in the client's buffer.
+ */
+struct QueryResult {
+    RequestResult<int32_t> result;
+    std::vector<Box>       boxes;
+
+    template<typename Archive>
+    void serialize(Archive& a) {
+        a & result;
+        a & boxes;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,651 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_GROUP_STATE_H
+#define __COLZA_GROUP_STATE_H
+
+#include "colza/Exception.hpp"
+#include "colza/ErrorCodes.hpp"
+#include "colza/RequestResult.hpp"
+#include "colza/GroupView.hpp"
+#include "SSGUtil.hpp"
+
+#include <thallium.hpp>
+#include <thallium/serialization/stl/string.hpp>
+#include <thallium/serialization/stl/vector.hpp>
+#include <thallium/serialization/stl/pair.hpp>
+#include <mona.h>
+#include <ssg.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace colza {
+
+using namespace std::string_literals;
+namespace tl = thallium;
+
+/**
+ * @brief The GroupState holds everything related to the SSG group and
+ * to MoNA address resolution that is common to all the providers of
+ * a process. Providers sharing the same SSG group (e.g. one provider per
+ * NUMA domain, each with its own pool) share a single GroupState, so
+ * that membership updates and MoNA lookups are done once per process.
+ */
+class GroupState {
+
+    public:
+
+    /**
+     * @brief Callbacks a provider registers to be notified by the group.
+     */
+    struct Listener {
+        std::function<void(mona_instance_t, const GroupView&)> onViewUpdated;
+        std::function<void()> waitUntilInactive;
+        std::function<void(const std::vector<std::string>&)> migrate;
+        std::function<void(ssg_member_id_t)> onMemberDied;
+    };
+
+    // (member id, MoNA address) pairs exchanged by the colza_get_mona_addr RPC
+    using KnownAddresses = std::vector<std::pair<ssg_member_id_t, std::string>>;
+
+    // maximum number of members queried concurrently for their addresses
+    static constexpr size_t MAX_CONCURRENT_LOOKUPS = 16;
+    static constexpr double INITIAL_BACKOFF_MS = 10.0;
+    static constexpr double MAX_BACKOFF_MS = 1000.0;
+
+    tl::engine             m_engine;
+    ssg_group_id_t         m_gid;
+    mona_instance_t        m_mona;
+    uint16_t               m_provider_id;
+    tl::pool               m_pool;
+    tl::remote_procedure   m_get_mona_addr;
+    // initialization
+    tl::mutex              m_init_mtx;
+    bool                   m_initialized = false;
+    bool                   m_left = false;
+    // MoNA
+    tl::mutex              m_mona_mtx;
+    tl::condition_variable m_mona_cv;
+    std::string            m_mona_self_addr;
+    ssg_member_id_t        m_self_id = SSG_MEMBER_ID_INVALID;
+    // MoNA addresses (as strings) of the members we know of, including
+    // members that contacted us before SSG notified us of their joining
+    std::map<ssg_member_id_t, std::string> m_known_addresses;
+    std::map<ssg_member_id_t, na_addr_t> m_mona_addresses;
+    std::shared_ptr<const GroupView> m_view;
+    // serializes the publication of views with their notification to
+    // the listeners, so that listeners receive every version in order
+    tl::mutex              m_view_mtx;
+    // providers attached to this group
+    tl::mutex              m_listeners_mtx;
+    std::map<const void*, Listener> m_listeners;
+
+    GroupState(const tl::engine& engine, ssg_group_id_t gid,
+               mona_instance_t mona, uint16_t provider_id, const tl::pool& pool)
+    : m_engine(engine)
+    , m_gid(gid)
+    , m_mona(mona)
+    , m_provider_id(provider_id)
+    , m_pool(pool)
+    , m_get_mona_addr(m_engine.define("colza_get_mona_addr"))
+    , m_view(std::make_shared<GroupView>()) {}
+
+    GroupState(const GroupState&) = delete;
+    GroupState(GroupState&&) = delete;
+    GroupState& operator=(const GroupState&) = delete;
+    GroupState& operator=(GroupState&&) = delete;
+
+    ~GroupState() {
+        spdlog::trace("[group] Releasing shared group state");
+        if(m_initialized) {
+            ssg_group_remove_membership_update_callback(
+                m_gid, &GroupState::membershipUpdate,
+                static_cast<void*>(this));
+        }
+        std::lock_guard<tl::mutex> lock(m_mona_mtx);
+        for(auto& p : m_mona_addresses) {
+            mona_addr_free(m_mona, p.second);
+        }
+        m_mona_addresses.clear();
+    }
+
+    /**
+     * @brief Get the GroupState associated with the provided SSG group
+     * in this process, creating and initializing it if necessary.
+     * Only the first provider to acquire the group will join it
+     * (if must_join is true) and resolve the MoNA addresses.
+     */
+    static std::shared_ptr<GroupState> Acquire(
+            const tl::engine& engine, ssg_group_id_t gid, bool must_join,
+            mona_instance_t mona, uint16_t provider_id, const tl::pool& pool) {
+        std::shared_ptr<GroupState> state;
+        {
+            std::lock_guard<std::mutex> lock(RegistryMutex());
+            auto& registry = Registry();
+            auto it = registry.find(gid);
+            if(it != registry.end())
+                state = it->second.lock();
+            if(!state) {
+                state = std::make_shared<GroupState>(engine, gid, mona, provider_id, pool);
+                registry[gid] = state;
+            }
+        }
+        if(state->m_mona != mona) {
+            throw Exception(ErrorCode::MONA_ERROR,
+                "Providers sharing an SSG group must share the same MoNA instance");
+        }
+        state->_initialize(must_join);
+        return state;
+    }
+
+    /**
+     * @brief Hash of the current view. It is published along with the
+     * view, so a request carrying this hash addresses the members of
+     * the view, with the ranks of the view.
+     */
+    uint64_t groupHash() {
+        return getView()->hash;
+    }
+
+    /**
+     * @brief SSG member id of this process.
+     */
+    ssg_member_id_t selfId() {
+        std::lock_guard<tl::mutex> lock(m_mona_mtx);
+        return m_self_id;
+    }
+
+    void addListener(const void* key, Listener listener) {
+        std::lock_guard<tl::mutex> lock(m_listeners_mtx);
+        m_listeners[key] = std::move(listener);
+    }
+
+    void removeListener(const void* key) {
+        std::lock_guard<tl::mutex> lock(m_listeners_mtx);
+        m_listeners.erase(key);
+    }
+
+    /**
+     * @brief Returns the current view of the group. Views are immutable,
+     * so the lock is only held to copy the shared pointer.
+     */
+    std::shared_ptr<const GroupView> getView() {
+        std::lock_guard<tl::mutex> lock(m_mona_mtx);
+        return m_view;
+    }
+
+    /**
+     * @brief Builds the version of the view following old_view, made of
+     * the members of the SSG group (member_ids, in SSG rank order) whose
+     * MoNA address is in addresses. Since the view is rebuilt from the
+     * state of the group rather than from the event being processed,
+     * servers agree on the ranks of a view with a given hash whatever
+     * the order in which they processed the events.
+     *
+     * @return the new view, or nullptr if the members did not change.
+     */
+    static std::shared_ptr<GroupView> NextView(
+            const GroupView& old_view,
+            const std::vector<ssg_member_id_t>& member_ids,
+            const std::map<ssg_member_id_t, na_addr_t>& addresses) {
+        auto view = std::make_shared<GroupView>();
+        for(auto member_id : member_ids) {
+            auto it = addresses.find(member_id);
+            if(it == addresses.end()) {
+                spdlog::trace("[group] Member {} not in view until its address is resolved",
+                              member_id);
+                continue;
+            }
+            view->member_ids.push_back(member_id);
+            view->addresses.push_back(it->second);
+            view->hash = UpdateGroupHash(view->hash, member_id);
+            if(old_view.rankOf(member_id) == -1)
+                view->joined.push_back(member_id);
+        }
+        view->rank_map.resize(old_view.size(), -1);
+        for(size_t i = 0; i < old_view.size(); i++) {
+            auto member_id = old_view.member_ids[i];
+            view->rank_map[i] = view->rankOf(member_id);
+            if(view->rank_map[i] == -1)
+                view->left.push_back(member_id);
+        }
+        if(view->joined.empty() && view->left.empty() && old_view.version != 0)
+            return nullptr;
+        view->version = old_view.version + 1;
+        return view;
+    }
+
+    /**
+     * @brief Handles a colza_get_mona_addr request: records the caller's
+     * address (if provided) and returns all the addresses known by this
+     * process, starting with its own.
+     */
+    KnownAddresses exchangeMonaAddresses(ssg_member_id_t caller_id,
+                                         const std::string& caller_addr) {
+        std::unique_lock<tl::mutex> guard(m_mona_mtx);
+        while(m_mona_self_addr.empty()) {
+            m_mona_cv.wait(guard);
+        }
+        if(caller_id != SSG_MEMBER_ID_INVALID && !caller_addr.empty())
+            m_known_addresses.emplace(caller_id, caller_addr);
+        KnownAddresses result;
+        result.reserve(m_known_addresses.size());
+        result.emplace_back(m_self_id, m_mona_self_addr);
+        for(const auto& p : m_known_addresses) {
+            if(p.first != m_self_id)
+                result.push_back(p);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Leaves the SSG group. Only the first call actually leaves.
+     *
+     * If migrate is false, waits for all the providers of the group to
+     * be inactive, then leaves. If migrate is true, the providers first
+     * hand their blocks over to the remaining members of the group and
+     * start forwarding incoming data to them, then the process leaves
+     * the group and waits for on-going iterations to complete, taking
+     * part in their execution with no block.
+     *
+     * @param migrate Whether to migrate the data held by the providers.
+     */
+    void leave(bool migrate = false) {
+        std::vector<Listener> listeners;
+        {
+            std::lock_guard<tl::mutex> lock(m_listeners_mtx);
+            for(auto& p : m_listeners)
+                listeners.push_back(p.second);
+        }
+        if(migrate) {
+            auto addresses = _remainingMemberAddresses();
+            spdlog::trace("[group] Migrating data to {} remaining members", addresses.size());
+            for(auto& listener : listeners) {
+                if(listener.migrate) listener.migrate(addresses);
+            }
+            _leaveOnce();
+        }
+        for(auto& listener : listeners) {
+            if(listener.waitUntilInactive) listener.waitUntilInactive();
+        }
+        spdlog::trace("[group] All the providers are inactive, process can leave");
+        _leaveOnce();
+    }
+
+    private:
+
+    void _leaveOnce() {
+        std::lock_guard<tl::mutex> lock(m_init_mtx);
+        if(m_left) return;
+        ssg_group_leave(m_gid);
+        m_left = true;
+    }
+
+    /**
+     * @brief Returns the addresses of the members of the group other
+     * than this process, in rank order, i.e. the order in which clients
+     * will see them once this process has left.
+     */
+    std::vector<std::string> _remainingMemberAddresses() {
+        std::vector<std::string> addresses;
+        ssg_member_id_t self_id = SSG_MEMBER_ID_INVALID;
+        ssg_get_self_id(m_engine.get_margo_instance(), &self_id);
+        int group_size = 0;
+        ssg_get_group_size(m_gid, &group_size);
+        for(int i = 0; i < group_size; i++) {
+            ssg_member_id_t member_id = SSG_MEMBER_ID_INVALID;
+            ssg_get_group_member_id_from_rank(m_gid, i, &member_id);
+            if(member_id == self_id) continue;
+            hg_addr_t a = HG_ADDR_NULL;
+            ssg_get_group_member_addr(m_gid, member_id, &a);
+            addresses.push_back(static_cast<std::string>(tl::endpoint(m_engine, a, false)));
+        }
+        return addresses;
+    }
+
+    static std::map<ssg_group_id_t, std::weak_ptr<GroupState>>& Registry() {
+        static std::map<ssg_group_id_t, std::weak_ptr<GroupState>> registry;
+        return registry;
+    }
+
+    static std::mutex& RegistryMutex() {
+        static std::mutex mtx;
+        return mtx;
+    }
+
+    void _initialize(bool must_join) {
+        std::lock_guard<tl::mutex> lock(m_init_mtx);
+        if(m_initialized) return;
+        int ret;
+        if(must_join) {
+            ret = ssg_group_join(m_engine.get_margo_instance(),
+                    m_gid, &GroupState::membershipUpdate,
+                    static_cast<void*>(this));
+            if(ret != SSG_SUCCESS) {
+                throw Exception(ErrorCode::SSG_ERROR,
+                    "Could not join SSG group (ssg_group_join returned "s +
+                    std::to_string(ret) + ")");
+            }
+        } else {
+            ssg_group_add_membership_update_callback(
+                    m_gid, &GroupState::membershipUpdate,
+                    static_cast<void*>(this));
+        }
+        m_initialized = true;
+        {
+            std::lock_guard<tl::mutex> lock(m_mona_mtx);
+            na_addr_t my_mona_addr;
+            na_return_t ret = mona_addr_self(m_mona, &my_mona_addr);
+            if(ret != NA_SUCCESS)
+                throw Exception(ErrorCode::MONA_ERROR,
+                    "Could not get address from MoNA");
+            char buf[256];
+            na_size_t buf_size = 256;
+            ret = mona_addr_to_string(m_mona, buf, &buf_size, my_mona_addr);
+            mona_addr_free(m_mona, my_mona_addr);
+            if(ret != NA_SUCCESS) {
+                throw Exception(ErrorCode::MONA_ERROR,
+                    "Could not serialize MoNA address");
+            }
+            m_mona_self_addr = buf;
+            spdlog::trace("[group] MoNA address: {}", m_mona_self_addr);
+            int sret = ssg_get_self_id(m_engine.get_margo_instance(), &m_self_id);
+            if(sret != SSG_SUCCESS) {
+                throw Exception(ErrorCode::SSG_ERROR,
+                    "ssg_get_self_id failed with error code "s + std::to_string(sret));
+            }
+            m_known_addresses[m_self_id] = m_mona_self_addr;
+        }
+        m_mona_cv.notify_all();
+        _resolveMonaAddresses();
+    }
+
+    /**
+     * @brief Records MoNA addresses learned from other members.
+     */
+    void _learnAddresses(const KnownAddresses& addresses) {
+        std::lock_guard<tl::mutex> lock(m_mona_mtx);
+        for(const auto& p : addresses) {
+            if(!p.second.empty())
+                m_known_addresses.emplace(p.first, p.second);
+        }
+    }
+
+    bool _isKnown(ssg_member_id_t member_id) {
+        std::lock_guard<tl::mutex> lock(m_mona_mtx);
+        return m_known_addresses.count(member_id) != 0;
+    }
+
+    bool _isMember(ssg_member_id_t member_id) const {
+        int rank = -1;
+        int ret = ssg_get_group_member_rank(m_gid, member_id, &rank);
+        return ret == SSG_SUCCESS && rank >= 0;
+    }
+
+    /**
+     * @brief Sends our own MoNA address to the given member and learns
+     * all the addresses it knows in return. Failures are retried with
+     * exponential backoff as long as the member is part of the group.
+     *
+     * @return false if the member left before answering.
+     */
+    bool _exchangeAddressesWith(ssg_member_id_t member_id) {
+        hg_addr_t hg_addr = HG_ADDR_NULL;
+        int ret = ssg_get_group_member_addr(m_gid, member_id, &hg_addr);
+        if(ret != SSG_SUCCESS)
+            return false;
+        tl::provider_handle ph;
+        try {
+            ph = tl::provider_handle(m_engine, hg_addr, m_provider_id, false);
+        } catch(const std::exception& e) {
+            spdlog::critical("Could not create provider handle from address to member {}: {}",
+                             member_id, e.what());
+            throw;
+        }
+        double backoff_ms = INITIAL_BACKOFF_MS;
+        while(true) {
+            try {
+                RequestResult<KnownAddresses> result =
+                    m_get_mona_addr.on(ph)(m_self_id, m_mona_self_addr);
+                if(result.success()) {
+                    _learnAddresses(result.value());
+                    return true;
+                }
+            } catch(const std::exception& ex) {
+                spdlog::trace("[group] Failed to get MoNA addresses from member {}: {}",
+                              member_id, ex.what());
+            }
+            if(!_isMember(member_id))
+                return false;
+            spdlog::trace("[group] Retrying in {} ms", backoff_ms);
+            tl::thread::sleep(m_engine, backoff_ms);
+            backoff_ms = (2*backoff_ms < MAX_BACKOFF_MS) ? 2*backoff_ms : MAX_BACKOFF_MS;
+        }
+    }
+
+    /**
+     * @brief Resolves the MoNA address of a member, contacting it only
+     * if its address has not already been learned from another member.
+     *
+     * @return NA_ADDR_NULL if the member left before its address was known.
+     */
+    na_addr_t _resolveMember(ssg_member_id_t member_id) {
+        if(!_isKnown(member_id) && !_exchangeAddressesWith(member_id))
+            return NA_ADDR_NULL;
+        std::string addr_str;
+        {
+            std::lock_guard<tl::mutex> lock(m_mona_mtx);
+            addr_str = m_known_addresses[member_id];
+        }
+        na_addr_t addr = NA_ADDR_NULL;
+        na_return_t ret = mona_addr_lookup(m_mona, addr_str.c_str(), &addr);
+        if(ret != NA_SUCCESS)
+            throw Exception(ErrorCode::MONA_ERROR,
+                "mona_addr_lookup failed with error code "s + std::to_string(ret));
+        spdlog::trace("[group] Successfully obtained MoNA address of member {}", member_id);
+        return addr;
+    }
+
+    /**
+     * @brief Returns the member ids of the SSG group, in rank order.
+     */
+    std::vector<ssg_member_id_t> _ssgMemberIds() const {
+        int group_size = 0;
+        int ret = ssg_get_group_size(m_gid, &group_size);
+        if(ret != SSG_SUCCESS) {
+            throw Exception(ErrorCode::SSG_ERROR,
+                "ssg_get_group_size failed with error code "s +std::to_string(ret));
+        }
+        std::vector<ssg_member_id_t> member_ids(group_size);
+        if(group_size == 0) return member_ids;
+        ret = ssg_get_group_member_ids_from_range(m_gid, 0, group_size-1, member_ids.data());
+        if(ret != SSG_SUCCESS) {
+            throw Exception(ErrorCode::SSG_ERROR,
+                "ssg_get_group_member_ids_from_range failed with error code "s +std::to_string(ret));
+        }
+        return member_ids;
+    }
+
+    /**
+     * @brief Resolves the MoNA addresses of all the members of the group.
+     * A fixed number of ULTs are started on the pool to query members
+     * concurrently. Each response carries all the addresses the peer
+     * knows, and members whose address has been learned this way are
+     * not contacted. Throws if the address of a member that is still
+     * part of the group could not be resolved.
+     */
+    void _resolveMonaAddresses() {
+        spdlog::trace("[group] Resolving MoNA addressed of SSG group");
+        int self_rank = -1;
+        int ret = ssg_get_group_member_rank(m_gid, m_self_id, &self_rank);
+        if(ret != SSG_SUCCESS) {
+            throw Exception(ErrorCode::SSG_ERROR,
+                "ssg_get_group_member_rank failed with error code "s +std::to_string(ret));
+        }
+        auto member_ids = _ssgMemberIds();
+        int group_size = (int)member_ids.size();
+        // members are queried starting from our own rank so that
+        // the processes of the group don't all query the same members
+        std::vector<ssg_member_id_t> to_query;
+        for(int i = 1; i < group_size; i++)
+            to_query.push_back(member_ids[(self_rank + i) % group_size]);
+        size_t next = 0;
+        tl::mutex queue_mtx;
+        size_t num_workers = (to_query.size() < MAX_CONCURRENT_LOOKUPS)
+                           ? to_query.size() : MAX_CONCURRENT_LOOKUPS;
+        std::vector<tl::managed<tl::thread>> workers;
+        for(size_t i = 0; i < num_workers; i++) {
+            workers.push_back(m_pool.make_thread([this, &to_query, &next, &queue_mtx]() {
+                while(true) {
+                    ssg_member_id_t member_id;
+                    {
+                        std::lock_guard<tl::mutex> lock(queue_mtx);
+                        if(next == to_query.size()) return;
+                        member_id = to_query[next++];
+                    }
+                    if(_isKnown(member_id)) continue;
+                    try {
+                        if(!_exchangeAddressesWith(member_id))
+                            spdlog::trace("[group] Member {} left before its address was resolved",
+                                          member_id);
+                    } catch(const std::exception& ex) {
+                        spdlog::error("[group] Could not resolve address of member {}: {}",
+                                      member_id, ex.what());
+                    }
+                }
+            }));
+        }
+        for(auto& worker : workers)
+            worker->join();
+
+        decltype(m_mona_addresses) tmp_addresses;
+        for(auto member_id : member_ids) {
+            {
+                std::lock_guard<tl::mutex> lock(m_mona_mtx);
+                if(m_mona_addresses.count(member_id) != 0)
+                    continue;
+            }
+            if(member_id == m_self_id) {
+                na_addr_t self_mona_addr;
+                mona_addr_self(m_mona, &self_mona_addr);
+                tmp_addresses[member_id] = self_mona_addr;
+            } else if(_isKnown(member_id)) {
+                tmp_addresses[member_id] = _resolveMember(member_id);
+            } else if(_isMember(member_id)) {
+                for(auto& p : tmp_addresses)
+                    mona_addr_free(m_mona, p.second);
+                throw Exception(ErrorCode::MONA_ERROR,
+                    "Could not resolve the MoNA address of member "s
+                    + std::to_string(member_id));
+            }
+        }
+        {
+            std::lock_guard<tl::mutex> view_lock(m_view_mtx);
+            std::lock_guard<tl::mutex> lock(m_mona_mtx);
+            for(auto& p : tmp_addresses) {
+                if(!m_mona_addresses.insert(p).second)
+                    mona_addr_free(m_mona, p.second);
+            }
+            _publishView();
+        }
+        m_mona_cv.notify_all();
+        spdlog::trace("[group] Done resolving MoNA addressed of SSG group");
+        spdlog::trace("[group] {} addresses found in SSG group", tmp_addresses.size());
+    }
+
+    /**
+     * @brief Publishes the next version of the view (see NextView) from
+     * the members of the SSG group. Must be called with m_mona_mtx held,
+     * after m_mona_addresses has been updated.
+     *
+     * @return false if the members did not change, in which case no
+     * new version is published.
+     */
+    bool _publishView() {
+        auto view = NextView(*m_view, _ssgMemberIds(), m_mona_addresses);
+        if(!view) return false;
+        spdlog::trace("[group] Published view {} with {} members, hash {}",
+                      view->version, view->size(), view->hash);
+        m_view = std::move(view);
+        return true;
+    }
+
+    void _membershipUpdate(ssg_member_id_t member_id,
+                           ssg_member_update_type_t update_type) {
+        spdlog::trace("[group] Member {} updated", member_id);
+        m_pool.make_thread([this, member_id, update_type]() {
+
+        na_addr_t na_addr = NA_ADDR_NULL;
+        if(update_type == SSG_MEMBER_JOINED) {
+            spdlog::trace("[group] Member {} joined", member_id);
+            try {
+                na_addr = _resolveMember(member_id);
+            } catch(const std::exception& ex) {
+                // the view, and its hash, will not match the group as long
+                // as this member is part of it, so iterations cannot start
+                spdlog::critical("[group] Could not resolve the MoNA address of member {} ({}), "
+                                 "iterations will be refused until it leaves", member_id, ex.what());
+                return;
+            }
+            if(na_addr == NA_ADDR_NULL) {
+                spdlog::trace("[group] Member {} left before its address was resolved", member_id);
+                return;
+            }
+        } else if(update_type == SSG_MEMBER_DIED) {
+            spdlog::warn("[group] Member {} died", member_id);
+        } else {
+            spdlog::trace("[group] Member {} left", member_id);
+        }
+        std::lock_guard<tl::mutex> view_lock(m_view_mtx);
+        bool changed = false;
+        {
+            std::lock_guard<tl::mutex> lock(m_mona_mtx);
+            if(update_type == SSG_MEMBER_JOINED) {
+                // the member may have left while its address was resolved
+                if(!_isMember(member_id) || !m_mona_addresses.emplace(member_id, na_addr).second)
+                    mona_addr_free(m_mona, na_addr);
+            } else {
+                m_mona_addresses.erase(member_id);
+                m_known_addresses.erase(member_id);
+            }
+            changed = _publishView();
+        }
+        m_mona_cv.notify_all();
+        bool died = update_type == SSG_MEMBER_DIED;
+        if(!changed && !died) return;
+        auto view = getView();
+        std::vector<Listener> listeners;
+        {
+            std::lock_guard<tl::mutex> lock(m_listeners_mtx);
+            for(auto& p : m_listeners)
+                listeners.push_back(p.second);
+        }
+        for(auto& listener : listeners) {
+            if(died && listener.onMemberDied)
+                listener.onMemberDied(member_id);
+            if(changed && listener.onViewUpdated)
+                listener.onViewUpdated(m_mona, *view);
+        }
+
+        }, tl::anonymous());
+    }
+
+    static void membershipUpdate(void* p, ssg_member_id_t member_id,
+            ssg_member_update_type_t update_type) {
+        auto group = static_cast<GroupState*>(p);
+        group->_membershipUpdate(member_id, update_type);
+    }
+};
+
+}
+
+#endif
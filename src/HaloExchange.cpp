@@ -0,0 +1,236 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/HaloExchange.hpp"
+#include "colza/Exception.hpp"
+
+#include "TypeSizes.hpp"
+
+#include <cstring>
+
+namespace colza {
+
+class HaloExchangeImpl {
+
+    public:
+
+    // region of a local block to send to, or receive from, a neighbor
+    struct Transfer {
+        size_t local;
+        Box    region;
+    };
+
+    // ghost region of a local block filled from another local block
+    struct LocalCopy {
+        size_t src;
+        size_t dst;
+        Box    region;
+    };
+
+    Communicator           m_comm;
+    size_t                 m_width = 0;
+    size_t                 m_element_size = 0;
+    std::vector<Box>       m_ghosted;
+    std::vector<int>       m_neighbors;
+    std::vector<std::vector<Transfer>> m_sends; // per neighbor
+    std::vector<std::vector<Transfer>> m_recvs; // per neighbor
+    std::vector<size_t>    m_sendcounts, m_sdispls;
+    std::vector<size_t>    m_recvcounts, m_rdispls;
+    std::vector<LocalCopy> m_local_copies;
+    // buffers reused across exchanges
+    mutable std::vector<char> m_sendbuf;
+    mutable std::vector<char> m_recvbuf;
+};
+
+namespace {
+
+// gathers the boxes of all the members, indexed by rank
+std::vector<std::vector<Box>> GatherBoxes(const Communicator& comm,
+                                          const std::vector<Box>& boxes) {
+    const int n = comm.size();
+    uint64_t ndims = boxes.empty() ? 0 : boxes[0].ndims();
+    for(const auto& box : boxes)
+        if(box.ndims() != ndims)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "HaloExchange requires boxes with the same number of dimensions");
+    uint64_t info[2] = { boxes.size(), ndims };
+    std::vector<uint64_t> infos(2*n);
+    comm.allgather(info, sizeof(info), infos.data());
+
+    // serialize the local boxes and send the same buffer to everyone
+    std::vector<int64_t> local;
+    local.reserve(2*ndims*boxes.size());
+    for(const auto& box : boxes) {
+        local.insert(local.end(), box.lower.begin(), box.lower.end());
+        local.insert(local.end(), box.upper.begin(), box.upper.end());
+    }
+    std::vector<size_t> sendcounts(n, local.size()*sizeof(int64_t));
+    std::vector<size_t> sdispls(n, 0);
+    std::vector<size_t> recvcounts(n), rdispls(n);
+    size_t total = 0;
+    for(int i = 0; i < n; i++) {
+        if(infos[2*i] != 0 && ndims != 0 && infos[2*i+1] != ndims)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "HaloExchange requires boxes with the same number of dimensions");
+        recvcounts[i] = infos[2*i]*2*infos[2*i+1]*sizeof(int64_t);
+        rdispls[i] = total;
+        total += recvcounts[i];
+    }
+    std::vector<int64_t> all(total/sizeof(int64_t));
+    comm.alltoallv(local.data(), sendcounts, sdispls,
+                   all.data(), recvcounts, rdispls);
+
+    std::vector<std::vector<Box>> result(n);
+    for(int i = 0; i < n; i++) {
+        const int64_t* p = all.data() + rdispls[i]/sizeof(int64_t);
+        size_t d = infos[2*i+1];
+        for(uint64_t b = 0; b < infos[2*i]; b++) {
+            result[i].emplace_back(std::vector<int64_t>(p, p + d),
+                                   std::vector<int64_t>(p + d, p + 2*d));
+            p += 2*d;
+        }
+    }
+    return result;
+}
+
+}
+
+HaloExchange::HaloExchange() = default;
+
+HaloExchange::HaloExchange(const Communicator& comm,
+                           const std::vector<Box>& boxes,
+                           size_t width,
+                           Type type)
+: self(std::make_shared<HaloExchangeImpl>()) {
+    self->m_comm = comm;
+    self->m_width = width;
+    self->m_element_size = ComputeDataSize({1}, type);
+    for(const auto& box : boxes)
+        self->m_ghosted.push_back(box.grow((int64_t)width));
+
+    auto all = GatherBoxes(comm, boxes);
+    const int n = comm.size(), r = comm.rank();
+    const size_t esize = self->m_element_size;
+    const auto& mine = boxes;
+
+    // ghost cells of a block come from blocks intersecting its grown box;
+    // both sides enumerate pairs as (sender block, receiver block)
+    for(int q = 0; q < n; q++) {
+        if(q == r) continue;
+        const auto& theirs = all[q];
+        std::vector<HaloExchangeImpl::Transfer> sends, recvs;
+        size_t send_bytes = 0, recv_bytes = 0;
+        for(size_t i = 0; i < mine.size(); i++) {
+            for(size_t j = 0; j < theirs.size(); j++) {
+                Box region = mine[i].intersect(theirs[j].grow((int64_t)width));
+                if(region.empty()) continue;
+                send_bytes += region.volume()*esize;
+                sends.push_back({ i, std::move(region) });
+            }
+        }
+        for(size_t j = 0; j < theirs.size(); j++) {
+            for(size_t i = 0; i < mine.size(); i++) {
+                Box region = theirs[j].intersect(self->m_ghosted[i]);
+                if(region.empty()) continue;
+                recv_bytes += region.volume()*esize;
+                recvs.push_back({ i, std::move(region) });
+            }
+        }
+        if(sends.empty() && recvs.empty()) continue;
+        self->m_neighbors.push_back(q);
+        self->m_sends.push_back(std::move(sends));
+        self->m_recvs.push_back(std::move(recvs));
+        self->m_sendcounts.push_back(send_bytes);
+        self->m_recvcounts.push_back(recv_bytes);
+    }
+    size_t send_total = 0, recv_total = 0;
+    for(size_t k = 0; k < self->m_neighbors.size(); k++) {
+        self->m_sdispls.push_back(send_total);
+        self->m_rdispls.push_back(recv_total);
+        send_total += self->m_sendcounts[k];
+        recv_total += self->m_recvcounts[k];
+    }
+    self->m_sendbuf.resize(send_total);
+    self->m_recvbuf.resize(recv_total);
+
+    for(size_t i = 0; i < mine.size(); i++) {
+        for(size_t j = 0; j < mine.size(); j++) {
+            if(i == j) continue;
+            Box region = mine[j].intersect(self->m_ghosted[i]);
+            if(region.empty()) continue;
+            self->m_local_copies.push_back({ j, i, std::move(region) });
+        }
+    }
+}
+
+HaloExchange::HaloExchange(const HaloExchange&) = default;
+
+HaloExchange::HaloExchange(HaloExchange&&) = default;
+
+HaloExchange& HaloExchange::operator=(const HaloExchange&) = default;
+
+HaloExchange& HaloExchange::operator=(HaloExchange&&) = default;
+
+HaloExchange::~HaloExchange() = default;
+
+HaloExchange::operator bool() const {
+    return static_cast<bool>(self);
+}
+
+#define CHECK_HALO_EXCHANGE_VALID() \
+    do {\
+        if(not self)\
+            throw Exception(ErrorCode::INVALID_INSTANCE,\
+                "Invalid colza::HaloExchange object");\
+    } while(0)
+
+size_t HaloExchange::width() const {
+    CHECK_HALO_EXCHANGE_VALID();
+    return self->m_width;
+}
+
+Box HaloExchange::ghostedBox(size_t i) const {
+    CHECK_HALO_EXCHANGE_VALID();
+    return self->m_ghosted.at(i);
+}
+
+std::vector<int> HaloExchange::neighbors() const {
+    CHECK_HALO_EXCHANGE_VALID();
+    return self->m_neighbors;
+}
+
+void HaloExchange::exchange(const std::vector<void*>& data) const {
+    CHECK_HALO_EXCHANGE_VALID();
+    if(data.size() != self->m_ghosted.size())
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "HaloExchange::exchange expects one buffer per local block");
+    const size_t esize = self->m_element_size;
+    const auto& ghosted = self->m_ghosted;
+
+    for(size_t k = 0; k < self->m_neighbors.size(); k++) {
+        char* out = self->m_sendbuf.data() + self->m_sdispls[k];
+        for(const auto& t : self->m_sends[k]) {
+            CopyRegion(data[t.local], ghosted[t.local], out, t.region, t.region, esize);
+            out += t.region.volume()*esize;
+        }
+    }
+    // local copies overlap with the communication
+    auto request = self->m_comm.ineighborExchange(self->m_neighbors,
+        self->m_sendbuf.data(), self->m_sendcounts, self->m_sdispls,
+        self->m_recvbuf.data(), self->m_recvcounts, self->m_rdispls);
+    for(const auto& c : self->m_local_copies) {
+        CopyRegion(data[c.src], ghosted[c.src], data[c.dst], ghosted[c.dst], c.region, esize);
+    }
+    request.wait();
+    for(size_t k = 0; k < self->m_neighbors.size(); k++) {
+        const char* in = self->m_recvbuf.data() + self->m_rdispls[k];
+        for(const auto& t : self->m_recvs[k]) {
+            CopyRegion(in, t.region, data[t.local], ghosted[t.local], t.region, esize);
+            in += t.region.volume()*esize;
+        }
+    }
+}
+
+}
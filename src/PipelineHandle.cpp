@@ -9,6 +9,7 @@
 
 #include "AsyncRequestImpl.hpp"
 #include "ClientImpl.hpp"
+#include "FetchTypes.hpp"
 #include "PipelineHandleImpl.hpp"
 #include "TypeSizes.hpp"
 
@@ -16,8 +17,62 @@
 #include <thallium/serialization/stl/string.hpp>
 #include <thallium/serialization/stl/pair.hpp>
 
+#include <algorithm>
+
 namespace colza {
 
+namespace {
+
+/**
+ * Builds the keys of a colza_fetch RPC, exposing the buffers of all
+ * the requests as a single bulk handle.
+ */
+std::vector<FetchKey> MakeFetchKeys(tl::engine& engine,
+                                    const std::vector<FetchRequest>& requests,
+                                    tl::bulk& bulk) {
+    std::vector<FetchKey> keys(requests.size());
+    std::vector<std::pair<void*, size_t>> segments;
+    size_t offset = 0;
+    for(size_t i = 0; i < requests.size(); i++) {
+        auto& r = requests[i];
+        keys[i].dataset_name = r.dataset_name;
+        keys[i].iteration    = r.iteration;
+        keys[i].block_id     = r.block_id;
+        keys[i].offset       = offset;
+        keys[i].capacity     = r.buffer ? r.size : 0;
+        if(keys[i].capacity) {
+            segments.emplace_back(r.buffer, r.size);
+            offset += r.size;
+        }
+    }
+    if(!segments.empty())
+        bulk = engine.expose(segments, tl::bulk_mode::write_only);
+    return keys;
+}
+
+void ApplyFetched(const std::vector<FetchedBlock>& fetched,
+                  std::vector<FetchRequest>& requests) {
+    if(fetched.size() != requests.size())
+        throw Exception(ErrorCode::OTHER_ERROR, "Invalid response to fetch request");
+    for(size_t i = 0; i < requests.size(); i++) {
+        auto& r    = requests[i];
+        r.info     = fetched[i].info;
+        r.result   = fetched[i].result.success() ? 0 : fetched[i].result.value();
+        r.error    = fetched[i].result.error();
+    }
+}
+
+void CheckFetched(const std::vector<FetchedBlock>& fetched, BlockInfo* info) {
+    if(fetched.size() != 1)
+        throw Exception(ErrorCode::OTHER_ERROR, "Invalid response to fetch request");
+    if(info) *info = fetched[0].info;
+    auto& result = fetched[0].result;
+    if(!result.success())
+        throw Exception((ErrorCode)result.value(), result.error());
+}
+
+}
+
 PipelineHandle::PipelineHandle() = default;
 
 PipelineHandle::PipelineHandle(const std::shared_ptr<PipelineHandleImpl>& impl)
@@ -49,7 +104,27 @@ void PipelineHandle::start(uint64_t iteration) const {
     auto& ph            = self->m_ph;
     auto& pipeline_name = self->m_name;
     const uint64_t group_hash = 0;
-    RequestResult<int32_t> response = start.on(ph)(group_hash, pipeline_name, iteration);
+    RequestResult<int32_t> response = start.on(ph)(
+            group_hash, pipeline_name, iteration, false, (uint64_t)0, false,
+            std::vector<uint16_t>(), false);
+    if(!response.success()) {
+        throw Exception((ErrorCode)response.value(), response.error());
+    }
+}
+
+void PipelineHandle::start(uint64_t iteration,
+           uint64_t expected_blocks,
+           bool autoCleanup) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    auto& start         = self->m_client->m_start;
+    auto& ph            = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    const uint64_t group_hash = 0;
+    RequestResult<int32_t> response = start.on(ph)(
+            group_hash, pipeline_name, iteration, true, expected_blocks, autoCleanup,
+            std::vector<uint16_t>(), false);
     if(!response.success()) {
         throw Exception((ErrorCode)response.value(), response.error());
     }
@@ -182,6 +257,396 @@ void PipelineHandle::stage(const std::string& dataset_name,
     }
 }
 
+void PipelineHandle::stageShared(const std::vector<std::string>& other_pipelines,
+           const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const std::vector<size_t>& dimensions,
+           const std::vector<int64_t>& offsets,
+           const Type& type,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+             "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_stage_shared;
+    auto& ph  = self->m_ph;
+    std::vector<std::string> pipeline_names;
+    pipeline_names.reserve(other_pipelines.size() + 1);
+    pipeline_names.push_back(self->m_name);
+    pipeline_names.insert(pipeline_names.end(), other_pipelines.begin(), other_pipelines.end());
+    auto sender_addr = origin_addr == "" ?
+        static_cast<std::string>(self->m_client->m_engine.self()) :
+        origin_addr;
+    if(req == nullptr) { // synchronous call
+        RequestResult<int32_t> response = rpc.on(ph)(
+                pipeline_names,
+                sender_addr,
+                dataset_name,
+                iteration,
+                block_id,
+                dimensions,
+                offsets,
+                type,
+                data);
+        if(response.success()) {
+            if(result) *result = response.value();
+        } else {
+            throw Exception((ErrorCode)response.value(), response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(
+                pipeline_names,
+                sender_addr,
+                dataset_name,
+                iteration,
+                block_id,
+                dimensions,
+                offsets,
+                type,
+                data);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [result](AsyncRequestImpl& async_request_impl) {
+                RequestResult<int32_t> response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    if(response.success()) {
+                        if(result) *result = response.value();
+                    } else {
+                        throw Exception((ErrorCode)response.value(), response.error());
+                    }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::stageShared(const std::vector<std::string>& other_pipelines,
+           const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const std::vector<size_t>& dimensions,
+           const std::vector<int64_t>& offsets,
+           const Type& type,
+           const void* data,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    std::vector<std::pair<void*, size_t>> segment(1);
+    segment[0].first = const_cast<void*>(data);
+    segment[0].second = ComputeDataSize(dimensions, type);
+    auto bulk = self->m_client->m_engine.expose(segment, tl::bulk_mode::read_only);
+    if(req == nullptr) { // synchronous call
+        stageShared(other_pipelines, dataset_name, iteration, block_id,
+                    dimensions, offsets, type, bulk, "", result);
+    } else { // asynchronous call
+        AsyncRequest stage_request;
+        stageShared(other_pipelines, dataset_name, iteration, block_id,
+                    dimensions, offsets, type, bulk, "", result, &stage_request);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::vector<tl::async_response>());
+        async_request_impl->m_wait_callback =
+            [stage_request, bulk=std::move(bulk)](AsyncRequestImpl&) {
+                stage_request.wait();
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::fetch(const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           BlockInfo* info,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+             "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_fetch;
+    auto& ph  = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    auto receiver_addr = origin_addr == "" ?
+        static_cast<std::string>(self->m_client->m_engine.self()) :
+        origin_addr;
+    std::vector<FetchKey> keys(1);
+    keys[0].dataset_name = dataset_name;
+    keys[0].iteration    = iteration;
+    keys[0].block_id     = block_id;
+    keys[0].capacity     = data.size();
+    if(req == nullptr) { // synchronous call
+        std::vector<FetchedBlock> response = rpc.on(ph)(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                data);
+        CheckFetched(response, info);
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                data);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [info](AsyncRequestImpl& async_request_impl) {
+                std::vector<FetchedBlock> response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    CheckFetched(response, info);
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::fetch(const std::string& dataset_name,
+           uint64_t iteration,
+           uint64_t block_id,
+           void* buffer,
+           size_t size,
+           BlockInfo* info,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_fetch;
+    auto& ph  = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    auto receiver_addr = static_cast<std::string>(self->m_client->m_engine.self());
+    std::vector<FetchRequest> requests(1);
+    requests[0].dataset_name = dataset_name;
+    requests[0].iteration    = iteration;
+    requests[0].block_id     = block_id;
+    requests[0].buffer       = buffer;
+    requests[0].size         = size;
+    tl::bulk bulk;
+    auto keys = MakeFetchKeys(self->m_client->m_engine, requests, bulk);
+    if(req == nullptr) { // synchronous call
+        std::vector<FetchedBlock> response = rpc.on(ph)(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                bulk);
+        CheckFetched(response, info);
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                bulk);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [info, bulk=std::move(bulk)](AsyncRequestImpl& async_request_impl) {
+                std::vector<FetchedBlock> response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    CheckFetched(response, info);
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::fetch(std::vector<FetchRequest>& requests,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_fetch;
+    auto& ph  = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    auto receiver_addr = static_cast<std::string>(self->m_client->m_engine.self());
+    tl::bulk bulk;
+    auto keys = MakeFetchKeys(self->m_client->m_engine, requests, bulk);
+    if(req == nullptr) { // synchronous call
+        std::vector<FetchedBlock> response = rpc.on(ph)(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                bulk);
+        ApplyFetched(response, requests);
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(
+                pipeline_name,
+                receiver_addr,
+                keys,
+                bulk);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [&requests, bulk=std::move(bulk)](AsyncRequestImpl& async_request_impl) {
+                std::vector<FetchedBlock> response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    ApplyFetched(response, requests);
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::query(const std::string& dataset_name,
+           uint64_t iteration,
+           const Box& region,
+           const Type& type,
+           const thallium::bulk& data,
+           const std::string& origin_addr,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+             "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_query;
+    auto& ph  = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    auto receiver_addr = origin_addr == "" ?
+        static_cast<std::string>(self->m_client->m_engine.self()) :
+        origin_addr;
+    if(req == nullptr) { // synchronous call
+        QueryResult response = rpc.on(ph)(
+                pipeline_name,
+                receiver_addr,
+                dataset_name,
+                iteration,
+                region.lower,
+                region.upper,
+                type,
+                data,
+                false);
+        if(response.result.success()) {
+            if(result) *result = response.result.value();
+        } else {
+            throw Exception((ErrorCode)response.result.value(), response.result.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(
+                pipeline_name,
+                receiver_addr,
+                dataset_name,
+                iteration,
+                region.lower,
+                region.upper,
+                type,
+                data,
+                false);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [result](AsyncRequestImpl& async_request_impl) {
+                QueryResult response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    if(response.result.success()) {
+                        if(result) *result = response.result.value();
+                    } else {
+                        throw Exception((ErrorCode)response.result.value(),
+                                        response.result.error());
+                    }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
+void PipelineHandle::query(const std::string& dataset_name,
+           uint64_t iteration,
+           const Box& region,
+           const Type& type,
+           void* buffer,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    queryPacked(dataset_name, iteration, region, type, buffer,
+                ComputeDataSize(region.extents(), type), result, req);
+}
+
+void PipelineHandle::queryPacked(const std::string& dataset_name,
+           uint64_t iteration,
+           const Box& region,
+           const Type& type,
+           void* buffer,
+           size_t capacity,
+           int32_t* result,
+           AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    if(region.lower.size() != region.upper.size() || region.empty())
+        throw Exception(ErrorCode::OTHER_ERROR, "Invalid region");
+    auto impl = self;
+    auto receiver_addr = static_cast<std::string>(impl->m_client->m_engine.self());
+    const size_t element_size = ComputeDataSize({}, type);
+    const size_t region_size = region.volume()*element_size;
+    // the server pushes its parts of the region straight into the buffer
+    // when they form a single contiguous run of it, and otherwise into
+    // this temporary buffer, one after the other, sending back their
+    // boxes to scatter them
+    auto packed = std::make_shared<std::vector<char>>(std::max(capacity, element_size));
+    auto send = [=]() {
+        std::vector<std::pair<void*, size_t>> segments(2);
+        segments[0].first = buffer;
+        segments[0].second = region_size;
+        segments[1].first = packed->data();
+        segments[1].second = packed->size();
+        auto bulk = impl->m_client->m_engine.expose(segments, tl::bulk_mode::write_only);
+        return impl->m_client->m_query.on(impl->m_ph).async(
+                impl->m_name,
+                receiver_addr,
+                dataset_name,
+                iteration,
+                region.lower,
+                region.upper,
+                type,
+                bulk,
+                true);
+    };
+    auto finish = [=](QueryResult response) {
+        if(!response.result.success()
+        && response.result.value() == (int)ErrorCode::BUFFER_TOO_SMALL
+        && !response.boxes.empty()) {
+            // the blocks of the server overlap more than expected
+            size_t size = 0;
+            for(auto& box : response.boxes)
+                size += box.volume()*element_size;
+            packed->resize(size);
+            QueryResult retried = send().wait();
+            response = std::move(retried);
+        }
+        if(!response.result.success())
+            throw Exception((ErrorCode)response.result.value(), response.result.error());
+        size_t offset = 0;
+        for(auto& box : response.boxes) {
+            size_t size = box.volume()*element_size;
+            if(box.ndims() != region.ndims() || box.intersect(region) != box
+            || offset + size > packed->size())
+                throw Exception(ErrorCode::OTHER_ERROR, "Invalid response to query request");
+            CopyRegion(packed->data() + offset, box, buffer, region, box, element_size);
+            offset += size;
+        }
+        if(result) *result = response.result.value();
+    };
+    if(req == nullptr) { // synchronous call
+        finish(send().wait());
+    } else { // asynchronous call
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(send());
+        async_request_impl->m_wait_callback =
+            [finish](AsyncRequestImpl& async_request_impl) {
+                QueryResult response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    finish(std::move(response));
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
 void PipelineHandle::execute(uint64_t iteration,
              int32_t* result,
              bool autoCleanup,
@@ -218,6 +683,41 @@ void PipelineHandle::execute(uint64_t iteration,
     }
 }
 
+void PipelineHandle::wait(uint64_t iteration,
+             int32_t* result,
+             AsyncRequest* req) const {
+    if(not self)
+        throw Exception(ErrorCode::INVALID_INSTANCE,
+            "Invalid colza::PipelineHandle object");
+    auto& rpc = self->m_client->m_wait_execution;
+    auto& ph  = self->m_ph;
+    auto& pipeline_name = self->m_name;
+    if(req == nullptr) { // synchronous call
+        RequestResult<int32_t> response = rpc.on(ph)(pipeline_name, iteration);
+        if(response.success()) {
+            if(result) *result = response.value();
+        } else {
+            throw Exception((ErrorCode)response.value(), response.error());
+        }
+    } else { // asynchronous call
+        auto async_response = rpc.on(ph).async(pipeline_name, iteration);
+        auto async_request_impl =
+            std::make_shared<AsyncRequestImpl>(std::move(async_response));
+        async_request_impl->m_wait_callback =
+            [result](AsyncRequestImpl& async_request_impl) {
+                RequestResult<int32_t> response =
+                    async_request_impl.m_async_responses[0].wait();
+                    async_request_impl.m_async_responses.clear();
+                    if(response.success()) {
+                        if(result) *result = response.value();
+                    } else {
+                        throw Exception((ErrorCode)response.value(), response.error());
+                    }
+            };
+        *req = AsyncRequest(std::move(async_request_impl));
+    }
+}
+
 void PipelineHandle::cleanup(uint64_t iteration,
              int32_t* result,
              AsyncRequest* req) const {
@@ -0,0 +1,42 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_PLACEMENT_HPP
+#define __COLZA_PLACEMENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace colza {
+
+/**
+ * @brief Location of a block among the pipelines of a distributed
+ * pipeline: rank of the server, and position of the provider id in
+ * the list of provider ids used on each server.
+ */
+struct BlockPlacement {
+    size_t server;
+    size_t provider;
+};
+
+/**
+ * @brief Index of the pipeline a block with the given hash is sent to,
+ * the (server, provider) pairs being ordered by server rank first, then
+ * by position of the provider id. DistributedPipelineHandle routes
+ * blocks this way, and providers use PlaceBlock to forward and migrate
+ * blocks, so that both agree on where a block lives.
+ */
+inline static size_t PlacementIndex(uint64_t hash, size_t num_servers, size_t num_providers) {
+    return hash % (num_servers * num_providers);
+}
+
+inline static BlockPlacement PlaceBlock(uint64_t hash, size_t num_servers, size_t num_providers) {
+    auto i = PlacementIndex(hash, num_servers, num_providers);
+    return BlockPlacement{ i / num_providers, i % num_providers };
+}
+
+}
+
+#endif
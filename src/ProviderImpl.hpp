@@ -9,7 +9,12 @@
 #include "colza/Backend.hpp"
 #include "colza/Exception.hpp"
 #include "colza/ErrorCodes.hpp"
-#include "SSGUtil.hpp"
+#include "CommunicatorImpl.hpp"
+#include "FetchTypes.hpp"
+#include "GroupState.hpp"
+#include "Placement.hpp"
+#include "SpanningTree.hpp"
+#include "TypeSizes.hpp"
 
 #include <thallium.hpp>
 #include <thallium/serialization/stl/string.hpp>
@@ -22,6 +27,9 @@
 #include <fstream>
 #include <dlfcn.h>
 #include <tuple>
+#include <algorithm>
+#include <functional>
+#include <set>
 
 #define FIND_PIPELINE(__var__) \
         std::shared_ptr<PipelineState> __var__;\
@@ -44,10 +52,85 @@ namespace colza {
 using namespace std::string_literals;
 namespace tl = thallium;
 
+// execution triggered by the arrival of the last block expected
+// by an iteration (see ProviderImpl::start)
+struct ExecutionTrigger {
+    bool                     armed = false;
+    uint64_t                 iteration = 0;
+    uint64_t                 expected_blocks = 0;
+    uint64_t                 staged_blocks = 0;
+    bool                     auto_cleanup = false;
+    bool                     fired = false;
+    bool                     done = false;
+    RequestResult<int32_t>   result;
+};
+
+// progress of the handover of a pipeline's blocks to the remaining
+// servers when its server leaves the group (see ProviderImpl::_handOver)
+enum class HandoverState {
+    NONE,      // blocks are staged and executed locally
+    PENDING,   // remaining servers are asked to hold their execution
+    MIGRATING, // blocks are migrated, incoming blocks are forwarded
+    DONE       // blocks have been migrated, incoming blocks are forwarded
+};
+
+// configuration of a pipeline before the last update it received from
+// updateDistributedPipeline, restored if the update fails on other
+// servers (see ProviderImpl::_revertUpdateFromRequest)
+struct ConfigSnapshot {
+    bool           valid = false;
+    // whether the update reconfigured the backend, rather than
+    // being deferred to a later iteration
+    bool           applied = false;
+    nlohmann::json config;
+    bool           has_pending_config = false;
+    nlohmann::json pending_config;
+    uint64_t       pending_from_iteration = 0;
+};
+
 struct PipelineState {
     std::shared_ptr<Backend> pipeline;
+    std::string              type;
+    // configuration the pipeline currently has
+    nlohmann::json           config;
+    // context of the pipeline's Communicators, the same on all the
+    // servers, held as long as the pipeline exists so that another
+    // pipeline of the process cannot take it
+    std::shared_ptr<CommunicatorContext> context;
     bool                     active = false;
     uint64_t                 iteration = 0;
+    // configuration waiting for the next iteration boundary
+    bool                     has_pending_config = false;
+    nlohmann::json           pending_config;
+    uint64_t                 pending_from_iteration = 0;
+    ConfigSnapshot           previous_config;
+    // a reconfigure or start call is running on the pipeline outside of
+    // m_pipelines_mtx, other reconfigure and start calls wait for it
+    bool                     in_transition = false;
+    ExecutionTrigger         trigger;
+    // provider ids over which the client places the blocks on each
+    // server (see PlaceBlock), as sent with the last start request
+    std::vector<uint16_t>    provider_ids;
+    // whether that client places blocks with its own HashFunction, which
+    // the provider cannot reproduce, so that blocks are not migrated
+    bool                     custom_placement = false;
+    // whether execute has been called for the current iteration
+    bool                     executed = false;
+    // views of the group received during an iteration, applied when the
+    // next one starts so that all the servers run an iteration with the
+    // Communicator they started it with
+    std::vector<GroupView>   pending_views;
+    // hash of the last view applied to the pipeline, i.e. of the
+    // members of its Communicator
+    uint64_t                 view_hash = 0;
+    // SSG member ids of the leaving servers handing the blocks of the
+    // current iteration over to this pipeline (once per pipeline handing
+    // them over), which executes once they are done or have died
+    std::multiset<ssg_member_id_t> handovers;
+    // on a leaving server, handover of the blocks of the current
+    // iteration, and remaining pipelines holding their execution for it
+    HandoverState            handover = HandoverState::NONE;
+    std::vector<tl::provider_handle> held_pipelines;
 };
 
 class ProviderImpl : public tl::provider<ProviderImpl> {
@@ -56,95 +139,132 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
 
     using json = nlohmann::json;
 
+    // maximum number of children of a node in the spanning
+    // tree used to propagate group-wide admin operations
+    static constexpr int32_t TREE_FANOUT = 4;
+
+    struct TreeChild {
+        tl::provider_handle ph;
+        int32_t             first_rank;
+        int32_t             last_rank;
+    };
+
+    // backend instance waiting in a pool, along with the configuration
+    // it currently has (that of its last pipeline if it was recycled)
+    struct PooledBackend {
+        std::shared_ptr<Backend> instance;
+        json                     config;
+    };
+
+    // pre-constructed backend instances of a given type
+    struct BackendPool {
+        size_t                     size = 0;
+        std::string                library;
+        json                       config;
+        std::vector<PooledBackend> instances;
+    };
+
     public:
 
     // security
     std::string            m_token;
-    // SSG
-    tl::mutex              m_ssg_mtx;
-    tl::condition_variable m_ssg_cv;
-    ssg_group_id_t         m_gid;
-    uint64_t               m_group_hash = 0;
+    // SSG and MoNA state shared with other providers of this process
+    std::shared_ptr<GroupState> m_group;
     tl::pool               m_pool;
-    // Mona
-    tl::mutex              m_mona_mtx;
-    tl::condition_variable m_mona_cv;
-    mona_instance_t        m_mona;
-    std::string            m_mona_self_addr;
-    std::map<ssg_member_id_t, na_addr_t> m_mona_addresses;
     // Admin RPC
     tl::remote_procedure m_create_pipeline;
     tl::remote_procedure m_destroy_pipeline;
+    tl::remote_procedure m_update_pipeline;
+    tl::remote_procedure m_create_dist_pipeline;
+    tl::remote_procedure m_destroy_dist_pipeline;
+    tl::remote_procedure m_update_dist_pipeline;
+    tl::remote_procedure m_revert_dist_update;
     // Client RPC
     tl::remote_procedure m_check_pipeline;
     tl::remote_procedure m_start;
     tl::remote_procedure m_stage;
+    tl::remote_procedure m_stage_shared;
+    tl::remote_procedure m_fetch;
+    tl::remote_procedure m_query;
+    tl::remote_procedure m_summarize;
     tl::remote_procedure m_execute;
+    tl::remote_procedure m_wait_execution;
     tl::remote_procedure m_cleanup;
     tl::remote_procedure m_abort;
     tl::remote_procedure m_leave;
     // Other RPCs
     tl::remote_procedure m_get_mona_addr;
+    tl::remote_procedure m_migrate_block;
+    tl::remote_procedure m_begin_handover;
+    tl::remote_procedure m_end_handover;
     // Pipelines
     std::unordered_map<std::string, std::shared_ptr<PipelineState>> m_pipelines;
     size_t m_num_active_pipelines = 0;
+    // Graceful leave: once m_forwarding is set, no iteration starts and
+    // the blocks of pipelines handed over (see _handOver) are forwarded
+    // to the remaining servers, listed in rank order
+    bool m_forwarding = false;
+    std::vector<tl::endpoint> m_forward_targets;
+    size_t m_num_inflight_stages = 0;
+    // Prewarmed backend instances, indexed by backend type
+    std::unordered_map<std::string, BackendPool> m_backend_pools;
+    size_t m_num_pool_refills = 0;
+    // number of execution streams serving m_pool, from the provider's
+    // "task_concurrency" configuration (0 if not given)
+    size_t m_task_concurrency = 0;
+    tl::mutex m_backend_pools_mtx;
+    tl::condition_variable m_backend_pools_cv;
     tl::mutex m_pipelines_mtx;
     tl::condition_variable m_pipelines_cv;
 
     ProviderImpl(const tl::engine& engine, ssg_group_id_t gid, bool must_join,
                  mona_instance_t mona, uint16_t provider_id, const tl::pool& pool)
     : tl::provider<ProviderImpl>(engine, provider_id)
-    , m_gid(gid)
-    , m_pool(pool)
-    , m_mona(mona)
+    , m_pool(pool.is_null() ? engine.get_handler_pool() : pool)
     , m_create_pipeline(define("colza_create_pipeline", &ProviderImpl::createPipeline, pool))
     , m_destroy_pipeline(define("colza_destroy_pipeline", &ProviderImpl::destroyPipeline, pool))
+    , m_update_pipeline(define("colza_update_pipeline", &ProviderImpl::updatePipeline, pool))
+    , m_create_dist_pipeline(define("colza_create_distributed_pipeline",
+                             &ProviderImpl::createDistributedPipeline, pool))
+    , m_destroy_dist_pipeline(define("colza_destroy_distributed_pipeline",
+                              &ProviderImpl::destroyDistributedPipeline, pool))
+    , m_update_dist_pipeline(define("colza_update_distributed_pipeline",
+                             &ProviderImpl::updateDistributedPipeline, pool))
+    , m_revert_dist_update(define("colza_revert_distributed_pipeline_update",
+                           &ProviderImpl::revertDistributedPipelineUpdate, pool))
     , m_check_pipeline(define("colza_check_pipeline", &ProviderImpl::checkPipeline, pool))
     , m_start(define("colza_start", &ProviderImpl::start, pool))
     , m_stage(define("colza_stage", &ProviderImpl::stage, pool))
+    , m_stage_shared(define("colza_stage_shared", &ProviderImpl::stageShared, pool))
+    , m_fetch(define("colza_fetch", &ProviderImpl::fetch, pool))
+    , m_query(define("colza_query", &ProviderImpl::query, pool))
+    , m_summarize(define("colza_summarize", &ProviderImpl::summarize, pool))
     , m_execute(define("colza_execute", &ProviderImpl::execute, pool))
+    , m_wait_execution(define("colza_wait_execution", &ProviderImpl::waitExecution, pool))
     , m_cleanup(define("colza_cleanup", &ProviderImpl::cleanup, pool))
     , m_abort(define("colza_abort", &ProviderImpl::abort, pool))
     , m_leave(define("colza_leave", &ProviderImpl::leave, pool).disable_response())
     , m_get_mona_addr(define("colza_get_mona_addr", &ProviderImpl::getMonaAddress, pool))
+    , m_migrate_block(define("colza_migrate_block", &ProviderImpl::migrateBlock, pool))
+    , m_begin_handover(define("colza_begin_handover", &ProviderImpl::beginHandover, pool))
+    , m_end_handover(define("colza_end_handover", &ProviderImpl::endHandover, pool))
     {
-        int ret;
-        if(must_join) {
-            ret = ssg_group_join(engine.get_margo_instance(),
-                    m_gid, &ProviderImpl::membershipUpdate,
-                    static_cast<void*>(this));
-            if(ret != SSG_SUCCESS) {
-                throw Exception(ErrorCode::SSG_ERROR,
-                    "Could not join SSG group (ssg_group_join returned "s +
-                    std::to_string(ret) + ")");
-            }
-        } else {
-            ssg_group_add_membership_update_callback(
-                    m_gid, &ProviderImpl::membershipUpdate,
-                    static_cast<void*>(this));
-        }
-        m_group_hash = ComputeGroupHash(m_gid);
-        spdlog::trace("[provider:{}] Group hash computed: {}", id(), m_group_hash);
-        {
-            std::lock_guard<tl::mutex> lock(m_mona_mtx);
-            na_addr_t my_mona_addr;
-            na_return_t ret = mona_addr_self(m_mona, &my_mona_addr);
-            if(ret != NA_SUCCESS)
-                throw Exception(ErrorCode::MONA_ERROR,
-                    "Could not get address from MoNA");
-            char buf[256];
-            na_size_t buf_size = 256;
-            ret = mona_addr_to_string(m_mona, buf, &buf_size, my_mona_addr);
-            mona_addr_free(m_mona, my_mona_addr);
-            if(ret != NA_SUCCESS) {
-                throw Exception(ErrorCode::MONA_ERROR,
-                    "Could not serialize MoNA address");
-            }
-            m_mona_self_addr = buf;
-            spdlog::trace("[provider:{}] MoNA address: {}", id(), m_mona_self_addr);
-        }
-        m_mona_cv.notify_all();
-        _resolveMonaAddresses();
+        m_group = GroupState::Acquire(engine, gid, must_join, mona, provider_id, m_pool);
+        spdlog::trace("[provider:{}] Group hash is {}", id(), m_group->groupHash());
+        GroupState::Listener listener;
+        listener.onViewUpdated = [this](mona_instance_t mona, const GroupView& view) {
+            _updateGroupView(mona, view);
+        };
+        listener.waitUntilInactive = [this]() {
+            _waitUntilInactive();
+        };
+        listener.migrate = [this](const std::vector<std::string>& addresses) {
+            _migrateBlocks(addresses);
+        };
+        listener.onMemberDied = [this](ssg_member_id_t member_id) {
+            _releaseHandovers(member_id);
+        };
+        m_group->addListener(this, std::move(listener));
         spdlog::trace("[provider:{0}] Registered provider with id {0}", id());
     }
 
@@ -152,22 +272,34 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         spdlog::trace("[provider:{}] Deregistering provider", id());
         m_create_pipeline.deregister();
         m_destroy_pipeline.deregister();
+        m_update_pipeline.deregister();
+        m_create_dist_pipeline.deregister();
+        m_destroy_dist_pipeline.deregister();
+        m_update_dist_pipeline.deregister();
+        m_revert_dist_update.deregister();
         m_check_pipeline.deregister();
         m_stage.deregister();
+        m_stage_shared.deregister();
+        m_fetch.deregister();
+        m_query.deregister();
+        m_summarize.deregister();
         m_execute.deregister();
+        m_wait_execution.deregister();
         m_cleanup.deregister();
         m_abort.deregister();
-        m_pipelines.clear();
-        ssg_group_remove_membership_update_callback(
-                m_gid, &ProviderImpl::membershipUpdate,
-                static_cast<void*>(this));
+        m_migrate_block.deregister();
+        m_begin_handover.deregister();
+        m_end_handover.deregister();
         {
-            std::lock_guard<tl::mutex> lock(m_mona_mtx);
-            for(auto& p : m_mona_addresses) {
-                mona_addr_free(m_mona, p.second);
+            std::unique_lock<tl::mutex> lock(m_backend_pools_mtx);
+            while(m_num_pool_refills != 0) {
+                m_backend_pools_cv.wait(lock);
             }
-            m_mona_addresses.clear();
+            m_backend_pools.clear();
         }
+        m_pipelines.clear();
+        m_group->removeListener(this);
+        m_group.reset();
         spdlog::trace("[provider:{}]    => done!", id());
     }
 
@@ -184,6 +316,19 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             throw Exception(ErrorCode::JSON_PARSE_ERROR,
                 "Could not parse JSON configuration");
         }
+        // the backends run their parallel work on m_pool, only the
+        // user knows how many execution streams serve it
+        auto concurrency_it = json_config.find("task_concurrency");
+        if(concurrency_it != json_config.end()) {
+            if(!concurrency_it->is_number_unsigned()) {
+                throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                    "'task_concurrency' entry should be a non-negative integer");
+            }
+            m_task_concurrency = concurrency_it->get<size_t>();
+        }
+        auto pools_it = json_config.find("backend_pool");
+        if(pools_it != json_config.end())
+            _processBackendPoolConfig(*pools_it);
         auto it = json_config.find("pipelines");
         if(it == json_config.end()) return;
         auto pipelines = *it;
@@ -209,24 +354,197 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         }
     }
 
-    void _createPipeline(const std::string& name,
-                         const std::string& type,
-                         const json& config,
-                         const std::string& library) {
+    /**
+     * @brief Processes the "backend_pool" section of the provider's
+     * configuration, which has the following format:
+     *
+     *     "backend_pool" : {
+     *         "<type>" : { "size" : 4, "library" : "...", "config" : {} }
+     *     }
+     *
+     * and pre-constructs "size" instances of each backend type.
+     */
+    void _processBackendPoolConfig(const json& pools) {
+        if(!pools.is_object()) {
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "'backend_pool' entry should be an object");
+        }
+        for(auto& p : pools.items()) {
+            const auto& type = p.key();
+            auto& pool_config = p.value();
+            if(!pool_config.is_object()) {
+                throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                    "Backend pool for type '"s + type + "' should be an object");
+            }
+            BackendPool pool;
+            pool.size    = pool_config.value("size", (size_t)0);
+            pool.library = pool_config.value("library", std::string());
+            pool.config  = pool_config.value("config", json::object());
+            _loadLibrary(pool.library);
+            for(size_t i = 0; i < pool.size; i++) {
+                pool.instances.push_back({_instantiateBackend(type, pool.config), pool.config});
+            }
+            spdlog::trace("[provider:{}] Prewarmed {} instances of backend {}",
+                          id(), pool.size, type);
+            std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+            m_backend_pools[type] = std::move(pool);
+        }
+    }
+
+    void _loadLibrary(const std::string& library) {
         if(!library.empty()) {
             void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_GLOBAL | RTLD_NODELETE);
             if(!handle) {
                 throw Exception(ErrorCode::INVALID_LIBRARY, dlerror());
             }
         }
+    }
+
+    std::unique_ptr<Backend> _instantiateBackend(const std::string& type,
+                                                 const json& config) {
+        PipelineFactoryArgs args;
+        args.engine = get_engine();
+        args.config = config;
+        args.gid = m_group->m_gid;
+        args.pool = m_pool;
+        args.concurrency = m_task_concurrency;
+        return PipelineFactory::createPipeline(type, args);
+    }
+
+    /**
+     * @brief Takes a backend instance of the given type from the pool,
+     * if any, and adapts it to the requested configuration. Returns
+     * a null pointer if the pool is empty or if the instance could not
+     * be reconfigured, in which case the instance is dropped since its
+     * state is unknown. Taking an instance triggers an asynchronous
+     * refill of the pool.
+     */
+    std::shared_ptr<Backend> _takeFromBackendPool(const std::string& type,
+                                                  const json& config) {
+        PooledBackend pooled;
+        {
+            std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+            auto it = m_backend_pools.find(type);
+            if(it == m_backend_pools.end() || it->second.instances.empty())
+                return nullptr;
+            pooled = std::move(it->second.instances.back());
+            it->second.instances.pop_back();
+            m_num_pool_refills += 1;
+        }
+        m_pool.make_thread([this, type]() {
+            _refillBackendPool(type);
+        }, tl::anonymous());
+        if(config != pooled.config) {
+            auto result = pooled.instance->reconfigure(config);
+            if(!result.success()) {
+                spdlog::trace("[provider:{}] Pooled instance of backend {} could not be "
+                              "reconfigured ({}), creating a new one", id(), type, result.error());
+                return nullptr;
+            }
+        }
+        return pooled.instance;
+    }
+
+    void _refillBackendPool(const std::string& type) {
+        json config;
+        bool needed = false;
+        {
+            std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+            auto it = m_backend_pools.find(type);
+            if(it != m_backend_pools.end()) {
+                needed = it->second.instances.size() < it->second.size;
+                config = it->second.config;
+            }
+        }
+        PooledBackend instance;
+        if(needed) {
+            try {
+                instance.instance = _instantiateBackend(type, config);
+                instance.config = config;
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Could not refill pool of backend {}: {}",
+                              id(), type, ex.what());
+            }
+        }
+        {
+            std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+            auto it = m_backend_pools.find(type);
+            if(instance.instance && it != m_backend_pools.end()
+            && it->second.instances.size() < it->second.size)
+                it->second.instances.push_back(std::move(instance));
+            m_num_pool_refills -= 1;
+        }
+        m_backend_pools_cv.notify_all();
+    }
+
+    /**
+     * @brief Puts back a backend instance in the pool of its type, if the
+     * pool is not full. The instance must have been reset by the caller.
+     * Returns false if the instance was not taken.
+     */
+    bool _returnToBackendPool(const std::string& type, PooledBackend pooled) {
+        std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+        auto it = m_backend_pools.find(type);
+        if(it == m_backend_pools.end() || it->second.instances.size() >= it->second.size)
+            return false;
+        it->second.instances.push_back(std::move(pooled));
+        return true;
+    }
+
+    /**
+     * @brief Resets the backend instance of a destroyed pipeline and puts
+     * it back in the pool of its type, along with the configuration it
+     * had, if the pool is not full. Must be called without holding
+     * m_pipelines_mtx.
+     */
+    void _recycleBackend(const std::string& type,
+                         std::shared_ptr<Backend> pipeline,
+                         json config) {
+        {
+            std::lock_guard<tl::mutex> lock(m_backend_pools_mtx);
+            auto it = m_backend_pools.find(type);
+            if(it == m_backend_pools.end() || it->second.instances.size() >= it->second.size)
+                return;
+        }
+        auto result = pipeline->reset();
+        if(!result.success()) {
+            spdlog::trace("[provider:{}] Backend {} cannot be recycled: {}",
+                          id(), type, result.error());
+            return;
+        }
+        if(_returnToBackendPool(type, {std::move(pipeline), std::move(config)}))
+            spdlog::trace("[provider:{}] Recycled instance of backend {}", id(), type);
+    }
+
+    /**
+     * @brief Creates a pipeline whose Communicators use the given context.
+     * Without a context, the lowest context free in the process is used,
+     * which is the same on all the servers if they create their pipelines
+     * in the same order (e.g. from the same configuration); otherwise the
+     * pipeline should be created with createDistributedPipeline, which
+     * agrees on a context across the group.
+     */
+    void _createPipeline(const std::string& name,
+                         const std::string& type,
+                         const json& config,
+                         const std::string& library,
+                         std::shared_ptr<CommunicatorContext> context = nullptr) {
+        _loadLibrary(library);
+
+        try {
+            if(!context) context = std::make_shared<CommunicatorContext>();
+        } catch(const Exception& ex) {
+            spdlog::error("[provider:{}] Cannot create pipeline {}: {}", id(), name, ex.what());
+            throw Exception(ErrorCode::PIPELINE_CREATE_ERROR, ex.what());
+        }
 
-        std::unique_ptr<Backend> pipeline;
+        std::shared_ptr<Backend> pipeline;
         try {
-            PipelineFactoryArgs args;
-            args.engine = get_engine();
-            args.config = config;
-            args.gid = m_gid;
-            pipeline = PipelineFactory::createPipeline(type, args);
+            pipeline = _takeFromBackendPool(type, config);
+            if(pipeline)
+                spdlog::trace("[provider:{}] Using prewarmed instance of backend {}", id(), type);
+            else
+                pipeline = _instantiateBackend(type, config);
         } catch(const Exception& ex) {
             spdlog::error("[provider:{}] Error when creating pipeline {} of type {}:",
                     id(), name, type);
@@ -246,19 +564,23 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
                 "Unknown pipeline type "s + type);
         }
 
-        std::vector<na_addr_t> addresses;
-        {
-            std::lock_guard<tl::mutex> lock(m_mona_mtx);
-            addresses.reserve(m_mona_addresses.size());
-            for(const auto& p : m_mona_addresses)
-                addresses.push_back(p.second);
-        }
-        pipeline->updateMonaAddresses(m_mona, addresses);
+        // a new pipeline has no previous view to compute deltas from
+        GroupView view = *m_group->getView();
+        view.joined.clear();
+        view.left.clear();
+        view.rank_map.clear();
+        pipeline->updateMonaAddresses(m_group->m_mona, view.addresses);
+        pipeline->updateGroupView(view);
+        _updateCommunicator(*pipeline, name, context->value(), m_group->m_mona, view.addresses);
 
         {
             std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
             auto state = std::make_shared<PipelineState>();
             state->pipeline = std::move(pipeline);
+            state->type = type;
+            state->config = config;
+            state->context = std::move(context);
+            state->view_hash = view.hash;
             m_pipelines[name] = std::move(state);
         }
 
@@ -274,6 +596,19 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
                         const std::string& library) {
 
         spdlog::trace("[provider:{}] Received createPipeline request", id());
+        auto result = _createPipelineFromRequest(
+            token, pipeline_name, pipeline_type, pipeline_config, library);
+        req.respond(result);
+    }
+
+    RequestResult<int32_t> _createPipelineFromRequest(
+                        const std::string& token,
+                        const std::string& pipeline_name,
+                        const std::string& pipeline_type,
+                        const std::string& pipeline_config,
+                        const std::string& library,
+                        std::shared_ptr<CommunicatorContext> context = nullptr) {
+
         spdlog::trace("[provider:{}]    => type = {}", id(), pipeline_type);
         if(!pipeline_config.empty())
             spdlog::trace("[provider:{}]    => config = {}", id(), pipeline_config);
@@ -287,9 +622,8 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             result.success() = false;
             result.error() = "Invalid security token";
             result.value() = (int)ErrorCode::INVALID_SECURITY_TOKEN;
-            req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
-            return;
+            return result;
         }
 
         json json_config;
@@ -303,67 +637,558 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             result.success() = false;
             spdlog::error("[provider:{}] Could not parse pipeline configuration for pipeline {}",
                     id(), pipeline_name);
-            req.respond(result);
-            return;
+            return result;
         }
 
         try {
-            _createPipeline(pipeline_name, pipeline_type, json_config, library);
+            _createPipeline(pipeline_name, pipeline_type, json_config, library,
+                            std::move(context));
         } catch(Exception& e) {
             result.error()   = e.what();
             result.success() = false;
             result.value()   = (int)e.code();
-            req.respond(result);
-            return;
+            return result;
         }
         result.success() = true;
-        req.respond(result);
+        return result;
     }
 
     void destroyPipeline(const tl::request& req,
                          const std::string& token,
                          const std::string& pipeline_name) {
-        RequestResult<int32_t> result;
         spdlog::trace("[provider:{}] Received destroyPipeline request for pipeline {}", id(), pipeline_name);
+        auto result = _destroyPipelineFromRequest(token, pipeline_name);
+        req.respond(result);
+    }
+
+    RequestResult<int32_t> _destroyPipelineFromRequest(
+                         const std::string& token,
+                         const std::string& pipeline_name) {
+        RequestResult<int32_t> result;
 
         if(m_token.size() > 0 && m_token != token) {
             result.success() = false;
             result.error() = "Invalid security token";
             result.value() = (int)ErrorCode::INVALID_SECURITY_TOKEN;
-            req.respond(result);
             spdlog::error("[provider:{}] Invalid security token {}", id(), token);
-            return;
+            return result;
         }
 
+        std::shared_ptr<PipelineState> state;
         {
-            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            auto it = m_pipelines.find(pipeline_name);
+            while(it != m_pipelines.end() && it->second->in_transition) {
+                m_pipelines_cv.wait(lock);
+                it = m_pipelines.find(pipeline_name);
+            }
 
-            if(m_pipelines.count(pipeline_name) == 0) {
+            if(it == m_pipelines.end()) {
                 result.success() = false;
                 result.error() = "Pipeline "s + pipeline_name + " not found";
                 result.value() = (int)ErrorCode::INVALID_PIPELINE_NAME;
-                req.respond(result);
                 spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
-                return;
+                return result;
             }
 
-            auto state = m_pipelines[pipeline_name];
+            state = it->second;
             if(state->active) {
                 result.success() = false;
                 result.error() = "Cannot destroy a pipeline while active";
                 result.value() = (int)ErrorCode::PIPELINE_IS_ACTIVE;
-                req.respond(result);
                 spdlog::error("[provider:{}] Pipeline {} could not be destroyed "
                               "because it is active", id(), pipeline_name);
-                return;
+                return result;
             }
 
-            result = state->pipeline->destroy();
             m_pipelines.erase(pipeline_name);
         }
 
-        req.respond(result);
+        result = state->pipeline->destroy();
+        // recycle the instance if nothing else references it
+        if(result.success() && state->pipeline.use_count() == 1)
+            _recycleBackend(state->type, std::move(state->pipeline), std::move(state->config));
+
         spdlog::trace("[provider:{}] Pipeline {} successfully destroyed", id(), pipeline_name);
+        return result;
+    }
+
+    void updatePipeline(const tl::request& req,
+                        const std::string& token,
+                        const std::string& pipeline_name,
+                        const std::string& pipeline_config,
+                        uint64_t from_iteration) {
+        spdlog::trace("[provider:{}] Received updatePipeline request for pipeline {}", id(), pipeline_name);
+        auto result = _updatePipelineFromRequest(token, pipeline_name, pipeline_config, from_iteration);
+        req.respond(result);
+    }
+
+    /**
+     * @brief Updates the configuration of a pipeline. If keep_previous
+     * is set, the configuration the pipeline had is kept so that the
+     * update can be reverted with _revertUpdateFromRequest.
+     */
+    RequestResult<int32_t> _updatePipelineFromRequest(
+                        const std::string& token,
+                        const std::string& pipeline_name,
+                        const std::string& pipeline_config,
+                        uint64_t from_iteration,
+                        bool keep_previous = false) {
+        RequestResult<int32_t> result;
+
+        if(m_token.size() > 0 && m_token != token) {
+            result.success() = false;
+            result.error() = "Invalid security token";
+            result.value() = (int)ErrorCode::INVALID_SECURITY_TOKEN;
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return result;
+        }
+
+        json json_config;
+        try {
+            if(!pipeline_config.empty()) {
+                json_config = json::parse(pipeline_config);
+            }
+        } catch(json::parse_error& e) {
+            result.error() = e.what();
+            result.value() = (int)ErrorCode::JSON_PARSE_ERROR;
+            result.success() = false;
+            spdlog::error("[provider:{}] Could not parse pipeline configuration for pipeline {}",
+                    id(), pipeline_name);
+            return result;
+        }
+
+        std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+        auto it = m_pipelines.find(pipeline_name);
+        while(it != m_pipelines.end() && it->second->in_transition) {
+            m_pipelines_cv.wait(lock);
+            it = m_pipelines.find(pipeline_name);
+        }
+        if(it == m_pipelines.end()) {
+            result.success() = false;
+            result.error() = "Pipeline with name "s + pipeline_name + " not found";
+            result.value() = (int)ErrorCode::INVALID_PIPELINE_NAME;
+            spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
+            return result;
+        }
+        auto state = it->second;
+        ConfigSnapshot previous;
+        previous.valid                  = keep_previous;
+        previous.config                 = state->config;
+        previous.has_pending_config     = state->has_pending_config;
+        previous.pending_config         = state->pending_config;
+        previous.pending_from_iteration = state->pending_from_iteration;
+        state->previous_config = ConfigSnapshot();
+        if(state->active || from_iteration != 0) {
+            // the new configuration will be applied when
+            // the next suitable iteration starts
+            state->previous_config = std::move(previous);
+            state->has_pending_config = true;
+            state->pending_config = std::move(json_config);
+            state->pending_from_iteration = from_iteration;
+            spdlog::trace("[provider:{}] Configuration of pipeline {} will be updated "
+                          "at iteration >= {}", id(), pipeline_name, from_iteration);
+        } else {
+            state->has_pending_config = false;
+            state->in_transition = true;
+            lock.unlock();
+            result = state->pipeline->reconfigure(json_config);
+            lock.lock();
+            if(result.success()) {
+                state->config = std::move(json_config);
+                previous.applied = true;
+                state->previous_config = std::move(previous);
+            }
+            state->in_transition = false;
+            m_pipelines_cv.notify_all();
+            if(!result.success()) {
+                spdlog::error("[provider:{}] Pipeline {} could not be reconfigured: {}",
+                        id(), pipeline_name, result.error());
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Restores the configuration a pipeline had before its last
+     * update from updateDistributedPipeline. If the update reconfigured
+     * the backend and the pipeline has started an iteration since, the
+     * previous configuration is applied when the next iteration starts.
+     */
+    RequestResult<int32_t> _revertUpdateFromRequest(
+                        const std::string& token,
+                        const std::string& pipeline_name) {
+        RequestResult<int32_t> result;
+
+        if(m_token.size() > 0 && m_token != token) {
+            result.success() = false;
+            result.error() = "Invalid security token";
+            result.value() = (int)ErrorCode::INVALID_SECURITY_TOKEN;
+            spdlog::error("[provider:{}] Invalid security token {}", id(), token);
+            return result;
+        }
+
+        std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+        auto it = m_pipelines.find(pipeline_name);
+        while(it != m_pipelines.end() && it->second->in_transition) {
+            m_pipelines_cv.wait(lock);
+            it = m_pipelines.find(pipeline_name);
+        }
+        if(it == m_pipelines.end()) {
+            result.success() = false;
+            result.error() = "Pipeline with name "s + pipeline_name + " not found";
+            result.value() = (int)ErrorCode::INVALID_PIPELINE_NAME;
+            spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
+            return result;
+        }
+        auto state = it->second;
+        if(!state->previous_config.valid) {
+            spdlog::trace("[provider:{}] No update of pipeline {} to revert", id(), pipeline_name);
+            return result;
+        }
+        auto previous = std::move(state->previous_config);
+        state->previous_config = ConfigSnapshot();
+        state->has_pending_config     = previous.has_pending_config;
+        state->pending_config         = std::move(previous.pending_config);
+        state->pending_from_iteration = previous.pending_from_iteration;
+        if(!previous.applied) {
+            spdlog::trace("[provider:{}] Reverted deferred update of pipeline {}",
+                          id(), pipeline_name);
+            return result;
+        }
+        if(state->active) {
+            if(!state->has_pending_config) {
+                state->has_pending_config     = true;
+                state->pending_config         = std::move(previous.config);
+                state->pending_from_iteration = 0;
+            }
+            spdlog::trace("[provider:{}] Configuration of pipeline {} will be reverted "
+                          "when the next iteration starts", id(), pipeline_name);
+            return result;
+        }
+        state->in_transition = true;
+        lock.unlock();
+        result = state->pipeline->reconfigure(previous.config);
+        lock.lock();
+        if(result.success())
+            state->config = std::move(previous.config);
+        state->in_transition = false;
+        m_pipelines_cv.notify_all();
+        if(!result.success()) {
+            spdlog::error("[provider:{}] Configuration of pipeline {} could not be reverted: {}",
+                    id(), pipeline_name, result.error());
+        }
+        return result;
+    }
+
+    void createDistributedPipeline(const tl::request& req,
+                                   const std::string& token,
+                                   const std::string& pipeline_name,
+                                   const std::string& pipeline_type,
+                                   const std::string& pipeline_config,
+                                   const std::string& library,
+                                   uint32_t context_id,
+                                   uint64_t group_hash,
+                                   int32_t first_rank,
+                                   int32_t last_rank) {
+        spdlog::trace("[provider:{}] Received createDistributedPipeline request "
+                      "for pipeline {} (ranks {} to {})", id(), pipeline_name,
+                      first_rank, last_rank);
+        // the root picks the communicator context of the pipeline (the
+        // request from the admin has none) and the other servers claim
+        // the same one, so that they all agree on it
+        std::shared_ptr<CommunicatorContext> context;
+        try {
+            if(context_id == 0)
+                context = std::make_shared<CommunicatorContext>();
+            else
+                context = std::make_shared<CommunicatorContext>(context_id);
+        } catch(const Exception& ex) {
+            RequestResult<int32_t> result;
+            result.success() = false;
+            result.error()   = "Could not create pipeline "s + pipeline_name + ": " + ex.what();
+            result.value()   = (int)ErrorCode::PIPELINE_CREATE_ERROR;
+            spdlog::error("[provider:{}] {}", id(), result.error());
+            req.respond(result);
+            return;
+        }
+        context_id = context->value();
+        auto result = _runTreeOperation(group_hash, first_rank, last_rank,
+            [&]() {
+                return _createPipelineFromRequest(
+                    token, pipeline_name, pipeline_type, pipeline_config, library,
+                    std::move(context));
+            },
+            [&](const TreeChild& child) {
+                return m_create_dist_pipeline.on(child.ph).async(
+                    token, pipeline_name, pipeline_type, pipeline_config, library,
+                    context_id, group_hash, child.first_rank, child.last_rank);
+            },
+            [&](bool local_ok, const std::vector<TreeChild>& succeeded) {
+                // the subtree rooted here must be all-or-nothing
+                spdlog::warn("[provider:{}] Rolling back creation of pipeline {}",
+                             id(), pipeline_name);
+                std::vector<tl::async_response> responses;
+                for(auto& child : succeeded) {
+                    try {
+                        responses.push_back(m_destroy_dist_pipeline.on(child.ph).async(
+                            token, pipeline_name, group_hash, child.first_rank, child.last_rank));
+                    } catch(const std::exception& ex) {
+                        spdlog::error("[provider:{}] Could not roll back ranks {} to {}: {}",
+                                      id(), child.first_rank, child.last_rank, ex.what());
+                    }
+                }
+                if(local_ok) _destroyPipelineFromRequest(token, pipeline_name);
+                for(auto& r : responses) {
+                    try { r.wait(); } catch(...) {}
+                }
+            });
+        req.respond(result);
+    }
+
+    void destroyDistributedPipeline(const tl::request& req,
+                                    const std::string& token,
+                                    const std::string& pipeline_name,
+                                    uint64_t group_hash,
+                                    int32_t first_rank,
+                                    int32_t last_rank) {
+        spdlog::trace("[provider:{}] Received destroyDistributedPipeline request "
+                      "for pipeline {} (ranks {} to {})", id(), pipeline_name,
+                      first_rank, last_rank);
+        auto result = _runTreeOperation(group_hash, first_rank, last_rank,
+            [&]() {
+                return _destroyPipelineFromRequest(token, pipeline_name);
+            },
+            [&](const TreeChild& child) {
+                return m_destroy_dist_pipeline.on(child.ph).async(
+                    token, pipeline_name, group_hash, child.first_rank, child.last_rank);
+            },
+            nullptr);
+        req.respond(result);
+    }
+
+    void updateDistributedPipeline(const tl::request& req,
+                                   const std::string& token,
+                                   const std::string& pipeline_name,
+                                   const std::string& pipeline_config,
+                                   uint64_t from_iteration,
+                                   uint64_t group_hash,
+                                   int32_t first_rank,
+                                   int32_t last_rank) {
+        spdlog::trace("[provider:{}] Received updateDistributedPipeline request "
+                      "for pipeline {} (ranks {} to {})", id(), pipeline_name,
+                      first_rank, last_rank);
+        auto result = _runTreeOperation(group_hash, first_rank, last_rank,
+            [&]() {
+                return _updatePipelineFromRequest(
+                    token, pipeline_name, pipeline_config, from_iteration, true);
+            },
+            [&](const TreeChild& child) {
+                return m_update_dist_pipeline.on(child.ph).async(
+                    token, pipeline_name, pipeline_config, from_iteration,
+                    group_hash, child.first_rank, child.last_rank);
+            },
+            [&](bool local_ok, const std::vector<TreeChild>& succeeded) {
+                // all the servers of the subtree keep the same configuration
+                spdlog::warn("[provider:{}] Rolling back update of pipeline {}",
+                             id(), pipeline_name);
+                std::vector<tl::async_response> responses;
+                for(auto& child : succeeded) {
+                    try {
+                        responses.push_back(m_revert_dist_update.on(child.ph).async(
+                            token, pipeline_name, group_hash, child.first_rank, child.last_rank));
+                    } catch(const std::exception& ex) {
+                        spdlog::error("[provider:{}] Could not roll back ranks {} to {}: {}",
+                                      id(), child.first_rank, child.last_rank, ex.what());
+                    }
+                }
+                if(local_ok) _revertUpdateFromRequest(token, pipeline_name);
+                for(auto& r : responses) {
+                    try { r.wait(); } catch(...) {}
+                }
+            });
+        req.respond(result);
+    }
+
+    void revertDistributedPipelineUpdate(const tl::request& req,
+                                         const std::string& token,
+                                         const std::string& pipeline_name,
+                                         uint64_t group_hash,
+                                         int32_t first_rank,
+                                         int32_t last_rank) {
+        spdlog::trace("[provider:{}] Received revertDistributedPipelineUpdate request "
+                      "for pipeline {} (ranks {} to {})", id(), pipeline_name,
+                      first_rank, last_rank);
+        auto result = _runTreeOperation(group_hash, first_rank, last_rank,
+            [&]() {
+                return _revertUpdateFromRequest(token, pipeline_name);
+            },
+            [&](const TreeChild& child) {
+                return m_revert_dist_update.on(child.ph).async(
+                    token, pipeline_name, group_hash, child.first_rank, child.last_rank);
+            },
+            nullptr);
+        req.respond(result);
+    }
+
+    /**
+     * Children of first_rank in the spanning tree covering the ranks
+     * [first_rank, last_rank] of the given view (see SubtreeRanges).
+     */
+    std::vector<TreeChild> _treeChildren(const GroupView& view,
+                                         int32_t first_rank, int32_t last_rank) {
+        std::vector<TreeChild> children;
+        if(last_rank >= (int32_t)view.size()) {
+            throw Exception(ErrorCode::INVALID_GROUP_HASH,
+                "Rank "s + std::to_string(last_rank) + " not in group view");
+        }
+        for(auto& range : SubtreeRanges(first_rank, last_rank, TREE_FANOUT)) {
+            hg_addr_t a = HG_ADDR_NULL;
+            int ret = ssg_get_group_member_addr(
+                m_group->m_gid, view.member_ids[range.first_rank], &a);
+            if(ret != SSG_SUCCESS) {
+                throw Exception(ErrorCode::SSG_ERROR,
+                    "ssg_get_group_member_addr failed with error code "s
+                    + std::to_string(ret));
+            }
+            TreeChild child;
+            child.ph = tl::provider_handle(get_engine(), a, get_provider_id(), false);
+            child.first_rank = range.first_rank;
+            child.last_rank  = range.last_rank;
+            children.push_back(std::move(child));
+        }
+        return children;
+    }
+
+    /**
+     * Runs local_op on this provider while forwarding the operation down
+     * a spanning tree covering ranks [first_rank, last_rank] of the group
+     * view (this provider being at first_rank), and aggregates the
+     * results of the whole subtree. If anything fails and a rollback
+     * function is provided, it is called with whether the local
+     * operation succeeded and the list of children whose subtree
+     * succeeded.
+     */
+    RequestResult<int32_t> _runTreeOperation(
+            uint64_t group_hash, int32_t first_rank, int32_t last_rank,
+            const std::function<RequestResult<int32_t>()>& local_op,
+            const std::function<tl::async_response(const TreeChild&)>& forward,
+            const std::function<void(bool, const std::vector<TreeChild>&)>& rollback) {
+        RequestResult<int32_t> result;
+        // ranks are those of the view, which are the SSG ranks
+        // the admin sees when the hashes match
+        auto view = m_group->getView();
+        if(group_hash != view->hash) {
+            result.value() = (int)ErrorCode::INVALID_GROUP_HASH;
+            result.success() = false;
+            result.error() = "Inconsistent group view";
+            spdlog::error("[provider:{}] Incorrect group hash sent by admin", id());
+            return result;
+        }
+        int self_rank = view->rankOf(m_group->m_self_id);
+        if(self_rank != first_rank) {
+            result.value() = (int)ErrorCode::INVALID_GROUP_HASH;
+            result.success() = false;
+            result.error() = "Inconsistent group view (expected rank "s
+                + std::to_string(first_rank) + ", found " + std::to_string(self_rank) + ")";
+            spdlog::error("[provider:{}] {}", id(), result.error());
+            return result;
+        }
+        std::vector<TreeChild> children;
+        try {
+            children = _treeChildren(*view, first_rank, last_rank);
+        } catch(const Exception& ex) {
+            result.value() = (int)ex.code();
+            result.success() = false;
+            result.error() = ex.what();
+            return result;
+        }
+
+        auto add_error = [&result](const RequestResult<int32_t>& r) {
+            if(result.success()) {
+                result.success() = false;
+                result.value() = r.value();
+                result.error() = r.error();
+            } else {
+                result.error() += "; " + r.error();
+            }
+        };
+
+        std::vector<tl::async_response> responses;
+        std::vector<bool> sent(children.size(), false);
+        for(unsigned i = 0; i < children.size(); i++) {
+            try {
+                responses.push_back(forward(children[i]));
+                sent[i] = true;
+            } catch(const std::exception& ex) {
+                RequestResult<int32_t> r;
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+                r.error() = "[ranks "s + std::to_string(children[i].first_rank) + "-"
+                          + std::to_string(children[i].last_rank) + "] " + ex.what();
+                add_error(r);
+            }
+        }
+
+        auto local_result = local_op();
+        if(!local_result.success()) {
+            local_result.error() = "[rank "s + std::to_string(first_rank) + "] "
+                                 + local_result.error();
+            add_error(local_result);
+        }
+
+        std::vector<TreeChild> succeeded;
+        unsigned j = 0;
+        for(unsigned i = 0; i < children.size(); i++) {
+            if(!sent[i]) continue;
+            RequestResult<int32_t> r;
+            try {
+                r = responses[j++].wait();
+            } catch(const std::exception& ex) {
+                r.success() = false;
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+                r.error() = "[ranks "s + std::to_string(children[i].first_rank) + "-"
+                          + std::to_string(children[i].last_rank) + "] " + ex.what();
+            }
+            if(r.success()) succeeded.push_back(children[i]);
+            else add_error(r);
+        }
+
+        if(!result.success() && rollback)
+            rollback(local_result.success(), succeeded);
+        return result;
+    }
+
+    // Applies the configuration waiting for the given iteration, if any.
+    // Called with the pipeline in transition, outside of m_pipelines_mtx.
+    // The configuration is dropped if the backend rejects it, and the
+    // error is returned so that the iteration does not start with it.
+    RequestResult<int32_t> _applyPendingConfig(const std::string& pipeline_name,
+                                               PipelineState& state, uint64_t iteration) {
+        RequestResult<int32_t> result;
+        json config;
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            if(!state.has_pending_config || iteration < state.pending_from_iteration)
+                return result;
+            state.has_pending_config = false;
+            config = std::move(state.pending_config);
+            state.pending_config = json();
+        }
+        result = state.pipeline->reconfigure(config);
+        if(result.success()) {
+            {
+                std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                state.config = std::move(config);
+            }
+            spdlog::trace("[provider:{}] Pipeline {} reconfigured before iteration {}",
+                    id(), pipeline_name, iteration);
+        } else {
+            spdlog::error("[provider:{}] Pipeline {} could not be reconfigured "
+                          "before iteration {}: {}", id(), pipeline_name, iteration,
+                          result.error());
+            result.error() = "Pending configuration could not be applied: "s + result.error();
+        }
+        return result;
     }
 
     void checkPipeline(const tl::request& req,
@@ -375,13 +1200,32 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         req.respond(result);
     }
 
+    /**
+     * @brief Starts an iteration. If trigger is set, the pipeline
+     * executes the iteration by itself as soon as expected_blocks
+     * blocks have been staged into it (immediately if none is expected),
+     * then cleans it up if auto_cleanup is set. Clients then wait for
+     * the execution with waitExecution. Blocks migrated or forwarded
+     * from a leaving server are not counted, instead the execution is
+     * held until that server has handed all its blocks of the iteration
+     * over (see beginHandover). provider_ids are the provider ids over
+     * which a DistributedPipelineHandle places the blocks on each server
+     * (empty for a PipelineHandle), kept to place the blocks the same way
+     * if this server leaves, unless custom_placement indicates that the
+     * client places them with its own HashFunction.
+     */
     void start(const tl::request& req,
                uint64_t group_hash,
                const std::string& pipeline_name,
-               uint64_t iteration) {
+               uint64_t iteration,
+               bool trigger,
+               uint64_t expected_blocks,
+               bool auto_cleanup,
+               const std::vector<uint16_t>& provider_ids,
+               bool custom_placement) {
         spdlog::trace("[provider:{}] Received start request for pipeline {}", id(), pipeline_name);
         RequestResult<int32_t> result;
-        if(group_hash != m_group_hash) {
+        if(group_hash != m_group->groupHash()) {
             result.value() = (int)ErrorCode::INVALID_GROUP_HASH;
             result.success() = false;
             result.error() = "Inconsistent group view";
@@ -391,7 +1235,18 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         }
         FIND_PIPELINE(state);
         auto pipeline = state->pipeline;
-        if(state->active) {
+        bool forwarding;
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            forwarding = m_forwarding;
+        }
+        if(forwarding) {
+            result.value() = (int)ErrorCode::INVALID_GROUP_HASH;
+            result.success() = false;
+            result.error() = "Server is leaving the group";
+            spdlog::error("[provider:{}] Refusing to start pipeline {}, server is leaving",
+                          id(), pipeline_name);
+        } else if(state->active) {
             result.value() = (int)ErrorCode::PIPELINE_IS_ACTIVE;
             result.success() = false;
             result.error() = "Pipeline is already active";
@@ -401,24 +1256,61 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             result.error() = "Pipeline cannot be started at an inferior iteration number";
         } else {
             {
-                std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+                while(state->in_transition)
+                    m_pipelines_cv.wait(lock);
+                state->in_transition = true;
                 m_num_active_pipelines += 1;
             }
-            result = pipeline->start(iteration);
-            spdlog::trace("[provider:{}] Pipeline {} successfuly started iteration {}",
-                          id(), pipeline_name, iteration);
+            _applyPendingViews(pipeline_name, *state);
+            {
+                // the view may have changed since the hash was checked,
+                // the iteration must run with the members the client sees
+                std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                if(state->view_hash != group_hash) {
+                    result.value() = (int)ErrorCode::INVALID_GROUP_HASH;
+                    result.success() = false;
+                    result.error() = "Inconsistent group view";
+                    spdlog::error("[provider:{}] Group view of pipeline {} does not match "
+                                  "the group hash sent by client", id(), pipeline_name);
+                }
+            }
+            if(result.success())
+                result = _applyPendingConfig(pipeline_name, *state, iteration);
+            if(result.success()) {
+                result = pipeline->start(iteration);
+                spdlog::trace("[provider:{}] Pipeline {} successfuly started iteration {}",
+                              id(), pipeline_name, iteration);
+            }
             if(result.success()) {
-                state->iteration = iteration;
-                state->active = true;
+                {
+                    std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                    state->in_transition           = false;
+                    state->trigger = ExecutionTrigger();
+                    state->trigger.armed           = trigger;
+                    state->trigger.iteration       = iteration;
+                    state->trigger.expected_blocks = expected_blocks;
+                    state->trigger.auto_cleanup    = auto_cleanup;
+                    state->trigger.fired           = trigger && expected_blocks == 0;
+                    state->provider_ids            = provider_ids;
+                    state->custom_placement        = custom_placement;
+                    state->executed                = false;
+                    state->handovers.clear();
+                    state->iteration               = iteration;
+                    state->active                  = true;
+                }
             } else {
                 {
                     std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                    state->in_transition = false;
                     m_num_active_pipelines -= 1;
                 }
-                m_pipelines_cv.notify_all();
             }
+            m_pipelines_cv.notify_all();
         }
         req.respond(result);
+        if(result.success() && trigger && expected_blocks == 0)
+            _fireTrigger(pipeline_name, *state, iteration);
     }
 
     void stage(const tl::request& req,
@@ -435,24 +1327,596 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         RequestResult<int32_t> result;
         FIND_PIPELINE(state);
         auto pipeline = state->pipeline;
-        if(!state->active) {
-            result.value() = (int)ErrorCode::PIPELINE_NOT_ACTIVE;
-            result.success() = false;
-            result.error() = "Pipeline is not active";
-            spdlog::error("[provider:{}] Pipeline {} is not active", id(), pipeline_name);
-        } else if(state->iteration != iteration) {
-            result.value() = (int)ErrorCode::INVALID_ITERATION;
+        bool forwarding = false;
+        tl::provider_handle target;
+        {
+            // checked under the lock, since the block counts towards
+            // the trigger of the iteration that is active
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            while(state->handover == HandoverState::PENDING)
+                m_pipelines_cv.wait(lock);
+            if(!state->active) {
+                result.value() = (int)ErrorCode::PIPELINE_NOT_ACTIVE;
+                result.success() = false;
+                result.error() = "Pipeline is not active";
+                spdlog::error("[provider:{}] Pipeline {} is not active", id(), pipeline_name);
+            } else if(state->iteration != iteration) {
+                result.value() = (int)ErrorCode::INVALID_ITERATION;
+                result.success() = false;
+                result.error() = "Invalid iteration";
+                spdlog::error("[provider:{}] Invalid iteration ({})", id(), iteration);
+            } else {
+                forwarding = _isForwarding(*state);
+                if(forwarding) {
+                    target = _placementTarget(*state, m_forward_targets,
+                                              dataset_name, iteration, block_id);
+                } else {
+                    m_num_inflight_stages += 1;
+                }
+            }
+        }
+        if(result.success()) {
+            if(forwarding) {
+                spdlog::trace("[provider:{}] Forwarding block {} of dataset {} to {}",
+                              id(), block_id, dataset_name, static_cast<std::string>(target));
+                try {
+                    result = m_migrate_block.on(target)(
+                        pipeline_name, sender_addr, dataset_name, iteration,
+                        block_id, dimensions, offsets, type, data);
+                } catch(const std::exception& ex) {
+                    result.value() = (int)ErrorCode::OTHER_ERROR;
+                    result.success() = false;
+                    result.error() = ex.what();
+                    spdlog::error("[provider:{}] Could not forward block {}: {}",
+                                  id(), block_id, ex.what());
+                }
+            } else {
+                result = pipeline->stage(
+                        sender_addr, dataset_name, iteration,
+                        block_id, dimensions, offsets, type, data);
+                {
+                    std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                    m_num_inflight_stages -= 1;
+                }
+                m_pipelines_cv.notify_all();
+            }
+        }
+        bool fire = result.success() && _countStagedBlock(*state, iteration);
+        req.respond(result);
+        if(fire)
+            _fireTrigger(pipeline_name, *state, iteration);
+    }
+
+    /**
+     * @brief Stages a block into several pipelines, pulling it once
+     * into memory shared by all of them (see Backend::stageShared).
+     */
+    void stageShared(const tl::request& req,
+                     const std::vector<std::string>& pipeline_names,
+                     const std::string& sender_addr,
+                     const std::string& dataset_name,
+                     uint64_t iteration,
+                     uint64_t block_id,
+                     const std::vector<size_t>& dimensions,
+                     const std::vector<int64_t>& offsets,
+                     const Type& type,
+                     const thallium::bulk& data) {
+        spdlog::trace("[provider:{}] Received stage request for {} pipelines",
+                      id(), pipeline_names.size());
+        RequestResult<int32_t> result;
+        result.value() = 0;
+        auto fail = [&result](const std::string& error, ErrorCode code) {
             result.success() = false;
-            result.error() = "Invalid iteration";
-            spdlog::error("[provider:{}] Invalid iteration ({})", id(), iteration);
+            result.error() = error;
+            result.value() = (int)code;
+        };
+        // all the pipelines are checked before the block is pulled
+        std::vector<std::shared_ptr<PipelineState>> states;
+        std::vector<std::shared_ptr<Backend>> pipelines;
+        // pipelines whose blocks are handed over to the remaining servers
+        // get the block forwarded, the others get it staged locally
+        std::vector<tl::provider_handle> targets;
+        bool staging_locally = false;
+        {
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            auto pending = [this, &pipeline_names]() {
+                for(auto& name : pipeline_names) {
+                    auto it = m_pipelines.find(name);
+                    if(it != m_pipelines.end() && it->second->handover == HandoverState::PENDING)
+                        return true;
+                }
+                return false;
+            };
+            while(pending())
+                m_pipelines_cv.wait(lock);
+            for(auto& name : pipeline_names) {
+                auto it = m_pipelines.find(name);
+                if(it == m_pipelines.end()) {
+                    fail("Pipeline with name "s + name + " not found",
+                         ErrorCode::INVALID_PIPELINE_NAME);
+                } else if(!it->second->active) {
+                    fail("Pipeline "s + name + " is not active", ErrorCode::PIPELINE_NOT_ACTIVE);
+                } else if(it->second->iteration != iteration) {
+                    fail("Invalid iteration", ErrorCode::INVALID_ITERATION);
+                }
+                if(!result.success()) break;
+                states.push_back(it->second);
+                pipelines.push_back(it->second->pipeline);
+            }
+            if(result.success()) {
+                targets.resize(states.size());
+                for(size_t i = 0; i < states.size(); i++) {
+                    if(_isForwarding(*states[i])) {
+                        targets[i] = _placementTarget(*states[i], m_forward_targets,
+                                                      dataset_name, iteration, block_id);
+                    } else {
+                        staging_locally = true;
+                    }
+                }
+                if(staging_locally)
+                    m_num_inflight_stages += 1;
+            }
+        }
+        if(!result.success()) {
+            spdlog::error("[provider:{}] {}", id(), result.error());
+            req.respond(result);
+            return;
+        }
+        std::vector<size_t> fired;
+        // each pipeline may place the block on a different server
+        for(size_t i = 0; i < pipelines.size(); i++) {
+            if(targets[i].is_null()) continue;
+            RequestResult<int32_t> r;
+            try {
+                r = m_migrate_block.on(targets[i])(
+                    pipeline_names[i], sender_addr, dataset_name, iteration,
+                    block_id, dimensions, offsets, type, data);
+            } catch(const std::exception& ex) {
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+                r.success() = false;
+                r.error() = ex.what();
+                spdlog::error("[provider:{}] Could not forward block {}: {}",
+                              id(), block_id, ex.what());
+            }
+            if(!r.success() && result.success())
+                fail("Pipeline "s + pipeline_names[i] + ": " + r.error(), (ErrorCode)r.value());
+            if(r.success() && _countStagedBlock(*states[i], iteration))
+                fired.push_back(i);
+        }
+        if(!staging_locally) {
+            req.respond(result);
+            for(auto i : fired)
+                _fireTrigger(pipeline_names[i], *states[i], iteration);
+            return;
+        }
+        BlockStore::BlockPtr block;
+        if(data.size() != ComputeDataSize(dimensions, type)) {
+            fail("Block size does not match its dimensions and type", ErrorCode::OTHER_ERROR);
         } else {
-            result = pipeline->stage(
+            try {
+                block = BlockStore::Pull(get_engine(), sender_addr, dataset_name, block_id,
+                                         dimensions, offsets, type, data);
+            } catch(const std::exception& ex) {
+                fail(ex.what(), ErrorCode::OTHER_ERROR);
+            }
+        }
+        for(size_t i = 0; block && i < pipelines.size(); i++) {
+            if(!targets[i].is_null()) continue;
+            auto r = StageSharedBlock(*pipelines[i], get_engine(),
+                                      dataset_name, iteration, block_id, block);
+            if(!r.success() && result.success())
+                fail("Pipeline "s + pipeline_names[i] + ": " + r.error(), (ErrorCode)r.value());
+            if(r.success() && _countStagedBlock(*states[i], iteration))
+                fired.push_back(i);
+        }
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            m_num_inflight_stages -= 1;
+        }
+        m_pipelines_cv.notify_all();
+        req.respond(result);
+        for(auto i : fired)
+            _fireTrigger(pipeline_names[i], *states[i], iteration);
+    }
+
+    void fetch(const tl::request& req,
+               const std::string& pipeline_name,
+               const std::string& origin_addr,
+               const std::vector<FetchKey>& keys,
+               const thallium::bulk& data) {
+        spdlog::trace("[provider:{}] Received fetch request for {} blocks of pipeline {}",
+                      id(), keys.size(), pipeline_name);
+        std::vector<FetchedBlock> fetched(keys.size());
+        auto fail = [](FetchedBlock& f, const std::string& error, ErrorCode code) {
+            f.result.success() = false;
+            f.result.error() = error;
+            f.result.value() = (int)code;
+        };
+        std::shared_ptr<PipelineState> state;
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            auto it = m_pipelines.find(pipeline_name);
+            if(it != m_pipelines.end())
+                state = it->second;
+        }
+        if(!state) {
+            for(auto& f : fetched)
+                fail(f, "Pipeline with name "s + pipeline_name + " not found",
+                     ErrorCode::INVALID_PIPELINE_NAME);
+            spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
+            req.respond(fetched);
+            return;
+        }
+        tl::endpoint origin_ep;
+        try {
+            origin_ep = get_engine().lookup(origin_addr);
+        } catch(const std::exception& ex) {
+            for(auto& f : fetched)
+                fail(f, ex.what(), ErrorCode::OTHER_ERROR);
+            spdlog::error("[provider:{}] Could not lookup {}: {}", id(), origin_addr, ex.what());
+            req.respond(fetched);
+            return;
+        }
+        // blocks are pushed one at a time, straight from the backend's
+        // memory into the region of the client's buffer reserved for them
+        for(size_t i = 0; i < keys.size(); i++) {
+            auto& key = keys[i];
+            auto& out = fetched[i];
+            if(key.offset + key.capacity > data.size()) {
+                fail(out, "Buffer region exceeds the exposed memory", ErrorCode::OTHER_ERROR);
+                continue;
+            }
+            auto push = [&](const BlockInfo& info, const void* block_data) {
+                RequestResult<int32_t> result;
+                result.value() = 0;
+                out.info = info;
+                if(info.size > key.capacity) {
+                    result.success() = false;
+                    result.error() = "Buffer too small for block ("s
+                                   + std::to_string(info.size) + " bytes needed)";
+                    result.value() = (int)ErrorCode::BUFFER_TOO_SMALL;
+                    return result;
+                }
+                if(info.size == 0)
+                    return result;
+                try {
+                    std::vector<std::pair<void*, size_t>> segments = {
+                        std::make_pair(const_cast<void*>(block_data), info.size)
+                    };
+                    auto local_bulk = get_engine().expose(segments, tl::bulk_mode::read_only);
+                    data.select(key.offset, info.size).on(origin_ep) << local_bulk;
+                } catch(const std::exception& ex) {
+                    result.success() = false;
+                    result.error() = ex.what();
+                    result.value() = (int)ErrorCode::OTHER_ERROR;
+                }
+                return result;
+            };
+            try {
+                out.result = state->pipeline->fetch(
+                    key.dataset_name, key.iteration, key.block_id, push);
+            } catch(const std::exception& ex) {
+                fail(out, ex.what(), ErrorCode::OTHER_ERROR);
+            }
+            if(!out.result.success())
+                spdlog::trace("[provider:{}] Could not fetch block {} of dataset {}: {}",
+                              id(), key.block_id, key.dataset_name, out.result.error());
+        }
+        req.respond(fetched);
+    }
+
+    /**
+     * @brief Checks whether the parts of a query, packed one after the
+     * other in data, exactly tile their bounding box and whether that
+     * box forms a single contiguous run of a buffer covering the region.
+     * If so, the parts are rearranged in data to cover the bounding box
+     * in row-major order, offset is set to the position of the box in
+     * the region's buffer, and true is returned.
+     */
+    static bool _assembleParts(const std::vector<Box>& boxes,
+                               const Box& region,
+                               size_t element_size,
+                               std::vector<char>& data,
+                               size_t& offset) {
+        if(boxes.empty()) return false;
+        Box bbox = boxes[0];
+        size_t volume = 0;
+        for(auto& box : boxes) {
+            for(size_t d = 0; d < bbox.ndims(); d++) {
+                bbox.lower[d] = std::min(bbox.lower[d], box.lower[d]);
+                bbox.upper[d] = std::max(bbox.upper[d], box.upper[d]);
+            }
+            volume += box.volume();
+        }
+        if(volume != bbox.volume()) return false;
+        for(size_t i = 0; i < boxes.size(); i++)
+            for(size_t j = i + 1; j < boxes.size(); j++)
+                if(boxes[i].intersects(boxes[j])) return false;
+        size_t num_runs = 0;
+        ForEachRun(bbox, region, bbox, element_size,
+            [&](size_t, size_t dst_offset, size_t) {
+                if(num_runs++ == 0) offset = dst_offset;
+            });
+        if(num_runs != 1) return false;
+        if(boxes.size() > 1) {
+            std::vector<char> assembled(data.size());
+            size_t src_offset = 0;
+            for(auto& box : boxes) {
+                CopyRegion(data.data() + src_offset, box, assembled.data(), bbox,
+                           box, element_size);
+                src_offset += box.volume()*element_size;
+            }
+            data.swap(assembled);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Extracts the parts of the pipeline's blocks that intersect
+     * a region and pushes them into the client's buffer, which covers
+     * the region in row-major order. In packed mode, if the parts tile a
+     * box forming a single contiguous run of the client's buffer, they
+     * are assembled into that box and pushed to their place with a
+     * single transfer. Otherwise they are packed one after the other and
+     * pushed with a single transfer into the temporary buffer following
+     * the region in the client's bulk handle, the client scattering them
+     * using the boxes sent back. Outside of packed mode, each part is
+     * pushed to its place with one transfer per contiguous run.
+     */
+    void query(const tl::request& req,
+               const std::string& pipeline_name,
+               const std::string& origin_addr,
+               const std::string& dataset_name,
+               uint64_t iteration,
+               const std::vector<int64_t>& lower,
+               const std::vector<int64_t>& upper,
+               const Type& type,
+               const thallium::bulk& data,
+               bool packed) {
+        spdlog::trace("[provider:{}] Received query request for dataset {} of pipeline {}",
+                      id(), dataset_name, pipeline_name);
+        QueryResult response;
+        auto& result = response.result;
+        result.value() = 0;
+        auto fail = [&result](const std::string& error, ErrorCode code) {
+            result.success() = false;
+            result.error() = error;
+            result.value() = (int)code;
+        };
+        std::shared_ptr<PipelineState> state;
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            auto it = m_pipelines.find(pipeline_name);
+            if(it != m_pipelines.end())
+                state = it->second;
+        }
+        if(!state) {
+            fail("Pipeline with name "s + pipeline_name + " not found",
+                 ErrorCode::INVALID_PIPELINE_NAME);
+            spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
+            req.respond(response);
+            return;
+        }
+        const Box region(lower, upper);
+        const size_t element_size = ComputeDataSize({}, type);
+        if(lower.size() != upper.size() || region.empty()) {
+            fail("Invalid region", ErrorCode::OTHER_ERROR);
+            req.respond(response);
+            return;
+        }
+        const size_t region_size = region.volume()*element_size;
+        if(data.size() < region_size) {
+            fail("Buffer too small for the region", ErrorCode::BUFFER_TOO_SMALL);
+            req.respond(response);
+            return;
+        }
+        std::vector<char> packed_data;
+        tl::endpoint origin_ep;
+        auto push = [&](const BlockInfo& info, const void* block_data) {
+            RequestResult<int32_t> r;
+            r.value() = 0;
+            if(info.type != type) {
+                r.success() = false;
+                r.error() = "Type of dataset "s + dataset_name + " does not match the query";
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+                return r;
+            }
+            auto box = Box::FromBlock(info.dimensions, info.offsets);
+            if(box.ndims() != region.ndims()) {
+                r.success() = false;
+                r.error() = "Dimensions of dataset "s + dataset_name + " do not match the query";
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+                return r;
+            }
+            auto overlap = box.intersect(region);
+            if(overlap.empty())
+                return r;
+            try {
+                if(packed) {
+                    auto offset = packed_data.size();
+                    packed_data.resize(offset + overlap.volume()*element_size);
+                    CopyRegion(block_data, box, packed_data.data() + offset,
+                               overlap, overlap, element_size);
+                    response.boxes.push_back(overlap);
+                    return r;
+                }
+                packed_data.resize(overlap.volume()*element_size);
+                CopyRegion(block_data, box, packed_data.data(), overlap, overlap, element_size);
+                std::vector<std::pair<void*, size_t>> segments = {
+                    std::make_pair<void*, size_t>(packed_data.data(), packed_data.size())
+                };
+                auto local_bulk = get_engine().expose(segments, tl::bulk_mode::read_only);
+                if(origin_ep.is_null())
+                    origin_ep = get_engine().lookup(origin_addr);
+                ForEachRun(overlap, region, overlap, element_size,
+                    [&](size_t src_offset, size_t dst_offset, size_t size) {
+                        data.select(dst_offset, size).on(origin_ep)
+                            << local_bulk.select(src_offset, size);
+                    });
+            } catch(const std::exception& ex) {
+                r.success() = false;
+                r.error() = ex.what();
+                r.value() = (int)ErrorCode::OTHER_ERROR;
+            }
+            return r;
+        };
+        try {
+            result = state->pipeline->query(dataset_name, iteration, region, push);
+        } catch(const std::exception& ex) {
+            fail(ex.what(), ErrorCode::OTHER_ERROR);
+        }
+        if(packed && result.success() && !packed_data.empty()) {
+            size_t offset = 0;
+            bool placed = _assembleParts(response.boxes, region, element_size,
+                                         packed_data, offset);
+            if(!placed && packed_data.size() > data.size() - region_size) {
+                fail("Buffer too small for the blocks intersecting the region",
+                     ErrorCode::BUFFER_TOO_SMALL);
+            } else {
+                if(!placed) offset = region_size;
+                try {
+                    std::vector<std::pair<void*, size_t>> segments = {
+                        std::make_pair<void*, size_t>(packed_data.data(), packed_data.size())
+                    };
+                    auto local_bulk = get_engine().expose(segments, tl::bulk_mode::read_only);
+                    data.select(offset, packed_data.size()).on(get_engine().lookup(origin_addr))
+                        << local_bulk;
+                    if(placed) response.boxes.clear();
+                } catch(const std::exception& ex) {
+                    fail(ex.what(), ErrorCode::OTHER_ERROR);
+                }
+            }
+        }
+        if(!result.success() && result.value() != (int)ErrorCode::BUFFER_TOO_SMALL)
+            response.boxes.clear();
+        req.respond(response);
+    }
+
+    void summarize(const tl::request& req,
+                   const std::string& pipeline_name,
+                   const std::string& dataset_name,
+                   uint64_t iteration,
+                   uint64_t max_boxes) {
+        spdlog::trace("[provider:{}] Received summarize request for dataset {} of pipeline {}",
+                      id(), dataset_name, pipeline_name);
+        RequestResult<std::vector<Box>> result;
+        std::shared_ptr<PipelineState> state;
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            auto it = m_pipelines.find(pipeline_name);
+            if(it != m_pipelines.end())
+                state = it->second;
+        }
+        if(!state) {
+            result.success() = false;
+            result.error() = "Pipeline with name "s + pipeline_name + " not found";
+            spdlog::error("[provider:{}] Pipeline {} not found", id(), pipeline_name);
+            req.respond(result);
+            return;
+        }
+        try {
+            auto r = state->pipeline->summarize(dataset_name, iteration, max_boxes, result.value());
+            result.success() = r.success();
+            result.error() = r.error();
+        } catch(const std::exception& ex) {
+            result.success() = false;
+            result.error() = ex.what();
+        }
+        req.respond(result);
+    }
+
+    void migrateBlock(const tl::request& req,
+                      const std::string& pipeline_name,
+                      const std::string& sender_addr,
+                      const std::string& dataset_name,
+                      uint64_t iteration,
+                      uint64_t block_id,
+                      const std::vector<size_t>& dimensions,
+                      const std::vector<int64_t>& offsets,
+                      const Type& type,
+                      const thallium::bulk& data) {
+        spdlog::trace("[provider:{}] Received block {} of dataset {} migrated from {}",
+                      id(), block_id, dataset_name, sender_addr);
+        RequestResult<int32_t> result;
+        FIND_PIPELINE(state);
+        // blocks of past iterations are data retained by the pipeline,
+        // blocks of the current iteration are only accepted while a
+        // leaving server hands them over (see beginHandover)
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            if(iteration > state->iteration) {
+                result.value() = (int)ErrorCode::INVALID_ITERATION;
+                result.success() = false;
+                result.error() = "Invalid iteration";
+            } else if(iteration == state->iteration && state->active && state->handovers.empty()) {
+                result.value() = (int)ErrorCode::PIPELINE_IS_ACTIVE;
+                result.success() = false;
+                result.error() = "Iteration is not being handed over";
+            }
+        }
+        if(result.success()) {
+            result = state->pipeline->stage(
                     sender_addr, dataset_name, iteration,
                     block_id, dimensions, offsets, type, data);
+        } else {
+            spdlog::error("[provider:{}] Rejecting block {} of iteration {} migrated to pipeline {}: {}",
+                          id(), block_id, iteration, pipeline_name, result.error());
+        }
+        req.respond(result);
+    }
+
+    /**
+     * @brief Called by a leaving server before it hands the blocks of an
+     * iteration of the pipeline over. If the pipeline has not started
+     * executing the iteration, its execution is held until endHandover
+     * and the response's value is 1. Otherwise the value is 0 and the
+     * leaving server keeps the blocks of the iteration. The execution is
+     * also released if SSG reports that the leaving server (leaver_id)
+     * died before calling endHandover.
+     */
+    void beginHandover(const tl::request& req,
+                       const std::string& pipeline_name,
+                       uint64_t iteration,
+                       ssg_member_id_t leaver_id) {
+        spdlog::trace("[provider:{}] Received handover request for iteration {} of pipeline {}",
+                      id(), iteration, pipeline_name);
+        RequestResult<int32_t> result;
+        FIND_PIPELINE(state);
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            if(state->active && state->iteration == iteration && !state->executed) {
+                state->handovers.insert(leaver_id);
+                result.value() = 1;
+            } else {
+                result.value() = 0;
+            }
         }
         req.respond(result);
     }
 
+    /**
+     * @brief Called by a leaving server once it has handed all the
+     * blocks of the iteration over, releasing the execution held by
+     * beginHandover.
+     */
+    void endHandover(const tl::request& req,
+                     const std::string& pipeline_name,
+                     uint64_t iteration,
+                     ssg_member_id_t leaver_id) {
+        spdlog::trace("[provider:{}] Handover of iteration {} of pipeline {} completed",
+                      id(), iteration, pipeline_name);
+        RequestResult<int32_t> result;
+        FIND_PIPELINE(state);
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            auto it = state->handovers.find(leaver_id);
+            if(state->iteration == iteration && it != state->handovers.end())
+                state->handovers.erase(it);
+        }
+        m_pipelines_cv.notify_all();
+        req.respond(result);
+    }
+
     void execute(const tl::request& req,
                  const std::string& pipeline_name,
                  uint64_t iteration,
@@ -460,8 +1924,10 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         spdlog::trace("[provider:{}] Received execute request for pipeline {}", id(), pipeline_name);
         RequestResult<int32_t> result;
         FIND_PIPELINE(state);
-        auto pipeline = state->pipeline;
-        if(!state->active) {
+        if(_waitTriggered(*state, iteration, result)) {
+            // the iteration executes by itself (and autoCleanup was given
+            // to start), so this only waits for the execution to complete
+        } else if(!state->active) {
             result.value() = (int)ErrorCode::PIPELINE_NOT_ACTIVE;
             result.success() = false;
             result.error() = "Pipeline is not active";
@@ -472,18 +1938,143 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             result.error() = "Invalid iteration";
             spdlog::error("[provider:{}] Invalid iteration ({})", id(), iteration);
         } else {
-            result = pipeline->execute(iteration);
-            if(result.success() && autoCleanup) {
-                result = pipeline->cleanup(iteration);
-                if(result.success()) {
-                    std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
-                    state->active = false;
-                    m_num_active_pipelines -= 1;
-                }
+            result = _execute(pipeline_name, *state, iteration, autoCleanup);
+        }
+        req.respond(result);
+    }
+
+    void waitExecution(const tl::request& req,
+                       const std::string& pipeline_name,
+                       uint64_t iteration) {
+        spdlog::trace("[provider:{}] Received wait request for pipeline {}", id(), pipeline_name);
+        RequestResult<int32_t> result;
+        FIND_PIPELINE(state);
+        if(!_waitTriggered(*state, iteration, result)) {
+            result.value() = (int)ErrorCode::INVALID_ITERATION;
+            result.success() = false;
+            result.error() = "Iteration was not started with expected blocks";
+            spdlog::error("[provider:{}] Iteration {} of pipeline {} does not execute by itself",
+                          id(), iteration, pipeline_name);
+        }
+        req.respond(result);
+    }
+
+    /**
+     * @brief Executes an iteration. While blocks of the iteration are
+     * handed over from a leaving server, the execution waits for them.
+     * On the leaving server, it waits for its blocks to be migrated,
+     * releases the remaining servers, and takes part in the iteration
+     * (in particular in its collective operations) with no block.
+     */
+    RequestResult<int32_t> _execute(const std::string& pipeline_name,
+                                    PipelineState& state, uint64_t iteration,
+                                    bool autoCleanup) {
+        std::vector<tl::provider_handle> held;
+        {
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            while(!state.handovers.empty()
+               || state.handover == HandoverState::PENDING
+               || state.handover == HandoverState::MIGRATING)
+                m_pipelines_cv.wait(lock);
+            state.executed = true;
+            held.swap(state.held_pipelines);
+        }
+        _endHandover(pipeline_name, iteration, held);
+        RequestResult<int32_t> result = state.pipeline->execute(iteration);
+        if(result.success() && autoCleanup) {
+            result = state.pipeline->cleanup(iteration);
+            if(result.success()) {
+                std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                state.active = false;
+                m_num_active_pipelines -= 1;
+            }
+            m_pipelines_cv.notify_all();
+        }
+        return result;
+    }
+
+    /**
+     * @brief Counts a block staged into the pipeline, returning true if
+     * it is the last block its trigger expects, in which case the caller
+     * must call _fireTrigger (after responding to its client).
+     */
+    bool _countStagedBlock(PipelineState& state, uint64_t iteration) {
+        std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+        auto& trigger = state.trigger;
+        if(!trigger.armed || trigger.fired || trigger.iteration != iteration)
+            return false;
+        trigger.staged_blocks += 1;
+        if(trigger.staged_blocks < trigger.expected_blocks)
+            return false;
+        trigger.fired = true;
+        return true;
+    }
+
+    void _fireTrigger(const std::string& pipeline_name,
+                      PipelineState& state, uint64_t iteration) {
+        spdlog::trace("[provider:{}] All expected blocks staged, pipeline {} executing iteration {}",
+                      id(), pipeline_name, iteration);
+        bool auto_cleanup;
+        {
+            // the trigger is reset by start, read it under the lock and
+            // give up if the iteration was cleaned up in the meantime
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            auto& trigger = state.trigger;
+            if(trigger.iteration != iteration || trigger.done)
+                return;
+            if(!state.active || state.iteration != iteration) {
+                spdlog::trace("[provider:{}] Iteration {} of pipeline {} is no longer active",
+                              id(), iteration, pipeline_name);
+                trigger.done = true;
+                trigger.result.value() = (int)ErrorCode::PIPELINE_NOT_ACTIVE;
+                trigger.result.success() = false;
+                trigger.result.error() = "Iteration was cleaned up before it executed";
+                lock.unlock();
                 m_pipelines_cv.notify_all();
+                return;
             }
+            auto_cleanup = trigger.auto_cleanup;
+            if(!state.handovers.empty())
+                spdlog::trace("[provider:{}] Pipeline {} waiting for {} leaving servers "
+                              "to hand their blocks over", id(), pipeline_name,
+                              state.handovers.size());
         }
-        req.respond(result);
+        auto result = _execute(pipeline_name, state, iteration, auto_cleanup);
+        if(!result.success()) {
+            spdlog::error("[provider:{}] Pipeline {} failed to execute iteration {}: {}",
+                          id(), pipeline_name, iteration, result.error());
+        }
+        {
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            auto& trigger = state.trigger;
+            if(trigger.iteration == iteration && !trigger.done) {
+                trigger.done   = true;
+                trigger.result = result;
+            }
+        }
+        m_pipelines_cv.notify_all();
+    }
+
+    /**
+     * @brief If the iteration was started with a trigger, waits for its
+     * execution, sets result to its outcome, and returns true.
+     */
+    bool _waitTriggered(PipelineState& state, uint64_t iteration,
+                        RequestResult<int32_t>& result) {
+        std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+        auto& trigger = state.trigger;
+        if(!trigger.armed || trigger.iteration != iteration)
+            return false;
+        while(!trigger.done && trigger.iteration == iteration)
+            m_pipelines_cv.wait(lock);
+        if(trigger.iteration == iteration) {
+            result = trigger.result;
+        } else {
+            result.value() = (int)ErrorCode::INVALID_ITERATION;
+            result.success() = false;
+            result.error() = "Pipeline has moved on to another iteration";
+        }
+        return true;
     }
 
     void cleanup(const tl::request& req,
@@ -538,8 +2129,17 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
             pipeline->abort(iteration);
             {
                 std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                auto& trigger = state->trigger;
+                if(trigger.armed && trigger.iteration == iteration && !trigger.done) {
+                    trigger.fired  = true;
+                    trigger.done   = true;
+                    trigger.result.value()   = (int)ErrorCode::OTHER_ERROR;
+                    trigger.result.success() = false;
+                    trigger.result.error()   = "Iteration was aborted";
+                }
                 state->active = false;
                 state->iteration -= 1;
+                state->handovers.clear();
                 m_num_active_pipelines -= 1;
             }
             m_pipelines_cv.notify_all();
@@ -547,163 +2147,311 @@ class ProviderImpl : public tl::provider<ProviderImpl> {
         req.respond(result);
     }
 
-    void leave() {
-        spdlog::trace("[provider:{}] Received request to leave", id());
+    void leave(bool migrate) {
+        spdlog::trace("[provider:{}] Received request to leave (migrate = {})", id(), migrate);
+        m_group->leave(migrate);
+        spdlog::trace("[provider:{}] Left SSG group, calling finalize", id());
+        get_engine().finalize();
         {
-            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
-            while(m_num_active_pipelines != 0) {
-                m_pipelines_cv.wait(lock);
-            }
-            spdlog::trace("[provider:{}] All the pipelines are inactive, provider can leave", id());
-            ssg_group_leave(m_gid);
-            spdlog::trace("[provider:{}] Left SSG group, calling finalize", id());
-            get_engine().finalize();
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
             m_pipelines.clear();
         }
     }
 
-    void getMonaAddress(const tl::request& req) {
+    void getMonaAddress(const tl::request& req,
+                        ssg_member_id_t caller_id,
+                        const std::string& caller_addr) {
         spdlog::trace("[provider:{}] Received request for MoNA address", id());
-        RequestResult<std::string> result;
-        {
-            std::unique_lock<tl::mutex> guard(m_mona_mtx);
-            while(m_mona_self_addr.empty()) {
-                m_mona_cv.wait(guard);
-            }
-            result.value() = m_mona_self_addr;
-        }
+        RequestResult<GroupState::KnownAddresses> result;
+        result.value() = m_group->exchangeMonaAddresses(caller_id, caller_addr);
         req.respond(result);
     }
 
-    na_addr_t _requestMonaAddressFromSSGMember(ssg_member_id_t member_id) {
-        hg_addr_t hg_addr = HG_ADDR_NULL;
-        ssg_get_group_member_addr(m_gid, member_id, &hg_addr);
-        tl::provider_handle ph;
+    /**
+     * @brief Hands a new view of the group to the pipelines. Active
+     * pipelines get it when their next iteration starts, since the
+     * servers that started the current iteration run it together.
+     */
+    void _updateGroupView(mona_instance_t mona, const GroupView& view) {
+        std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+        for(auto& p : m_pipelines) {
+            auto& state = p.second;
+            if(state->active)
+                state->pending_views.push_back(view);
+            else
+                _applyGroupView(p.first, *state, mona, view);
+        }
+    }
+
+    void _applyPendingViews(const std::string& pipeline_name, PipelineState& state) {
+        std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+        for(auto& view : state.pending_views)
+            _applyGroupView(pipeline_name, state, m_group->m_mona, view);
+        state.pending_views.clear();
+    }
+
+    void _applyGroupView(const std::string& pipeline_name, PipelineState& state,
+                         mona_instance_t mona, const GroupView& view) {
+        state.pipeline->updateMonaAddresses(mona, view.addresses);
+        state.pipeline->updateGroupView(view);
+        _updateCommunicator(*state.pipeline, pipeline_name, state.context->value(),
+                            mona, view.addresses);
+        state.view_hash = view.hash;
+    }
+
+    void _updateCommunicator(Backend& pipeline, const std::string& pipeline_name,
+                             uint32_t context, mona_instance_t mona,
+                             const std::vector<na_addr_t>& addresses) {
+        if(addresses.empty()) return;
         try {
-            ph = tl::provider_handle(get_engine(), hg_addr, get_provider_id(), false);
-        } catch(const std::exception& e) {
-            spdlog::critical("Could not create provider handle from address to member {}: {}",
-                             member_id, e.what());
-            throw;
-        }
-        RequestResult<std::string> result;
-        bool ok = false;
-        while(!ok) {
+            pipeline.updateCommunicator(Communicator(mona, addresses, m_pool, context));
+        } catch(const Exception& ex) {
+            spdlog::error("[provider:{}] Could not build communicator of pipeline {}: {}",
+                          id(), pipeline_name, ex.what());
+        }
+    }
+
+    /**
+     * @brief Pipeline to which a block is forwarded or migrated: the
+     * block is placed over the given servers and over the provider ids
+     * sent with the pipeline's last start request, the same way the
+     * client places it once this server has left. A pipeline that has
+     * only been used through a PipelineHandle places its blocks over
+     * the providers with the same id as this one.
+     */
+    tl::provider_handle _placementTarget(const PipelineState& state,
+                                         const std::vector<tl::endpoint>& servers,
+                                         const std::string& dataset_name,
+                                         uint64_t iteration,
+                                         uint64_t block_id) const {
+        auto h = state.pipeline->placementHash(dataset_name, iteration, block_id);
+        if(state.provider_ids.empty()) {
+            auto p = PlaceBlock(h, servers.size(), 1);
+            return tl::provider_handle(servers[p.server], id());
+        }
+        auto p = PlaceBlock(h, servers.size(), state.provider_ids.size());
+        return tl::provider_handle(servers[p.server], state.provider_ids[p.provider]);
+    }
+
+    /**
+     * @brief Switches the provider to forwarding mode, waits for the
+     * blocks being staged to be stored, then sends all the blocks held
+     * by the pipelines to the servers listed in addresses (in rank
+     * order), placing each block with _placementTarget.
+     */
+    void _migrateBlocks(const std::vector<std::string>& addresses) {
+        std::vector<tl::endpoint> targets;
+        targets.reserve(addresses.size());
+        for(const auto& addr : addresses) {
             try {
-                result = m_get_mona_addr.on(ph)();
-                ok = true;
-            } catch(...) {
-                // TODO improve that to retry only in relevant
-                // cases and sleep for increasing amounts of time
-                spdlog::trace("[provider:{}] Failed to get MoNA address of member {}, retrying...", id(), member_id);
-                tl::thread::sleep(get_engine(), 100);
-            }
-        }
-        na_addr_t addr = NA_ADDR_NULL;
-        na_return_t ret = mona_addr_lookup(m_mona, result.value().c_str(), &addr);
-        if(ret != NA_SUCCESS)
-            throw Exception(ErrorCode::MONA_ERROR,
-                "mona_addr_lookup failed with error code "s + std::to_string(ret));
-        spdlog::trace("[provider:{}] Successfully obtained MoNA address of member {}", id(), member_id);
-        return addr;
-    }
-
-    void _resolveMonaAddresses() {
-        // TODO we could speed up this function if the getMonaAddress RPC
-        // were to piggy-back the addresses it already knows
-        spdlog::trace("[provider:{}] Resolving MoNA addressed of SSG group", id());
-        ssg_member_id_t self_id = SSG_MEMBER_ID_INVALID;
-        int ret = ssg_get_self_id(get_engine().get_margo_instance(), &self_id);
-        if(ret != SSG_SUCCESS) {
-            throw Exception(ErrorCode::SSG_ERROR,
-                "ssg_get_self_id failed with error code "s +std::to_string(ret));
-        }
-        int self_rank = -1;
-        ret = ssg_get_group_member_rank(m_gid, self_id, &self_rank);
-        if(ret != SSG_SUCCESS) {
-            throw Exception(ErrorCode::SSG_ERROR,
-                "ssg_get_group_member_rank failed with error code "s +std::to_string(ret));
-        }
-        int group_size = 0;
-        ret = ssg_get_group_size(m_gid, &group_size);
-        if(ret != SSG_SUCCESS) {
-            throw Exception(ErrorCode::SSG_ERROR,
-                "ssg_get_group_size failed with error code "s +std::to_string(ret));
-        }
-        std::vector<ssg_member_id_t> member_ids(group_size);
-        ret = ssg_get_group_member_ids_from_range(m_gid, 0, group_size-1, member_ids.data());
-        if(ret != SSG_SUCCESS) {
-            throw Exception(ErrorCode::SSG_ERROR,
-                "ssg_get_group_member_ids_from_range failed with error code "s +std::to_string(ret));
-        }
-        decltype(m_mona_addresses) tmp_addresses;
-        for(int i = 0; i < group_size; i++) {
-            int j = (self_rank + i) % group_size;
-            ssg_member_id_t member_id = member_ids[j];
-            if(m_mona_addresses.count(member_id) != 0)
-                continue;
-            if(member_id == self_id) {
-                na_addr_t self_mona_addr;
-                mona_addr_self(m_mona, &self_mona_addr);
-                tmp_addresses[member_id] = self_mona_addr;
-            } else {
-                tmp_addresses[member_id] = _requestMonaAddressFromSSGMember(member_id);
+                targets.push_back(get_engine().lookup(addr));
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Could not lookup {}: {}", id(), addr, ex.what());
             }
         }
+        std::vector<std::pair<std::string, std::shared_ptr<PipelineState>>> pipelines;
         {
-            std::lock_guard<tl::mutex> lock(m_mona_mtx);
-            m_mona_addresses.insert(tmp_addresses.begin(), tmp_addresses.end());
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            m_forward_targets = targets;
+            m_forwarding = true;
+            while(m_num_inflight_stages != 0) {
+                m_pipelines_cv.wait(lock);
+            }
+            for(auto& p : m_pipelines)
+                pipelines.emplace_back(p.first, p.second);
         }
-        m_mona_cv.notify_all();
-        spdlog::trace("[provider:{}] Done resolving MoNA addressed of SSG group", id());
-        spdlog::trace("[provider:{}] {} addresses found in SSG group", id(), group_size);
+        if(targets.empty()) {
+            spdlog::warn("[provider:{}] No server left to migrate data to", id());
+            return;
+        }
+        for(auto& p : pipelines)
+            _handOver(p.first, *p.second, targets);
     }
 
-    void _membershipUpdate(ssg_member_id_t member_id,
-                           ssg_member_update_type_t update_type) {
-        spdlog::trace("[provider:{}] Member {} updated", id(), member_id);
-        m_group_hash = UpdateGroupHash(m_group_hash, member_id);
-        spdlog::trace("[provider:{}] Group hash was updated to {}", id(), m_group_hash);
-        // TODO use the provider's pool instead of self ES
-        tl::xstream::self().make_thread([this, member_id, update_type]() {
-
-        if(update_type == SSG_MEMBER_JOINED) {
-            spdlog::trace("[provider:{}] Member {} joined", id(), member_id);
-            na_addr_t na_addr = _requestMonaAddressFromSSGMember(member_id);
-            {
-                std::lock_guard<tl::mutex> lock(m_mona_mtx);
-                m_mona_addresses[member_id] = na_addr;
+    /**
+     * @brief Hands the blocks of a pipeline over to the remaining
+     * servers. If an iteration is active and has not started executing,
+     * the remaining pipelines are first asked to hold their execution
+     * (see beginHandover), then its blocks are migrated along with the
+     * retained ones and the blocks staged afterwards are forwarded. If
+     * one of them has already started executing it, the iteration's
+     * blocks stay here and only the retained ones are migrated. The
+     * migrated blocks are then released by cleaning up their past
+     * iterations, and by restarting the active one, which this pipeline
+     * still executes with the remaining ones. Nothing is migrated if the
+     * client places blocks with its own HashFunction.
+     */
+    void _handOver(const std::string& pipeline_name, PipelineState& state,
+                   const std::vector<tl::endpoint>& targets) {
+        bool active;
+        uint64_t iteration;
+        {
+            // once the handover is pending, blocks of the pipeline wait
+            // for it to be accepted or declined before being staged
+            std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+            if(state.custom_placement) {
+                spdlog::warn("[provider:{}] Clients of pipeline {} place blocks with their own "
+                             "HashFunction, its blocks will not be migrated", id(), pipeline_name);
+                return;
+            }
+            active = state.active && !state.executed;
+            iteration = state.iteration;
+            if(active) state.handover = HandoverState::PENDING;
+            while(m_num_inflight_stages != 0) {
+                m_pipelines_cv.wait(lock);
+            }
+        }
+        bool handed_over = false;
+        std::vector<tl::provider_handle> held;
+        if(active) {
+            std::vector<tl::provider_handle> remaining;
+            for(auto& server : targets) {
+                if(state.provider_ids.empty()) {
+                    remaining.emplace_back(server, id());
+                } else {
+                    for(auto provider_id : state.provider_ids)
+                        remaining.emplace_back(server, provider_id);
+                }
+            }
+            std::vector<tl::async_response> responses;
+            auto self_id = m_group->selfId();
+            for(auto& ph : remaining)
+                responses.push_back(m_begin_handover.on(ph).async(pipeline_name, iteration, self_id));
+            handed_over = true;
+            for(size_t i = 0; i < responses.size(); i++) {
+                try {
+                    RequestResult<int32_t> result = responses[i].wait();
+                    if(result.success() && result.value() == 1)
+                        held.push_back(remaining[i]);
+                    else
+                        handed_over = false;
+                } catch(const std::exception& ex) {
+                    spdlog::error("[provider:{}] Could not hand pipeline {} over to {}: {}",
+                                  id(), pipeline_name, static_cast<std::string>(remaining[i]),
+                                  ex.what());
+                    handed_over = false;
+                }
+            }
+            if(!handed_over) {
+                spdlog::warn("[provider:{}] Iteration {} of pipeline {} is already executing, "
+                             "its blocks will not be migrated", id(), iteration, pipeline_name);
+                _endHandover(pipeline_name, iteration, held);
+                held.clear();
             }
-            m_mona_cv.notify_all();
-        } else {
-            spdlog::trace("[provider:{}] Member {} left", id(), member_id);
             {
-                std::lock_guard<tl::mutex> lock(m_mona_mtx);
-                m_mona_addresses.erase(member_id);
+                std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+                state.handover = handed_over ? HandoverState::MIGRATING : HandoverState::NONE;
+                state.held_pipelines = held;
+            }
+            m_pipelines_cv.notify_all();
+        }
+        auto self_addr = static_cast<std::string>(get_engine().self());
+        auto& pipeline = state.pipeline;
+        auto blocks = pipeline->exportBlocks();
+        if(active && !handed_over) {
+            blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                [iteration](const ExportedBlock& b) { return b.iteration == iteration; }),
+                blocks.end());
+        }
+        spdlog::trace("[provider:{}] Migrating {} blocks of pipeline {}",
+                      id(), blocks.size(), pipeline_name);
+        std::vector<tl::async_response> responses;
+        std::vector<uint64_t> block_ids;
+        std::set<uint64_t> iterations;
+        responses.reserve(blocks.size());
+        for(auto& b : blocks) {
+            auto target = _placementTarget(state, targets,
+                                           b.dataset_name, b.iteration, b.block_id);
+            responses.push_back(m_migrate_block.on(target).async(
+                pipeline_name, self_addr, b.dataset_name, b.iteration,
+                b.block_id, b.dimensions, b.offsets, b.type, b.data));
+            block_ids.push_back(b.block_id);
+            iterations.insert(b.iteration);
+        }
+        for(size_t i = 0; i < responses.size(); i++) {
+            try {
+                RequestResult<int32_t> result = responses[i].wait();
+                if(!result.success()) {
+                    spdlog::error("[provider:{}] Migration of block {} of pipeline {} failed: {}",
+                                  id(), block_ids[i], pipeline_name, result.error());
+                }
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Migration of block {} of pipeline {} failed: {}",
+                              id(), block_ids[i], pipeline_name, ex.what());
+            }
+        }
+        for(auto it : iterations) {
+            if(!handed_over || it != iteration)
+                pipeline->cleanup(it);
+        }
+        if(handed_over && iterations.count(iteration)) {
+            // the iteration is still active: drop its blocks by restarting
+            // it, cleanup being left to the client once it has executed
+            pipeline->abort(iteration);
+            auto result = pipeline->start(iteration);
+            if(!result.success()) {
+                spdlog::error("[provider:{}] Could not restart iteration {} of pipeline {}: {}",
+                              id(), iteration, pipeline_name, result.error());
             }
         }
-        std::vector<na_addr_t> addresses;
         {
-            std::lock_guard<tl::mutex> lock(m_mona_mtx);
-            addresses.reserve(m_mona_addresses.size());
-            for(const auto& p : m_mona_addresses)
-                addresses.push_back(p.second);
+            std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
+            if(state.handover == HandoverState::MIGRATING)
+                state.handover = HandoverState::DONE;
         }
+        m_pipelines_cv.notify_all();
+    }
+
+    bool _isForwarding(const PipelineState& state) const {
+        return state.handover == HandoverState::MIGRATING
+            || state.handover == HandoverState::DONE;
+    }
+
+    /**
+     * @brief Releases the execution of the remaining pipelines held
+     * for an iteration handed over by this server.
+     */
+    void _endHandover(const std::string& pipeline_name, uint64_t iteration,
+                      const std::vector<tl::provider_handle>& held) {
+        std::vector<tl::async_response> responses;
+        auto self_id = m_group->selfId();
+        for(auto& ph : held)
+            responses.push_back(m_end_handover.on(ph).async(pipeline_name, iteration, self_id));
+        for(size_t i = 0; i < responses.size(); i++) {
+            try {
+                responses[i].wait();
+            } catch(const std::exception& ex) {
+                spdlog::error("[provider:{}] Could not release pipeline {} on {}: {}",
+                              id(), pipeline_name, static_cast<std::string>(held[i]), ex.what());
+            }
+        }
+    }
+
+    /**
+     * @brief Releases the executions held for a leaving server that
+     * died before completing its handover (see beginHandover). Its
+     * blocks that were not migrated are lost.
+     */
+    void _releaseHandovers(ssg_member_id_t member_id) {
         {
             std::lock_guard<tl::mutex> lock(m_pipelines_mtx);
             for(auto& p : m_pipelines) {
-                auto& state = p.second;
-                state->pipeline->updateMonaAddresses(m_mona, addresses);
+                auto& state = *p.second;
+                if(state.handovers.erase(member_id) != 0) {
+                    spdlog::error("[provider:{}] Member {} died while handing iteration {} "
+                                  "of pipeline {} over, executing without its remaining blocks",
+                                  id(), member_id, state.iteration, p.first);
+                }
             }
         }
-
-        }, tl::anonymous());
+        m_pipelines_cv.notify_all();
     }
 
-    static void membershipUpdate(void* p, ssg_member_id_t member_id,
-            ssg_member_update_type_t update_type) {
-        auto provider = static_cast<ProviderImpl*>(p);
-        provider->_membershipUpdate(member_id, update_type);
+    void _waitUntilInactive() {
+        std::unique_lock<tl::mutex> lock(m_pipelines_mtx);
+        while(m_num_active_pipelines != 0) {
+            m_pipelines_cv.wait(lock);
+        }
     }
 };
 
@@ -0,0 +1,292 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/Redistribution.hpp"
+#include "colza/Exception.hpp"
+
+#include "ReduceOps.hpp"
+#include "TypeSizes.hpp"
+
+#include <cstring>
+
+namespace colza {
+
+namespace {
+
+// a region sent to another server is preceded by the index of the
+// target block and the lower and upper corners of the region
+size_t HeaderSize(size_t ndims) {
+    return sizeof(uint64_t)*(1 + 2*ndims);
+}
+
+// size of a region sent to another server; the data is padded to a
+// multiple of 8 bytes so that the next header and data, which Deliver
+// reads in place as elements of the type, stay aligned
+size_t MessageSize(size_t ndims, const Box& region, size_t element_size) {
+    const size_t align = sizeof(uint64_t);
+    const size_t data_size = region.volume()*element_size;
+    return HeaderSize(ndims) + (data_size + align - 1)/align*align;
+}
+
+char* WriteHeader(char* out, uint64_t index, const Box& region) {
+    std::memcpy(out, &index, sizeof(index));
+    out += sizeof(index);
+    std::memcpy(out, region.lower.data(), region.ndims()*sizeof(int64_t));
+    out += region.ndims()*sizeof(int64_t);
+    std::memcpy(out, region.upper.data(), region.ndims()*sizeof(int64_t));
+    out += region.ndims()*sizeof(int64_t);
+    return out;
+}
+
+const char* ReadHeader(const char* in, size_t ndims, uint64_t& index, Box& region) {
+    std::memcpy(&index, in, sizeof(index));
+    in += sizeof(index);
+    region.lower.resize(ndims);
+    region.upper.resize(ndims);
+    std::memcpy(region.lower.data(), in, ndims*sizeof(int64_t));
+    in += ndims*sizeof(int64_t);
+    std::memcpy(region.upper.data(), in, ndims*sizeof(int64_t));
+    in += ndims*sizeof(int64_t);
+    return in;
+}
+
+// splits [lower, upper) into n nearly equal parts, returns the i-th one
+std::pair<int64_t, int64_t> Split(int64_t lower, int64_t upper, size_t n, size_t i) {
+    int64_t len = upper - lower;
+    int64_t q = len / (int64_t)n, r = len % (int64_t)n;
+    int64_t lo = lower + (int64_t)i*q + std::min<int64_t>((int64_t)i, r);
+    int64_t hi = lo + q + ((int64_t)i < r ? 1 : 0);
+    return { lo, hi };
+}
+
+// makes the block own its data so that remote regions can be written to it
+void Materialize(RedistributedBlock& block, size_t element_size) {
+    if(!block.source) return;
+    auto begin = static_cast<const char*>(block.source);
+    block.storage.assign(begin, begin + block.box.volume()*element_size);
+    block.source = nullptr;
+}
+
+// writes region from a buffer covering src_box into the target block,
+// either overwriting its cells or combining them with op
+void Deliver(const void* src, const Box& src_box, RedistributedBlock& block,
+             const Box& region, Type type, size_t element_size,
+             const Communicator::ReduceOp* op) {
+    if(!op) {
+        Materialize(block, element_size);
+        CopyRegion(src, src_box, block.storage.data(), block.box, region, element_size);
+        return;
+    }
+    auto in  = static_cast<const char*>(src);
+    auto out = block.storage.data();
+    ForEachRun(src_box, block.box, region, element_size,
+        [&](size_t src_offset, size_t dst_offset, size_t size) {
+            ApplyOp(type, *op, in + src_offset, out + dst_offset, size/element_size);
+        });
+}
+
+}
+
+Decomposition Decomposition::Slabs(const Box& domain, size_t axis, int num_ranks) {
+    if(axis >= domain.ndims())
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Slab axis exceeds the number of dimensions of the domain");
+    if(num_ranks <= 0)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Invalid number of ranks for decomposition");
+    Decomposition result;
+    for(int i = 0; i < num_ranks; i++) {
+        Box box = domain;
+        auto range = Split(domain.lower[axis], domain.upper[axis], num_ranks, i);
+        box.lower[axis] = range.first;
+        box.upper[axis] = range.second;
+        result.boxes.push_back(std::move(box));
+        result.owners.push_back(i);
+    }
+    return result;
+}
+
+Decomposition Decomposition::Regular(const Box& domain,
+                                     const std::vector<size_t>& splits,
+                                     int num_ranks) {
+    if(splits.size() != domain.ndims())
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Regular decomposition expects one split count per dimension");
+    if(num_ranks <= 0)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Invalid number of ranks for decomposition");
+    size_t num_bricks = 1;
+    for(auto s : splits) {
+        if(s == 0)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Regular decomposition cannot have 0 splits along a dimension");
+        num_bricks *= s;
+    }
+    Decomposition result;
+    result.boxes.reserve(num_bricks);
+    result.owners.reserve(num_bricks);
+    const size_t n = domain.ndims();
+    std::vector<size_t> idx(n, 0);
+    for(size_t b = 0; b < num_bricks; b++) {
+        Box box = domain;
+        for(size_t d = 0; d < n; d++) {
+            auto range = Split(domain.lower[d], domain.upper[d], splits[d], idx[d]);
+            box.lower[d] = range.first;
+            box.upper[d] = range.second;
+        }
+        result.boxes.push_back(std::move(box));
+        result.owners.push_back((int)((b*(size_t)num_ranks)/num_bricks));
+        for(size_t d = n; d-- > 0;) {
+            if(++idx[d] < splits[d]) break;
+            idx[d] = 0;
+        }
+    }
+    return result;
+}
+
+namespace {
+
+std::vector<RedistributedBlock> RedistributeImpl(const Communicator& comm,
+                                                 const std::vector<LocalBlock>& blocks,
+                                                 const Decomposition& target,
+                                                 Type type,
+                                                 const Communicator::ReduceOp* op) {
+    const int n = comm.size(), r = comm.rank();
+    const size_t esize = ComputeDataSize({1}, type);
+    const size_t num_targets = target.boxes.size();
+    if(target.owners.size() != num_targets)
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "Decomposition should have one owner per block");
+    const size_t ndims = num_targets ? target.boxes[0].ndims() : 0;
+    for(size_t t = 0; t < num_targets; t++) {
+        if(target.boxes[t].ndims() != ndims)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Blocks of the decomposition have different numbers of dimensions");
+        if(target.owners[t] < 0 || target.owners[t] >= n)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Decomposition refers to a rank outside of the communicator");
+    }
+    for(const auto& block : blocks) {
+        if(block.box.ndims() != ndims)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Staged block and decomposition have different numbers of dimensions");
+    }
+
+    // allocate the target blocks owned locally, referencing staged blocks
+    // that coincide with them instead of copying (unless combining)
+    std::vector<RedistributedBlock> result;
+    std::vector<long> slot(num_targets, -1);
+    std::vector<long> borrowed(num_targets, -1);
+    for(size_t t = 0; t < num_targets; t++) {
+        if(target.owners[t] != r) continue;
+        slot[t] = (long)result.size();
+        result.emplace_back();
+        auto& out = result.back();
+        out.index = t;
+        out.box   = target.boxes[t];
+        for(size_t b = 0; b < blocks.size() && !op; b++) {
+            if(blocks[b].box == out.box && !out.box.empty()) {
+                out.source  = blocks[b].data;
+                borrowed[t] = (long)b;
+                break;
+            }
+        }
+        if(!out.source)
+            out.storage.resize(out.box.volume()*esize, 0);
+        if(op)
+            FillIdentity(type, *op, out.storage.data(), out.box.volume());
+    }
+
+    // local overlaps are copied directly; remote ones are sized for packing
+    std::vector<size_t> sendcounts(n, 0);
+    for(size_t b = 0; b < blocks.size(); b++) {
+        const auto& block = blocks[b];
+        if(block.box.empty()) continue;
+        for(size_t t = 0; t < num_targets; t++) {
+            if(borrowed[t] == (long)b) continue;
+            Box region = block.box.intersect(target.boxes[t]);
+            if(region.empty()) continue;
+            int owner = target.owners[t];
+            if(owner == r) {
+                Deliver(block.data, block.box, result[slot[t]], region, type, esize, op);
+            } else {
+                sendcounts[owner] += MessageSize(ndims, region, esize);
+            }
+        }
+    }
+    if(n == 1) return result;
+
+    std::vector<size_t> sdispls(n, 0);
+    for(int i = 1; i < n; i++)
+        sdispls[i] = sdispls[i-1] + sendcounts[i-1];
+    std::vector<char> sendbuf(sdispls[n-1] + sendcounts[n-1]);
+
+    // pack remote overlaps straight from the staged blocks
+    std::vector<size_t> pos = sdispls;
+    for(const auto& block : blocks) {
+        if(block.box.empty()) continue;
+        for(size_t t = 0; t < num_targets; t++) {
+            int owner = target.owners[t];
+            if(owner == r) continue;
+            Box region = block.box.intersect(target.boxes[t]);
+            if(region.empty()) continue;
+            char* out = WriteHeader(sendbuf.data() + pos[owner], t, region);
+            CopyRegion(block.data, block.box, out, region, region, esize);
+            pos[owner] += MessageSize(ndims, region, esize);
+        }
+    }
+
+    // exchange sizes, then data
+    std::vector<uint64_t> send_sizes(sendcounts.begin(), sendcounts.end());
+    std::vector<uint64_t> recv_sizes(n, 0);
+    std::vector<size_t> size_counts(n, sizeof(uint64_t));
+    std::vector<size_t> size_displs(n);
+    for(int i = 0; i < n; i++)
+        size_displs[i] = i*sizeof(uint64_t);
+    comm.alltoallv(send_sizes.data(), size_counts, size_displs,
+                   recv_sizes.data(), size_counts, size_displs);
+
+    std::vector<size_t> recvcounts(recv_sizes.begin(), recv_sizes.end());
+    std::vector<size_t> rdispls(n, 0);
+    for(int i = 1; i < n; i++)
+        rdispls[i] = rdispls[i-1] + recvcounts[i-1];
+    std::vector<char> recvbuf(rdispls[n-1] + recvcounts[n-1]);
+    comm.alltoallv(sendbuf.data(), sendcounts, sdispls,
+                   recvbuf.data(), recvcounts, rdispls);
+
+    // unpack the received regions into the target blocks
+    const char* in  = recvbuf.data();
+    const char* end = in + recvbuf.size();
+    while(in < end) {
+        uint64_t index = 0;
+        Box region;
+        const char* data = ReadHeader(in, ndims, index, region);
+        if(index >= num_targets || slot[index] < 0)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Received a region for a block not owned by this server");
+        Deliver(data, region, result[slot[index]], region, type, esize, op);
+        in += MessageSize(ndims, region, esize);
+    }
+    return result;
+}
+
+}
+
+std::vector<RedistributedBlock> Redistribute(const Communicator& comm,
+                                             const std::vector<LocalBlock>& blocks,
+                                             const Decomposition& target,
+                                             Type type) {
+    return RedistributeImpl(comm, blocks, target, type, nullptr);
+}
+
+std::vector<RedistributedBlock> Redistribute(const Communicator& comm,
+                                             const std::vector<LocalBlock>& blocks,
+                                             const Decomposition& target,
+                                             Type type,
+                                             Communicator::ReduceOp op) {
+    return RedistributeImpl(comm, blocks, target, type, &op);
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_REDUCE_OPS_HPP
+#define __COLZA_REDUCE_OPS_HPP
+
+#include "colza/Communicator.hpp"
+#include "TypeDispatch.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace colza {
+
+template<typename T>
+void ApplyOp(Communicator::ReduceOp op, const T* in, T* inout, size_t count) {
+    using ReduceOp = Communicator::ReduceOp;
+    switch(op) {
+        case ReduceOp::SUM:
+            for(size_t i = 0; i < count; i++) inout[i] = static_cast<T>(inout[i] + in[i]);
+            break;
+        case ReduceOp::PROD:
+            for(size_t i = 0; i < count; i++) inout[i] = static_cast<T>(inout[i] * in[i]);
+            break;
+        case ReduceOp::MIN:
+            for(size_t i = 0; i < count; i++) inout[i] = std::min(inout[i], in[i]);
+            break;
+        case ReduceOp::MAX:
+            for(size_t i = 0; i < count; i++) inout[i] = std::max(inout[i], in[i]);
+            break;
+    }
+}
+
+/**
+ * @brief Combines count elements of the given type: inout = in op inout.
+ */
+inline void ApplyOp(Type type, Communicator::ReduceOp op,
+                    const void* in, void* inout, size_t count) {
+    DispatchType(type, [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        ApplyOp(op, static_cast<const T*>(in), static_cast<T*>(inout), count);
+    });
+}
+
+/**
+ * @brief Fills count elements of the given type with the identity of
+ * the operation (0 for SUM, 1 for PROD, the largest value for MIN and
+ * the lowest one, or -infinity, for MAX).
+ */
+inline void FillIdentity(Type type, Communicator::ReduceOp op, void* out, size_t count) {
+    using ReduceOp = Communicator::ReduceOp;
+    DispatchType(type, [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        using limits = std::numeric_limits<T>;
+        T value = T(0);
+        switch(op) {
+            case ReduceOp::SUM:  value = T(0); break;
+            case ReduceOp::PROD: value = T(1); break;
+            case ReduceOp::MIN:
+                value = limits::has_infinity ? limits::infinity() : limits::max();
+                break;
+            case ReduceOp::MAX:
+                value = limits::has_infinity ? -limits::infinity() : limits::lowest();
+                break;
+        }
+        std::fill(static_cast<T*>(out), static_cast<T*>(out) + count, value);
+    });
+}
+
+}
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/SampleSort.hpp"
+#include "colza/Exception.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace colza {
+
+namespace {
+
+// number of samples contributed by each member, per member of the group
+constexpr size_t OVERSAMPLING = 16;
+// number of bits of the digits used by the radix sort
+constexpr unsigned RADIX_BITS = 8;
+constexpr size_t   RADIX_SIZE = 1 << RADIX_BITS;
+
+bool IsFloat(Type type) {
+    return type == Type::FLOAT32 || type == Type::FLOAT64;
+}
+
+bool IsSigned(Type type) {
+    return type == Type::INT8 || type == Type::INT16
+        || type == Type::INT32 || type == Type::INT64;
+}
+
+// maps the bits of a key to an unsigned integer with the same ordering
+template<typename U>
+U ToOrdered(U bits, Type type) {
+    const U msb = static_cast<U>(U(1) << (8*sizeof(U) - 1));
+    if(IsFloat(type))
+        return (bits & msb) ? static_cast<U>(~bits) : static_cast<U>(bits | msb);
+    if(IsSigned(type))
+        return static_cast<U>(bits ^ msb);
+    return bits;
+}
+
+template<typename U>
+U FromOrdered(U key, Type type) {
+    const U msb = static_cast<U>(U(1) << (8*sizeof(U) - 1));
+    if(IsFloat(type))
+        return (key & msb) ? static_cast<U>(key ^ msb) : static_cast<U>(~key);
+    if(IsSigned(type))
+        return static_cast<U>(key ^ msb);
+    return key;
+}
+
+/**
+ * Stable LSD radix sort of keys, applying the same permutation to perm.
+ * The histograms of all the digits are computed in a single pass, and
+ * passes in which all the keys share the same digit are skipped.
+ */
+template<typename U>
+void RadixSort(std::vector<U>& keys, std::vector<uint64_t>& perm) {
+    const size_t n = keys.size();
+    constexpr size_t passes = sizeof(U)*8/RADIX_BITS;
+    if(n < 2) return;
+    std::vector<size_t> hist(passes*RADIX_SIZE, 0);
+    for(auto k : keys)
+        for(size_t p = 0; p < passes; p++)
+            hist[p*RADIX_SIZE + ((k >> (p*RADIX_BITS)) & (RADIX_SIZE-1))] += 1;
+    std::vector<U> tmp_keys(n);
+    std::vector<uint64_t> tmp_perm(n);
+    for(size_t p = 0; p < passes; p++) {
+        size_t* h = hist.data() + p*RADIX_SIZE;
+        const unsigned shift = p*RADIX_BITS;
+        if(h[(keys[0] >> shift) & (RADIX_SIZE-1)] == n) continue;
+        size_t sum = 0;
+        for(size_t b = 0; b < RADIX_SIZE; b++) {
+            size_t c = h[b];
+            h[b] = sum;
+            sum += c;
+        }
+        for(size_t i = 0; i < n; i++) {
+            size_t pos = h[(keys[i] >> shift) & (RADIX_SIZE-1)]++;
+            tmp_keys[pos] = keys[i];
+            tmp_perm[pos] = perm[i];
+        }
+        keys.swap(tmp_keys);
+        perm.swap(tmp_perm);
+    }
+}
+
+// sampled key with its origin (rank and position), used to break ties
+struct Sample {
+    uint64_t key;
+    uint64_t origin;
+    double   weight;
+};
+
+inline uint64_t Origin(int rank, size_t position) {
+    return (static_cast<uint64_t>(rank) << 40) | position;
+}
+
+inline bool operator<(const Sample& a, const Sample& b) {
+    return a.key < b.key || (a.key == b.key && a.origin < b.origin);
+}
+
+std::vector<Sample> SelectSplitters(const Communicator& comm,
+                                    const std::vector<Sample>& local) {
+    const int n = comm.size();
+    std::vector<Sample> all(local.size()*n);
+    comm.allgather(local.data(), local.size()*sizeof(Sample), all.data());
+    all.erase(std::remove_if(all.begin(), all.end(),
+                             [](const Sample& s) { return s.weight == 0.0; }),
+              all.end());
+    std::sort(all.begin(), all.end());
+    double total = 0.0;
+    for(const auto& s : all) total += s.weight;
+    std::vector<Sample> splitters;
+    if(all.empty()) return splitters;
+    double acc = 0.0;
+    size_t k = 0;
+    for(int j = 1; j < n; j++) {
+        double target = total*j/n;
+        while(k + 1 < all.size() && acc + all[k].weight < target) {
+            acc += all[k].weight;
+            k += 1;
+        }
+        splitters.push_back(all[k]);
+    }
+    return splitters;
+}
+
+template<typename U>
+SortedPartition SortAs(const Communicator& comm,
+                       const std::vector<SortInput>& inputs,
+                       Type type, size_t value_size) {
+    const int n = comm.size(), r = comm.rank();
+
+    // convert the keys and sort them locally
+    size_t count = 0;
+    std::vector<size_t> starts;
+    for(const auto& input : inputs) {
+        starts.push_back(count);
+        count += input.count;
+    }
+    if(count >= (size_t(1) << 40))
+        throw Exception(ErrorCode::OTHER_ERROR,
+            "SampleSort cannot sort more than 2^40 keys per server");
+    std::vector<U> keys;
+    keys.reserve(count);
+    for(const auto& input : inputs) {
+        auto p = static_cast<const char*>(input.keys);
+        for(size_t i = 0; i < input.count; i++) {
+            U bits;
+            std::memcpy(&bits, p + i*sizeof(U), sizeof(U));
+            keys.push_back(ToOrdered(bits, type));
+        }
+    }
+    std::vector<uint64_t> perm(count);
+    std::iota(perm.begin(), perm.end(), 0);
+    RadixSort(keys, perm);
+
+    auto value_of = [&](uint64_t index) -> const char* {
+        size_t b = std::upper_bound(starts.begin(), starts.end(), index) - starts.begin() - 1;
+        if(!inputs[b].values) return nullptr;
+        return static_cast<const char*>(inputs[b].values) + (index - starts[b])*value_size;
+    };
+
+    // pick regular samples and select splitters
+    const size_t num_samples = OVERSAMPLING*n;
+    std::vector<Sample> samples(num_samples, Sample{0, 0, 0.0});
+    if(count != 0) {
+        for(size_t k = 0; k < num_samples; k++) {
+            size_t pos = ((2*k + 1)*count)/(2*num_samples);
+            samples[k] = Sample{ keys[pos], Origin(r, pos), (double)count/num_samples };
+        }
+    }
+    auto splitters = n > 1 ? SelectSplitters(comm, samples) : std::vector<Sample>();
+
+    // partition the sorted keys
+    std::vector<size_t> bounds(n + 1, 0);
+    bounds[n] = count;
+    for(int j = 1; j < n; j++) {
+        if(splitters.empty()) {
+            bounds[j] = count;
+            continue;
+        }
+        const Sample& s = splitters[j-1];
+        size_t lo = bounds[j-1], hi = count;
+        while(lo < hi) {
+            size_t mid = lo + (hi - lo)/2;
+            if(Sample{ keys[mid], Origin(r, mid), 0.0 } < s) lo = mid + 1;
+            else hi = mid;
+        }
+        bounds[j] = lo;
+    }
+
+    // exchange counts, then keys and values
+    std::vector<uint64_t> send_counts(n), recv_counts(n);
+    for(int i = 0; i < n; i++)
+        send_counts[i] = bounds[i+1] - bounds[i];
+    std::vector<size_t> unit(n, sizeof(uint64_t)), unit_displs(n);
+    for(int i = 0; i < n; i++)
+        unit_displs[i] = i*sizeof(uint64_t);
+    if(n > 1) {
+        comm.alltoallv(send_counts.data(), unit, unit_displs,
+                       recv_counts.data(), unit, unit_displs);
+    } else {
+        recv_counts = send_counts;
+    }
+
+    std::vector<size_t> sendcounts(n), sdispls(n), recvcounts(n), rdispls(n);
+    size_t total = 0;
+    for(int i = 0; i < n; i++) {
+        sendcounts[i] = send_counts[i]*sizeof(U);
+        sdispls[i]    = bounds[i]*sizeof(U);
+        recvcounts[i] = recv_counts[i]*sizeof(U);
+        rdispls[i]    = total*sizeof(U);
+        total += recv_counts[i];
+    }
+    std::vector<U> rkeys(total);
+    comm.alltoallv(keys.data(), sendcounts, sdispls,
+                   rkeys.data(), recvcounts, rdispls);
+
+    std::vector<char> rvalues;
+    if(value_size != 0) {
+        std::vector<char> svalues(count*value_size);
+        for(size_t i = 0; i < count; i++) {
+            const char* v = value_of(perm[i]);
+            if(v) std::memcpy(svalues.data() + i*value_size, v, value_size);
+        }
+        for(int i = 0; i < n; i++) {
+            sendcounts[i] = send_counts[i]*value_size;
+            sdispls[i]    = bounds[i]*value_size;
+            recvcounts[i] = recv_counts[i]*value_size;
+            rdispls[i]    = (rdispls[i]/sizeof(U))*value_size;
+        }
+        rvalues.resize(total*value_size);
+        comm.alltoallv(svalues.data(), sendcounts, sdispls,
+                       rvalues.data(), recvcounts, rdispls);
+    }
+    keys = std::vector<U>();
+    perm = std::vector<uint64_t>();
+
+    // the received runs are sorted; the radix sort being stable, equal
+    // keys remain ordered by origin
+    std::vector<uint64_t> rperm(total);
+    std::iota(rperm.begin(), rperm.end(), 0);
+    if(n > 1) RadixSort(rkeys, rperm);
+
+    SortedPartition result;
+    result.count = total;
+    result.keys.resize(total*sizeof(U));
+    for(size_t i = 0; i < total; i++) {
+        U bits = FromOrdered(rkeys[i], type);
+        std::memcpy(result.keys.data() + i*sizeof(U), &bits, sizeof(U));
+    }
+    if(value_size != 0) {
+        result.values.resize(total*value_size);
+        for(size_t i = 0; i < total; i++)
+            std::memcpy(result.values.data() + i*value_size,
+                        rvalues.data() + rperm[i]*value_size, value_size);
+    }
+    return result;
+}
+
+}
+
+SortedPartition SampleSort(const Communicator& comm,
+                           const std::vector<SortInput>& inputs,
+                           Type type,
+                           size_t value_size) {
+    switch(type) {
+        case Type::INT8:
+        case Type::UINT8:
+            return SortAs<uint8_t>(comm, inputs, type, value_size);
+        case Type::INT16:
+        case Type::UINT16:
+            return SortAs<uint16_t>(comm, inputs, type, value_size);
+        case Type::INT32:
+        case Type::UINT32:
+        case Type::FLOAT32:
+            return SortAs<uint32_t>(comm, inputs, type, value_size);
+        case Type::INT64:
+        case Type::UINT64:
+        case Type::FLOAT64:
+            return SortAs<uint64_t>(comm, inputs, type, value_size);
+    }
+    throw Exception(ErrorCode::OTHER_ERROR, "Invalid type");
+}
+
+}
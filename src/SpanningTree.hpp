@@ -0,0 +1,49 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_SPANNING_TREE_HPP
+#define __COLZA_SPANNING_TREE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief Ranks [first_rank, last_rank] of the group forming a subtree
+ * of the spanning tree used to propagate group-wide operations, the
+ * root of the subtree being first_rank.
+ */
+struct SubtreeRange {
+    int32_t first_rank;
+    int32_t last_rank;
+};
+
+/**
+ * @brief Splits the ranks (first_rank, last_rank] into at most fanout
+ * contiguous ranges of sizes differing by at most one, each of which
+ * is the subtree of a child of first_rank. Applied recursively, this
+ * gives a tree of depth logarithmic in the size of the group.
+ */
+inline static std::vector<SubtreeRange> SubtreeRanges(int32_t first_rank,
+                                                      int32_t last_rank,
+                                                      int32_t fanout) {
+    std::vector<SubtreeRange> ranges;
+    int32_t remaining = last_rank - first_rank;
+    if(remaining <= 0 || fanout <= 0) return ranges;
+    int32_t num_children = std::min(remaining, fanout);
+    int32_t start = first_rank + 1;
+    for(int32_t i = 0; i < num_children; i++) {
+        int32_t count = remaining / num_children + (i < remaining % num_children ? 1 : 0);
+        ranges.push_back(SubtreeRange{ start, start + count - 1 });
+        start += count;
+    }
+    return ranges;
+}
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "colza/TaskRuntime.hpp"
+#include "colza/Exception.hpp"
+
+#include <abt.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+namespace colza {
+
+namespace {
+
+// number of chunks per worker when parallelFor chooses the grain,
+// so that faster workers can take over the chunks of slower ones
+constexpr size_t CHUNKS_PER_WORKER = 4;
+
+// used when the caller does not know how many execution streams serve
+// the pool: Argobots cannot tell, so count all those of the process
+size_t DefaultConcurrency() {
+    int num_xstreams = 0;
+    if(ABT_xstream_get_num(&num_xstreams) != ABT_SUCCESS || num_xstreams < 1)
+        return 1;
+    return num_xstreams;
+}
+
+// first exception thrown by the tasks of a loop or graph
+class FirstError {
+
+    tl::mutex          m_mtx;
+    std::exception_ptr m_error;
+    std::atomic<bool>  m_failed{false};
+
+    public:
+
+    void record(std::exception_ptr error) {
+        std::lock_guard<tl::mutex> lock(m_mtx);
+        if(!m_error) m_error = error;
+        m_failed = true;
+    }
+
+    bool failed() const {
+        return m_failed;
+    }
+
+    void rethrow() {
+        if(m_error) std::rethrow_exception(m_error);
+    }
+};
+
+}
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> task,
+                                 const std::vector<TaskId>& after) {
+    const TaskId id = m_tasks.size();
+    for(auto predecessor : after) {
+        if(predecessor >= id)
+            throw Exception(ErrorCode::OTHER_ERROR,
+                "Task depends on a task that is not in the graph");
+    }
+    for(auto predecessor : after)
+        m_tasks[predecessor].successors.push_back(id);
+    Task t;
+    t.function = std::move(task);
+    t.num_predecessors = after.size();
+    m_tasks.push_back(std::move(t));
+    return id;
+}
+
+TaskRuntime::TaskRuntime(const tl::pool& pool, size_t concurrency)
+: m_pool(pool)
+, m_concurrency(concurrency != 0 ? concurrency : DefaultConcurrency()) {}
+
+void TaskRuntime::parallelFor(size_t begin, size_t end, size_t grain,
+                              const RangeFunction& body) const {
+    if(begin >= end) return;
+    const size_t n = end - begin;
+    if(grain == 0)
+        grain = std::max<size_t>(1, n / (m_concurrency * CHUNKS_PER_WORKER));
+    const size_t num_chunks = (n - 1) / grain + 1;
+    const size_t num_workers = std::min(m_concurrency, num_chunks);
+
+    std::atomic<size_t> next{0};
+    FirstError error;
+    auto work = [&]() {
+        while(!error.failed()) {
+            size_t chunk = next.fetch_add(1);
+            if(chunk >= num_chunks) return;
+            size_t b = begin + chunk * grain;
+            size_t e = b + std::min(grain, end - b);
+            try {
+                body(b, e);
+            } catch(...) {
+                error.record(std::current_exception());
+            }
+        }
+    };
+    std::vector<tl::managed<tl::thread>> workers;
+    for(size_t i = 1; i < num_workers; i++)
+        workers.push_back(m_pool.make_thread(work));
+    work();
+    for(auto& worker : workers)
+        worker->join();
+    error.rethrow();
+}
+
+void TaskRuntime::run(const TaskGraph& graph) const {
+    const auto& tasks = graph.m_tasks;
+    if(tasks.empty()) return;
+
+    std::vector<size_t> remaining(tasks.size());
+    std::deque<TaskGraph::TaskId> ready;
+    for(size_t i = 0; i < tasks.size(); i++) {
+        remaining[i] = tasks[i].num_predecessors;
+        if(remaining[i] == 0) ready.push_back(i);
+    }
+    size_t running = 0;
+    tl::mutex mtx;
+    tl::condition_variable cv;
+    FirstError error;
+    // a worker leaves when no task is ready and none is running, which
+    // happens once all the tasks have run or once one of them failed
+    auto work = [&]() {
+        std::unique_lock<tl::mutex> lock(mtx);
+        while(true) {
+            while(ready.empty() && running != 0)
+                cv.wait(lock);
+            if(ready.empty()) return;
+            auto id = ready.front();
+            ready.pop_front();
+            running += 1;
+            lock.unlock();
+            try {
+                tasks[id].function();
+            } catch(...) {
+                error.record(std::current_exception());
+            }
+            lock.lock();
+            running -= 1;
+            if(error.failed()) {
+                ready.clear();
+            } else {
+                for(auto successor : tasks[id].successors) {
+                    if(--remaining[successor] == 0)
+                        ready.push_back(successor);
+                }
+            }
+            cv.notify_all();
+        }
+    };
+    const size_t num_workers = std::min(m_concurrency, tasks.size());
+    std::vector<tl::managed<tl::thread>> workers;
+    for(size_t i = 1; i < num_workers; i++)
+        workers.push_back(m_pool.make_thread(work));
+    work();
+    for(auto& worker : workers)
+        worker->join();
+    error.rethrow();
+}
+
+}
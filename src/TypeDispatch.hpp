@@ -0,0 +1,44 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_TYPE_DISPATCH_HPP
+#define __COLZA_TYPE_DISPATCH_HPP
+
+#include <colza/Types.hpp>
+#include <colza/Exception.hpp>
+#include <cstdint>
+
+namespace colza {
+
+template<typename T>
+struct TypeTag {
+    using type = T;
+};
+
+/**
+ * @brief Calls f(TypeTag<T>()) where T is the C++ type corresponding
+ * to the given colza::Type, so that kernels written as generic lambdas
+ * are instantiated (and vectorized) for every type.
+ */
+template<typename F>
+auto DispatchType(Type type, F&& f) -> decltype(f(TypeTag<int8_t>())) {
+    switch(type) {
+        case Type::INT8:    return f(TypeTag<int8_t>());
+        case Type::UINT8:   return f(TypeTag<uint8_t>());
+        case Type::INT16:   return f(TypeTag<int16_t>());
+        case Type::UINT16:  return f(TypeTag<uint16_t>());
+        case Type::INT32:   return f(TypeTag<int32_t>());
+        case Type::UINT32:  return f(TypeTag<uint32_t>());
+        case Type::INT64:   return f(TypeTag<int64_t>());
+        case Type::UINT64:  return f(TypeTag<uint64_t>());
+        case Type::FLOAT32: return f(TypeTag<float>());
+        case Type::FLOAT64: return f(TypeTag<double>());
+    }
+    throw Exception(ErrorCode::OTHER_ERROR, "Invalid type");
+}
+
+}
+
+#endif
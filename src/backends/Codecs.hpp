@@ -0,0 +1,397 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_CODECS_HPP
+#define __COLZA_CODECS_HPP
+
+#include <colza/Exception.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief Transposes the bytes of count elements of element_size bytes,
+ * so that the i-th bytes of all the elements are contiguous. Exponents
+ * and high-order bytes of neighboring values, which are often equal,
+ * then form long runs that a byte-oriented codec compresses well.
+ */
+inline void ByteShuffle(const void* in, size_t count, size_t element_size, void* out) {
+    auto src = static_cast<const uint8_t*>(in);
+    auto dst = static_cast<uint8_t*>(out);
+    for(size_t b = 0; b < element_size; b++)
+        for(size_t i = 0; i < count; i++)
+            dst[b*count + i] = src[i*element_size + b];
+}
+
+/**
+ * @brief Inverse of ByteShuffle.
+ */
+inline void ByteUnshuffle(const void* in, size_t count, size_t element_size, void* out) {
+    auto src = static_cast<const uint8_t*>(in);
+    auto dst = static_cast<uint8_t*>(out);
+    for(size_t b = 0; b < element_size; b++)
+        for(size_t i = 0; i < count; i++)
+            dst[i*element_size + b] = src[b*count + i];
+}
+
+namespace lz {
+
+constexpr size_t MIN_MATCH  = 4;
+constexpr size_t HASH_BITS  = 14;
+constexpr size_t MAX_OFFSET = 65535;
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+inline void PutLength(std::vector<uint8_t>& out, size_t len) {
+    while(len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(len));
+}
+
+inline size_t GetLength(const uint8_t*& in, const uint8_t* end) {
+    size_t len = 0;
+    uint8_t b = 255;
+    while(b == 255) {
+        if(in == end)
+            throw Exception(ErrorCode::OTHER_ERROR, "Truncated LZ stream");
+        b = *in++;
+        len += b;
+    }
+    return len;
+}
+
+inline void PutSequence(std::vector<uint8_t>& out, const uint8_t* literals,
+                        size_t num_literals, size_t offset, size_t match) {
+    size_t lit_code   = std::min<size_t>(num_literals, 15);
+    size_t match_code = match ? std::min<size_t>(match - MIN_MATCH, 15) : 0;
+    out.push_back(static_cast<uint8_t>((lit_code << 4) | match_code));
+    if(lit_code == 15) PutLength(out, num_literals - 15);
+    out.insert(out.end(), literals, literals + num_literals);
+    if(match == 0) return;
+    out.push_back(static_cast<uint8_t>(offset & 0xFF));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if(match_code == 15) PutLength(out, match - MIN_MATCH - 15);
+}
+
+}
+
+/**
+ * @brief Compresses size bytes with a greedy LZ77 codec in the spirit
+ * of LZ4: a sequence is a token (literal and match length nibbles),
+ * extended lengths, literals, and a 16-bit match offset. Matches are
+ * found through a hash table of 4-byte prefixes. The stream ends with
+ * a sequence made only of literals.
+ */
+inline void LZCompress(const void* data, size_t size, std::vector<uint8_t>& out) {
+    using namespace lz;
+    auto in = static_cast<const uint8_t*>(data);
+    out.reserve(out.size() + size + size/255 + 16);
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    size_t anchor = 0, i = 0;
+    while(i + MIN_MATCH <= size) {
+        uint32_t seq = Read32(in + i);
+        uint32_t h = Hash(seq);
+        size_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(i);
+        if(candidate < i && i - candidate <= MAX_OFFSET && Read32(in + candidate) == seq) {
+            size_t match = MIN_MATCH;
+            while(i + match < size && in[candidate + match] == in[i + match]) match++;
+            PutSequence(out, in + anchor, i - anchor, i - candidate, match);
+            i += match;
+            anchor = i;
+        } else {
+            i++;
+        }
+    }
+    PutSequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+/**
+ * @brief Decompresses a stream produced by LZCompress into size bytes.
+ */
+inline void LZDecompress(const uint8_t* in, size_t in_size, void* data, size_t size) {
+    using namespace lz;
+    auto out = static_cast<uint8_t*>(data);
+    const uint8_t* end = in + in_size;
+    size_t pos = 0;
+    while(in < end) {
+        uint8_t token = *in++;
+        size_t num_literals = token >> 4;
+        if(num_literals == 15) num_literals += GetLength(in, end);
+        if((size_t)(end - in) < num_literals || size - pos < num_literals)
+            throw Exception(ErrorCode::OTHER_ERROR, "Corrupted LZ stream");
+        std::memcpy(out + pos, in, num_literals);
+        in  += num_literals;
+        pos += num_literals;
+        if(in == end) break;
+        if(end - in < 2)
+            throw Exception(ErrorCode::OTHER_ERROR, "Truncated LZ stream");
+        size_t offset = in[0] | (size_t(in[1]) << 8);
+        in += 2;
+        size_t match = (token & 0xF) + MIN_MATCH;
+        if((token & 0xF) == 15) match += GetLength(in, end);
+        if(offset == 0 || offset > pos || size - pos < match)
+            throw Exception(ErrorCode::OTHER_ERROR, "Corrupted LZ stream");
+        // byte by byte, since the match may overlap its own output
+        for(size_t k = 0; k < match; k++, pos++)
+            out[pos] = out[pos - offset];
+    }
+    if(pos != size)
+        throw Exception(ErrorCode::OTHER_ERROR, "LZ stream has an unexpected size");
+}
+
+/**
+ * @brief Canonical Huffman coder for symbols in [0, num_symbols).
+ * Code lengths are limited to MAX_BITS by flattening the frequencies
+ * until the tree is shallow enough.
+ */
+class HuffmanCoder {
+
+    public:
+
+    static constexpr unsigned MAX_BITS = 24;
+
+    private:
+
+    std::vector<uint8_t>  m_lengths; // code length of each symbol (0 if unused)
+    std::vector<uint32_t> m_codes;
+
+    static std::vector<uint8_t> Lengths(std::vector<uint64_t> freq) {
+        const size_t n = freq.size();
+        std::vector<uint8_t> lengths(n, 0);
+        while(true) {
+            using Node = std::pair<uint64_t, size_t>;
+            std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+            std::vector<size_t> parent;
+            for(size_t s = 0; s < n; s++)
+                if(freq[s]) heap.emplace(freq[s], s);
+            if(heap.empty()) return lengths;
+            if(heap.size() == 1) {
+                lengths[heap.top().second] = 1;
+                return lengths;
+            }
+            // nodes 0..n-1 are the symbols, the next ones internal nodes
+            parent.assign(n, 0);
+            while(heap.size() > 1) {
+                auto a = heap.top(); heap.pop();
+                auto b = heap.top(); heap.pop();
+                size_t node = parent.size();
+                parent.push_back(0);
+                parent[a.second] = node;
+                parent[b.second] = node;
+                heap.emplace(a.first + b.first, node);
+            }
+            const size_t root = parent.size() - 1;
+            std::vector<uint8_t> depth(parent.size(), 0);
+            unsigned max_depth = 0;
+            for(size_t node = root; node-- > 0;) {
+                if(node < n && !freq[node]) continue;
+                depth[node] = depth[parent[node]] + 1;
+                if(node < n) max_depth = std::max<unsigned>(max_depth, depth[node]);
+            }
+            if(max_depth <= MAX_BITS) {
+                for(size_t s = 0; s < n; s++)
+                    lengths[s] = freq[s] ? depth[s] : 0;
+                return lengths;
+            }
+            for(auto& f : freq)
+                if(f) f = (f + 1)/2;
+        }
+    }
+
+    void assignCodes() {
+        const size_t n = m_lengths.size();
+        std::vector<size_t> order;
+        for(size_t s = 0; s < n; s++)
+            if(m_lengths[s]) order.push_back(s);
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return m_lengths[a] != m_lengths[b] ? m_lengths[a] < m_lengths[b] : a < b;
+        });
+        m_codes.assign(n, 0);
+        uint32_t code = 0;
+        unsigned len = order.empty() ? 0 : m_lengths[order[0]];
+        for(auto s : order) {
+            code <<= (m_lengths[s] - len);
+            len = m_lengths[s];
+            m_codes[s] = code++;
+        }
+    }
+
+    public:
+
+    HuffmanCoder() = default;
+
+    /**
+     * @brief Builds the code from the frequency of each symbol.
+     */
+    explicit HuffmanCoder(const std::vector<uint64_t>& frequencies)
+    : m_lengths(Lengths(frequencies)) {
+        assignCodes();
+    }
+
+    /**
+     * @brief Builds the code from code lengths (e.g. read from a stream).
+     */
+    explicit HuffmanCoder(std::vector<uint8_t> lengths)
+    : m_lengths(std::move(lengths)) {
+        for(auto l : m_lengths)
+            if(l > MAX_BITS)
+                throw Exception(ErrorCode::OTHER_ERROR, "Invalid Huffman code length");
+        assignCodes();
+    }
+
+    const std::vector<uint8_t>& lengths() const {
+        return m_lengths;
+    }
+
+    /**
+     * @brief Appends the codes of the symbols to out, most significant
+     * bit first, padding the last byte with zeros.
+     */
+    void encode(const uint32_t* symbols, size_t count, std::vector<uint8_t>& out) const {
+        uint64_t bits = 0;
+        unsigned num_bits = 0;
+        for(size_t i = 0; i < count; i++) {
+            auto s = symbols[i];
+            bits = (bits << m_lengths[s]) | m_codes[s];
+            num_bits += m_lengths[s];
+            while(num_bits >= 8) {
+                num_bits -= 8;
+                out.push_back(static_cast<uint8_t>(bits >> num_bits));
+            }
+        }
+        if(num_bits)
+            out.push_back(static_cast<uint8_t>(bits << (8 - num_bits)));
+    }
+
+    /**
+     * @brief Decodes count symbols from in, returns the end of the
+     * encoded bits.
+     */
+    const uint8_t* decode(const uint8_t* in, const uint8_t* end,
+                          uint32_t* symbols, size_t count) const {
+        // canonical decoding tables: first code and first symbol index
+        // of each length
+        std::vector<size_t> order;
+        for(size_t s = 0; s < m_lengths.size(); s++)
+            if(m_lengths[s]) order.push_back(s);
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return m_lengths[a] != m_lengths[b] ? m_lengths[a] < m_lengths[b] : a < b;
+        });
+        std::vector<uint32_t> num(MAX_BITS + 1, 0), first(MAX_BITS + 2, 0), index(MAX_BITS + 2, 0);
+        for(auto s : order) num[m_lengths[s]]++;
+        uint32_t code = 0, idx = 0;
+        for(unsigned l = 1; l <= MAX_BITS; l++) {
+            code = (code + num[l-1]) << 1;
+            first[l] = code;
+            index[l] = idx;
+            idx += num[l];
+        }
+        size_t bit = 0;
+        const size_t total_bits = (size_t)(end - in)*8;
+        for(size_t i = 0; i < count; i++) {
+            uint32_t c = 0;
+            unsigned l = 0;
+            while(true) {
+                if(bit == total_bits || l == MAX_BITS)
+                    throw Exception(ErrorCode::OTHER_ERROR, "Corrupted Huffman stream");
+                c = (c << 1) | ((in[bit >> 3] >> (7 - (bit & 7))) & 1);
+                bit++;
+                l++;
+                if(num[l] && c - first[l] < num[l]) {
+                    symbols[i] = static_cast<uint32_t>(order[index[l] + (c - first[l])]);
+                    break;
+                }
+            }
+        }
+        return in + (bit + 7)/8;
+    }
+};
+
+/**
+ * @brief Error-bounded quantizer with a Lorenzo (previous value)
+ * predictor, as in SZ. Each value is predicted from the reconstruction
+ * of the previous one and the difference is quantized into 2*RADIUS
+ * bins of width 2*error_bound; values whose bin falls outside of this
+ * range, or whose reconstruction would exceed the bound because of
+ * rounding, are stored verbatim and coded as symbol 0.
+ */
+template<typename T>
+struct Quantizer {
+
+    static constexpr int64_t RADIUS = 32768;
+    static constexpr size_t  NUM_SYMBOLS = 2*RADIUS;
+
+    /**
+     * @brief Quantizes n values, filling symbols (n entries) and
+     * outliers. Returns the maximum reconstruction error.
+     */
+    static double Quantize(const T* x, size_t n, double error_bound,
+                           uint32_t* symbols, std::vector<T>& outliers) {
+        const double width = 2*error_bound;
+        double max_error = 0.0;
+        T prediction = T(0);
+        for(size_t i = 0; i < n; i++) {
+            double diff = (double)x[i] - (double)prediction;
+            double q = std::nearbyint(diff/width);
+            if(std::isfinite(q) && std::fabs(q) < RADIUS) {
+                T reconstructed = static_cast<T>((double)prediction + q*width);
+                double error = std::fabs((double)reconstructed - (double)x[i]);
+                if(error <= error_bound) {
+                    symbols[i] = static_cast<uint32_t>((int64_t)q + RADIUS);
+                    max_error  = std::max(max_error, error);
+                    prediction = reconstructed;
+                    continue;
+                }
+            }
+            symbols[i] = 0;
+            outliers.push_back(x[i]);
+            prediction = x[i];
+        }
+        return max_error;
+    }
+
+    /**
+     * @brief Reconstructs n values from their symbols and outliers.
+     */
+    static void Dequantize(const uint32_t* symbols, size_t n, double error_bound,
+                           const T* outliers, size_t num_outliers, T* x) {
+        const double width = 2*error_bound;
+        T prediction = T(0);
+        size_t o = 0;
+        for(size_t i = 0; i < n; i++) {
+            if(symbols[i] == 0) {
+                if(o == num_outliers)
+                    throw Exception(ErrorCode::OTHER_ERROR, "Missing outliers in quantized stream");
+                prediction = outliers[o++];
+            } else {
+                double q = (double)((int64_t)symbols[i] - RADIUS);
+                prediction = static_cast<T>((double)prediction + q*width);
+            }
+            x[i] = prediction;
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,372 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "CompositePipeline.hpp"
+#include <colza/Exception.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+COLZA_REGISTER_BACKEND(composite, colza::CompositePipeline);
+
+namespace colza {
+
+void CompositePipeline::onConfigure(const json& config) {
+    if(!config.contains("stages") || !config["stages"].is_array() || config["stages"].empty())
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "Composite pipeline requires a non-empty array of \"stages\"");
+    const auto& stages = config["stages"];
+    const size_t n = stages.size();
+    if(n > Communicator::MAX_DERIVED)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "Composite pipeline supports at most "
+            + std::to_string(Communicator::MAX_DERIVED) + " stages");
+    std::vector<Stage> parsed(n);
+    std::vector<json> configs(n);
+    std::map<std::string, size_t> indices;
+    for(size_t i = 0; i < n; i++) {
+        const auto& s = stages[i];
+        if(!s.is_object())
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR, "Stages should be objects");
+        auto& stage = parsed[i];
+        stage.name = s.value("name", std::string());
+        stage.type = s.value("type", std::string());
+        if(stage.name.empty() || stage.name.find('/') != std::string::npos)
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Stages should have a \"name\" without '/'");
+        if(stage.type.empty() || stage.type == "composite")
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Stage " + stage.name + " should have a non-composite \"type\"");
+        if(!indices.emplace(stage.name, i).second)
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Stage " + stage.name + " is defined more than once");
+        if(s.contains("datasets"))
+            stage.datasets = s["datasets"].get<std::vector<std::string>>();
+        std::sort(stage.datasets.begin(), stage.datasets.end());
+        configs[i] = s.value("config", json::object());
+    }
+    for(size_t i = 0; i < n; i++) {
+        if(!stages[i].contains("after")) continue;
+        for(auto& name : stages[i]["after"].get<std::vector<std::string>>()) {
+            auto it = indices.find(name);
+            if(it == indices.end())
+                throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                    "Stage " + parsed[i].name + " comes after unknown stage " + name);
+            parsed[i].after.push_back(it->second);
+        }
+    }
+    // the stages can be ordered only if their dependencies have no cycle
+    std::vector<size_t> pending(n), ready;
+    for(size_t i = 0; i < n; i++) {
+        pending[i] = parsed[i].after.size();
+        if(pending[i] == 0) ready.push_back(i);
+    }
+    size_t ordered = 0;
+    while(!ready.empty()) {
+        size_t i = ready.back();
+        ready.pop_back();
+        ordered += 1;
+        for(size_t j = 0; j < n; j++)
+            for(auto p : parsed[j].after)
+                if(p == i && --pending[j] == 0) ready.push_back(j);
+    }
+    if(ordered != n)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "The dependencies of the stages should not have cycles");
+
+    std::lock_guard<tl::mutex> g(m_stages_mtx);
+    if(m_stages.empty()) {
+        PipelineFactoryArgs args;
+        args.gid    = m_gid;
+        args.engine = m_engine;
+        args.pool   = m_pool;
+        args.concurrency = m_tasks.concurrency();
+        for(size_t i = 0; i < n; i++) {
+            args.config = configs[i];
+            parsed[i].backend = PipelineFactory::createPipeline(parsed[i].type, args);
+            if(!parsed[i].backend)
+                throw Exception(ErrorCode::PIPELINE_CREATE_ERROR,
+                    "Unknown pipeline type " + parsed[i].type + " for stage " + parsed[i].name);
+        }
+        m_stages = std::move(parsed);
+        return;
+    }
+    if(n != m_stages.size())
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "Reconfiguring a composite pipeline cannot change its stages");
+    for(size_t i = 0; i < n; i++) {
+        if(parsed[i].name != m_stages[i].name || parsed[i].type != m_stages[i].type)
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Reconfiguring a composite pipeline cannot change its stages");
+    }
+    for(size_t i = 0; i < n; i++) {
+        auto result = m_stages[i].backend->reconfigure(configs[i]);
+        if(!result.success())
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Stage " + m_stages[i].name + ": " + result.error());
+    }
+    for(size_t i = 0; i < n; i++) {
+        m_stages[i].datasets = std::move(parsed[i].datasets);
+        m_stages[i].after    = std::move(parsed[i].after);
+    }
+}
+
+void CompositePipeline::updateMonaAddresses(
+        mona_instance_t mona,
+        const std::vector<na_addr_t>& addresses) {
+    StagingPipeline::updateMonaAddresses(mona, addresses);
+    std::lock_guard<tl::mutex> g(m_stages_mtx);
+    for(auto& stage : m_stages)
+        stage.backend->updateMonaAddresses(mona, addresses);
+}
+
+void CompositePipeline::updateGroupView(const GroupView& view) {
+    std::lock_guard<tl::mutex> g(m_stages_mtx);
+    for(auto& stage : m_stages)
+        stage.backend->updateGroupView(view);
+}
+
+void CompositePipeline::updateCommunicator(const Communicator& comm) {
+    StagingPipeline::updateCommunicator(comm);
+    std::lock_guard<tl::mutex> g(m_stages_mtx);
+    for(auto& stage : m_stages) {
+        try {
+            stage.comm = comm ? comm.derive(stage.name) : Communicator();
+        } catch(const Exception& ex) {
+            spdlog::error("Could not build communicator of stage {}: {}", stage.name, ex.what());
+            stage.comm = Communicator();
+        }
+        stage.backend->updateCommunicator(stage.comm);
+    }
+}
+
+template<typename F>
+RequestResult<int32_t> CompositePipeline::forEachStage(F&& f) {
+    std::vector<std::pair<std::string, Backend*>> stages;
+    {
+        std::lock_guard<tl::mutex> g(m_stages_mtx);
+        for(auto& stage : m_stages)
+            stages.emplace_back(stage.name, stage.backend.get());
+    }
+    // all the stages are called, and the first failure is reported
+    RequestResult<int32_t> result = Success();
+    for(auto& stage : stages) {
+        auto r = f(*stage.second);
+        if(!r.success() && result.success())
+            result = Failure("Stage " + stage.first + ": " + r.error(), (ErrorCode)r.value());
+    }
+    return result;
+}
+
+RequestResult<int32_t> CompositePipeline::start(uint64_t iteration) {
+    return forEachStage([iteration](Backend& b) { return b.start(iteration); });
+}
+
+void CompositePipeline::abort(uint64_t iteration) {
+    forEachStage([iteration](Backend& b) {
+        b.abort(iteration);
+        return Success();
+    });
+    StagingPipeline::abort(iteration);
+}
+
+RequestResult<int32_t> CompositePipeline::stage(
+        const std::string& sender_addr,
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const std::vector<size_t>& dimensions,
+        const std::vector<int64_t>& offsets,
+        const Type& type,
+        const thallium::bulk& data) {
+    auto result = StagingPipeline::stage(sender_addr, dataset_name, iteration,
+                                         block_id, dimensions, offsets, type, data);
+    if(!result.success()) return result;
+    auto block = m_store.find(dataset_name, iteration, block_id);
+    if(!block) return result; // aborted in the meantime
+    return forward(dataset_name, iteration, block_id, block);
+}
+
+RequestResult<int32_t> CompositePipeline::stageShared(
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const BlockStore::BlockPtr& block) {
+    auto result = StagingPipeline::stageShared(dataset_name, iteration, block_id, block);
+    if(!result.success()) return result;
+    return forward(dataset_name, iteration, block_id, block);
+}
+
+RequestResult<int32_t> CompositePipeline::forward(const std::string& dataset_name,
+                                                  uint64_t iteration,
+                                                  uint64_t block_id,
+                                                  const BlockStore::BlockPtr& block) {
+    std::vector<std::pair<std::string, Backend*>> consumers;
+    {
+        std::lock_guard<tl::mutex> g(m_stages_mtx);
+        for(auto& stage : m_stages) {
+            if(stage.datasets.empty()
+            || std::binary_search(stage.datasets.begin(), stage.datasets.end(), dataset_name))
+                consumers.emplace_back(stage.name, stage.backend.get());
+        }
+    }
+    RequestResult<int32_t> result = Success();
+    for(auto& consumer : consumers) {
+        auto r = StageSharedBlock(*consumer.second, m_engine,
+                                  dataset_name, iteration, block_id, block);
+        if(!r.success() && result.success())
+            result = Failure("Stage " + consumer.first + ": " + r.error(), (ErrorCode)r.value());
+    }
+    return result;
+}
+
+RequestResult<int32_t> CompositePipeline::execute(uint64_t iteration) {
+    struct Task {
+        std::string         name;
+        Backend*            backend;
+        std::vector<size_t> after;
+        Communicator        comm;
+    };
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<tl::mutex> g(m_stages_mtx);
+        for(auto& stage : m_stages)
+            tasks.push_back({ stage.name, stage.backend.get(), stage.after, stage.comm });
+    }
+    const size_t n = tasks.size();
+    std::vector<RequestResult<int32_t>> results(n);
+    std::vector<double> seconds(n, 0.0);
+    std::vector<bool> done(n, false), skipped(n, false);
+    tl::mutex mtx;
+    tl::condition_variable cv;
+
+    std::vector<tl::managed<tl::thread>> ults;
+    for(size_t i = 0; i < n; i++) {
+        ults.push_back(m_pool.make_thread([&, i]() {
+            auto& task = tasks[i];
+            int32_t skip = 0;
+            {
+                std::unique_lock<tl::mutex> lock(mtx);
+                for(auto p : task.after) {
+                    while(!done[p]) cv.wait(lock);
+                    if(!results[p].success()) skip = 1;
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            RequestResult<int32_t> result;
+            try {
+                // a stage runs on all the servers or on none, since its
+                // collectives would not match otherwise
+                if(!task.after.empty() && task.comm && task.comm.size() > 1) {
+                    int32_t any = 0;
+                    task.comm.allreduce(&skip, &any, 1, Type::INT32, Communicator::ReduceOp::MAX);
+                    skip = any;
+                }
+                if(skip)
+                    result = Failure("Skipped since a stage it comes after failed");
+                else
+                    result = task.backend->execute(iteration);
+            } catch(const std::exception& ex) {
+                result = Failure(ex.what());
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::lock_guard<tl::mutex> g(mtx);
+            results[i] = std::move(result);
+            seconds[i] = elapsed.count();
+            skipped[i] = skip != 0;
+            done[i]    = true;
+            cv.notify_all();
+        }));
+    }
+    for(auto& ult : ults)
+        ult->join();
+
+    RequestResult<int32_t> result = Success();
+    json stages = json::object();
+    for(size_t i = 0; i < n; i++) {
+        json entry;
+        if(results[i].success()) {
+            entry["seconds"] = seconds[i];
+        } else {
+            entry["error"] = results[i].error();
+            if(skipped[i]) entry["skipped"] = true;
+            if(result.success())
+                result = Failure("Stage " + tasks[i].name + ": " + results[i].error(),
+                                 (ErrorCode)results[i].value());
+        }
+        stages[tasks[i].name] = std::move(entry);
+    }
+    publishResults(iteration, { { "stages", std::move(stages) } }, communicator());
+    return result;
+}
+
+RequestResult<int32_t> CompositePipeline::cleanup(uint64_t iteration) {
+    auto result = forEachStage([iteration](Backend& b) { return b.cleanup(iteration); });
+    auto own = StagingPipeline::cleanup(iteration);
+    return result.success() ? own : result;
+}
+
+RequestResult<int32_t> CompositePipeline::destroy() {
+    return forEachStage([](Backend& b) { return b.destroy(); });
+}
+
+RequestResult<int32_t> CompositePipeline::reset() {
+    auto result = forEachStage([](Backend& b) { return b.reset(); });
+    auto own = StagingPipeline::reset();
+    return result.success() ? own : result;
+}
+
+Backend* CompositePipeline::stageOf(const std::string& name, std::string& rest) {
+    auto slash = name.find('/');
+    if(slash == std::string::npos) return nullptr;
+    auto stage_name = name.substr(0, slash);
+    std::lock_guard<tl::mutex> g(m_stages_mtx);
+    for(auto& stage : m_stages) {
+        if(stage.name != stage_name) continue;
+        rest = name.substr(slash + 1);
+        return stage.backend.get();
+    }
+    return nullptr;
+}
+
+RequestResult<int32_t> CompositePipeline::summarize(const std::string& dataset_name,
+                                                    uint64_t iteration,
+                                                    size_t max_boxes,
+                                                    std::vector<Box>& boxes) {
+    std::string rest;
+    auto backend = stageOf(dataset_name, rest);
+    if(backend)
+        return backend->summarize(rest, iteration, max_boxes, boxes);
+    return StagingPipeline::summarize(dataset_name, iteration, max_boxes, boxes);
+}
+
+RequestResult<int32_t> CompositePipeline::fetchDerived(const std::string& dataset_name,
+                                                       uint64_t iteration,
+                                                       uint64_t block_id,
+                                                       const FetchCallback& push) {
+    std::string rest;
+    auto backend = stageOf(dataset_name, rest);
+    if(backend)
+        return backend->fetch(rest, iteration, block_id, push);
+    return StagingPipeline::fetchDerived(dataset_name, iteration, block_id, push);
+}
+
+RequestResult<int32_t> CompositePipeline::queryDerived(const std::string& dataset_name,
+                                                       uint64_t iteration,
+                                                       const Box& region,
+                                                       const FetchCallback& push) {
+    std::string rest;
+    auto backend = stageOf(dataset_name, rest);
+    if(backend)
+        return backend->query(rest, iteration, region, push);
+    return StagingPipeline::queryDerived(dataset_name, iteration, region, push);
+}
+
+std::unique_ptr<Backend> CompositePipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new CompositePipeline(args));
+}
+
+}
@@ -0,0 +1,165 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_COMPOSITE_PIPELINE_HPP
+#define __COLZA_COMPOSITE_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+#include <memory>
+
+namespace colza {
+
+/**
+ * @brief The "composite" backend assembles a pipeline out of other
+ * registered backends, its stages, whose dependencies form a DAG.
+ *
+ * A staged block is stored once by the composite and handed by
+ * reference (Backend::stageShared) to every stage that consumes its
+ * dataset; the stages that do not support shared blocks pull it from
+ * the composite's memory through stage. execute runs the execute of
+ * each stage in its own ULT on the provider's pool, as soon as the
+ * stages it comes after have completed, so independent branches run
+ * in parallel. Each stage has its own Communicator, derived from the
+ * composite's, so that the collectives of concurrent stages do not mix;
+ * a composite has at most Communicator::MAX_DERIVED stages. A stage is
+ * skipped on all the servers if a stage it comes after failed on one
+ * of them.
+ *
+ * Dependencies only order the executions: no data flows between the
+ * stages. Every stage consumes staged datasets, and the blocks a stage
+ * derives are not handed to the stages that come after it, so a stage
+ * cannot process another one's products (e.g. compress the levels of a
+ * pyramid). Clients can fetch those products and stage them into
+ * another pipeline instead.
+ *
+ * Configuration:
+ * {
+ *     "stages" : [
+ *         {
+ *             "name"     : "stats",      // unique, without '/'
+ *             "type"     : "statistics", // registered backend type
+ *             "config"   : { ... },      // configuration of the stage
+ *             "datasets" : [ "a", "b" ], // optional, all by default
+ *             "after"    : [ "filter" ]  // optional, stages whose execute
+                                         // must complete first
+ *         },
+ *         ...
+ *     ],
+ *     "output" : "path/to/composite.jsonl" // optional
+ * }
+ *
+ * Stages cannot be composite pipelines themselves. Reconfiguring the
+ * pipeline reconfigures its stages, whose names and types cannot
+ * change. The results of an iteration give the duration of each
+ * stage's execute, or the error it reported. The staged datasets are
+ * fetched and queried from the composite itself, and the blocks
+ * derived by a stage under "<stage>/<name>" (e.g. "stats/$results").
+ */
+class CompositePipeline : public StagingPipeline {
+
+    struct Stage {
+        std::string              name;
+        std::string              type;
+        std::vector<std::string> datasets; // sorted, empty for all
+        std::vector<size_t>      after;    // indices of the stages to wait for
+        std::unique_ptr<Backend> backend;
+        Communicator             comm;
+    };
+
+    std::vector<Stage>     m_stages;
+    tl::mutex              m_stages_mtx;
+
+    public:
+
+    CompositePipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args) {
+        onConfigure(args.config);
+    }
+
+    void updateMonaAddresses(
+            mona_instance_t mona,
+            const std::vector<na_addr_t>& addresses) override;
+
+    void updateGroupView(const GroupView& view) override;
+
+    /**
+     * @brief Keeps the Communicator, and hands each stage one derived
+     * from it.
+     */
+    void updateCommunicator(const Communicator& comm) override;
+
+    RequestResult<int32_t> start(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    /**
+     * @brief Stores the block, then hands it to the stages that
+     * consume its dataset.
+     */
+    RequestResult<int32_t> stage(
+            const std::string& sender_addr,
+            const std::string& dataset_name,
+            uint64_t iteration,
+            uint64_t block_id,
+            const std::vector<size_t>& dimensions,
+            const std::vector<int64_t>& offsets,
+            const Type& type,
+            const thallium::bulk& data) override;
+
+    RequestResult<int32_t> stageShared(
+            const std::string& dataset_name,
+            uint64_t iteration,
+            uint64_t block_id,
+            const BlockStore::BlockPtr& block) override;
+
+    /**
+     * @brief Executes the DAG of stages. This is a collective operation
+     * if any stage's execute is.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> destroy() override;
+
+    RequestResult<int32_t> reset() override;
+
+    RequestResult<int32_t> summarize(const std::string& dataset_name,
+                                     uint64_t iteration,
+                                     size_t max_boxes,
+                                     std::vector<Box>& boxes) override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    RequestResult<int32_t> fetchDerived(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const FetchCallback& push) override;
+
+    RequestResult<int32_t> queryDerived(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        const Box& region,
+                                        const FetchCallback& push) override;
+
+    void onConfigure(const json& config) override;
+
+    private:
+
+    RequestResult<int32_t> forward(const std::string& dataset_name,
+                                   uint64_t iteration,
+                                   uint64_t block_id,
+                                   const BlockStore::BlockPtr& block);
+
+    Backend* stageOf(const std::string& name, std::string& rest);
+
+    template<typename F>
+    RequestResult<int32_t> forEachStage(F&& f);
+};
+
+}
+
+#endif
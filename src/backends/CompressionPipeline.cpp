@@ -0,0 +1,349 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "CompressionPipeline.hpp"
+#include "Codecs.hpp"
+#include "../TypeSizes.hpp"
+#include <spdlog/spdlog.h>
+#include <chrono>
+
+COLZA_REGISTER_BACKEND(compression, colza::CompressionPipeline);
+
+namespace colza {
+
+namespace {
+
+using Mode = CompressionPipeline::Mode;
+
+template<typename T>
+void Put(std::vector<uint8_t>& out, const T& value) {
+    auto p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+template<typename T>
+const uint8_t* Get(const uint8_t* in, const uint8_t* end, T& value) {
+    if((size_t)(end - in) < sizeof(T))
+        throw Exception(ErrorCode::OTHER_ERROR, "Truncated compressed block");
+    std::memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+}
+
+// layout: number of outliers, code lengths of the symbols in use,
+// size and content of the Huffman-coded symbols, outliers
+template<typename T>
+double LossyEncode(const T* x, size_t n, double error_bound, std::vector<uint8_t>& out) {
+    using Q = Quantizer<T>;
+    std::vector<uint32_t> symbols(n);
+    std::vector<T> outliers;
+    double max_error = Q::Quantize(x, n, error_bound, symbols.data(), outliers);
+    std::vector<uint64_t> frequencies(Q::NUM_SYMBOLS, 0);
+    for(auto s : symbols) frequencies[s] += 1;
+    HuffmanCoder coder(frequencies);
+    Put(out, static_cast<uint64_t>(outliers.size()));
+    const auto& lengths = coder.lengths();
+    uint32_t used = 0;
+    for(auto l : lengths) used += l ? 1 : 0;
+    Put(out, used);
+    for(size_t s = 0; s < lengths.size(); s++) {
+        if(!lengths[s]) continue;
+        Put(out, static_cast<uint32_t>(s));
+        out.push_back(lengths[s]);
+    }
+    std::vector<uint8_t> bits;
+    coder.encode(symbols.data(), n, bits);
+    Put(out, static_cast<uint64_t>(bits.size()));
+    out.insert(out.end(), bits.begin(), bits.end());
+    auto o = reinterpret_cast<const uint8_t*>(outliers.data());
+    out.insert(out.end(), o, o + outliers.size()*sizeof(T));
+    return max_error;
+}
+
+template<typename T>
+void LossyDecode(const std::vector<uint8_t>& bytes, double error_bound, T* x, size_t n) {
+    using Q = Quantizer<T>;
+    const uint8_t* in  = bytes.data();
+    const uint8_t* end = in + bytes.size();
+    uint64_t num_outliers = 0, num_bytes = 0;
+    uint32_t used = 0;
+    in = Get(in, end, num_outliers);
+    in = Get(in, end, used);
+    std::vector<uint8_t> lengths(Q::NUM_SYMBOLS, 0);
+    for(uint32_t i = 0; i < used; i++) {
+        uint32_t s = 0;
+        in = Get(in, end, s);
+        if(s >= Q::NUM_SYMBOLS || in == end)
+            throw Exception(ErrorCode::OTHER_ERROR, "Invalid symbol in compressed block");
+        lengths[s] = *in++;
+    }
+    in = Get(in, end, num_bytes);
+    if((size_t)(end - in) < num_bytes + num_outliers*sizeof(T))
+        throw Exception(ErrorCode::OTHER_ERROR, "Truncated compressed block");
+    std::vector<uint32_t> symbols(n);
+    HuffmanCoder(std::move(lengths)).decode(in, in + num_bytes, symbols.data(), n);
+    in += num_bytes;
+    std::vector<T> outliers(num_outliers);
+    std::memcpy(outliers.data(), in, num_outliers*sizeof(T));
+    Q::Dequantize(symbols.data(), n, error_bound, outliers.data(), outliers.size(), x);
+}
+
+const char* ModeName(Mode mode) {
+    return mode == Mode::LOSSY ? "lossy" : "lossless";
+}
+
+CompressionPipeline::Codec CodecFromJson(const json& config, CompressionPipeline::Codec codec) {
+    if(config.contains("mode")) {
+        auto mode = config["mode"].get<std::string>();
+        if(mode == "lossless")   codec.mode = Mode::LOSSLESS;
+        else if(mode == "lossy") codec.mode = Mode::LOSSY;
+        else throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                    "\"mode\" should be \"lossless\" or \"lossy\"");
+    }
+    codec.error_bound = config.value("error_bound", codec.error_bound);
+    if(!(codec.error_bound > 0))
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"error_bound\" should be positive");
+    return codec;
+}
+
+}
+
+CompressionPipeline::CompressedBlock CompressionPipeline::Compress(
+        const void* data, size_t size, Type type, const Codec& codec) {
+    auto start = std::chrono::steady_clock::now();
+    CompressedBlock block;
+    block.codec         = codec;
+    block.type          = type;
+    block.original_size = size;
+    const size_t esize = ComputeDataSize({1}, type);
+    const size_t count = size/esize;
+    if(codec.mode == Mode::LOSSY && type == Type::FLOAT32) {
+        block.max_error = LossyEncode(static_cast<const float*>(data), count,
+                                      codec.error_bound, block.bytes);
+    } else if(codec.mode == Mode::LOSSY && type == Type::FLOAT64) {
+        block.max_error = LossyEncode(static_cast<const double*>(data), count,
+                                      codec.error_bound, block.bytes);
+    } else {
+        block.codec.mode = Mode::LOSSLESS;
+        std::vector<char> shuffled(size);
+        ByteShuffle(data, count, esize, shuffled.data());
+        LZCompress(shuffled.data(), size, block.bytes);
+    }
+    block.bytes.shrink_to_fit();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    block.seconds = elapsed.count();
+    return block;
+}
+
+std::vector<char> CompressionPipeline::Decompress(const CompressedBlock& block) {
+    std::vector<char> data(block.original_size);
+    const size_t esize = ComputeDataSize({1}, block.type);
+    const size_t count = block.original_size/esize;
+    if(block.codec.mode == Mode::LOSSY && block.type == Type::FLOAT32) {
+        LossyDecode(block.bytes, block.codec.error_bound,
+                    reinterpret_cast<float*>(data.data()), count);
+    } else if(block.codec.mode == Mode::LOSSY && block.type == Type::FLOAT64) {
+        LossyDecode(block.bytes, block.codec.error_bound,
+                    reinterpret_cast<double*>(data.data()), count);
+    } else {
+        std::vector<char> shuffled(block.original_size);
+        LZDecompress(block.bytes.data(), block.bytes.size(), shuffled.data(), shuffled.size());
+        ByteUnshuffle(shuffled.data(), count, esize, data.data());
+    }
+    return data;
+}
+
+std::vector<uint8_t> CompressionPipeline::Serialize(const CompressedBlock& block) {
+    std::vector<uint8_t> out;
+    out.reserve(2*sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double) + block.bytes.size());
+    Put(out, static_cast<uint32_t>(block.codec.mode));
+    Put(out, static_cast<uint32_t>(block.type));
+    Put(out, static_cast<uint64_t>(block.original_size));
+    Put(out, block.codec.error_bound);
+    out.insert(out.end(), block.bytes.begin(), block.bytes.end());
+    return out;
+}
+
+CompressionPipeline::CompressedBlock CompressionPipeline::Deserialize(const void* data, size_t size) {
+    auto in  = static_cast<const uint8_t*>(data);
+    auto end = in + size;
+    uint32_t mode = 0, type = 0;
+    uint64_t original_size = 0;
+    CompressedBlock block;
+    in = Get(in, end, mode);
+    in = Get(in, end, type);
+    in = Get(in, end, original_size);
+    in = Get(in, end, block.codec.error_bound);
+    if(mode > (uint32_t)Mode::LOSSY || type > (uint32_t)Type::FLOAT64)
+        throw Exception(ErrorCode::OTHER_ERROR, "Invalid compressed block header");
+    block.codec.mode    = (Mode)mode;
+    block.type          = (Type)type;
+    block.original_size = original_size;
+    block.bytes.assign(in, end);
+    return block;
+}
+
+void CompressionPipeline::onConfigure(const json& config) {
+    Codec default_codec = CodecFromJson(config, Codec());
+    std::map<std::string, Codec> codecs;
+    if(config.contains("datasets")) {
+        auto& datasets = config["datasets"];
+        if(!datasets.is_object())
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "\"datasets\" should be an object mapping names to codecs");
+        for(auto it = datasets.begin(); it != datasets.end(); ++it)
+            codecs[it.key()] = CodecFromJson(it.value(), default_codec);
+    }
+    std::lock_guard<tl::mutex> g(m_compressed_mtx);
+    m_default = default_codec;
+    m_codecs  = std::move(codecs);
+}
+
+CompressionPipeline::Codec CompressionPipeline::codecOf(const std::string& dataset_name) const {
+    auto it = m_codecs.find(dataset_name);
+    return it == m_codecs.end() ? m_default : it->second;
+}
+
+void CompressionPipeline::onStaged(const std::string& dataset_name,
+                                   uint64_t iteration,
+                                   uint64_t block_id,
+                                   const BlockStore::BlockPtr& block) {
+    Codec codec;
+    {
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        codec = codecOf(dataset_name);
+    }
+    spawnOnStaged(iteration, block, [this, dataset_name, iteration, block_id, codec](const StagedBlock& b) {
+        auto compressed = std::make_shared<const CompressedBlock>(
+            Compress(b.data, b.size, b.type, codec));
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        m_compressed[iteration][dataset_name][block_id] = std::move(compressed);
+    });
+}
+
+RequestResult<int32_t> CompressionPipeline::execute(uint64_t iteration) {
+    waitForSpawned(iteration);
+    auto comm = communicator();
+    if(!comm)
+        spdlog::warn("Compression pipeline has no communicator, results will be local");
+    try {
+        auto names = globalDatasetNames(comm, iteration);
+        const size_t num = names.size();
+        // blocks, original bytes, compressed bytes and seconds are
+        // summed; the max error and whether any block is lossy are maxed
+        std::vector<double> sums(4*num, 0.0), maxs(2*num, 0.0);
+        {
+            std::lock_guard<tl::mutex> g(m_compressed_mtx);
+            auto& local = m_compressed[iteration];
+            for(size_t d = 0; d < num; d++) {
+                auto it = local.find(names[d]);
+                if(it == local.end()) continue;
+                for(auto& b : it->second) {
+                    auto& block = *b.second;
+                    sums[4*d]     += 1;
+                    sums[4*d + 1] += block.original_size;
+                    sums[4*d + 2] += block.bytes.size();
+                    sums[4*d + 3] += block.seconds;
+                    maxs[2*d]      = std::max(maxs[2*d], block.max_error);
+                    if(block.codec.mode == Mode::LOSSY) maxs[2*d + 1] = 1.0;
+                }
+            }
+        }
+        if(comm && comm.size() > 1 && num != 0) {
+            using Op = Communicator::ReduceOp;
+            comm.allreduce(sums.data(), sums.data(), sums.size(), Type::FLOAT64, Op::SUM);
+            comm.allreduce(maxs.data(), maxs.data(), maxs.size(), Type::FLOAT64, Op::MAX);
+        }
+        json result = json::object();
+        for(size_t d = 0; d < num; d++) {
+            double original = sums[4*d + 1], compressed = sums[4*d + 2];
+            double seconds  = sums[4*d + 3];
+            bool lossy = maxs[2*d + 1] > 0;
+            json stats;
+            stats["mode"]             = ModeName(lossy ? Mode::LOSSY : Mode::LOSSLESS);
+            stats["blocks"]           = static_cast<uint64_t>(sums[4*d]);
+            stats["original_bytes"]   = static_cast<uint64_t>(original);
+            stats["compressed_bytes"] = static_cast<uint64_t>(compressed);
+            stats["ratio"]            = compressed > 0 ? original/compressed : 0.0;
+            // throughput of a single ULT, as blocks are compressed concurrently
+            stats["seconds"]          = seconds;
+            stats["throughput_mbps"]  = seconds > 0 ? original/seconds/1e6 : 0.0;
+            if(lossy) {
+                stats["error_bound"] = codecOf(names[d]).error_bound;
+                stats["max_error"]   = maxs[2*d];
+            }
+            result[names[d]] = std::move(stats);
+        }
+        publishResults(iteration, std::move(result), comm);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    return Success();
+}
+
+void CompressionPipeline::abort(uint64_t iteration) {
+    waitForSpawned(iteration);
+    {
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        m_compressed.erase(iteration);
+    }
+    StagingPipeline::abort(iteration);
+}
+
+RequestResult<int32_t> CompressionPipeline::cleanup(uint64_t iteration) {
+    waitForSpawned(iteration);
+    {
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        m_compressed.erase(iteration);
+    }
+    return StagingPipeline::cleanup(iteration);
+}
+
+RequestResult<int32_t> CompressionPipeline::fetchDerived(const std::string& dataset_name,
+                                                         uint64_t iteration,
+                                                         uint64_t block_id,
+                                                         const FetchCallback& push) {
+    static const std::string suffix = "/compressed";
+    if(dataset_name.size() <= suffix.size()
+    || dataset_name.compare(dataset_name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        return StagingPipeline::fetchDerived(dataset_name, iteration, block_id, push);
+    auto name = dataset_name.substr(0, dataset_name.size() - suffix.size());
+    waitForSpawned(iteration);
+    std::shared_ptr<const CompressedBlock> block;
+    {
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        auto it = m_compressed.find(iteration);
+        if(it != m_compressed.end()) {
+            auto ds = it->second.find(name);
+            if(ds != it->second.end()) {
+                auto b = ds->second.find(block_id);
+                if(b != ds->second.end()) block = b->second;
+            }
+        }
+    }
+    if(!block)
+        return Failure("Block not found", ErrorCode::BLOCK_NOT_FOUND);
+    auto bytes = Serialize(*block);
+    BlockInfo info;
+    info.dimensions = { bytes.size() };
+    info.type       = Type::UINT8;
+    info.size       = bytes.size();
+    return push(info, bytes.data());
+}
+
+RequestResult<int32_t> CompressionPipeline::reset() {
+    waitForAllSpawned();
+    {
+        std::lock_guard<tl::mutex> g(m_compressed_mtx);
+        m_compressed.clear();
+    }
+    return StagingPipeline::reset();
+}
+
+std::unique_ptr<Backend> CompressionPipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new CompressionPipeline(args));
+}
+
+}
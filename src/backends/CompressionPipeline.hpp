@@ -0,0 +1,144 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_COMPRESSION_PIPELINE_HPP
+#define __COLZA_COMPRESSION_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+#include <memory>
+
+namespace colza {
+
+/**
+ * @brief The "compression" backend compresses every staged block in a
+ * ULT of the provider's pool as soon as it is staged, and execute
+ * reports, for each dataset, the compression ratio and throughput
+ * achieved across all the servers.
+ *
+ * Two modes are available for each dataset:
+ * - "lossless": the bytes of the elements are shuffled (all the first
+ *   bytes, then all the second bytes, etc.) and compressed with an
+ *   LZ77 codec;
+ * - "lossy": values are predicted from their predecessor, the errors
+ *   are quantized so that the reconstruction is within error_bound of
+ *   the original, and the quantization bins are Huffman-coded. Integer
+ *   datasets are always compressed losslessly.
+ *
+ * Configuration (all fields optional):
+ * {
+ *     "mode"        : "lossless",          // default mode
+ *     "error_bound" : 1e-4,                // default absolute error bound
+ *     "datasets"    : {                    // per-dataset overrides
+ *         "temperature" : { "mode" : "lossy", "error_bound" : 0.01 }
+ *     },
+ *     "output"      : "path/to/compression.jsonl"
+ * }
+ *
+ * Compressed blocks are kept until the iteration is cleaned up, and
+ * can be fetched (as UINT8 blocks) under the name "<dataset>/compressed",
+ * with the id of the block they were compressed from. A fetched block
+ * starts with a header giving the codec, the type of the elements and
+ * the original size (see Serialize), so that clients can rebuild it
+ * with Deserialize and Decompress.
+ */
+class CompressionPipeline : public StagingPipeline {
+
+    public:
+
+    enum class Mode { LOSSLESS, LOSSY };
+
+    struct Codec {
+        Mode   mode = Mode::LOSSLESS;
+        double error_bound = 1e-4;
+    };
+
+    /**
+     * @brief Compressed form of a staged block.
+     */
+    struct CompressedBlock {
+        Codec                codec;
+        Type                 type;
+        size_t               original_size = 0;
+        std::vector<uint8_t> bytes;
+        double               seconds = 0.0;   // time spent compressing
+        double               max_error = 0.0; // for lossy compression
+    };
+
+    /**
+     * @brief Compresses size bytes of elements of the given type.
+     */
+    static CompressedBlock Compress(const void* data, size_t size, Type type, const Codec& codec);
+
+    /**
+     * @brief Decompresses a block into its original_size bytes.
+     */
+    static std::vector<char> Decompress(const CompressedBlock& block);
+
+    /**
+     * @brief Bytes of a block as fetched from the pipeline: the mode
+     * (uint32), the type of the elements (uint32), the original size in
+     * bytes (uint64) and the error bound (double), followed by the
+     * compressed bytes.
+     */
+    static std::vector<uint8_t> Serialize(const CompressedBlock& block);
+
+    /**
+     * @brief Rebuilds a block from the bytes produced by Serialize,
+     * throwing a colza::Exception if they are truncated or invalid.
+     */
+    static CompressedBlock Deserialize(const void* data, size_t size);
+
+    private:
+
+    // blocks are shared so that fetches can push them without the lock
+    using BlockMap = std::map<std::string,
+                              std::map<uint64_t, std::shared_ptr<const CompressedBlock>>>;
+
+    Codec                         m_default;
+    std::map<std::string, Codec>  m_codecs;
+    std::map<uint64_t, BlockMap>  m_compressed;
+    tl::mutex                     m_compressed_mtx;
+
+    Codec codecOf(const std::string& dataset_name) const;
+
+    public:
+
+    CompressionPipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args) {
+        onConfigure(args.config);
+    }
+
+    /**
+     * @brief Waits for the blocks of the iteration to be compressed and
+     * reports the results. This is a collective operation.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> reset() override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    void onStaged(const std::string& dataset_name,
+                  uint64_t iteration,
+                  uint64_t block_id,
+                  const BlockStore::BlockPtr& block) override;
+
+    RequestResult<int32_t> fetchDerived(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const FetchCallback& push) override;
+
+    void onConfigure(const json& config) override;
+};
+
+}
+
+#endif
@@ -0,0 +1,514 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "PyramidPipeline.hpp"
+#include "../ReduceOps.hpp"
+#include "../TypeDispatch.hpp"
+#include "../TypeSizes.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+COLZA_REGISTER_BACKEND(pyramid, colza::PyramidPipeline);
+
+namespace colza {
+
+namespace {
+
+using Method = PyramidPipeline::Method;
+
+// division and modulo rounding towards -infinity (b > 0), since
+// offsets may be negative
+int64_t FloorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+int64_t FloorMod(int64_t a, int64_t b) {
+    return a - FloorDiv(a, b)*b;
+}
+
+// box of the coarse cells covering at least one cell of box
+Box Coarsen(const Box& box, int64_t f) {
+    Box result = box;
+    for(size_t d = 0; d < box.ndims(); d++) {
+        result.lower[d] = FloorDiv(box.lower[d], f);
+        result.upper[d] = FloorDiv(box.upper[d] - 1, f) + 1;
+    }
+    return result;
+}
+
+// reduces a row of len cells starting at coordinate x0 into the coarse
+// row out, whose first cell has coordinate out_x0; cells are summed for
+// MEAN, maxed for MAX, and only the first cell of each coarse cell is
+// kept for STRIDE. The cells between the first and the last partial
+// coarse cells are processed one offset k at a time, so that the inner
+// loops are strided loads the compiler can vectorize.
+template<typename In, typename Out>
+void PoolRow(const In* in, int64_t x0, size_t len,
+             Out* out, int64_t out_x0, int64_t f, Method method) {
+    const size_t step = (size_t)f;
+    const size_t head = std::min((size_t)((f - FloorMod(x0, f)) % f), len);
+    const size_t full = (len - head)/step;
+    auto cell = [x0, out_x0, f](size_t i) {
+        return (size_t)(FloorDiv(x0 + (int64_t)i, f) - out_x0);
+    };
+    if(method == Method::STRIDE) {
+        // the head cells are never the first of their coarse cell
+        for(size_t i = head; i < len; i += step)
+            out[cell(i)] = static_cast<Out>(in[i]);
+        return;
+    }
+    auto combine = [method](Out& acc, In v) {
+        Out x = static_cast<Out>(v);
+        if(method == Method::MEAN) acc += x;
+        else acc = x > acc ? x : acc;
+    };
+    for(size_t i = 0; i < head; i++)
+        combine(out[cell(i)], in[i]);
+    if(full != 0) {
+        Out* o = out + cell(head);
+        const In* x = in + head;
+        if(method == Method::MEAN) {
+            for(size_t k = 0; k < step; k++)
+                for(size_t j = 0; j < full; j++)
+                    o[j] += static_cast<Out>(x[j*step + k]);
+        } else {
+            for(size_t k = 0; k < step; k++)
+                for(size_t j = 0; j < full; j++) {
+                    Out v = static_cast<Out>(x[j*step + k]);
+                    o[j] = v > o[j] ? v : o[j];
+                }
+        }
+    }
+    for(size_t i = head + full*step; i < len; i++)
+        combine(out[cell(i)], in[i]);
+}
+
+// reduces the cells of in (covering in_box) into out, which covers
+// Coarsen(in_box, f) and is initialized with the identity of the method
+template<typename In, typename Out>
+void Pool(const In* in, const Box& in_box,
+          Out* out, const Box& out_box, int64_t f, Method method) {
+    if(in_box.empty()) return;
+    const size_t n = in_box.ndims();
+    const auto in_ext  = in_box.extents();
+    const auto out_ext = out_box.extents();
+    std::vector<size_t> out_stride(n);
+    size_t s = 1;
+    for(size_t d = n; d-- > 0;) {
+        out_stride[d] = s;
+        s *= out_ext[d];
+    }
+    const size_t len  = in_ext[n-1];
+    const size_t rows = in_box.volume()/len;
+    std::vector<size_t> idx(n, 0);
+    for(size_t r = 0; r < rows; r++) {
+        bool keep = true;
+        size_t o = 0;
+        for(size_t d = 0; d + 1 < n; d++) {
+            int64_t x = in_box.lower[d] + (int64_t)idx[d];
+            if(method == Method::STRIDE && FloorMod(x, f) != 0) keep = false;
+            o += (size_t)(FloorDiv(x, f) - out_box.lower[d])*out_stride[d];
+        }
+        if(keep)
+            PoolRow(in + r*len, in_box.lower[n-1], len,
+                    out + o, out_box.lower[n-1], f, method);
+        for(size_t d = n - 1; d-- > 0;) {
+            if(++idx[d] < in_ext[d]) break;
+            idx[d] = 0;
+        }
+    }
+}
+
+// number of cells of in_box covered by each cell of out_box
+void CellCounts(const Box& in_box, const Box& out_box, int64_t f, uint32_t* out) {
+    const size_t n = out_box.ndims();
+    const auto ext = out_box.extents();
+    std::vector<std::vector<uint32_t>> per_dim(n);
+    for(size_t d = 0; d < n; d++) {
+        per_dim[d].resize(ext[d]);
+        for(size_t j = 0; j < ext[d]; j++) {
+            int64_t lo = (out_box.lower[d] + (int64_t)j)*f;
+            int64_t c = std::min(lo + f, in_box.upper[d]) - std::max(lo, in_box.lower[d]);
+            per_dim[d][j] = c > 0 ? (uint32_t)c : 0;
+        }
+    }
+    std::vector<size_t> idx(n, 0);
+    const size_t total = out_box.volume();
+    for(size_t i = 0; i < total; i++) {
+        uint32_t c = 1;
+        for(size_t d = 0; d < n; d++) c *= per_dim[d][idx[d]];
+        out[i] = c;
+        for(size_t d = n; d-- > 0;) {
+            if(++idx[d] < ext[d]) break;
+            idx[d] = 0;
+        }
+    }
+}
+
+template<typename Out>
+void Mean(const double* sums, const uint32_t* counts, Out* out, size_t n) {
+    const Out nan = std::numeric_limits<Out>::quiet_NaN();
+    for(size_t i = 0; i < n; i++)
+        out[i] = counts[i] ? static_cast<Out>(sums[i]/counts[i]) : nan;
+}
+
+// level with a volume ratio times smaller than the staged data, assembled
+// on ceil(n/ratio) servers as slabs along its longest dimension
+Decomposition LevelDecomposition(const Box& domain, double ratio, int n) {
+    auto ext = domain.extents();
+    size_t axis = std::max_element(ext.begin(), ext.end()) - ext.begin();
+    double parts = std::min({ std::ceil(n/ratio), (double)n, (double)ext[axis] });
+    int k = std::max(1, (int)parts);
+    auto decomposition = Decomposition::Slabs(domain, axis, k);
+    for(int i = 0; i < k; i++)
+        decomposition.owners[i] = (int)(((int64_t)i*n)/k);
+    return decomposition;
+}
+
+// sums (or values) and counts of the coarse cells covered by a local block
+struct Partial {
+    Box                   box;
+    std::vector<char>     values;
+    std::vector<uint32_t> counts;
+};
+
+const char* MethodName(Method method) {
+    switch(method) {
+        case Method::STRIDE: return "stride";
+        case Method::MEAN:   return "mean";
+        case Method::MAX:    return "max";
+    }
+    return "";
+}
+
+// splits "<dataset>/<level>" into its dataset name and level number
+bool ParseLevelName(const std::string& full_name, std::string& name, size_t& level) {
+    auto slash = full_name.rfind('/');
+    if(slash == std::string::npos || slash + 1 == full_name.size()
+    || full_name.size() - slash > 10
+    || full_name.find_first_not_of("0123456789", slash + 1) != std::string::npos)
+        return false;
+    name  = full_name.substr(0, slash);
+    level = std::stoul(full_name.substr(slash + 1));
+    return true;
+}
+
+BlockInfo LevelBlockInfo(const PyramidPipeline::Level& level, const RedistributedBlock& block) {
+    BlockInfo info;
+    info.dimensions = block.box.extents();
+    info.offsets    = block.box.lower;
+    info.type       = level.type;
+    info.size       = ComputeDataSize(info.dimensions, level.type);
+    return info;
+}
+
+}
+
+void PyramidPipeline::onConfigure(const json& config) {
+    std::vector<std::string> selected;
+    if(config.contains("datasets"))
+        selected = config["datasets"].get<std::vector<std::string>>();
+    auto method = config.value("method", std::string("mean"));
+    auto factor = config.value("factor", (int64_t)2);
+    auto levels = config.value("levels", (int64_t)3);
+    if(method != "mean" && method != "max" && method != "stride")
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"method\" should be \"mean\", \"max\" or \"stride\"");
+    if(factor < 2)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"factor\" should be at least 2");
+    if(levels < 1)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"levels\" should be at least 1");
+    std::sort(selected.begin(), selected.end());
+    m_selected = std::move(selected);
+    m_method   = method == "mean" ? Method::MEAN
+               : method == "max"  ? Method::MAX : Method::STRIDE;
+    m_factor   = factor;
+    m_levels   = (size_t)levels;
+}
+
+std::vector<PyramidPipeline::Level> PyramidPipeline::buildPyramid(
+        const Communicator& comm,
+        const std::vector<const StagedBlock*>& blocks,
+        const Box& domain, Type type) {
+    using Op = Communicator::ReduceOp;
+    const Method  method = m_method;
+    const int64_t f = m_factor;
+    const Op      op = method == Method::MAX ? Op::MAX : Op::SUM;
+    // mean levels are summed in double, the others keep the input type
+    const Type acc_type = method == Method::MEAN ? Type::FLOAT64 : type;
+    const Type out_type = method != Method::MEAN ? type
+                        : type == Type::FLOAT32 ? Type::FLOAT32 : Type::FLOAT64;
+    const size_t acc_size = ComputeDataSize({1}, acc_type);
+
+    std::vector<Level> levels;
+    std::vector<Partial> partials;
+    uint64_t factor = 1;
+    double ratio = 1.0;
+    for(size_t l = 1; l <= m_levels; l++) {
+        factor *= (uint64_t)f;
+        ratio  *= std::pow((double)f, (double)domain.ndims());
+        // the first level reduces the staged blocks, the next ones
+        // reduce the partial results of the previous level
+        std::vector<Partial> next;
+        if(l == 1) {
+            for(auto block : blocks) {
+                Box box = Box::FromBlock(block->dimensions, block->offsets);
+                if(box.empty()) continue;
+                Partial p;
+                p.box = Coarsen(box, f);
+                p.values.resize(p.box.volume()*acc_size);
+                FillIdentity(acc_type, op, p.values.data(), p.box.volume());
+                DispatchType(type, [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    auto x = reinterpret_cast<const T*>(block->data);
+                    if(method == Method::MEAN)
+                        Pool(x, box, reinterpret_cast<double*>(p.values.data()), p.box, f, method);
+                    else
+                        Pool(x, box, reinterpret_cast<T*>(p.values.data()), p.box, f, method);
+                });
+                if(method == Method::MEAN) {
+                    p.counts.resize(p.box.volume());
+                    CellCounts(box, p.box, f, p.counts.data());
+                }
+                next.push_back(std::move(p));
+            }
+        } else {
+            for(auto& prev : partials) {
+                Partial p;
+                p.box = Coarsen(prev.box, f);
+                p.values.resize(p.box.volume()*acc_size);
+                FillIdentity(acc_type, op, p.values.data(), p.box.volume());
+                DispatchType(acc_type, [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    Pool(reinterpret_cast<const T*>(prev.values.data()), prev.box,
+                         reinterpret_cast<T*>(p.values.data()), p.box, f, method);
+                });
+                if(method == Method::MEAN) {
+                    p.counts.resize(p.box.volume(), 0);
+                    Pool(prev.counts.data(), prev.box, p.counts.data(), p.box, f, Method::MEAN);
+                }
+                next.push_back(std::move(p));
+            }
+        }
+        partials = std::move(next);
+
+        // cells shared by blocks of different servers are combined
+        // while assembling the level on its owners
+        Level level;
+        level.factor        = factor;
+        level.domain        = Coarsen(domain, (int64_t)factor);
+        level.type          = out_type;
+        level.decomposition = LevelDecomposition(level.domain, ratio, comm.size());
+        std::vector<LocalBlock> values, counts;
+        for(auto& p : partials) {
+            values.push_back(LocalBlock{ p.values.data(), p.box });
+            counts.push_back(LocalBlock{ p.counts.data(), p.box });
+        }
+        level.blocks = Redistribute(comm, values, level.decomposition, acc_type, op);
+        if(method == Method::MEAN) {
+            auto sums = Redistribute(comm, counts, level.decomposition, Type::UINT32, Op::SUM);
+            for(size_t b = 0; b < level.blocks.size(); b++) {
+                auto& block = level.blocks[b];
+                size_t n = block.box.volume();
+                std::vector<char> means(n*ComputeDataSize({1}, out_type));
+                auto s = reinterpret_cast<const double*>(block.data());
+                auto c = reinterpret_cast<const uint32_t*>(sums[b].data());
+                if(out_type == Type::FLOAT32)
+                    Mean(s, c, reinterpret_cast<float*>(means.data()), n);
+                else
+                    Mean(s, c, reinterpret_cast<double*>(means.data()), n);
+                block.storage = std::move(means);
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+RequestResult<int32_t> PyramidPipeline::execute(uint64_t iteration) {
+    auto comm = communicator();
+    if(!comm)
+        return Failure("Pyramid pipeline has no communicator", ErrorCode::MONA_ERROR);
+    try {
+        auto names = globalDatasetNames(comm, iteration);
+        if(!m_selected.empty()) {
+            std::vector<std::string> kept;
+            std::set_intersection(names.begin(), names.end(),
+                                  m_selected.begin(), m_selected.end(),
+                                  std::back_inserter(kept));
+            names = std::move(kept);
+        }
+        auto blocks = blocksOf(iteration);
+        const size_t num = names.size();
+        const bool distributed = comm.size() > 1 && num != 0;
+        using Op = Communicator::ReduceOp;
+
+        // number of dimensions and type (+1, 0 if absent) of each dataset
+        std::vector<int64_t> meta(2*num, 0);
+        for(size_t d = 0; d < num; d++) {
+            for(auto block : blocks[names[d]]) {
+                meta[2*d]     = std::max<int64_t>(meta[2*d], block->dimensions.size());
+                meta[2*d + 1] = std::max<int64_t>(meta[2*d + 1], (int64_t)block->type + 1);
+            }
+        }
+        if(distributed)
+            comm.allreduce(meta.data(), meta.data(), meta.size(), Type::INT64, Op::MAX);
+
+        // bounding box of each dataset, as -lower and upper reduced with MAX
+        std::vector<size_t> first(num + 1, 0);
+        for(size_t d = 0; d < num; d++)
+            first[d+1] = first[d] + 2*(size_t)meta[2*d];
+        std::vector<int64_t> bounds(first[num], std::numeric_limits<int64_t>::lowest());
+        for(size_t d = 0; d < num; d++) {
+            const size_t ndims = (size_t)meta[2*d];
+            for(auto block : blocks[names[d]]) {
+                if(block->dimensions.size() != ndims
+                || (int64_t)block->type + 1 != meta[2*d + 1])
+                    throw Exception(ErrorCode::OTHER_ERROR,
+                        "Blocks of dataset " + names[d]
+                        + " have different numbers of dimensions or types");
+                Box box = Box::FromBlock(block->dimensions, block->offsets);
+                if(box.empty()) continue;
+                for(size_t i = 0; i < ndims; i++) {
+                    auto& lo = bounds[first[d] + i];
+                    auto& up = bounds[first[d] + ndims + i];
+                    lo = std::max(lo, -box.lower[i]);
+                    up = std::max(up, box.upper[i]);
+                }
+            }
+        }
+        if(distributed && !bounds.empty())
+            comm.allreduce(bounds.data(), bounds.data(), bounds.size(), Type::INT64, Op::MAX);
+
+        PyramidMap pyramids;
+        json result = json::object();
+        for(size_t d = 0; d < num; d++) {
+            const size_t ndims = (size_t)meta[2*d];
+            json levels = json::array();
+            Box domain;
+            for(size_t i = 0; i < ndims; i++) {
+                // the bounds are untouched if all the blocks are empty
+                if(bounds[first[d] + i] == std::numeric_limits<int64_t>::lowest()) {
+                    domain = Box();
+                    break;
+                }
+                domain.lower.push_back(-bounds[first[d] + i]);
+                domain.upper.push_back(bounds[first[d] + ndims + i]);
+            }
+            if(!domain.empty()) {
+                Type type = static_cast<Type>(meta[2*d + 1] - 1);
+                auto pyramid = buildPyramid(comm, blocks[names[d]], domain, type);
+                for(auto& level : pyramid) {
+                    levels.push_back({
+                        { "factor",     level.factor },
+                        { "offsets",    level.domain.lower },
+                        { "dimensions", level.domain.extents() },
+                        { "type",       static_cast<uint32_t>(level.type) },
+                        { "servers",    level.decomposition.boxes.size() }
+                    });
+                }
+                pyramids[names[d]] = std::move(pyramid);
+            }
+            result[names[d]] = {
+                { "method", MethodName(m_method) },
+                { "levels", std::move(levels) }
+            };
+        }
+        {
+            std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+            m_pyramids[iteration] = std::move(pyramids);
+        }
+        publishResults(iteration, std::move(result), comm);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    return Success();
+}
+
+void PyramidPipeline::abort(uint64_t iteration) {
+    {
+        std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+        m_pyramids.erase(iteration);
+    }
+    StagingPipeline::abort(iteration);
+}
+
+RequestResult<int32_t> PyramidPipeline::cleanup(uint64_t iteration) {
+    {
+        std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+        m_pyramids.erase(iteration);
+    }
+    return StagingPipeline::cleanup(iteration);
+}
+
+const PyramidPipeline::Level* PyramidPipeline::findLevel(uint64_t iteration,
+                                                         const std::string& name,
+                                                         size_t level) const {
+    auto it = m_pyramids.find(iteration);
+    if(it == m_pyramids.end()) return nullptr;
+    auto ds = it->second.find(name);
+    if(ds == it->second.end() || level == 0 || level > ds->second.size())
+        return nullptr;
+    return &ds->second[level-1];
+}
+
+RequestResult<int32_t> PyramidPipeline::fetchDerived(const std::string& dataset_name,
+                                                     uint64_t iteration,
+                                                     uint64_t block_id,
+                                                     const FetchCallback& push) {
+    std::string name;
+    size_t level_number;
+    if(!ParseLevelName(dataset_name, name, level_number))
+        return StagingPipeline::fetchDerived(dataset_name, iteration, block_id, push);
+    std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+    auto level = findLevel(iteration, name, level_number);
+    if(!level)
+        return Failure("Pyramid level not found", ErrorCode::BLOCK_NOT_FOUND);
+    for(auto& block : level->blocks) {
+        if(block.index == block_id)
+            return push(LevelBlockInfo(*level, block), block.data());
+    }
+    return Failure("Block not found", ErrorCode::BLOCK_NOT_FOUND);
+}
+
+RequestResult<int32_t> PyramidPipeline::queryDerived(const std::string& dataset_name,
+                                                     uint64_t iteration,
+                                                     const Box& region,
+                                                     const FetchCallback& push) {
+    std::string name;
+    size_t level_number;
+    if(!ParseLevelName(dataset_name, name, level_number))
+        return StagingPipeline::queryDerived(dataset_name, iteration, region, push);
+    std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+    auto level = findLevel(iteration, name, level_number);
+    if(!level)
+        return Success();
+    for(auto& block : level->blocks) {
+        if(!block.box.intersects(region)) continue;
+        auto result = push(LevelBlockInfo(*level, block), block.data());
+        if(!result.success())
+            return result;
+    }
+    return Success();
+}
+
+RequestResult<int32_t> PyramidPipeline::reset() {
+    {
+        std::lock_guard<tl::mutex> g(m_pyramids_mtx);
+        m_pyramids.clear();
+    }
+    return StagingPipeline::reset();
+}
+
+std::unique_ptr<Backend> PyramidPipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new PyramidPipeline(args));
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_PYRAMID_PIPELINE_HPP
+#define __COLZA_PYRAMID_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+#include <colza/Redistribution.hpp>
+
+namespace colza {
+
+/**
+ * @brief The "pyramid" backend builds, for each dataset of an
+ * iteration, a multi-resolution pyramid of the N-dimensional field
+ * formed by the blocks staged on all the servers (placed in the global
+ * index space by their offsets). Level l reduces the field by factor^l
+ * along every dimension, each coarse cell being the mean, the max, or
+ * the first (stride) of the fine cells it covers.
+ *
+ * Each server reduces its own blocks, cascading from one level to the
+ * next; cells shared by blocks of different servers are then combined
+ * while assembling the level with Redistribute. Level l is assembled on
+ * ceil(N/factor^(l*ndims)) of the N servers, so that coarse levels end
+ * up on fewer servers.
+ *
+ * Configuration:
+ * {
+ *     "datasets" : [ "a", "b" ],           // optional, all by default
+ *     "method"   : "mean",                 // "mean", "max" or "stride"
+ *     "factor"   : 2,                      // reduction between levels
+ *     "levels"   : 3,                      // 2x, 4x and 8x by default
+ *     "output"   : "path/to/pyramid.jsonl" // optional
+ * }
+ *
+ * Levels hold the input type for "max" and "stride", and floating
+ * point values for "mean" (float for float inputs, double otherwise).
+ * Cells not covered by any staged block are NaN for "mean", the lowest
+ * value for "max" and 0 for "stride". The levels are kept until the
+ * iteration is cleaned up; the results only describe them. Level l of
+ * a dataset can be fetched under the name "<dataset>/<l>", the block
+ * id being the index of a slab in the level's decomposition (slab i is
+ * on the server of rank floor(i*N/k) if the level spans k servers).
+ * Regions of a level can be queried under the same name, in the
+ * level's (coarse) index space.
+ */
+class PyramidPipeline : public StagingPipeline {
+
+    public:
+
+    enum class Method { STRIDE, MEAN, MAX };
+
+    /**
+     * @brief Level of the pyramid of a dataset.
+     */
+    struct Level {
+        uint64_t                        factor = 1;
+        Box                             domain;  // global coarse domain
+        Type                            type = Type::FLOAT64;
+        Decomposition                   decomposition;
+        std::vector<RedistributedBlock> blocks;  // blocks owned locally
+    };
+
+    private:
+
+    using PyramidMap = std::map<std::string, std::vector<Level>>;
+
+    std::vector<std::string>       m_selected;
+    Method                         m_method = Method::MEAN;
+    int64_t                        m_factor = 2;
+    size_t                         m_levels = 3;
+    std::map<uint64_t, PyramidMap> m_pyramids;
+    tl::mutex                      m_pyramids_mtx;
+
+    public:
+
+    PyramidPipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args) {
+        onConfigure(args.config);
+    }
+
+    /**
+     * @brief Builds the pyramids of the iteration. This is a collective
+     * operation across the servers of the group.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> reset() override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    RequestResult<int32_t> fetchDerived(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const FetchCallback& push) override;
+
+    RequestResult<int32_t> queryDerived(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        const Box& region,
+                                        const FetchCallback& push) override;
+
+    void onConfigure(const json& config) override;
+
+    private:
+
+    const Level* findLevel(uint64_t iteration, const std::string& name, size_t level) const;
+
+    std::vector<Level> buildPyramid(const Communicator& comm,
+                                    const std::vector<const StagedBlock*>& blocks,
+                                    const Box& domain, Type type);
+};
+
+}
+
+#endif
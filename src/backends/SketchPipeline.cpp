@@ -0,0 +1,278 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "SketchPipeline.hpp"
+#include "../TypeDispatch.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <set>
+
+COLZA_REGISTER_BACKEND(sketches, colza::SketchPipeline);
+
+namespace colza {
+
+namespace {
+
+template<typename T>
+uint64_t Bits(const T& value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+}
+
+json ValueFromBits(Type type, uint64_t bits) {
+    return DispatchType(type, [bits](auto tag) -> json {
+        using T = typename decltype(tag)::type;
+        T value;
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    });
+}
+
+template<typename T>
+void Put(std::vector<char>& out, const T& value) {
+    auto p = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+template<typename T>
+const char* Get(const char* in, T& value) {
+    std::memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+}
+
+}
+
+SketchPipeline::DatasetSketch::DatasetSketch(const Config& config, Type t, uint64_t seed)
+: type(t)
+, quantiles(KLLSketch::KForEpsilon(config.quantile_epsilon), seed)
+, distinct(HyperLogLog::PrecisionForError(config.distinct_error))
+, frequencies(config.top_k_epsilon, config.top_k_delta)
+, candidates(std::max<size_t>(4*config.top_k, 64)) {}
+
+void SketchPipeline::DatasetSketch::merge(const DatasetSketch& other) {
+    quantiles.merge(other.quantiles);
+    distinct.merge(other.distinct);
+    frequencies.merge(other.frequencies);
+    candidates.merge(other.candidates);
+}
+
+void SketchPipeline::onConfigure(const json& config) {
+    Config c;
+    if(config.contains("quantiles")) {
+        auto& q = config["quantiles"];
+        c.quantile_epsilon = q.value("epsilon", c.quantile_epsilon);
+        if(q.contains("points"))
+            c.quantile_points = q["points"].get<std::vector<double>>();
+    }
+    if(config.contains("distinct"))
+        c.distinct_error = config["distinct"].value("relative_error", c.distinct_error);
+    if(config.contains("top_k")) {
+        auto& t = config["top_k"];
+        c.top_k         = t.value("k", c.top_k);
+        c.top_k_epsilon = t.value("epsilon", c.top_k_epsilon);
+        c.top_k_delta   = t.value("delta", c.top_k_delta);
+    }
+    if(!(c.quantile_epsilon > 0 && c.quantile_epsilon < 1)
+    || !(c.distinct_error > 0 && c.distinct_error < 1)
+    || !(c.top_k_epsilon > 0 && c.top_k_epsilon < 1)
+    || !(c.top_k_delta > 0 && c.top_k_delta < 1))
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "Sketch error bounds should be in (0, 1)");
+    for(auto p : c.quantile_points)
+        if(p < 0 || p > 1)
+            throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "Quantile points should be in [0, 1]");
+    m_sketch_config = c;
+}
+
+void SketchPipeline::onStaged(const std::string& dataset_name,
+                              uint64_t iteration,
+                              uint64_t block_id,
+                              const BlockStore::BlockPtr& block) {
+    spawnOnStaged(iteration, block, [this, dataset_name, iteration, block_id](const StagedBlock& b) {
+        std::unique_ptr<DatasetSketch> sketch(
+            new DatasetSketch(m_sketch_config, b.type, Mix64(block_id)));
+        DispatchType(b.type, [&](auto tag) {
+            using T = typename decltype(tag)::type;
+            auto x = reinterpret_cast<const T*>(b.data);
+            size_t n = b.count();
+            sketch->quantiles.update(x, n);
+            for(size_t i = 0; i < n; i++) {
+                uint64_t bits = Bits(x[i]);
+                uint64_t hash = Mix64(bits);
+                sketch->distinct.add(hash);
+                sketch->frequencies.add(hash);
+                sketch->candidates.add(bits);
+            }
+        });
+        std::lock_guard<tl::mutex> g(m_sketches_mtx);
+        auto& slot = m_sketches[iteration][dataset_name];
+        if(!slot) slot = std::move(sketch);
+        else slot->merge(*sketch);
+    });
+}
+
+RequestResult<int32_t> SketchPipeline::execute(uint64_t iteration) {
+    waitForSpawned(iteration);
+    auto comm = communicator();
+    if(!comm)
+        spdlog::warn("Sketch pipeline has no communicator, results will be local");
+    const auto& config = m_sketch_config;
+    try {
+        auto names = globalDatasetNames(comm, iteration);
+        const size_t num = names.size();
+        // local sketches, with empty ones for datasets this server lacks
+        std::vector<DatasetSketch*> sketches(num);
+        std::vector<bool> present(num, false);
+        std::vector<std::unique_ptr<DatasetSketch>> empty;
+        {
+            std::lock_guard<tl::mutex> g(m_sketches_mtx);
+            auto& local = m_sketches[iteration];
+            for(size_t d = 0; d < num; d++) {
+                auto it = local.find(names[d]);
+                if(it != local.end() && it->second) {
+                    sketches[d] = it->second.get();
+                    present[d] = true;
+                } else {
+                    empty.emplace_back(new DatasetSketch(config, Type::UINT8, 0));
+                    sketches[d] = empty.back().get();
+                }
+            }
+        }
+
+        // registers and counters are merged with allreduce
+        std::vector<uint8_t> registers;
+        std::vector<uint64_t> counters;
+        for(auto s : sketches) {
+            auto& r = s->distinct.registers();
+            auto& c = s->frequencies.counters();
+            registers.insert(registers.end(), r.begin(), r.end());
+            counters.insert(counters.end(), c.begin(), c.end());
+        }
+        bool distributed = comm && comm.size() > 1 && num != 0;
+        if(distributed) {
+            using Op = Communicator::ReduceOp;
+            comm.allreduce(registers.data(), registers.data(), registers.size(),
+                           Type::UINT8, Op::MAX);
+            comm.allreduce(counters.data(), counters.data(), counters.size(),
+                           Type::UINT64, Op::SUM);
+        }
+        // quantile sketches and candidates are gathered on all the servers
+        std::vector<char> local;
+        for(size_t d = 0; d < num; d++) {
+            Put(local, static_cast<uint32_t>(present[d]));
+            Put(local, static_cast<uint32_t>(sketches[d]->type));
+            sketches[d]->quantiles.serialize(local);
+            auto keys = sketches[d]->candidates.candidates();
+            Put(local, static_cast<uint64_t>(keys.size()));
+            for(auto k : keys) Put(local, k);
+        }
+        auto all = distributed ? AllgatherBytes(comm, local)
+                               : std::vector<std::vector<char>>{ local };
+
+        std::vector<const char*> cursors;
+        for(auto& buf : all) cursors.push_back(buf.data());
+        size_t r_offset = 0, c_offset = 0;
+        json result = json::object();
+        for(size_t d = 0; d < num; d++) {
+            DatasetSketch merged(config, Type::UINT8, 0);
+            std::set<uint64_t> keys;
+            bool typed = false;
+            for(auto& in : cursors) {
+                uint32_t has = 0, type = 0;
+                uint64_t num_keys = 0;
+                in = Get(in, has);
+                in = Get(in, type);
+                KLLSketch q;
+                in = q.deserialize(in);
+                merged.quantiles.merge(q);
+                in = Get(in, num_keys);
+                for(uint64_t k = 0; k < num_keys; k++) {
+                    uint64_t key;
+                    in = Get(in, key);
+                    keys.insert(key);
+                }
+                if(has && !typed) {
+                    merged.type = static_cast<Type>(type);
+                    typed = true;
+                }
+            }
+            auto& r = merged.distinct.registers();
+            std::copy(registers.begin() + r_offset, registers.begin() + r_offset + r.size(), r.begin());
+            r_offset += r.size();
+            auto& c = merged.frequencies.counters();
+            std::copy(counters.begin() + c_offset, counters.begin() + c_offset + c.size(), c.begin());
+            c_offset += c.size();
+
+            json stats;
+            uint64_t count = merged.quantiles.count();
+            stats["count"] = count;
+            auto qs = merged.quantiles.quantiles(config.quantile_points);
+            json quantiles = json::object();
+            for(size_t i = 0; i < qs.size() && count != 0; i++)
+                quantiles[std::to_string(config.quantile_points[i])] = qs[i];
+            stats["quantiles"] = {
+                { "rank_error", config.quantile_epsilon },
+                { "values", std::move(quantiles) }
+            };
+            stats["distinct"] = {
+                { "relative_error", config.distinct_error },
+                { "estimate", count ? merged.distinct.estimate() : 0.0 }
+            };
+            std::vector<std::pair<uint64_t, uint64_t>> top;
+            for(auto k : keys)
+                top.emplace_back(merged.frequencies.estimate(Mix64(k)), k);
+            std::sort(top.begin(), top.end(), std::greater<std::pair<uint64_t, uint64_t>>());
+            if(top.size() > config.top_k) top.resize(config.top_k);
+            json heavy = json::array();
+            for(auto& t : top)
+                heavy.push_back({ { "value", ValueFromBits(merged.type, t.second) },
+                                  { "count", t.first } });
+            stats["top_k"] = {
+                { "count_error", config.top_k_epsilon*count },
+                { "values", std::move(heavy) }
+            };
+            result[names[d]] = std::move(stats);
+        }
+        publishResults(iteration, std::move(result), comm);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    return Success();
+}
+
+void SketchPipeline::abort(uint64_t iteration) {
+    waitForSpawned(iteration);
+    {
+        std::lock_guard<tl::mutex> g(m_sketches_mtx);
+        m_sketches.erase(iteration);
+    }
+    StagingPipeline::abort(iteration);
+}
+
+RequestResult<int32_t> SketchPipeline::cleanup(uint64_t iteration) {
+    waitForSpawned(iteration);
+    {
+        std::lock_guard<tl::mutex> g(m_sketches_mtx);
+        m_sketches.erase(iteration);
+    }
+    return StagingPipeline::cleanup(iteration);
+}
+
+RequestResult<int32_t> SketchPipeline::reset() {
+    waitForAllSpawned();
+    {
+        std::lock_guard<tl::mutex> g(m_sketches_mtx);
+        m_sketches.clear();
+    }
+    return StagingPipeline::reset();
+}
+
+std::unique_ptr<Backend> SketchPipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new SketchPipeline(args));
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_SKETCH_PIPELINE_HPP
+#define __COLZA_SKETCH_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+#include "Sketches.hpp"
+
+namespace colza {
+
+/**
+ * @brief The "sketches" backend computes approximate quantiles
+ * (KLL), distinct counts (HyperLogLog) and heavy hitters (Misra-Gries
+ * candidates with count-min estimates) for each dataset of an
+ * iteration, across all the servers.
+ *
+ * Sketches are built for each block in a ULT of the provider's pool
+ * as soon as the block is staged, and merged into the server's sketch
+ * of the dataset; execute only merges the servers' sketches.
+ *
+ * Configuration (all fields optional):
+ * {
+ *     "quantiles" : { "epsilon" : 0.01,           // rank error
+ *                     "points"  : [ 0.5, 0.99 ] },
+ *     "distinct"  : { "relative_error" : 0.02 },
+ *     "top_k"     : { "k" : 10,
+ *                     "epsilon" : 0.001,          // count error / N
+ *                     "delta"   : 0.01 },         // failure probability
+ *     "output"    : "path/to/sketches.jsonl"
+ * }
+ */
+class SketchPipeline : public StagingPipeline {
+
+    struct Config {
+        double              quantile_epsilon = 0.01;
+        std::vector<double> quantile_points  = { 0.0, 0.01, 0.25, 0.5, 0.75, 0.99, 1.0 };
+        double              distinct_error   = 0.02;
+        size_t              top_k            = 10;
+        double              top_k_epsilon    = 0.001;
+        double              top_k_delta      = 0.01;
+    };
+
+    struct DatasetSketch {
+        Type           type;
+        KLLSketch      quantiles;
+        HyperLogLog    distinct;
+        CountMinSketch frequencies;
+        MisraGries     candidates;
+
+        DatasetSketch(const Config& config, Type t, uint64_t seed);
+        void merge(const DatasetSketch& other);
+    };
+
+    using SketchMap = std::map<std::string, std::unique_ptr<DatasetSketch>>;
+
+    Config                        m_sketch_config;
+    std::map<uint64_t, SketchMap> m_sketches;
+    tl::mutex                     m_sketches_mtx;
+
+    public:
+
+    SketchPipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args) {
+        onConfigure(args.config);
+    }
+
+    /**
+     * @brief Merges the sketches of all the servers and computes the
+     * results. This is a collective operation.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> reset() override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    void onStaged(const std::string& dataset_name,
+                  uint64_t iteration,
+                  uint64_t block_id,
+                  const BlockStore::BlockPtr& block) override;
+
+    void onConfigure(const json& config) override;
+};
+
+}
+
+#endif
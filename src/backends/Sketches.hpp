@@ -0,0 +1,344 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_SKETCHES_HPP
+#define __COLZA_SKETCHES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace colza {
+
+/**
+ * @brief 64-bit mixing function (splitmix64 finalizer).
+ */
+inline uint64_t Mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief KLL quantile sketch. Items are kept in levels of compactors;
+ * an item at level h has weight 2^h. When a level exceeds its capacity
+ * it is sorted and every other item (with a random offset) is promoted
+ * to the next level. The rank error is O(1/k) with high probability.
+ * Sketches are mergeable and can be serialized.
+ */
+class KLLSketch {
+
+    size_t                           m_k = 200;
+    uint64_t                         m_n = 0;
+    uint64_t                         m_rng = 1;
+    std::vector<std::vector<double>> m_levels;
+
+    size_t capacity(size_t level) const {
+        size_t depth = m_levels.size() - 1 - level;
+        double c = std::ceil(m_k * std::pow(2.0/3.0, (double)depth));
+        return c < 2.0 ? 2 : (size_t)c;
+    }
+
+    bool randomBit() {
+        m_rng = Mix64(m_rng);
+        return m_rng & 1;
+    }
+
+    // adding a level lowers the capacity of the levels below it,
+    // so compaction is repeated until every level fits
+    void compress() {
+        bool compacted = true;
+        while(compacted) {
+            compacted = false;
+            for(size_t h = 0; h < m_levels.size(); h++) {
+                if(m_levels[h].size() <= capacity(h)) continue;
+                compact(h);
+                compacted = true;
+            }
+        }
+    }
+
+    void compact(size_t h) {
+        if(h + 1 == m_levels.size()) m_levels.emplace_back();
+        auto& level = m_levels[h];
+        std::sort(level.begin(), level.end());
+        // an odd item out stays at this level
+        double leftover = 0.0;
+        bool odd = level.size() % 2 == 1;
+        if(odd) {
+            leftover = level.back();
+            level.pop_back();
+        }
+        auto& next = m_levels[h + 1];
+        for(size_t i = randomBit() ? 1 : 0; i < level.size(); i += 2)
+            next.push_back(level[i]);
+        level.clear();
+        if(odd) level.push_back(leftover);
+    }
+
+    public:
+
+    KLLSketch(size_t k = 200, uint64_t seed = 1)
+    : m_k(k < 8 ? 8 : k)
+    , m_rng(seed)
+    , m_levels(1) {}
+
+    /**
+     * @brief Parameter k giving a normalized rank error of about
+     * epsilon.
+     */
+    static size_t KForEpsilon(double epsilon) {
+        return (size_t)std::ceil(1.7/epsilon);
+    }
+
+    uint64_t count() const {
+        return m_n;
+    }
+
+    template<typename T>
+    void update(const T* x, size_t n) {
+        size_t i = 0;
+        while(i < n) {
+            auto& level0 = m_levels[0];
+            size_t cap = capacity(0);
+            size_t room = level0.size() <= cap ? cap + 1 - level0.size() : 1;
+            size_t end = std::min(n, i + room);
+            for(; i < end; i++)
+                level0.push_back(static_cast<double>(x[i]));
+            compress();
+        }
+        m_n += n;
+    }
+
+    void merge(const KLLSketch& other) {
+        while(m_levels.size() < other.m_levels.size())
+            m_levels.emplace_back();
+        for(size_t h = 0; h < other.m_levels.size(); h++)
+            m_levels[h].insert(m_levels[h].end(),
+                               other.m_levels[h].begin(), other.m_levels[h].end());
+        m_n += other.m_n;
+        compress();
+    }
+
+    /**
+     * @brief Returns the approximate quantiles (in [0,1]) of the items.
+     */
+    std::vector<double> quantiles(const std::vector<double>& qs) const {
+        std::vector<std::pair<double, uint64_t>> items;
+        uint64_t total = 0;
+        for(size_t h = 0; h < m_levels.size(); h++) {
+            for(auto v : m_levels[h]) {
+                items.emplace_back(v, uint64_t(1) << h);
+                total += uint64_t(1) << h;
+            }
+        }
+        std::vector<double> result(qs.size(), std::nan(""));
+        if(items.empty()) return result;
+        std::sort(items.begin(), items.end());
+        for(size_t j = 0; j < qs.size(); j++) {
+            double target = qs[j]*total;
+            uint64_t acc = 0;
+            result[j] = items.back().first;
+            for(auto& item : items) {
+                acc += item.second;
+                if(acc >= target) {
+                    result[j] = item.first;
+                    break;
+                }
+            }
+        }
+        return result;
+    }
+
+    void serialize(std::vector<char>& out) const {
+        auto put = [&out](const void* p, size_t s) {
+            auto c = static_cast<const char*>(p);
+            out.insert(out.end(), c, c + s);
+        };
+        uint64_t header[3] = { m_k, m_n, m_levels.size() };
+        put(header, sizeof(header));
+        for(auto& level : m_levels) {
+            uint64_t size = level.size();
+            put(&size, sizeof(size));
+            put(level.data(), size*sizeof(double));
+        }
+    }
+
+    const char* deserialize(const char* in) {
+        uint64_t header[3];
+        std::memcpy(header, in, sizeof(header));
+        in += sizeof(header);
+        m_k = header[0];
+        m_n = header[1];
+        m_levels.assign(header[2], {});
+        for(auto& level : m_levels) {
+            uint64_t size;
+            std::memcpy(&size, in, sizeof(size));
+            in += sizeof(size);
+            level.resize(size);
+            std::memcpy(level.data(), in, size*sizeof(double));
+            in += size*sizeof(double);
+        }
+        if(m_levels.empty()) m_levels.emplace_back();
+        return in;
+    }
+};
+
+/**
+ * @brief HyperLogLog distinct-count sketch with 2^p one-byte registers.
+ * The relative standard error is about 1.04/sqrt(2^p). Merging two
+ * sketches takes the maximum of each register.
+ */
+class HyperLogLog {
+
+    unsigned             m_p = 12;
+    std::vector<uint8_t> m_registers;
+
+    public:
+
+    HyperLogLog(unsigned p = 12)
+    : m_p(p < 4 ? 4 : (p > 18 ? 18 : p))
+    , m_registers(size_t(1) << m_p, 0) {}
+
+    static unsigned PrecisionForError(double relative_error) {
+        double m = std::pow(1.04/relative_error, 2.0);
+        return (unsigned)std::ceil(std::log2(m));
+    }
+
+    void add(uint64_t hash) {
+        size_t index = hash >> (64 - m_p);
+        uint64_t rest = (hash << m_p) | (uint64_t(1) << (m_p - 1));
+        uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+        if(rank > m_registers[index]) m_registers[index] = rank;
+    }
+
+    void merge(const HyperLogLog& other) {
+        for(size_t i = 0; i < m_registers.size(); i++)
+            m_registers[i] = std::max(m_registers[i], other.m_registers[i]);
+    }
+
+    std::vector<uint8_t>& registers() {
+        return m_registers;
+    }
+
+    double estimate() const {
+        const double m = (double)m_registers.size();
+        double sum = 0.0;
+        size_t zeros = 0;
+        for(auto r : m_registers) {
+            sum += std::ldexp(1.0, -(int)r);
+            if(r == 0) zeros += 1;
+        }
+        double alpha = 0.7213/(1.0 + 1.079/m);
+        double e = alpha*m*m/sum;
+        if(e <= 2.5*m && zeros != 0)
+            e = m*std::log(m/zeros);
+        return e;
+    }
+};
+
+/**
+ * @brief Count-min sketch. Estimates exceed true counts by at most
+ * epsilon*N with probability 1-delta. Merging adds the counters.
+ */
+class CountMinSketch {
+
+    size_t                m_width = 0;
+    size_t                m_depth = 0;
+    std::vector<uint64_t> m_counters;
+
+    public:
+
+    CountMinSketch(double epsilon = 0.001, double delta = 0.01)
+    : m_width((size_t)std::ceil(std::exp(1.0)/epsilon))
+    , m_depth((size_t)std::ceil(std::log(1.0/delta)))
+    , m_counters(m_width*m_depth, 0) {}
+
+    void add(uint64_t hash, uint64_t count = 1) {
+        for(size_t d = 0; d < m_depth; d++)
+            m_counters[d*m_width + Mix64(hash + d) % m_width] += count;
+    }
+
+    uint64_t estimate(uint64_t hash) const {
+        uint64_t e = UINT64_MAX;
+        for(size_t d = 0; d < m_depth; d++)
+            e = std::min(e, m_counters[d*m_width + Mix64(hash + d) % m_width]);
+        return e;
+    }
+
+    void merge(const CountMinSketch& other) {
+        for(size_t i = 0; i < m_counters.size(); i++)
+            m_counters[i] += other.m_counters[i];
+    }
+
+    std::vector<uint64_t>& counters() {
+        return m_counters;
+    }
+};
+
+/**
+ * @brief Misra-Gries summary keeping at most m candidates for the most
+ * frequent keys. Any key occurring more than N/(m+1) times is kept.
+ * Summaries are mergeable.
+ */
+class MisraGries {
+
+    size_t                                 m_capacity = 64;
+    std::unordered_map<uint64_t, uint64_t> m_counters;
+
+    void prune() {
+        if(m_counters.size() <= m_capacity) return;
+        std::vector<uint64_t> counts;
+        counts.reserve(m_counters.size());
+        for(auto& c : m_counters) counts.push_back(c.second);
+        std::nth_element(counts.begin(), counts.begin() + m_capacity,
+                         counts.end(), std::greater<uint64_t>());
+        uint64_t cut = counts[m_capacity];
+        for(auto it = m_counters.begin(); it != m_counters.end();) {
+            if(it->second <= cut) {
+                it = m_counters.erase(it);
+            } else {
+                it->second -= cut;
+                ++it;
+            }
+        }
+    }
+
+    public:
+
+    MisraGries(size_t capacity = 64)
+    : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+    void add(uint64_t key) {
+        m_counters[key] += 1;
+        // pruning every capacity insertions amortizes its cost
+        if(m_counters.size() > 2*m_capacity) prune();
+    }
+
+    void merge(const MisraGries& other) {
+        for(auto& c : other.m_counters)
+            m_counters[c.first] += c.second;
+        prune();
+    }
+
+    /**
+     * @brief Returns the candidate keys.
+     */
+    std::vector<uint64_t> candidates() {
+        prune();
+        std::vector<uint64_t> keys;
+        for(auto& c : m_counters) keys.push_back(c.first);
+        return keys;
+    }
+};
+
+}
+
+#endif
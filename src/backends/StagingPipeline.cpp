@@ -0,0 +1,369 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "StagingPipeline.hpp"
+#include "../TypeSizes.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <fstream>
+
+namespace colza {
+
+void StagingPipeline::updateMonaAddresses(
+        mona_instance_t mona,
+        const std::vector<na_addr_t>& addresses) {
+    spdlog::trace("Mona addresses have been updated, group size is now {}", addresses.size());
+    (void)mona;
+}
+
+void StagingPipeline::updateCommunicator(const Communicator& comm) {
+    std::lock_guard<tl::mutex> g(m_comm_mtx);
+    m_comm = comm;
+}
+
+Communicator StagingPipeline::communicator() {
+    std::lock_guard<tl::mutex> g(m_comm_mtx);
+    return m_comm;
+}
+
+RequestResult<int32_t> StagingPipeline::start(uint64_t iteration) {
+    spdlog::trace("Iteration {} starting", iteration);
+    return Success();
+}
+
+void StagingPipeline::abort(uint64_t iteration) {
+    spdlog::trace("Iteration {} aborted", iteration);
+    m_store.erase(iteration);
+    std::lock_guard<tl::mutex> g(m_catalog_mtx);
+    m_catalog.erase(iteration);
+}
+
+RequestResult<int32_t> StagingPipeline::stage(
+        const std::string& sender_addr,
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const std::vector<size_t>& dimensions,
+        const std::vector<int64_t>& offsets,
+        const Type& type,
+        const thallium::bulk& data) {
+    if(data.size() != ComputeDataSize(dimensions, type))
+        return Failure("Block size does not match its dimensions and type");
+
+    BlockStore::BlockPtr stored;
+    try {
+        stored = m_store.stage(m_engine, sender_addr, dataset_name, iteration,
+                               block_id, dimensions, offsets, type, data);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what());
+    }
+    return afterStaging(dataset_name, iteration, block_id, stored);
+}
+
+RequestResult<int32_t> StagingPipeline::stageShared(
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const BlockStore::BlockPtr& block) {
+    BlockStore::BlockPtr stored;
+    try {
+        stored = m_store.link(dataset_name, iteration, block_id, block);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what());
+    }
+    return afterStaging(dataset_name, iteration, block_id, stored);
+}
+
+RequestResult<int32_t> StagingPipeline::afterStaging(const std::string& dataset_name,
+                                                     uint64_t iteration,
+                                                     uint64_t block_id,
+                                                     const BlockStore::BlockPtr& block) {
+    {
+        std::lock_guard<tl::mutex> g(m_catalog_mtx);
+        m_catalog.insert(dataset_name, iteration, block_id,
+                         Box::FromBlock(block->dimensions, block->offsets));
+    }
+    try {
+        onStaged(dataset_name, iteration, block_id, block);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what());
+    }
+    return Success();
+}
+
+void StagingPipeline::spawnOnStaged(uint64_t iteration,
+                                    const BlockStore::BlockPtr& block,
+                                    std::function<void(const StagedBlock&)> work) {
+    {
+        std::lock_guard<tl::mutex> g(m_spawned_mtx);
+        m_spawned[iteration] += 1;
+    }
+    m_pool.make_thread([this, iteration, block, work = std::move(work)]() {
+        try {
+            work(*block);
+        } catch(const std::exception& ex) {
+            spdlog::error("Could not process block {} of dataset {}: {}",
+                          block->block_id, *block->dataset_name, ex.what());
+        }
+        std::lock_guard<tl::mutex> g(m_spawned_mtx);
+        m_spawned[iteration] -= 1;
+        m_spawned_cv.notify_all();
+    }, tl::anonymous());
+}
+
+void StagingPipeline::waitForSpawned(uint64_t iteration) {
+    std::unique_lock<tl::mutex> lock(m_spawned_mtx);
+    while(m_spawned[iteration] != 0)
+        m_spawned_cv.wait(lock);
+    m_spawned.erase(iteration);
+}
+
+void StagingPipeline::waitForAllSpawned() {
+    std::unique_lock<tl::mutex> lock(m_spawned_mtx);
+    auto busy = [this]() {
+        for(auto& p : m_spawned)
+            if(p.second != 0) return true;
+        return false;
+    };
+    while(busy())
+        m_spawned_cv.wait(lock);
+    m_spawned.clear();
+}
+
+RequestResult<int32_t> StagingPipeline::cleanup(uint64_t iteration) {
+    {
+        std::lock_guard<tl::mutex> g(m_results_mtx);
+        m_results.erase(iteration);
+    }
+    m_store.erase(iteration);
+    std::lock_guard<tl::mutex> g(m_catalog_mtx);
+    m_catalog.erase(iteration);
+    return Success();
+}
+
+RequestResult<int32_t> StagingPipeline::destroy() {
+    return Success();
+}
+
+RequestResult<int32_t> StagingPipeline::reconfigure(const json& config) {
+    try {
+        onConfigure(config);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::JSON_CONFIG_ERROR);
+    }
+    m_config = config;
+    m_output = config.value("output", std::string());
+    return Success();
+}
+
+RequestResult<int32_t> StagingPipeline::reset() {
+    {
+        std::lock_guard<tl::mutex> g(m_results_mtx);
+        m_results.clear();
+    }
+    m_store.clear();
+    std::lock_guard<tl::mutex> g(m_catalog_mtx);
+    m_catalog.clear();
+    return Success();
+}
+
+std::vector<ExportedBlock> StagingPipeline::exportBlocks() {
+    // the exposed memory remains valid until the iteration is cleaned up
+    std::vector<ExportedBlock> blocks;
+    for(auto iteration : m_store.iterations()) {
+        for(auto& block : m_store.blocks(iteration)) {
+            ExportedBlock exported;
+            exported.dataset_name = *block->dataset_name;
+            exported.iteration    = iteration;
+            exported.block_id     = block->block_id;
+            exported.dimensions   = block->dimensions;
+            exported.offsets      = block->offsets;
+            exported.type         = block->type;
+            std::vector<std::pair<void*, size_t>> segments = {
+                std::pair<void*, size_t>(block->data, block->size)
+            };
+            exported.data = m_engine.expose(segments, tl::bulk_mode::read_only);
+            blocks.push_back(std::move(exported));
+        }
+    }
+    return blocks;
+}
+
+namespace {
+
+BlockInfo InfoOf(const StagedBlock& block) {
+    BlockInfo info;
+    info.dimensions = block.dimensions;
+    info.offsets    = block.offsets;
+    info.type       = block.type;
+    info.size       = block.size;
+    return info;
+}
+
+}
+
+RequestResult<int32_t> StagingPipeline::fetch(const std::string& dataset_name,
+                                              uint64_t iteration,
+                                              uint64_t block_id,
+                                              const FetchCallback& push) {
+    // the block remains valid while it is pushed, even if the
+    // iteration is cleaned up concurrently
+    auto block = m_store.find(dataset_name, iteration, block_id);
+    if(block)
+        return push(InfoOf(*block), block->data);
+    return fetchDerived(dataset_name, iteration, block_id, push);
+}
+
+RequestResult<int32_t> StagingPipeline::query(const std::string& dataset_name,
+                                              uint64_t iteration,
+                                              const Box& region,
+                                              const FetchCallback& push) {
+    std::vector<uint64_t> block_ids;
+    bool staged = false;
+    {
+        std::lock_guard<tl::mutex> g(m_catalog_mtx);
+        staged = m_catalog.count(dataset_name, iteration) != 0;
+        if(staged)
+            block_ids = m_catalog.find(dataset_name, iteration, region);
+    }
+    if(!staged)
+        return queryDerived(dataset_name, iteration, region, push);
+    for(auto block_id : block_ids) {
+        auto block = m_store.find(dataset_name, iteration, block_id);
+        if(!block) continue;
+        auto result = push(InfoOf(*block), block->data);
+        if(!result.success())
+            return result;
+    }
+    return Success();
+}
+
+RequestResult<int32_t> StagingPipeline::summarize(const std::string& dataset_name,
+                                                  uint64_t iteration,
+                                                  size_t max_boxes,
+                                                  std::vector<Box>& boxes) {
+    std::lock_guard<tl::mutex> g(m_catalog_mtx);
+    boxes = m_catalog.summary(dataset_name, iteration, max_boxes);
+    return Success();
+}
+
+RequestResult<int32_t> StagingPipeline::fetchDerived(const std::string& dataset_name,
+                                                     uint64_t iteration,
+                                                     uint64_t block_id,
+                                                     const FetchCallback& push) {
+    if(dataset_name == "$results" && block_id == 0) {
+        std::string document;
+        {
+            std::lock_guard<tl::mutex> g(m_results_mtx);
+            auto it = m_results.find(iteration);
+            if(it != m_results.end())
+                document = it->second.dump();
+        }
+        if(!document.empty()) {
+            BlockInfo info;
+            info.dimensions = { document.size() };
+            info.type       = Type::UINT8;
+            info.size       = document.size();
+            return push(info, document.data());
+        }
+    }
+    return Failure("Block not found", ErrorCode::BLOCK_NOT_FOUND);
+}
+
+std::map<std::string, std::vector<const StagedBlock*>> StagingPipeline::blocksOf(uint64_t iteration) {
+    std::map<std::string, std::vector<const StagedBlock*>> result;
+    for(auto& block : m_store.blocks(iteration))
+        result[*block->dataset_name].push_back(block.get());
+    return result;
+}
+
+std::vector<std::string> StagingPipeline::globalDatasetNames(const Communicator& comm,
+                                                             uint64_t iteration) {
+    std::vector<std::string> names = m_store.datasets(iteration);
+    if(!comm || comm.size() == 1) return names;
+    // serialize the names as null-terminated strings and gather them
+    std::vector<char> local;
+    for(auto& name : names) {
+        local.insert(local.end(), name.begin(), name.end());
+        local.push_back('\0');
+    }
+    names.clear();
+    for(auto& all : AllgatherBytes(comm, local)) {
+        size_t start = 0;
+        for(size_t i = 0; i < all.size(); i++) {
+            if(all[i] != '\0') continue;
+            names.emplace_back(all.data() + start, i - start);
+            start = i + 1;
+        }
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+std::vector<std::vector<char>> StagingPipeline::AllgatherBytes(const Communicator& comm,
+                                                               const std::vector<char>& local) {
+    const int n = comm.size();
+    uint64_t size = local.size();
+    std::vector<uint64_t> sizes(n);
+    comm.allgather(&size, sizeof(size), sizes.data());
+    std::vector<size_t> sendcounts(n, local.size()), sdispls(n, 0);
+    std::vector<size_t> recvcounts(sizes.begin(), sizes.end()), rdispls(n, 0);
+    for(int i = 1; i < n; i++)
+        rdispls[i] = rdispls[i-1] + recvcounts[i-1];
+    std::vector<char> all(rdispls[n-1] + recvcounts[n-1]);
+    comm.alltoallv(local.data(), sendcounts, sdispls,
+                   all.data(), recvcounts, rdispls);
+    std::vector<std::vector<char>> result(n);
+    for(int i = 0; i < n; i++)
+        result[i].assign(all.begin() + rdispls[i], all.begin() + rdispls[i] + recvcounts[i]);
+    return result;
+}
+
+std::vector<std::vector<char>> StagingPipeline::GatherBytes(const Communicator& comm,
+                                                            const std::vector<char>& local,
+                                                            int root) {
+    const int n = comm.size();
+    uint64_t size = local.size();
+    std::vector<uint64_t> sizes(n);
+    comm.allgather(&size, sizeof(size), sizes.data());
+    std::vector<size_t> sendcounts(n, 0), sdispls(n, 0);
+    std::vector<size_t> recvcounts(n, 0), rdispls(n, 0);
+    sendcounts[root] = local.size();
+    if(comm.rank() == root) {
+        recvcounts.assign(sizes.begin(), sizes.end());
+        for(int i = 1; i < n; i++)
+            rdispls[i] = rdispls[i-1] + recvcounts[i-1];
+    }
+    std::vector<char> all(rdispls[n-1] + recvcounts[n-1]);
+    comm.alltoallv(local.data(), sendcounts, sdispls,
+                   all.data(), recvcounts, rdispls);
+    std::vector<std::vector<char>> result(n);
+    if(comm.rank() != root) return result;
+    for(int i = 0; i < n; i++)
+        result[i].assign(all.begin() + rdispls[i], all.begin() + rdispls[i] + recvcounts[i]);
+    return result;
+}
+
+void StagingPipeline::publishResults(uint64_t iteration, json results, const Communicator& comm) {
+    if(!m_output.empty() && (!comm || comm.rank() == 0)) {
+        std::ofstream out(m_output, std::ios::app);
+        out << json{ { "iteration", iteration }, { "datasets", results } }.dump() << '\n';
+        if(!out)
+            spdlog::error("Could not write results to {}", m_output);
+    }
+    spdlog::trace("Results for iteration {}: {}", iteration, results.dump());
+    std::lock_guard<tl::mutex> g(m_results_mtx);
+    m_results[iteration] = std::move(results);
+}
+
+json StagingPipeline::results(uint64_t iteration) {
+    std::lock_guard<tl::mutex> g(m_results_mtx);
+    auto it = m_results.find(iteration);
+    if(it == m_results.end()) return json();
+    return it->second;
+}
+
+}
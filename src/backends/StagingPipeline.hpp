@@ -0,0 +1,309 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_STAGING_PIPELINE_HPP
+#define __COLZA_STAGING_PIPELINE_HPP
+
+#include <colza/Backend.hpp>
+#include <colza/BlockCatalog.hpp>
+#include <colza/BlockStore.hpp>
+#include <colza/Communicator.hpp>
+#include <colza/TaskRuntime.hpp>
+#include <thallium.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace colza {
+
+namespace tl = thallium;
+using json = nlohmann::json;
+
+/**
+ * @brief Block staged into a StagingPipeline.
+ */
+using StagedBlock = BlockStore::Block;
+
+/**
+ * @brief Base class for the built-in backends. It implements staging
+ * (pulling blocks into a BlockStore and recording their boxes in a
+ * BlockCatalog), cleanup, reset, migration, fetching, region queries,
+ * and keeps the Communicator handed over by the provider. Derived classes
+ * implement execute, and can override onStaged to process blocks as
+ * soon as they arrive (in the background with spawnOnStaged). They can
+ * parallelize execute with m_tasks.
+ */
+class StagingPipeline : public Backend {
+
+    protected:
+
+    tl::engine     m_engine;
+    tl::pool       m_pool;
+    TaskRuntime    m_tasks; // runs on m_pool
+    ssg_group_id_t m_gid;
+    json           m_config;
+    BlockStore     m_store;
+    BlockCatalog   m_catalog; // boxes of m_store's blocks
+    tl::mutex      m_catalog_mtx;
+    Communicator   m_comm;
+    tl::mutex      m_comm_mtx;
+    std::string    m_output;
+    std::map<uint64_t, json> m_results;
+    tl::mutex      m_results_mtx;
+
+    public:
+
+    StagingPipeline(const PipelineFactoryArgs& args)
+    : m_engine(args.engine)
+    , m_pool(args.pool)
+    , m_tasks(args.pool, args.concurrency)
+    , m_gid(args.gid)
+    , m_config(args.config)
+    , m_output(args.config.value("output", std::string())) {}
+
+    StagingPipeline(StagingPipeline&&) = delete;
+    StagingPipeline(const StagingPipeline&) = delete;
+    StagingPipeline& operator=(StagingPipeline&&) = delete;
+    StagingPipeline& operator=(const StagingPipeline&) = delete;
+
+    virtual ~StagingPipeline() = default;
+
+    void updateMonaAddresses(
+            mona_instance_t mona,
+            const std::vector<na_addr_t>& addresses) override;
+
+    void updateCommunicator(const Communicator& comm) override;
+
+    RequestResult<int32_t> start(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    /**
+     * @brief Pulls the block from the sender, stores it, then calls
+     * onStaged.
+     */
+    RequestResult<int32_t> stage(
+            const std::string& sender_addr,
+            const std::string& dataset_name,
+            uint64_t iteration,
+            uint64_t block_id,
+            const std::vector<size_t>& dimensions,
+            const std::vector<int64_t>& offsets,
+            const Type& type,
+            const thallium::bulk& data) override;
+
+    /**
+     * @brief Stores a reference to the shared block, then calls
+     * onStaged.
+     */
+    RequestResult<int32_t> stageShared(
+            const std::string& dataset_name,
+            uint64_t iteration,
+            uint64_t block_id,
+            const BlockStore::BlockPtr& block) override;
+
+    /**
+     * @brief Erases the blocks and results of the iteration.
+     */
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> destroy() override;
+
+    /**
+     * @brief Replaces the configuration and calls onConfigure.
+     */
+    RequestResult<int32_t> reconfigure(const json& config) override;
+
+    /**
+     * @brief Erases all the blocks so the instance can be recycled.
+     */
+    RequestResult<int32_t> reset() override;
+
+    std::vector<ExportedBlock> exportBlocks() override;
+
+    /**
+     * @brief Serves the staged blocks that have not been cleaned up,
+     * falling back to fetchDerived for the other names.
+     */
+    RequestResult<int32_t> fetch(const std::string& dataset_name,
+                                 uint64_t iteration,
+                                 uint64_t block_id,
+                                 const FetchCallback& push) override;
+
+    /**
+     * @brief Hands over the staged blocks of the dataset that intersect
+     * the region, falling back to queryDerived if the dataset has no
+     * staged block on this server.
+     */
+    RequestResult<int32_t> query(const std::string& dataset_name,
+                                 uint64_t iteration,
+                                 const Box& region,
+                                 const FetchCallback& push) override;
+
+    /**
+     * @brief Summarizes the staged blocks of the dataset.
+     */
+    RequestResult<int32_t> summarize(const std::string& dataset_name,
+                                     uint64_t iteration,
+                                     size_t max_boxes,
+                                     std::vector<Box>& boxes) override;
+
+    /**
+     * @brief Returns the results published by execute for the
+     * iteration (null if there is none).
+     */
+    json results(uint64_t iteration);
+
+    protected:
+
+    /**
+     * @brief Called after a block has been stored. The block is
+     * not modified until the iteration is cleaned up.
+     */
+    virtual void onStaged(const std::string& dataset_name,
+                          uint64_t iteration,
+                          uint64_t block_id,
+                          const BlockStore::BlockPtr& block) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)block_id;
+        (void)block;
+    }
+
+    /**
+     * @brief Called by fetch for names that are not staged datasets,
+     * so that derived classes can serve the products of execute. The
+     * default implementation serves the results of the iteration, as
+     * a JSON document of type UINT8, under the name "$results" with
+     * block id 0.
+     */
+    virtual RequestResult<int32_t> fetchDerived(const std::string& dataset_name,
+                                                uint64_t iteration,
+                                                uint64_t block_id,
+                                                const FetchCallback& push);
+
+    /**
+     * @brief Called by query for names that are not staged datasets.
+     * The default implementation has no block to hand over.
+     */
+    virtual RequestResult<int32_t> queryDerived(const std::string& dataset_name,
+                                                uint64_t iteration,
+                                                const Box& region,
+                                                const FetchCallback& push) {
+        (void)dataset_name;
+        (void)iteration;
+        (void)region;
+        (void)push;
+        return Success();
+    }
+
+    /**
+     * @brief Called when the configuration is replaced. Throwing
+     * an exception rejects the configuration.
+     */
+    virtual void onConfigure(const json& config) {
+        (void)config;
+    }
+
+    /**
+     * @brief Runs work on the block in a ULT of m_pool, so that onStaged
+     * can return before the block is processed. The ULT holds a reference
+     * to the block, and is counted in the pending work of the iteration
+     * until work returns. Exceptions thrown by work are logged.
+     */
+    void spawnOnStaged(uint64_t iteration,
+                       const BlockStore::BlockPtr& block,
+                       std::function<void(const StagedBlock&)> work);
+
+    /**
+     * @brief Waits for the work spawned on the blocks of the iteration.
+     * Derived classes call it before using or erasing what that work
+     * produces (e.g. in execute and cleanup).
+     */
+    void waitForSpawned(uint64_t iteration);
+
+    /**
+     * @brief Waits for the work spawned on the blocks of all iterations.
+     */
+    void waitForAllSpawned();
+
+    /**
+     * @brief Returns the current Communicator (invalid if the
+     * provider could not build one).
+     */
+    Communicator communicator();
+
+    /**
+     * @brief Returns pointers to the blocks of the iteration, by
+     * dataset name, sorted by block id. The blocks remain valid until
+     * the iteration is cleaned up.
+     */
+    std::map<std::string, std::vector<const StagedBlock*>> blocksOf(uint64_t iteration);
+
+    /**
+     * @brief Returns the union of the dataset names of the iteration
+     * on all the members of the communicator, in the same order on all
+     * of them. This is a collective operation.
+     */
+    std::vector<std::string> globalDatasetNames(const Communicator& comm, uint64_t iteration);
+
+    /**
+     * @brief Gathers a variable amount of bytes from all the members
+     * of the communicator, indexed by rank. This is a collective
+     * operation.
+     */
+    static std::vector<std::vector<char>> AllgatherBytes(const Communicator& comm,
+                                                         const std::vector<char>& local);
+
+    /**
+     * @brief Same as AllgatherBytes, but only root receives the bytes
+     * (the other members get an empty vector). This is a collective
+     * operation.
+     */
+    static std::vector<std::vector<char>> GatherBytes(const Communicator& comm,
+                                                      const std::vector<char>& local,
+                                                      int root);
+
+    /**
+     * @brief Keeps the results of the iteration until it is cleaned up
+     * and, if the configuration has an "output" file, appends them to it
+     * as a JSON line (only on rank 0, since results are group-wide).
+     */
+    void publishResults(uint64_t iteration, json results, const Communicator& comm);
+
+    /**
+     * @brief Helpers to build RequestResults.
+     */
+    static RequestResult<int32_t> Success() {
+        RequestResult<int32_t> result;
+        result.value() = 0;
+        return result;
+    }
+
+    static RequestResult<int32_t> Failure(const std::string& error,
+                                          ErrorCode code = ErrorCode::OTHER_ERROR) {
+        RequestResult<int32_t> result;
+        result.success() = false;
+        result.error() = error;
+        result.value() = (int32_t)code;
+        return result;
+    }
+
+    private:
+
+    std::map<uint64_t, size_t> m_spawned; // ULTs running per iteration
+    tl::mutex                  m_spawned_mtx;
+    tl::condition_variable     m_spawned_cv;
+
+    RequestResult<int32_t> afterStaging(const std::string& dataset_name,
+                                        uint64_t iteration,
+                                        uint64_t block_id,
+                                        const BlockStore::BlockPtr& block);
+};
+
+}
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "StatisticsPipeline.hpp"
+#include "../TypeDispatch.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+COLZA_REGISTER_BACKEND(statistics, colza::StatisticsPipeline);
+
+namespace colza {
+
+namespace {
+
+// number of independent accumulators in the kernels, which lets the
+// compiler vectorize the loops despite the dependency on the accumulator
+constexpr size_t LANES = 8;
+
+// number of elements processed by a task of execute
+constexpr size_t CHUNK_SIZE = 1024*1024;
+
+// NaNs are counted in nans and left out of the other moments
+struct Moments {
+    double count = 0.0;
+    double nans  = 0.0;
+    double min   = std::numeric_limits<double>::infinity();
+    double max   = -std::numeric_limits<double>::infinity();
+    double sum   = 0.0;
+
+    void merge(const Moments& other) {
+        count += other.count;
+        nans  += other.nans;
+        min    = std::min(min, other.min);
+        max    = std::max(max, other.max);
+        sum   += other.sum;
+    }
+};
+
+// part of a block of the dataset with the given index
+struct Chunk {
+    size_t             dataset;
+    const StagedBlock* block;
+    size_t             begin;
+    size_t             end;
+
+    template<typename T>
+    const T* data() const {
+        return reinterpret_cast<const T*>(block->data) + begin;
+    }
+
+    size_t count() const {
+        return end - begin;
+    }
+};
+
+// the accumulators start from the identities of min and max rather than
+// from x[0], which may be a NaN; comparisons with a NaN are false, so
+// NaNs never replace them, and they are added to the sum as 0
+template<typename T>
+void MinMaxSum(const T* x, size_t n, Moments& m) {
+    if(n == 0) return;
+    using limits = std::numeric_limits<T>;
+    T lo[LANES], hi[LANES];
+    double s[LANES], nans[LANES];
+    for(size_t l = 0; l < LANES; l++) {
+        lo[l]   = limits::has_infinity ? limits::infinity() : limits::max();
+        hi[l]   = limits::has_infinity ? -limits::infinity() : limits::lowest();
+        s[l]    = 0.0;
+        nans[l] = 0.0;
+    }
+    size_t i = 0;
+    for(; i + LANES <= n; i += LANES) {
+        for(size_t l = 0; l < LANES; l++) {
+            T v = x[i+l];
+            lo[l] = v < lo[l] ? v : lo[l];
+            hi[l] = v > hi[l] ? v : hi[l];
+            s[l] += v == v ? static_cast<double>(v) : 0.0;
+            nans[l] += v == v ? 0.0 : 1.0;
+        }
+    }
+    for(; i < n; i++) {
+        T v = x[i];
+        lo[0] = v < lo[0] ? v : lo[0];
+        hi[0] = v > hi[0] ? v : hi[0];
+        s[0] += v == v ? static_cast<double>(v) : 0.0;
+        nans[0] += v == v ? 0.0 : 1.0;
+    }
+    double num_nans = 0.0;
+    for(size_t l = 0; l < LANES; l++) {
+        m.min  = std::min(m.min, static_cast<double>(lo[l]));
+        m.max  = std::max(m.max, static_cast<double>(hi[l]));
+        m.sum += s[l];
+        num_nans += nans[l];
+    }
+    m.count += static_cast<double>(n) - num_nans;
+    m.nans  += num_nans;
+}
+
+template<typename T>
+double SquaredDeviations(const T* x, size_t n, double mean) {
+    double s[LANES] = { 0.0 };
+    size_t i = 0;
+    for(; i + LANES <= n; i += LANES) {
+        for(size_t l = 0; l < LANES; l++) {
+            double d = static_cast<double>(x[i+l]) - mean;
+            s[l] += d == d ? d*d : 0.0; // NaN
+        }
+    }
+    for(; i < n; i++) {
+        double d = static_cast<double>(x[i]) - mean;
+        s[0] += d == d ? d*d : 0.0;
+    }
+    double total = 0.0;
+    for(size_t l = 0; l < LANES; l++) total += s[l];
+    return total;
+}
+
+// counts has bins+2 entries, the last two being underflow and overflow
+template<typename T>
+void Histogram(const T* x, size_t n, double lo, double hi, size_t bins, uint64_t* counts) {
+    const double scale = hi > lo ? bins/(hi - lo) : 0.0;
+    for(size_t i = 0; i < n; i++) {
+        double v = static_cast<double>(x[i]);
+        if(v != v) continue; // NaN
+        if(v < lo) {
+            counts[bins] += 1;
+        } else if(v > hi) {
+            counts[bins+1] += 1;
+        } else {
+            size_t b = static_cast<size_t>((v - lo)*scale);
+            counts[b < bins ? b : bins - 1] += 1;
+        }
+    }
+}
+
+}
+
+void StatisticsPipeline::onConfigure(const json& config) {
+    std::vector<std::string> selected;
+    HistogramConfig histogram;
+    if(config.contains("datasets"))
+        selected = config["datasets"].get<std::vector<std::string>>();
+    if(config.contains("histogram")) {
+        auto& h = config["histogram"];
+        histogram.bins = h.value("bins", histogram.bins);
+        if(h.contains("range")) {
+            auto range = h["range"].get<std::vector<double>>();
+            if(range.size() != 2 || !(range[0] < range[1]))
+                throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                    "\"range\" should be an array [lo, hi] with lo < hi");
+            histogram.fixed_range = true;
+            histogram.lo = range[0];
+            histogram.hi = range[1];
+        }
+    }
+    std::sort(selected.begin(), selected.end());
+    m_selected  = std::move(selected);
+    m_histogram = histogram;
+}
+
+RequestResult<int32_t> StatisticsPipeline::execute(uint64_t iteration) {
+    auto comm = communicator();
+    if(!comm)
+        spdlog::warn("Statistics pipeline has no communicator, results will be local");
+    std::vector<std::string> names;
+    try {
+        names = globalDatasetNames(comm, iteration);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    if(!m_selected.empty()) {
+        std::vector<std::string> kept;
+        std::set_intersection(names.begin(), names.end(),
+                              m_selected.begin(), m_selected.end(),
+                              std::back_inserter(kept));
+        names = std::move(kept);
+    }
+    auto blocks = blocksOf(iteration);
+    const size_t num = names.size();
+    const size_t bins = m_histogram.bins;
+
+    // the blocks are split into chunks processed in parallel, each with
+    // its own accumulators, merged in chunk order so that the results do
+    // not depend on the scheduling of the tasks
+    std::vector<Chunk> chunks;
+    for(size_t d = 0; d < num; d++) {
+        for(auto block : blocks[names[d]]) {
+            const size_t n = block->count();
+            for(size_t b = 0; b < n; b += CHUNK_SIZE)
+                chunks.push_back(Chunk{ d, block, b, std::min(n, b + CHUNK_SIZE) });
+        }
+    }
+
+    // local min, max, count and sum of each dataset
+    std::vector<Moments> chunk_moments(chunks.size());
+    m_tasks.parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last) {
+        for(size_t c = first; c < last; c++) {
+            DispatchType(chunks[c].block->type, [&](auto tag) {
+                using T = typename decltype(tag)::type;
+                MinMaxSum(chunks[c].data<T>(), chunks[c].count(), chunk_moments[c]);
+            });
+        }
+    });
+    std::vector<Moments> moments(num);
+    for(size_t c = 0; c < chunks.size(); c++)
+        moments[chunks[c].dataset].merge(chunk_moments[c]);
+    // all the datasets are reduced at once, one allreduce per operation
+    std::vector<double> mins(num), maxs(num), sums(3*num);
+    for(size_t d = 0; d < num; d++) {
+        mins[d]       = moments[d].min;
+        maxs[d]       = moments[d].max;
+        sums[3*d]     = moments[d].count;
+        sums[3*d + 1] = moments[d].sum;
+        sums[3*d + 2] = moments[d].nans;
+    }
+    try {
+        if(comm && comm.size() > 1 && num != 0) {
+            using Op = Communicator::ReduceOp;
+            comm.allreduce(mins.data(), mins.data(), num, Type::FLOAT64, Op::MIN);
+            comm.allreduce(maxs.data(), maxs.data(), num, Type::FLOAT64, Op::MAX);
+            comm.allreduce(sums.data(), sums.data(), 3*num, Type::FLOAT64, Op::SUM);
+        }
+
+        // second pass: variance and histogram
+        std::vector<double> mean(num), m2(num, 0.0);
+        std::vector<double> lo(num), hi(num);
+        std::vector<uint64_t> hist(num*(bins + 2), 0);
+        for(size_t d = 0; d < num; d++) {
+            mean[d] = sums[3*d] > 0 ? sums[3*d + 1]/sums[3*d] : 0.0;
+            lo[d] = m_histogram.fixed_range ? m_histogram.lo : mins[d];
+            hi[d] = m_histogram.fixed_range ? m_histogram.hi : maxs[d];
+        }
+        std::vector<double> chunk_m2(chunks.size(), 0.0);
+        std::vector<uint64_t> chunk_hist(bins != 0 ? chunks.size()*(bins + 2) : 0, 0);
+        m_tasks.parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last) {
+            for(size_t c = first; c < last; c++) {
+                const size_t d = chunks[c].dataset;
+                DispatchType(chunks[c].block->type, [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    auto x = chunks[c].data<T>();
+                    chunk_m2[c] = SquaredDeviations(x, chunks[c].count(), mean[d]);
+                    if(bins != 0 && sums[3*d] > 0)
+                        Histogram(x, chunks[c].count(), lo[d], hi[d], bins,
+                                  chunk_hist.data() + c*(bins + 2));
+                });
+            }
+        });
+        for(size_t c = 0; c < chunks.size(); c++) {
+            const size_t d = chunks[c].dataset;
+            m2[d] += chunk_m2[c];
+            for(size_t b = 0; bins != 0 && b < bins + 2; b++)
+                hist[d*(bins + 2) + b] += chunk_hist[c*(bins + 2) + b];
+        }
+        if(comm && comm.size() > 1 && num != 0) {
+            using Op = Communicator::ReduceOp;
+            comm.allreduce(m2.data(), m2.data(), num, Type::FLOAT64, Op::SUM);
+            if(bins != 0)
+                comm.allreduce(hist.data(), hist.data(), hist.size(), Type::UINT64, Op::SUM);
+        }
+
+        json result = json::object();
+        for(size_t d = 0; d < num; d++) {
+            json stats;
+            double count = sums[3*d];
+            stats["count"] = static_cast<uint64_t>(count);
+            stats["nans"]  = static_cast<uint64_t>(sums[3*d + 2]);
+            if(count > 0) {
+                stats["min"]      = mins[d];
+                stats["max"]      = maxs[d];
+                stats["sum"]      = sums[3*d + 1];
+                stats["mean"]     = mean[d];
+                stats["variance"] = m2[d]/count;
+            }
+            if(bins != 0 && count > 0) {
+                auto h = hist.begin() + d*(bins + 2);
+                stats["histogram"] = {
+                    { "range",     { lo[d], hi[d] } },
+                    { "bins",      std::vector<uint64_t>(h, h + bins) },
+                    { "underflow", h[bins] },
+                    { "overflow",  h[bins + 1] }
+                };
+            }
+            result[names[d]] = std::move(stats);
+        }
+        publishResults(iteration, std::move(result), comm);
+    } catch(const std::exception& ex) {
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    return Success();
+}
+
+std::unique_ptr<Backend> StatisticsPipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new StatisticsPipeline(args));
+}
+
+}
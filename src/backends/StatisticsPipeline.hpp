@@ -0,0 +1,69 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_STATISTICS_PIPELINE_HPP
+#define __COLZA_STATISTICS_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+
+namespace colza {
+
+/**
+ * @brief The "statistics" backend computes, for each dataset of an
+ * iteration, the count, min, max, sum, mean, variance and a histogram
+ * of the values of all the blocks staged on all the servers.
+ *
+ * Configuration:
+ * {
+ *     "datasets"  : [ "a", "b" ],          // optional, all by default
+ *     "histogram" : {
+ *         "bins"  : 64,                    // 0 disables the histogram
+ *         "range" : [ lo, hi ]             // optional, adaptive by default
+ *     },
+ *     "output"    : "path/to/stats.jsonl"  // optional
+ * }
+ *
+ * NaNs are left out of all the statistics and counted separately as
+ * "nans". Without a range, the histogram spans the global [min, max] of the
+ * dataset. With a fixed range, values outside of it are counted as
+ * underflow/overflow. Results are kept until the iteration is cleaned
+ * up and, if an output file is given, appended to it by rank 0 as one
+ * JSON line per iteration.
+ */
+class StatisticsPipeline : public StagingPipeline {
+
+    struct HistogramConfig {
+        size_t bins = 64;
+        bool   fixed_range = false;
+        double lo = 0.0;
+        double hi = 0.0;
+    };
+
+    std::vector<std::string> m_selected;
+    HistogramConfig          m_histogram;
+
+    public:
+
+    StatisticsPipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args) {
+        onConfigure(args.config);
+    }
+
+    /**
+     * @brief Computes the statistics of the iteration. This is
+     * a collective operation across the servers of the group.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    void onConfigure(const json& config) override;
+};
+
+}
+
+#endif
@@ -0,0 +1,535 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include "WriterPipeline.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+COLZA_REGISTER_BACKEND(writer, colza::WriterPipeline);
+
+namespace colza {
+
+namespace {
+
+using Layout = WriterPipeline::Layout;
+
+// maximum number of buffers passed to a single pwritev
+constexpr size_t MAX_IOVECS = 512;
+
+uint64_t AlignUp(uint64_t x, uint64_t alignment) {
+    return (x + alignment - 1)/alignment*alignment;
+}
+
+std::string ErrnoMessage(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// part of the region written by a server; data is null for padding
+struct Segment {
+    const char* data;
+    size_t      size;
+};
+
+// keeping the blocks of an iteration alive after it is erased from the store
+using Blocks = std::vector<BlockStore::BlockPtr>;
+
+// called with the number of bytes of each completed write request
+using Progress = std::function<void(size_t)>;
+
+void WriteAll(int fd, const char* buffer, size_t size, uint64_t offset) {
+    while(size) {
+        ssize_t n = pwrite(fd, buffer, size, (off_t)offset);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0)
+            throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("pwrite failed"));
+        buffer += n;
+        size   -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+}
+
+// writes the segments back to back from offset, straight from the
+// blocks, in requests of at most buffer_size bytes
+void WriteGathered(int fd, const std::vector<Segment>& segments,
+                   uint64_t offset, size_t buffer_size, const Progress& progress) {
+    static const std::vector<char> zeros(65536, 0);
+    std::vector<struct iovec> iov;
+    size_t batch = 0;
+    auto flush = [&]() {
+        size_t first = 0;
+        while(first < iov.size()) {
+            int count = (int)std::min(iov.size() - first, MAX_IOVECS);
+            ssize_t n = pwritev(fd, iov.data() + first, count, (off_t)offset);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0)
+                throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("pwritev failed"));
+            offset += (uint64_t)n;
+            progress((size_t)n);
+            size_t left = (size_t)n;
+            while(first < iov.size() && left >= iov[first].iov_len) {
+                left -= iov[first].iov_len;
+                first++;
+            }
+            if(left) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+        iov.clear();
+        batch = 0;
+    };
+    for(const auto& s : segments) {
+        size_t done = 0;
+        while(done < s.size) {
+            size_t len = std::min(s.size - done, buffer_size - batch);
+            const char* data = s.data + done;
+            if(!s.data) {
+                len  = std::min(len, zeros.size());
+                data = zeros.data();
+            }
+            iov.push_back({ const_cast<char*>(data), len });
+            batch += len;
+            done  += len;
+            if(batch == buffer_size || iov.size() == MAX_IOVECS) flush();
+        }
+    }
+    flush();
+}
+
+// writes the segments back to back from offset through an aligned
+// buffer, as required by O_DIRECT; the offset and the total size of
+// the segments must be multiples of the alignment
+void WriteBuffered(int fd, const std::vector<Segment>& segments,
+                   uint64_t offset, size_t buffer_size, size_t alignment,
+                   const Progress& progress) {
+    const size_t capacity = (size_t)AlignUp(buffer_size, alignment);
+    void* ptr = nullptr;
+    if(posix_memalign(&ptr, alignment, capacity) != 0)
+        throw Exception(ErrorCode::OTHER_ERROR, "Could not allocate aligned buffer");
+    std::unique_ptr<char, decltype(&std::free)> buffer(static_cast<char*>(ptr), &std::free);
+    size_t fill = 0;
+    for(const auto& s : segments) {
+        size_t done = 0;
+        while(done < s.size) {
+            size_t len = std::min(s.size - done, capacity - fill);
+            if(s.data) std::memcpy(buffer.get() + fill, s.data + done, len);
+            else       std::memset(buffer.get() + fill, 0, len);
+            fill += len;
+            done += len;
+            if(fill == capacity) {
+                WriteAll(fd, buffer.get(), capacity, offset);
+                progress(capacity);
+                offset += capacity;
+                fill = 0;
+            }
+        }
+    }
+    if(fill) {
+        size_t len = (size_t)AlignUp(fill, alignment);
+        std::memset(buffer.get() + fill, 0, len - fill);
+        WriteAll(fd, buffer.get(), len, offset);
+        progress(len);
+    }
+}
+
+}
+
+// blocks handed over by execute to the drain
+struct WriterPipeline::WriteJob {
+    uint64_t             iteration = 0;
+    Config               config;
+    Communicator         comm;
+    int                  rank = 0;
+    Blocks               blocks;
+    size_t               num_blocks = 0;
+    size_t               memory = 0;    // staged bytes released once written
+    std::vector<Segment> segments;
+    std::string          file;
+    uint64_t             offset = 0;    // of the region in the file
+    uint64_t             bytes = 0;     // size of the region
+    uint64_t             file_size = 0; // to truncate to, if not 0
+    std::string          index_file;    // on server 0 only
+    json                 index;
+    std::chrono::steady_clock::time_point queued;
+};
+
+void WriterPipeline::WriteJobData(const WriteJob& job, const Progress& progress) {
+    const auto& config = job.config;
+    if(mkdir(config.path.c_str(), 0755) != 0 && errno != EEXIST)
+        throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("Could not create " + config.path));
+    int flags = O_WRONLY | O_CREAT;
+    if(config.direct) flags |= O_DIRECT;
+    int fd = open(job.file.c_str(), flags, 0644);
+    if(fd < 0)
+        throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("Could not open " + job.file));
+    try {
+        if(job.file_size && ftruncate(fd, (off_t)job.file_size) != 0)
+            throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("Could not resize " + job.file));
+        if(config.direct)
+            WriteBuffered(fd, job.segments, job.offset, config.buffer_size,
+                          config.alignment, progress);
+        else
+            WriteGathered(fd, job.segments, job.offset, config.buffer_size, progress);
+        if(config.sync && fdatasync(fd) != 0)
+            throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("Could not sync " + job.file));
+    } catch(...) {
+        close(fd);
+        throw;
+    }
+    if(close(fd) != 0)
+        throw Exception(ErrorCode::OTHER_ERROR, ErrnoMessage("Could not close " + job.file));
+    if(job.index_file.empty()) return;
+    std::ofstream out(job.index_file, std::ios::trunc);
+    out << job.index.dump() << '\n';
+    if(!out)
+        throw Exception(ErrorCode::OTHER_ERROR, "Could not write index " + job.index_file);
+}
+
+void WriterPipeline::onConfigure(const json& config) {
+    Config c;
+    c.path = config.value("path", std::string());
+    if(c.path.empty())
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "Writer pipeline requires a \"path\" to write to");
+    auto layout = config.value("layout", std::string("file-per-server"));
+    if(layout == "file-per-server") c.layout = Layout::FILE_PER_SERVER;
+    else if(layout == "shared")     c.layout = Layout::SHARED;
+    else throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+                "\"layout\" should be \"file-per-server\" or \"shared\"");
+    c.alignment     = config.value("alignment", c.alignment);
+    c.buffer_size   = config.value("buffer_size", c.buffer_size);
+    c.direct        = config.value("direct", c.direct);
+    c.sync          = config.value("sync", c.sync);
+    c.max_pending   = config.value("max_pending", c.max_pending);
+    c.max_bandwidth = config.value("max_bandwidth_mbps", 0.0)*1e6;
+    c.memory_limit  = config.value("memory_limit", c.memory_limit);
+    if(c.alignment == 0 || (c.alignment & (c.alignment - 1)) != 0)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"alignment\" should be a power of 2");
+    if(c.buffer_size < c.alignment)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"buffer_size\" should be at least the alignment");
+    if(c.max_pending == 0)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"max_pending\" should be at least 1");
+    if(c.max_bandwidth < 0)
+        throw Exception(ErrorCode::JSON_CONFIG_ERROR,
+            "\"max_bandwidth_mbps\" should not be negative");
+    std::lock_guard<tl::mutex> g(m_writes_mtx);
+    m_writer_config = c;
+}
+
+void WriterPipeline::waitForWrites(size_t max_pending) {
+    std::unique_lock<tl::mutex> lock(m_writes_mtx);
+    while(m_pending > max_pending)
+        m_writes_cv.wait(lock);
+}
+
+RequestResult<int32_t> WriterPipeline::stage(
+        const std::string& sender_addr,
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const std::vector<size_t>& dimensions,
+        const std::vector<int64_t>& offsets,
+        const Type& type,
+        const thallium::bulk& data) {
+    acquireMemory(iteration, data.size());
+    auto result = StagingPipeline::stage(sender_addr, dataset_name, iteration,
+                                         block_id, dimensions, offsets, type, data);
+    if(!result.success())
+        releaseMemory(iteration, data.size());
+    return result;
+}
+
+RequestResult<int32_t> WriterPipeline::stageShared(
+        const std::string& dataset_name,
+        uint64_t iteration,
+        uint64_t block_id,
+        const BlockStore::BlockPtr& block) {
+    // a shared block counts towards the limit, since the writer keeps
+    // it alive until it is written
+    acquireMemory(iteration, block->size);
+    auto result = StagingPipeline::stageShared(dataset_name, iteration, block_id, block);
+    if(!result.success())
+        releaseMemory(iteration, block->size);
+    return result;
+}
+
+void WriterPipeline::acquireMemory(uint64_t iteration, size_t size) {
+    // past the memory limit, staging waits for the drain to free
+    // memory; a block is still accepted when nothing is draining,
+    // since waiting would never end
+    std::unique_lock<tl::mutex> lock(m_writes_mtx);
+    const size_t limit = m_writer_config.memory_limit;
+    bool warned = false;
+    while(limit && m_memory_used + size > limit && m_pending != 0) {
+        if(!warned) {
+            spdlog::debug("Writer pipeline reached its memory limit, "
+                          "waiting for the drain to catch up");
+            warned = true;
+        }
+        m_writes_cv.wait(lock);
+    }
+    m_memory_used += size;
+    m_staged_bytes[iteration] += size;
+}
+
+void WriterPipeline::releaseMemory(uint64_t iteration, size_t size) {
+    std::lock_guard<tl::mutex> g(m_writes_mtx);
+    m_memory_used -= size;
+    m_staged_bytes[iteration] -= size;
+}
+
+void WriterPipeline::releaseStaged(uint64_t iteration) {
+    std::lock_guard<tl::mutex> g(m_writes_mtx);
+    auto it = m_staged_bytes.find(iteration);
+    if(it == m_staged_bytes.end()) return;
+    m_memory_used -= it->second;
+    m_staged_bytes.erase(it);
+    m_writes_cv.notify_all();
+}
+
+RequestResult<int32_t> WriterPipeline::execute(uint64_t iteration) {
+    Config config;
+    {
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        config = m_writer_config;
+    }
+    // with a memory limit, only the limit holds the pipeline back
+    if(!config.memory_limit)
+        waitForWrites(config.max_pending - 1);
+    auto comm = communicator();
+    const int rank = comm ? comm.rank() : 0;
+    const int size = comm ? comm.size() : 1;
+    const bool shared = config.layout == Layout::SHARED;
+
+    // the blocks are handed over to the drain, which releases them
+    auto job = std::make_shared<WriteJob>();
+    job->iteration = iteration;
+    job->config    = config;
+    job->comm      = comm;
+    job->rank      = rank;
+    job->queued    = std::chrono::steady_clock::now();
+    job->blocks = m_store.blocks(iteration);
+    m_store.erase(iteration);
+    {
+        std::lock_guard<tl::mutex> g(m_catalog_mtx);
+        m_catalog.erase(iteration);
+    }
+    {
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        auto it = m_staged_bytes.find(iteration);
+        if(it != m_staged_bytes.end()) {
+            job->memory = it->second;
+            m_staged_bytes.erase(it);
+        }
+    }
+    // blocks are packed in (dataset, block_id) order, and the region is
+    // padded to the alignment so that the regions of a shared file are
+    // aligned as well
+    json entries = json::array();
+    const uint64_t file_index = shared ? 0 : (uint64_t)rank;
+    for(auto& block : job->blocks) {
+        entries.push_back({ *block->dataset_name, block->block_id,
+                            static_cast<uint32_t>(block->type),
+                            block->dimensions, block->offsets,
+                            file_index, job->bytes, block->size });
+        job->segments.push_back({ block->data, block->size });
+        job->bytes += block->size;
+        job->num_blocks += 1;
+    }
+    uint64_t padded = AlignUp(job->bytes, config.alignment);
+    if(padded > job->bytes)
+        job->segments.push_back({ nullptr, (size_t)(padded - job->bytes) });
+
+    std::vector<std::string> files;
+    if(shared) {
+        files.push_back(std::to_string(iteration) + ".dat");
+    } else {
+        for(int r = 0; r < size; r++)
+            files.push_back(std::to_string(iteration) + "." + std::to_string(r) + ".dat");
+    }
+    try {
+        // exclusive scan of the region sizes gives the offsets in a shared file
+        uint64_t total = padded;
+        if(size > 1 && shared) {
+            std::vector<uint64_t> sizes(size);
+            comm.allgather(&padded, sizeof(padded), sizes.data());
+            total = 0;
+            for(int r = 0; r < size; r++) {
+                if(r == rank) job->offset = total;
+                total += sizes[r];
+            }
+            for(auto& e : entries)
+                e[6] = e[6].get<uint64_t>() + job->offset;
+        }
+        if(!shared)      job->file_size = padded;
+        else if(!rank)   job->file_size = total;
+        job->file = config.path + "/" + files[shared ? 0 : rank];
+
+        std::vector<std::vector<char>> all;
+        if(size > 1) {
+            auto dump = entries.dump();
+            all = GatherBytes(comm, std::vector<char>(dump.begin(), dump.end()), 0);
+        }
+        if(rank == 0) {
+            json blocks = json::array();
+            if(size == 1) blocks = std::move(entries);
+            for(auto& bytes : all)
+                for(auto& e : json::parse(bytes.begin(), bytes.end()))
+                    blocks.push_back(std::move(e));
+            job->index_file = config.path + "/" + std::to_string(iteration) + ".index.json";
+            job->index = {
+                { "iteration", iteration },
+                { "layout",    shared ? "shared" : "file-per-server" },
+                { "files",     files },
+                { "blocks",    std::move(blocks) }
+            };
+        }
+    } catch(const std::exception& ex) {
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        m_memory_used -= job->memory;
+        m_writes_cv.notify_all();
+        return Failure(ex.what(), ErrorCode::MONA_ERROR);
+    }
+    {
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        m_unwritten.insert(iteration);
+    }
+    enqueue(std::move(job));
+    return Success();
+}
+
+void WriterPipeline::enqueue(std::shared_ptr<WriteJob> job) {
+    std::lock_guard<tl::mutex> g(m_writes_mtx);
+    m_queue.push_back(std::move(job));
+    m_pending += 1;
+    if(m_draining) return;
+    m_draining = true;
+    m_io_pool->make_thread([this]() { drain(); }, tl::anonymous());
+}
+
+void WriterPipeline::drain() {
+    while(true) {
+        std::shared_ptr<WriteJob> job;
+        {
+            std::lock_guard<tl::mutex> g(m_writes_mtx);
+            if(m_queue.empty()) {
+                m_draining = false;
+                return;
+            }
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        auto start = std::chrono::steady_clock::now();
+        uint64_t written = 0;
+        // the blocks are written in order, each one is released as soon
+        // as the requests completed so far cover it
+        size_t next_block = 0, released = 0;
+        uint64_t block_end = 0;
+        auto progress = [this, &job, &written, &next_block, &released, &block_end, start](size_t n) {
+            written += n;
+            size_t freed = 0;
+            auto& blocks = job->blocks;
+            while(next_block < blocks.size() && block_end + blocks[next_block]->size <= written) {
+                block_end += blocks[next_block]->size;
+                freed     += blocks[next_block]->size;
+                blocks[next_block].reset();
+                next_block += 1;
+            }
+            if(freed) {
+                freed = std::min(freed, job->memory - released);
+                released += freed;
+                std::lock_guard<tl::mutex> g(m_writes_mtx);
+                m_memory_used -= freed;
+                m_writes_cv.notify_all();
+            }
+            // the drain sleeps whenever it gets ahead of the bandwidth cap
+            if(job->config.max_bandwidth <= 0) return;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            double ahead = written/job->config.max_bandwidth - elapsed.count();
+            if(ahead > 0) tl::thread::sleep(m_engine, ahead*1e3);
+        };
+        json stats;
+        stats["rank"] = job->rank;
+        try {
+            WriteJobData(*job, progress);
+            std::chrono::duration<double> queued  = start - job->queued;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            stats["file"]           = job->file;
+            stats["blocks"]         = job->num_blocks;
+            stats["bytes"]          = job->bytes;
+            stats["queued_seconds"] = queued.count();
+            stats["seconds"]        = elapsed.count();
+            stats["bandwidth_mbps"] = elapsed.count() > 0 ? job->bytes/elapsed.count()/1e6 : 0.0;
+        } catch(const std::exception& ex) {
+            spdlog::error("Could not write iteration {}: {}", job->iteration, ex.what());
+            stats["error"] = ex.what();
+        }
+        job->blocks.clear();
+        publishResults(job->iteration, std::move(stats), job->comm);
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        // the results of an iteration cleaned up while it was written
+        // would never be erased (see cleanup)
+        if(m_unwritten.erase(job->iteration) == 0) {
+            std::lock_guard<tl::mutex> results_lock(m_results_mtx);
+            m_results.erase(job->iteration);
+        }
+        m_memory_used -= job->memory - released;
+        m_pending -= 1;
+        m_writes_cv.notify_all();
+    }
+}
+
+void WriterPipeline::abort(uint64_t iteration) {
+    StagingPipeline::abort(iteration);
+    releaseStaged(iteration);
+}
+
+RequestResult<int32_t> WriterPipeline::cleanup(uint64_t iteration) {
+    {
+        // done before erasing the results, so that the drain either
+        // publishes them before they are erased, or erases them itself
+        std::lock_guard<tl::mutex> g(m_writes_mtx);
+        m_unwritten.erase(iteration);
+    }
+    auto result = StagingPipeline::cleanup(iteration);
+    releaseStaged(iteration);
+    return result;
+}
+
+RequestResult<int32_t> WriterPipeline::destroy() {
+    waitForWrites(0);
+    return StagingPipeline::destroy();
+}
+
+RequestResult<int32_t> WriterPipeline::reset() {
+    waitForWrites(0);
+    auto result = StagingPipeline::reset();
+    std::lock_guard<tl::mutex> g(m_writes_mtx);
+    m_staged_bytes.clear();
+    m_unwritten.clear();
+    m_memory_used = 0;
+    m_writes_cv.notify_all();
+    return result;
+}
+
+std::unique_ptr<Backend> WriterPipeline::create(const PipelineFactoryArgs& args) {
+    return std::unique_ptr<Backend>(new WriterPipeline(args));
+}
+
+}
@@ -0,0 +1,168 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#ifndef __COLZA_WRITER_PIPELINE_HPP
+#define __COLZA_WRITER_PIPELINE_HPP
+
+#include "StagingPipeline.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+
+namespace colza {
+
+/**
+ * @brief The "writer" backend persists the blocks of each iteration.
+ * All the blocks a server holds for an iteration are packed back to
+ * back into a single region of a file, written sequentially in large
+ * requests, either straight from the staged blocks with pwritev, or
+ * through an aligned buffer with O_DIRECT.
+ *
+ * With the "file-per-server" layout, server r writes <path>/<iteration>.<r>.dat.
+ * With the "shared" layout, all the servers write <path>/<iteration>.dat,
+ * each at an offset obtained by an exclusive scan of the (aligned) sizes
+ * of their regions.
+ *
+ * execute only computes the layout and hands the blocks over to a
+ * background drain, which writes the iterations in order, so writing
+ * overlaps with the staging of the next iterations and cleanup returns
+ * immediately. The memory of each block is released as soon as the
+ * write requests covering it complete. Without a memory limit, at most max_pending iterations are
+ * queued or being written, execute waiting for one to complete beyond
+ * that. With a memory limit (burst-buffer mode), execute never waits,
+ * and stage waits for the drain only when the staged and draining
+ * blocks would exceed the limit. The drain can be capped to a maximum
+ * bandwidth to leave room for other I/O on the storage. It runs on an
+ * execution stream of its own, so that its blocking writes never hold
+ * the execution streams serving the provider's RPCs.
+ *
+ * Once its own data is written, server 0 writes the index of the
+ * iteration, <path>/<iteration>.index.json:
+ * {
+ *     "iteration" : 42,
+ *     "layout"    : "shared",
+ *     "files"     : [ "42.dat" ],
+ *     "blocks"    : [ [ dataset, block_id, type, dimensions, offsets,
+ *                       file index, file offset, size ], ... ]
+ * }
+ *
+ * Configuration:
+ * {
+ *     "path"               : "path/to/directory",   // required
+ *     "layout"             : "file-per-server",     // or "shared"
+ *     "alignment"          : 4096,                  // alignment of the regions
+ *     "buffer_size"        : 16777216,              // size of the write requests
+ *     "direct"             : false,                 // use O_DIRECT
+ *     "sync"               : false,                 // fdatasync after writing
+ *     "max_pending"        : 2,
+ *     "memory_limit"       : 0,                     // bytes, 0 means no limit
+ *     "max_bandwidth_mbps" : 0,                     // 0 means no cap
+ *     "output"             : "path/to/writes.jsonl" // optional
+ * }
+ */
+class WriterPipeline : public StagingPipeline {
+
+    public:
+
+    enum class Layout { FILE_PER_SERVER, SHARED };
+
+    struct Config {
+        std::string path;
+        Layout      layout = Layout::FILE_PER_SERVER;
+        size_t      alignment = 4096;
+        size_t      buffer_size = 16*1024*1024;
+        bool        direct = false;
+        bool        sync = false;
+        size_t      max_pending = 2;
+        size_t      memory_limit = 0;
+        double      max_bandwidth = 0.0; // bytes/s
+    };
+
+    private:
+
+    struct WriteJob;
+
+    Config                                m_writer_config;
+    size_t                                m_pending = 0; // queued or being written
+    bool                                  m_draining = false;
+    std::deque<std::shared_ptr<WriteJob>> m_queue;
+    size_t                                m_memory_used = 0;
+    std::map<uint64_t, size_t>            m_staged_bytes; // not executed yet
+    std::set<uint64_t>                    m_unwritten; // executed, not written yet
+    tl::mutex                             m_writes_mtx;
+    tl::condition_variable                m_writes_cv;
+    // destroyed first, joining the drain before the members it uses
+    tl::managed<tl::pool>                 m_io_pool;
+    tl::managed<tl::xstream>              m_io_xstream;
+
+    void waitForWrites(size_t max_pending);
+
+    void acquireMemory(uint64_t iteration, size_t size);
+
+    void releaseMemory(uint64_t iteration, size_t size);
+
+    void releaseStaged(uint64_t iteration);
+
+    void enqueue(std::shared_ptr<WriteJob> job);
+
+    void drain();
+
+    static void WriteJobData(const WriteJob& job, const std::function<void(size_t)>& progress);
+
+    public:
+
+    WriterPipeline(const PipelineFactoryArgs& args)
+    : StagingPipeline(args)
+    , m_io_pool(tl::pool::create(tl::pool::access::mpmc))
+    , m_io_xstream(tl::xstream::create(tl::scheduler::predef::basic_wait, *m_io_pool)) {
+        onConfigure(args.config);
+    }
+
+    /**
+     * @brief Stages a block, waiting for the drain to free memory if
+     * the memory limit would be exceeded.
+     */
+    RequestResult<int32_t> stage(const std::string& sender_addr,
+                                 const std::string& dataset_name,
+                                 uint64_t iteration,
+                                 uint64_t block_id,
+                                 const std::vector<size_t>& dimensions,
+                                 const std::vector<int64_t>& offsets,
+                                 const Type& type,
+                                 const thallium::bulk& data) override;
+
+    /**
+     * @brief Same as stage, for shared blocks.
+     */
+    RequestResult<int32_t> stageShared(const std::string& dataset_name,
+                                       uint64_t iteration,
+                                       uint64_t block_id,
+                                       const BlockStore::BlockPtr& block) override;
+
+    /**
+     * @brief Computes the layout of the iteration and hands it over to
+     * the drain. This is a collective operation.
+     */
+    RequestResult<int32_t> execute(uint64_t iteration) override;
+
+    void abort(uint64_t iteration) override;
+
+    RequestResult<int32_t> cleanup(uint64_t iteration) override;
+
+    RequestResult<int32_t> destroy() override;
+
+    RequestResult<int32_t> reset() override;
+
+    static std::unique_ptr<Backend> create(const PipelineFactoryArgs& args);
+
+    protected:
+
+    void onConfigure(const json& config) override;
+};
+
+}
+
+#endif
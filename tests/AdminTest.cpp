@@ -8,11 +8,14 @@
 
 extern thallium::engine engine;
 extern std::string pipeline_type;
+extern std::string ssg_file;
 
 class AdminTest : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE( AdminTest );
     CPPUNIT_TEST( testAdminCreatePipeline );
+    CPPUNIT_TEST( testAdminUpdatePipeline );
+    CPPUNIT_TEST( testAdminDistributedPipeline );
     CPPUNIT_TEST_SUITE_END();
 
     static constexpr const char* pipeline_config = "{}";
@@ -46,5 +49,69 @@ class AdminTest : public CppUnit::TestFixture
             admin.destroyPipeline(addr, 0, "not_my_pipeline"),
             colza::Exception);
     }
+
+    void testAdminUpdatePipeline() {
+
+        colza::Admin admin(engine);
+        std::string addr = engine.self();
+
+        std::string pipeline_name = "my_pipeline";
+        admin.createPipeline(addr, 0, pipeline_name, pipeline_type, pipeline_config);
+
+        // Update the configuration of an inactive Pipeline
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.updatePipeline should not throw on valid Pipeline",
+                admin.updatePipeline(addr, 0, pipeline_name, "{\"x\":1}"));
+
+        // Defer the update to a future iteration
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.updatePipeline should not throw with from_iteration",
+                admin.updatePipeline(addr, 0, pipeline_name, "{\"x\":2}", 10));
+
+        // Update with an invalid JSON configuration
+        CPPUNIT_ASSERT_THROW_MESSAGE("admin.updatePipeline should throw on invalid JSON",
+                admin.updatePipeline(addr, 0, pipeline_name, "{\"x\":"),
+                colza::Exception);
+
+        // Update an invalid Pipeline
+        CPPUNIT_ASSERT_THROW_MESSAGE("admin.updatePipeline should throw on invalid Pipeline",
+                admin.updatePipeline(addr, 0, "not_my_pipeline", "{}"),
+                colza::Exception);
+
+        admin.destroyPipeline(addr, 0, pipeline_name);
+    }
+
+    void testAdminDistributedPipeline() {
+
+        colza::Admin admin(engine);
+        std::string pipeline_name = "my_distributed_pipeline";
+
+        // Create a Pipeline on all the members of the group
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.createDistributedPipeline should succeed",
+                admin.createDistributedPipeline(ssg_file, 0, pipeline_name,
+                                                pipeline_type, pipeline_config));
+
+        // A failed creation should not roll back the existing Pipeline
+        CPPUNIT_ASSERT_THROW_MESSAGE("admin.createDistributedPipeline should throw on existing Pipeline",
+                admin.createDistributedPipeline(ssg_file, 0, pipeline_name,
+                                                "blabla", pipeline_config),
+                colza::Exception);
+
+        // Update the configuration on all the members
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.updateDistributedPipeline should succeed",
+                admin.updateDistributedPipeline(ssg_file, 0, pipeline_name, "{\"x\":1}"));
+
+        // A failed update should leave the Pipeline in place
+        CPPUNIT_ASSERT_THROW_MESSAGE("admin.updateDistributedPipeline should throw on invalid JSON",
+                admin.updateDistributedPipeline(ssg_file, 0, pipeline_name, "{\"x\":"),
+                colza::Exception);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.updateDistributedPipeline should succeed after a failure",
+                admin.updateDistributedPipeline(ssg_file, 0, pipeline_name, "{\"x\":2}", 10));
+
+        // Destroy the Pipeline on all the members
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE("admin.destroyDistributedPipeline should succeed",
+                admin.destroyDistributedPipeline(ssg_file, 0, pipeline_name));
+        CPPUNIT_ASSERT_THROW_MESSAGE("admin.destroyDistributedPipeline should throw on invalid Pipeline",
+                admin.destroyDistributedPipeline(ssg_file, 0, pipeline_name),
+                colza::Exception);
+    }
 };
 CPPUNIT_TEST_SUITE_REGISTRATION( AdminTest );
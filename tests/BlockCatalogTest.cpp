@@ -0,0 +1,145 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/BlockCatalog.hpp>
+#include <map>
+#include <vector>
+
+class BlockCatalogTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( BlockCatalogTest );
+    CPPUNIT_TEST( testFind );
+    CPPUNIT_TEST( testIrregularBlocks );
+    CPPUNIT_TEST( testReplaceAndErase );
+    CPPUNIT_TEST( testSummary );
+    CPPUNIT_TEST_SUITE_END();
+
+    using Box = colza::Box;
+
+    colza::BlockCatalog  m_catalog;
+    std::map<uint64_t, Box> m_boxes; // boxes inserted in m_catalog
+
+    void insert(uint64_t block_id, const Box& box) {
+        m_catalog.insert("temperature", 1, block_id, box);
+        m_boxes[block_id] = box;
+    }
+
+    // ids of the inserted blocks intersecting the region, by scanning them
+    std::vector<uint64_t> scan(const Box& region) const {
+        std::vector<uint64_t> ids;
+        for(auto& p : m_boxes)
+            if(p.second.intersects(region)) ids.push_back(p.first);
+        return ids;
+    }
+
+    void checkFind(const Box& region) const {
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return the blocks intersecting the region, in order",
+                m_catalog.find("temperature", 1, region) == scan(region));
+    }
+
+    public:
+
+    void setUp() {
+        // 6x6 grid of 8x8 blocks, shifted so that some coordinates are negative
+        for(int64_t i = 0; i < 6; i++)
+            for(int64_t j = 0; j < 6; j++)
+                insert(i*6 + j, Box({i*8 - 20, j*8 - 20}, {i*8 - 12, j*8 - 12}));
+    }
+
+    void tearDown() {
+        m_catalog.clear();
+        m_boxes.clear();
+    }
+
+    void testFind() {
+        checkFind(Box({-20, -20}, {28, 28}));
+        checkFind(Box({-1, -1}, {1, 1}));
+        checkFind(Box({-12, -12}, {-4, -4}));
+        checkFind(Box({3, -100}, {4, 100}));
+        checkFind(Box({-1000, 5}, {1000, 6}));
+        checkFind(Box({100, 100}, {200, 200}));
+        checkFind(Box({0, 0}, {0, 10}));
+        for(int64_t x = -25; x < 30; x += 7)
+            for(int64_t y = -25; y < 30; y += 5)
+                checkFind(Box({x, y}, {x + 3, y + 11}));
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return nothing for another dataset",
+                m_catalog.find("pressure", 1, Box({-20, -20}, {28, 28})).empty());
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return nothing for another iteration",
+                m_catalog.find("temperature", 2, Box({-20, -20}, {28, 28})).empty());
+    }
+
+    void testIrregularBlocks() {
+        // a block much larger than a cell, and one with other dimensions
+        insert(100, Box({-1000, 0}, {1000, 3}));
+        m_catalog.insert("temperature", 1, 101, Box({0, 0, 0}, {4, 4, 4}));
+        checkFind(Box({500, 1}, {501, 2}));
+        checkFind(Box({-3, -3}, {3, 3}));
+        auto found = m_catalog.find("temperature", 1, Box({1, 1, 1}, {2, 2, 2}));
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should only return the blocks with the region's dimensions",
+                found == std::vector<uint64_t>({ 101 }));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "count should include all the blocks",
+                (size_t)38, m_catalog.count("temperature", 1));
+    }
+
+    void testReplaceAndErase() {
+        insert(7, Box({100, 100}, {108, 108}));
+        checkFind(Box({100, 100}, {101, 101}));
+        checkFind(Box({-12, -12}, {-4, -4}));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "replacing a block should not add one",
+                (size_t)36, m_catalog.count("temperature", 1));
+
+        CPPUNIT_ASSERT_MESSAGE(
+                "erasing a block should succeed",
+                m_catalog.erase("temperature", 1, 14));
+        m_boxes.erase(14);
+        CPPUNIT_ASSERT_MESSAGE(
+                "erasing a block twice should fail",
+                !m_catalog.erase("temperature", 1, 14));
+        checkFind(Box({-20, -20}, {28, 28}));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "erasing a block should remove it from the count",
+                (size_t)35, m_catalog.count("temperature", 1));
+
+        m_catalog.insert("temperature", 2, 0, Box({0, 0}, {8, 8}));
+        m_catalog.erase(1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "erasing an iteration should remove its blocks",
+                (size_t)0, m_catalog.count("temperature", 1));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "erasing an iteration should keep the other iterations",
+                (size_t)1, m_catalog.count("temperature", 2));
+    }
+
+    void testSummary() {
+        auto all = m_catalog.summary("temperature", 1, 100);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a summary of few blocks should be the blocks themselves",
+                m_boxes.size(), all.size());
+
+        auto summary = m_catalog.summary("temperature", 1, 4);
+        CPPUNIT_ASSERT_MESSAGE(
+                "a summary should have at most max_boxes boxes",
+                !summary.empty() && summary.size() <= 4);
+        for(auto& p : m_boxes) {
+            bool covered = false;
+            for(auto& box : summary)
+                covered = covered || box.contains(p.second);
+            CPPUNIT_ASSERT_MESSAGE(
+                    "a summary should cover every block",
+                    covered);
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "the summary of an unknown dataset should be empty",
+                m_catalog.summary("pressure", 1, 4).empty());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( BlockCatalogTest );
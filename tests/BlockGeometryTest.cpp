@@ -0,0 +1,169 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/BlockGeometry.hpp>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+class BlockGeometryTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( BlockGeometryTest );
+    CPPUNIT_TEST( testBox );
+    CPPUNIT_TEST( testForEachRun );
+    CPPUNIT_TEST( testCopyRegion );
+    CPPUNIT_TEST( testPackUnpack );
+    CPPUNIT_TEST_SUITE_END();
+
+    using Box = colza::Box;
+    using Run = std::tuple<size_t, size_t, size_t>;
+
+    static std::vector<Run> runsOf(const Box& src_box, const Box& dst_box,
+                                   const Box& region, size_t element_size) {
+        std::vector<Run> runs;
+        colza::ForEachRun(src_box, dst_box, region, element_size,
+            [&runs](size_t src_offset, size_t dst_offset, size_t size) {
+                runs.emplace_back(src_offset, dst_offset, size);
+            });
+        return runs;
+    }
+
+    // value of cell (i, j, k) in the source buffers of the tests below
+    static double valueAt(int64_t i, int64_t j, int64_t k) {
+        return (double)((i*100 + j)*100 + k);
+    }
+
+    static std::vector<double> fill(const Box& box) {
+        std::vector<double> data(box.volume());
+        size_t n = 0;
+        for(int64_t i = box.lower[0]; i < box.upper[0]; i++)
+            for(int64_t j = box.lower[1]; j < box.upper[1]; j++)
+                for(int64_t k = box.lower[2]; k < box.upper[2]; k++)
+                    data[n++] = valueAt(i, j, k);
+        return data;
+    }
+
+    static bool inside(const Box& box, int64_t i, int64_t j, int64_t k) {
+        return i >= box.lower[0] && i < box.upper[0]
+            && j >= box.lower[1] && j < box.upper[1]
+            && k >= box.lower[2] && k < box.upper[2];
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testBox() {
+        Box a({0, 0}, {4, 6});
+        Box b({2, -1}, {5, 3});
+        CPPUNIT_ASSERT_MESSAGE(
+                "a.intersect(b) should be the overlap of a and b",
+                a.intersect(b) == Box({2, 0}, {4, 3}));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "overlap of a and b should have 6 cells",
+                (size_t)6, a.intersect(b).volume());
+        CPPUNIT_ASSERT_MESSAGE(
+                "disjoint boxes should not intersect",
+                !a.intersects(Box({4, 0}, {6, 6})));
+        CPPUNIT_ASSERT_MESSAGE(
+                "boxes with different numbers of dimensions should not intersect",
+                !a.intersects(Box({0}, {4})));
+        CPPUNIT_ASSERT_MESSAGE(
+                "Box::FromBlock should offset the block's dimensions",
+                Box::FromBlock({4, 6}, {10, -20}) == Box({10, -20}, {14, -14}));
+        CPPUNIT_ASSERT_MESSAGE(
+                "a should contain its intersection with b",
+                a.contains(a.intersect(b)));
+    }
+
+    void testForEachRun() {
+        const size_t es = sizeof(double);
+        Box block({0, 0}, {4, 6});
+
+        auto runs = runsOf(block, block, block, es);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a full block should be a single run",
+                (size_t)1, runs.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "a full block should be a single run of all its bytes",
+                runs[0] == Run(0, 0, 24*es));
+
+        Box rows({1, 0}, {3, 6});
+        runs = runsOf(block, rows, rows, es);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "full-width rows should be merged into a single run",
+                (size_t)1, runs.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "full-width rows should start at their first row",
+                runs[0] == Run(6*es, 0, 12*es));
+
+        Box columns({1, 2}, {3, 5});
+        runs = runsOf(block, columns, columns, es);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a partial-width region should have one run per row",
+                (size_t)2, runs.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "first row of the region",
+                runs[0] == Run(8*es, 0, 3*es));
+        CPPUNIT_ASSERT_MESSAGE(
+                "second row of the region",
+                runs[1] == Run(14*es, 3*es, 3*es));
+
+        runs = runsOf(block, block, Box({2, 2}, {2, 5}), es);
+        CPPUNIT_ASSERT_MESSAGE(
+                "an empty region should have no run",
+                runs.empty());
+    }
+
+    void testCopyRegion() {
+        Box src_box({0, 0, 0}, {4, 5, 6});
+        Box dst_box({1, 1, 1}, {4, 4, 6});
+        Box region({2, 1, 3}, {4, 3, 6});
+        auto src = fill(src_box);
+        std::vector<double> dst(dst_box.volume(), -1.0);
+
+        colza::CopyRegion(src.data(), src_box, dst.data(), dst_box, region, sizeof(double));
+
+        size_t n = 0;
+        for(int64_t i = dst_box.lower[0]; i < dst_box.upper[0]; i++)
+            for(int64_t j = dst_box.lower[1]; j < dst_box.upper[1]; j++)
+                for(int64_t k = dst_box.lower[2]; k < dst_box.upper[2]; k++, n++) {
+                    double expected = inside(region, i, j, k) ? valueAt(i, j, k) : -1.0;
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                            "CopyRegion should copy the region and only the region",
+                            expected, dst[n]);
+                }
+    }
+
+    void testPackUnpack() {
+        Box src_box({-2, 0, 3}, {3, 4, 9});
+        Box region({-1, 1, 3}, {2, 4, 9});
+        auto src = fill(src_box);
+
+        // packing into a buffer covering exactly the region
+        std::vector<double> packed(region.volume(), 0.0);
+        colza::CopyRegion(src.data(), src_box, packed.data(), region, region, sizeof(double));
+        CPPUNIT_ASSERT_MESSAGE(
+                "packing should produce the region in row-major order",
+                packed == fill(region));
+
+        // unpacking into a buffer covering the source box
+        std::vector<double> unpacked(src_box.volume(), -1.0);
+        colza::CopyRegion(packed.data(), region, unpacked.data(), src_box, region, sizeof(double));
+        size_t n = 0;
+        for(int64_t i = src_box.lower[0]; i < src_box.upper[0]; i++)
+            for(int64_t j = src_box.lower[1]; j < src_box.upper[1]; j++)
+                for(int64_t k = src_box.lower[2]; k < src_box.upper[2]; k++, n++) {
+                    double expected = inside(region, i, j, k) ? src[n] : -1.0;
+                    CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                            "unpacking should restore the region",
+                            expected, unpacked[n]);
+                }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( BlockGeometryTest );
@@ -0,0 +1,168 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/BlockStore.hpp>
+#include <colza/Exception.hpp>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+class BlockStoreTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( BlockStoreTest );
+    CPPUNIT_TEST( testInsertAndFind );
+    CPPUNIT_TEST( testManyBlocks );
+    CPPUNIT_TEST( testLink );
+    CPPUNIT_TEST( testErase );
+    CPPUNIT_TEST_SUITE_END();
+
+    using BlockStore = colza::BlockStore;
+
+    static std::vector<double> payload(size_t n, double first) {
+        std::vector<double> data(n);
+        std::iota(data.begin(), data.end(), first);
+        return data;
+    }
+
+    static BlockStore::BlockPtr insert(BlockStore& store, const std::string& name,
+                                       uint64_t iteration, uint64_t block_id,
+                                       const std::vector<double>& data) {
+        return store.insert(name, iteration, block_id, { data.size() }, { 0 },
+                            colza::Type::FLOAT64, data.data(), data.size()*sizeof(double));
+    }
+
+    static bool holds(const BlockStore::BlockPtr& block, const std::vector<double>& data) {
+        return block && block->size == data.size()*sizeof(double)
+            && block->count() == data.size()
+            && std::memcmp(block->data, data.data(), block->size) == 0;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testInsertAndFind() {
+        BlockStore store;
+        auto data = payload(100, 0.5);
+        auto block = store.insert("temperature", 3, 42, { 10, 10 }, { 5, -5 },
+                                  colza::Type::FLOAT64, data.data(), data.size()*sizeof(double));
+        CPPUNIT_ASSERT_MESSAGE(
+                "insert should return the stored block",
+                holds(block, data));
+
+        auto found = store.find("temperature", 3, 42);
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return the inserted block",
+                found == block);
+        CPPUNIT_ASSERT_MESSAGE(
+                "a stored block should keep its dimensions and offsets",
+                found->dimensions == std::vector<size_t>({ 10, 10 })
+                && found->offsets == std::vector<int64_t>({ 5, -5 })
+                && found->type == colza::Type::FLOAT64
+                && *found->dataset_name == "temperature"
+                && found->block_id == 42);
+
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return null for another block id",
+                !store.find("temperature", 3, 43));
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return null for another iteration",
+                !store.find("temperature", 4, 42));
+        CPPUNIT_ASSERT_MESSAGE(
+                "find should return null for an unknown dataset",
+                !store.find("pressure", 3, 42));
+
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "inserting a block twice should throw",
+                insert(store, "temperature", 3, 42, data),
+                colza::Exception);
+    }
+
+    void testManyBlocks() {
+        // small chunks, so that payloads span many chunks and large
+        // payloads get their own
+        BlockStore store(4, 4096);
+        std::vector<std::vector<double>> data;
+        for(uint64_t i = 0; i < 500; i++) {
+            data.push_back(payload(i % 3 == 0 ? 1000 : (i % 17), i*1000.0));
+            insert(store, i % 2 ? "temperature" : "pressure", 1, i, data.back());
+        }
+        for(uint64_t i = 0; i < 500; i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "every block should keep its payload",
+                    holds(store.find(i % 2 ? "temperature" : "pressure", 1, i), data[i]));
+        }
+
+        auto all = store.blocks(1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "blocks should return all the blocks of the iteration",
+                (size_t)500, all.size());
+        auto temperature = store.blocks("temperature", 1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "blocks should return all the blocks of the dataset",
+                (size_t)250, temperature.size());
+        for(size_t i = 1; i < temperature.size(); i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the blocks of a dataset should be sorted by block id",
+                    temperature[i-1]->block_id < temperature[i]->block_id);
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "datasets should return the sorted dataset names",
+                store.datasets(1) == std::vector<std::string>({ "pressure", "temperature" }));
+    }
+
+    void testLink() {
+        BlockStore a, b;
+        auto data = payload(64, -3.0);
+        auto block = insert(a, "temperature", 1, 7, data);
+        auto linked = b.link("temperature/copy", 5, 9, block);
+        CPPUNIT_ASSERT_MESSAGE(
+                "a linked block should share the payload of the original block",
+                linked->data == block->data && holds(linked, data));
+        CPPUNIT_ASSERT_MESSAGE(
+                "a linked block should be found under its new name and id",
+                b.find("temperature/copy", 5, 9) == linked);
+
+        // the payload remains valid in b after a forgets it
+        block.reset();
+        a.clear();
+        CPPUNIT_ASSERT_MESSAGE(
+                "a linked block should outlive the store it was linked from",
+                holds(b.find("temperature/copy", 5, 9), data));
+    }
+
+    void testErase() {
+        BlockStore store;
+        auto data = payload(256, 1.0);
+        insert(store, "temperature", 1, 0, data);
+        insert(store, "temperature", 2, 0, data);
+        insert(store, "temperature", 3, 0, data);
+        auto held = store.find("temperature", 2, 0);
+
+        store.erase(2);
+        CPPUNIT_ASSERT_MESSAGE(
+                "erased blocks should not be found",
+                !store.find("temperature", 2, 0));
+        CPPUNIT_ASSERT_MESSAGE(
+                "iterations should return the iterations that were not erased",
+                store.iterations() == std::vector<uint64_t>({ 1, 3 }));
+        CPPUNIT_ASSERT_MESSAGE(
+                "a block found before its iteration is erased should remain valid",
+                holds(held, data));
+
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "a block can be inserted again once its iteration is erased",
+                insert(store, "temperature", 2, 0, data));
+
+        store.clear();
+        CPPUNIT_ASSERT_MESSAGE(
+                "clear should erase all the iterations",
+                store.iterations().empty());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( BlockStoreTest );
@@ -0,0 +1,272 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/Codecs.hpp"
+#include "../src/backends/CompressionPipeline.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+class CodecsTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( CodecsTest );
+    CPPUNIT_TEST( testByteShuffle );
+    CPPUNIT_TEST( testLZ );
+    CPPUNIT_TEST( testLZCorrupted );
+    CPPUNIT_TEST( testHuffman );
+    CPPUNIT_TEST( testLossless );
+    CPPUNIT_TEST( testLossy );
+    CPPUNIT_TEST( testSerialize );
+    CPPUNIT_TEST_SUITE_END();
+
+    using Pipeline = colza::CompressionPipeline;
+
+    static std::vector<uint8_t> lzRoundTrip(const std::vector<uint8_t>& data) {
+        std::vector<uint8_t> compressed;
+        colza::LZCompress(data.data(), data.size(), compressed);
+        std::vector<uint8_t> decompressed(data.size());
+        colza::LZDecompress(compressed.data(), compressed.size(),
+                            decompressed.data(), decompressed.size());
+        return decompressed;
+    }
+
+    // smooth field with some noise, as simulations typically produce
+    static std::vector<double> field(size_t n) {
+        std::vector<double> x(n);
+        uint64_t state = 1;
+        for(size_t i = 0; i < n; i++) {
+            state = state*6364136223846793005ULL + 1442695040888963407ULL;
+            double noise = (double)(state >> 11)/(double)(1ULL << 53) - 0.5;
+            x[i] = 100.0*std::sin(i*0.01) + 0.01*noise;
+        }
+        return x;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testByteShuffle() {
+        std::vector<uint32_t> x = { 0x01020304, 0x11121314, 0x21222324 };
+        std::vector<uint8_t> shuffled(x.size()*sizeof(uint32_t));
+        colza::ByteShuffle(x.data(), x.size(), sizeof(uint32_t), shuffled.data());
+        uint8_t first_bytes[3];
+        std::memcpy(first_bytes, x.data(), 1);
+        std::memcpy(first_bytes + 1, reinterpret_cast<uint8_t*>(x.data()) + 4, 1);
+        std::memcpy(first_bytes + 2, reinterpret_cast<uint8_t*>(x.data()) + 8, 1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "ByteShuffle should put the first bytes of the elements first",
+                std::memcmp(shuffled.data(), first_bytes, 3) == 0);
+        std::vector<uint32_t> y(x.size());
+        colza::ByteUnshuffle(shuffled.data(), x.size(), sizeof(uint32_t), y.data());
+        CPPUNIT_ASSERT_MESSAGE(
+                "ByteUnshuffle should restore the elements",
+                x == y);
+    }
+
+    void testLZ() {
+        std::vector<uint8_t> empty;
+        CPPUNIT_ASSERT_MESSAGE(
+                "LZ should round-trip an empty buffer",
+                lzRoundTrip(empty) == empty);
+
+        std::vector<uint8_t> tiny = { 1, 2, 3 };
+        CPPUNIT_ASSERT_MESSAGE(
+                "LZ should round-trip a buffer shorter than a match",
+                lzRoundTrip(tiny) == tiny);
+
+        // long runs need extended match lengths, overlapping matches
+        // and offsets up to the window size
+        std::vector<uint8_t> runs;
+        for(size_t i = 0; i < 70000; i++)
+            runs.push_back((i / 1000) % 2 ? 0 : (uint8_t)(i % 251));
+        std::vector<uint8_t> compressed;
+        colza::LZCompress(runs.data(), runs.size(), compressed);
+        CPPUNIT_ASSERT_MESSAGE(
+                "LZ should compress repetitive data",
+                compressed.size() < runs.size()/2);
+        CPPUNIT_ASSERT_MESSAGE(
+                "LZ should round-trip repetitive data",
+                lzRoundTrip(runs) == runs);
+
+        // random bytes have no match, and long literal runs
+        std::vector<uint8_t> random;
+        uint64_t state = 42;
+        for(size_t i = 0; i < 10000; i++) {
+            state = state*6364136223846793005ULL + 1442695040888963407ULL;
+            random.push_back((uint8_t)(state >> 56));
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "LZ should round-trip incompressible data",
+                lzRoundTrip(random) == random);
+    }
+
+    void testLZCorrupted() {
+        std::vector<uint8_t> data(1000, 7);
+        std::vector<uint8_t> compressed;
+        colza::LZCompress(data.data(), data.size(), compressed);
+        std::vector<uint8_t> out(data.size());
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "LZDecompress should reject a truncated stream",
+                colza::LZDecompress(compressed.data(), compressed.size()/2,
+                                    out.data(), out.size()),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "LZDecompress should reject a stream of another size",
+                colza::LZDecompress(compressed.data(), compressed.size(),
+                                    out.data(), out.size() - 1),
+                colza::Exception);
+    }
+
+    void testHuffman() {
+        // skewed frequencies give codes of very different lengths
+        std::vector<uint64_t> frequencies(64, 0);
+        std::vector<uint32_t> symbols;
+        for(uint32_t s = 0; s < 40; s++) {
+            frequencies[s] = 1ULL << (s % 20);
+            for(uint64_t i = 0; i < std::min<uint64_t>(frequencies[s], 50); i++)
+                symbols.push_back(s);
+        }
+        colza::HuffmanCoder coder(frequencies);
+        for(auto l : coder.lengths()) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "Huffman code lengths should be limited",
+                    l <= colza::HuffmanCoder::MAX_BITS);
+        }
+        std::vector<uint8_t> encoded;
+        coder.encode(symbols.data(), symbols.size(), encoded);
+
+        // the decoder only knows the code lengths, as when reading a stream
+        colza::HuffmanCoder decoder(coder.lengths());
+        std::vector<uint32_t> decoded(symbols.size());
+        auto end = decoder.decode(encoded.data(), encoded.data() + encoded.size(),
+                                  decoded.data(), decoded.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "Huffman decoding should consume all the encoded bytes",
+                end == encoded.data() + encoded.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "Huffman decoding should restore the symbols",
+                decoded == symbols);
+
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "Huffman decoding should reject a truncated stream",
+                decoder.decode(encoded.data(), encoded.data() + encoded.size()/2,
+                               decoded.data(), decoded.size()),
+                colza::Exception);
+    }
+
+    void testLossless() {
+        Pipeline::Codec codec;
+        codec.mode = Pipeline::Mode::LOSSLESS;
+
+        auto x = field(10000);
+        auto block = Pipeline::Compress(x.data(), x.size()*sizeof(double),
+                                        colza::Type::FLOAT64, codec);
+        auto restored = Pipeline::Decompress(block);
+        CPPUNIT_ASSERT_MESSAGE(
+                "lossless compression should restore the exact bytes",
+                restored.size() == x.size()*sizeof(double)
+                && std::memcmp(restored.data(), x.data(), restored.size()) == 0);
+
+        std::vector<int32_t> y(10000);
+        for(size_t i = 0; i < y.size(); i++)
+            y[i] = (int32_t)(i/10) - 500;
+        block = Pipeline::Compress(y.data(), y.size()*sizeof(int32_t),
+                                   colza::Type::INT32, codec);
+        CPPUNIT_ASSERT_MESSAGE(
+                "lossless compression should compress smooth integers",
+                block.bytes.size() < y.size()*sizeof(int32_t)/2);
+        restored = Pipeline::Decompress(block);
+        CPPUNIT_ASSERT_MESSAGE(
+                "lossless compression should restore integers exactly",
+                restored.size() == y.size()*sizeof(int32_t)
+                && std::memcmp(restored.data(), y.data(), restored.size()) == 0);
+    }
+
+    void testSerialize() {
+        Pipeline::Codec codec;
+        codec.mode = Pipeline::Mode::LOSSY;
+        codec.error_bound = 1e-2;
+
+        auto x = field(1000);
+        auto block = Pipeline::Compress(x.data(), x.size()*sizeof(double),
+                                        colza::Type::FLOAT64, codec);
+        auto bytes = Pipeline::Serialize(block);
+        auto parsed = Pipeline::Deserialize(bytes.data(), bytes.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "the header should give the codec, type and original size",
+                parsed.codec.mode == Pipeline::Mode::LOSSY
+                && parsed.codec.error_bound == codec.error_bound
+                && parsed.type == colza::Type::FLOAT64
+                && parsed.original_size == x.size()*sizeof(double)
+                && parsed.bytes == block.bytes);
+        auto restored = Pipeline::Decompress(parsed);
+        auto y = reinterpret_cast<const double*>(restored.data());
+        double max_error = 0;
+        for(size_t i = 0; i < x.size(); i++)
+            max_error = std::max(max_error, std::abs(x[i] - y[i]));
+        CPPUNIT_ASSERT_MESSAGE(
+                "a fetched block should be decompressed within the error bound",
+                max_error <= codec.error_bound);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a truncated header should be rejected",
+                Pipeline::Deserialize(bytes.data(), 8),
+                colza::Exception);
+    }
+
+    void testLossy() {
+        Pipeline::Codec codec;
+        codec.mode = Pipeline::Mode::LOSSY;
+        codec.error_bound = 1e-3;
+
+        auto x = field(10000);
+        x[100] = 1e30;  // values far from their prediction are outliers
+        x[200] = -1e30;
+        auto block = Pipeline::Compress(x.data(), x.size()*sizeof(double),
+                                        colza::Type::FLOAT64, codec);
+        CPPUNIT_ASSERT_MESSAGE(
+                "lossy compression should be within the error bound",
+                block.max_error <= codec.error_bound);
+        auto restored = Pipeline::Decompress(block);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "lossy compression should restore all the values",
+                x.size()*sizeof(double), restored.size());
+        auto y = reinterpret_cast<const double*>(restored.data());
+        for(size_t i = 0; i < x.size(); i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                    "restored values should be within the error bound",
+                    x[i], y[i], codec.error_bound);
+        }
+
+        std::vector<float> f(5000);
+        for(size_t i = 0; i < f.size(); i++)
+            f[i] = -3.0f + 0.001f*i;
+        block = Pipeline::Compress(f.data(), f.size()*sizeof(float),
+                                   colza::Type::FLOAT32, codec);
+        restored = Pipeline::Decompress(block);
+        auto g = reinterpret_cast<const float*>(restored.data());
+        for(size_t i = 0; i < f.size(); i++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                    "restored float32 values should be within the error bound",
+                    f[i], g[i], codec.error_bound);
+        }
+
+        std::vector<int64_t> n = { -3, 5, 1LL << 40, -(1LL << 50) };
+        block = Pipeline::Compress(n.data(), n.size()*sizeof(int64_t),
+                                   colza::Type::INT64, codec);
+        CPPUNIT_ASSERT_MESSAGE(
+                "integers should always be compressed losslessly",
+                block.codec.mode == Pipeline::Mode::LOSSLESS);
+        restored = Pipeline::Decompress(block);
+        CPPUNIT_ASSERT_MESSAGE(
+                "integers should be restored exactly",
+                std::memcmp(restored.data(), n.data(), restored.size()) == 0);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( CodecsTest );
@@ -0,0 +1,137 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/Communicator.hpp>
+#include "../src/CommunicatorImpl.hpp"
+#include <memory>
+#include <vector>
+
+extern thallium::engine engine;
+extern mona_instance_t mona;
+
+class CommunicatorTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( CommunicatorTest );
+    CPPUNIT_TEST( testContexts );
+    CPPUNIT_TEST( testTags );
+    CPPUNIT_TEST( testDerive );
+    CPPUNIT_TEST( testPendingOperations );
+    CPPUNIT_TEST_SUITE_END();
+
+    colza::Communicator makeCommunicator(uint32_t context) {
+        na_addr_t self_addr = NA_ADDR_NULL;
+        mona_addr_self(mona, &self_addr);
+        colza::Communicator comm(mona, { self_addr }, engine.get_handler_pool(), context);
+        mona_addr_free(mona, self_addr);
+        return comm;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testContexts() {
+        auto first = std::make_unique<colza::CommunicatorContext>();
+        colza::CommunicatorContext second;
+        CPPUNIT_ASSERT_MESSAGE(
+                "claimed contexts should be valid and distinct",
+                first->value() != 0 && second.value() != 0
+                && first->value() != second.value());
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "claiming a context in use should throw",
+                colza::CommunicatorContext(second.value()),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "claiming context 0 should throw",
+                colza::CommunicatorContext(0),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "claiming a context out of range should throw",
+                colza::CommunicatorContext(colza::Communicator::MAX_CONTEXT + 1),
+                colza::Exception);
+
+        auto value = first->value();
+        first.reset();
+        colza::CommunicatorContext again(value);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a released context should be claimable again",
+                value, again.value());
+    }
+
+    void testTags() {
+        using colza::CommunicatorImpl;
+        auto max_seq = (colza::Communicator::MAX_CONTEXT << CommunicatorImpl::DERIVED_BITS
+                        | colza::Communicator::MAX_DERIVED) << CommunicatorImpl::SEQ_BITS
+                        | (colza::Communicator::MAX_PENDING - 1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the largest tag should use all the bits",
+                (na_tag_t)0xFFFFFFFF,
+                CommunicatorImpl::makeTag(max_seq, colza::Communicator::MAX_STEPS));
+        CPPUNIT_ASSERT_MESSAGE(
+                "different sequence numbers should give different tags",
+                CommunicatorImpl::makeTag(1, 0) != CommunicatorImpl::makeTag(2, 0));
+        CPPUNIT_ASSERT_MESSAGE(
+                "different steps should give different tags",
+                CommunicatorImpl::makeTag(1, 0) != CommunicatorImpl::makeTag(1, 1));
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a step out of range should throw rather than wrap",
+                CommunicatorImpl::makeTag(1, colza::Communicator::MAX_STEPS + 1),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a communicator with a context out of range should not be built",
+                makeCommunicator(colza::Communicator::MAX_CONTEXT + 1),
+                colza::Exception);
+    }
+
+    void testDerive() {
+        auto comm = makeCommunicator(3);
+        // derive both from the communicator and from derived ones
+        std::vector<colza::Communicator> derived = { comm.derive("d") };
+        for(uint32_t i = 1; i < colza::Communicator::MAX_DERIVED; i++)
+            derived.push_back(i % 2 ? derived.back().derive("d") : comm.derive("d"));
+        for(auto& d : derived) {
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                    "derived communicators should have the same members",
+                    comm.size(), d.size());
+        }
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "deriving more than MAX_DERIVED communicators should throw",
+                comm.derive("extra"),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "communicators derived from derived ones should count too",
+                derived.back().derive("extra"),
+                colza::Exception);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "a new communicator should have its own count",
+                makeCommunicator(3).derive("d"));
+    }
+
+    void testPendingOperations() {
+        // more operations than sequence numbers, so that posting waits
+        // for the operations posted MAX_PENDING earlier
+        auto comm = makeCommunicator(0);
+        const size_t n = 3*colza::Communicator::MAX_PENDING + 5;
+        std::vector<int64_t> in(n), out(n, -1);
+        std::vector<colza::Communicator::Request> requests;
+        for(size_t i = 0; i < n; i++) {
+            in[i] = (int64_t)i;
+            requests.push_back(comm.iallreduce(&in[i], &out[i], 1,
+                                               colza::Type::INT64,
+                                               colza::Communicator::ReduceOp::SUM));
+        }
+        comm.barrier();
+        for(auto& r : requests) r.wait();
+        for(size_t i = 0; i < n; i++) {
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                    "every operation should complete with its own result",
+                    in[i], out[i]);
+        }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( CommunicatorTest );
@@ -0,0 +1,227 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/CompositePipeline.hpp"
+#include <colza/Exception.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+
+namespace tl = thallium;
+
+// what the stages of the tested composites did, in order
+static tl::mutex                log_mtx;
+static std::vector<std::string> log_entries;
+
+static void Log(const std::string& entry) {
+    std::lock_guard<tl::mutex> g(log_mtx);
+    log_entries.push_back(entry);
+}
+
+// stage recording the blocks it receives and its execution as
+// "<label>:<dataset>" and "<label>", after sleeping "delay" ms,
+// and failing if "fail" is set
+class RecordingStage : public colza::StagingPipeline {
+
+    public:
+
+    RecordingStage(const colza::PipelineFactoryArgs& args)
+    : colza::StagingPipeline(args) {}
+
+    colza::RequestResult<int32_t> execute(uint64_t iteration) override {
+        (void)iteration;
+        auto delay = m_config.value("delay", 0);
+        if(delay) tl::thread::sleep(m_engine, delay);
+        Log(m_config.value("label", std::string()));
+        if(m_config.value("fail", false))
+            return Failure("Stage failed on purpose");
+        return Success();
+    }
+
+    static std::unique_ptr<colza::Backend> create(const colza::PipelineFactoryArgs& args) {
+        return std::unique_ptr<colza::Backend>(new RecordingStage(args));
+    }
+
+    protected:
+
+    void onStaged(const std::string& dataset_name,
+                  uint64_t iteration,
+                  uint64_t block_id,
+                  const colza::BlockStore::BlockPtr& block) override {
+        (void)iteration;
+        (void)block_id;
+        (void)block;
+        Log(m_config.value("label", std::string()) + ":" + dataset_name);
+    }
+};
+
+COLZA_REGISTER_BACKEND(recording, RecordingStage);
+
+class CompositePipelineTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( CompositePipelineTest );
+    CPPUNIT_TEST( testConfiguration );
+    CPPUNIT_TEST( testOrder );
+    CPPUNIT_TEST( testSkip );
+    CPPUNIT_TEST( testDatasets );
+    CPPUNIT_TEST_SUITE_END();
+
+    using json = nlohmann::json;
+
+    static json makeStage(const std::string& name,
+                          std::vector<std::string> after = {},
+                          json config = json::object()) {
+        config["label"] = name;
+        json stage = { { "name", name }, { "type", "recording" }, { "config", config } };
+        if(!after.empty()) stage["after"] = after;
+        return stage;
+    }
+
+    static colza::PipelineFactoryArgs makeArgs(const json& stages) {
+        colza::PipelineFactoryArgs args;
+        args.gid    = SSG_GROUP_ID_INVALID;
+        args.engine = engine;
+        args.pool   = engine.get_handler_pool();
+        args.config = { { "stages", stages } };
+        return args;
+    }
+
+    static std::vector<std::string> takeLog() {
+        std::lock_guard<tl::mutex> g(log_mtx);
+        std::vector<std::string> entries;
+        entries.swap(log_entries);
+        return entries;
+    }
+
+    static size_t position(const std::vector<std::string>& entries, const std::string& entry) {
+        return std::find(entries.begin(), entries.end(), entry) - entries.begin();
+    }
+
+    public:
+
+    void setUp() {
+        takeLog();
+    }
+
+    void tearDown() {}
+
+    void testConfiguration() {
+        json too_many = json::array();
+        for(uint32_t i = 0; i <= colza::Communicator::MAX_DERIVED; i++)
+            too_many.push_back(makeStage("s" + std::to_string(i)));
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "more stages than derived communicators should be rejected",
+                colza::CompositePipeline(makeArgs(too_many)),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "cycles should be rejected",
+                colza::CompositePipeline(makeArgs({ makeStage("a", { "b" }), makeStage("b", { "a" }) })),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "unknown stages in \"after\" should be rejected",
+                colza::CompositePipeline(makeArgs({ makeStage("a", { "c" }) })),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "stages should have distinct names",
+                colza::CompositePipeline(makeArgs({ makeStage("a"), makeStage("a") })),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "stage names should not contain '/'",
+                colza::CompositePipeline(makeArgs({ makeStage("a/b") })),
+                colza::Exception);
+        auto nested = makeStage("a");
+        nested["type"] = "composite";
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "stages should not be composite",
+                colza::CompositePipeline(makeArgs({ nested })),
+                colza::Exception);
+    }
+
+    void testOrder() {
+        colza::CompositePipeline composite(makeArgs({
+            makeStage("a", {}, { { "delay", 100 } }),
+            makeStage("b", { "a" }),
+            makeStage("c")
+        }));
+        composite.start(1);
+        auto result = composite.execute(1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "execute should succeed",
+                result.success());
+        auto entries = takeLog();
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "every stage should execute once",
+                (size_t)3, entries.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "a stage should execute after the stages it comes after",
+                position(entries, "a") < position(entries, "b"));
+        CPPUNIT_ASSERT_MESSAGE(
+                "independent stages should not wait for each other",
+                position(entries, "c") < position(entries, "a"));
+        auto stages = composite.results(1)["stages"];
+        for(auto name : { "a", "b", "c" }) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the results should give the duration of each stage",
+                    stages[name].contains("seconds"));
+        }
+        composite.cleanup(1);
+    }
+
+    void testSkip() {
+        colza::CompositePipeline composite(makeArgs({
+            makeStage("a", {}, { { "fail", true } }),
+            makeStage("b", { "a" }),
+            makeStage("c")
+        }));
+        composite.start(1);
+        auto result = composite.execute(1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "execute should report the failure of a stage",
+                !result.success());
+        auto entries = takeLog();
+        CPPUNIT_ASSERT_MESSAGE(
+                "a stage after a failed stage should not execute",
+                position(entries, "b") == entries.size());
+        CPPUNIT_ASSERT_MESSAGE(
+                "stages that do not depend on the failed stage should execute",
+                position(entries, "c") != entries.size());
+        auto stages = composite.results(1)["stages"];
+        CPPUNIT_ASSERT_MESSAGE(
+                "the results should report the skipped stage",
+                stages["b"].value("skipped", false));
+        composite.cleanup(1);
+    }
+
+    void testDatasets() {
+        auto x_only = makeStage("a");
+        x_only["datasets"] = json::array({ "x" });
+        colza::CompositePipeline composite(makeArgs({ x_only, makeStage("b") }));
+        composite.start(1);
+        colza::BlockStore store;
+        std::vector<double> data(4, 1.0);
+        for(auto name : { "x", "y" }) {
+            auto block = store.insert(name, 1, 0, { 4 }, { 0 }, colza::Type::FLOAT64,
+                                      data.data(), data.size()*sizeof(double));
+            CPPUNIT_ASSERT_MESSAGE(
+                    "staging a shared block should succeed",
+                    composite.stageShared(name, 1, 0, block).success());
+        }
+        auto entries = takeLog();
+        std::sort(entries.begin(), entries.end());
+        std::vector<std::string> expected = { "a:x", "b:x", "b:y" };
+        CPPUNIT_ASSERT_MESSAGE(
+                "blocks should only go to the stages that consume their dataset",
+                expected == entries);
+        std::vector<colza::Box> boxes;
+        CPPUNIT_ASSERT_MESSAGE(
+                "the staged datasets should be summarized by the composite",
+                composite.summarize("y", 1, 1, boxes).success() && boxes.size() == 1);
+        composite.cleanup(1);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( CompositePipelineTest );
@@ -0,0 +1,171 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/Client.hpp>
+#include <colza/Admin.hpp>
+#include <colza/ClientCommunicator.hpp>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+extern std::string pipeline_type;
+extern std::string ssg_file;
+
+namespace tl = thallium;
+
+// communicator of client processes simulated by ULTs of this process
+class LocalCommunicator : public colza::ClientCommunicator {
+
+    public:
+
+    struct State {
+        tl::mutex              mtx;
+        tl::condition_variable cv;
+        int                    size = 0;
+        int                    arrived = 0;
+        uint64_t               generation = 0;
+        std::vector<char>      buffer;
+    };
+
+    LocalCommunicator(std::shared_ptr<State> state, int rank)
+    : m_state(std::move(state))
+    , m_rank(rank) {}
+
+    int size() const override { return m_state->size; }
+
+    int rank() const override { return m_rank; }
+
+    void barrier() const override {
+        std::unique_lock<tl::mutex> lock(m_state->mtx);
+        auto generation = m_state->generation;
+        if(++m_state->arrived == m_state->size) {
+            m_state->arrived = 0;
+            m_state->generation += 1;
+            m_state->cv.notify_all();
+        } else {
+            while(generation == m_state->generation)
+                m_state->cv.wait(lock);
+        }
+    }
+
+    void bcast(void* buffer, int bytes, int root) const override {
+        if(m_rank == root) {
+            std::lock_guard<tl::mutex> lock(m_state->mtx);
+            m_state->buffer.assign(static_cast<char*>(buffer), static_cast<char*>(buffer) + bytes);
+        }
+        barrier();
+        if(m_rank != root && bytes)
+            std::memcpy(buffer, m_state->buffer.data(), bytes);
+        barrier();
+    }
+
+    private:
+
+    std::shared_ptr<State> m_state;
+    int                    m_rank;
+};
+
+class DistributedPipelineHandleTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( DistributedPipelineHandleTest );
+    CPPUNIT_TEST( testCollectiveWait );
+    CPPUNIT_TEST( testSharedError );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr const char* pipeline_name = "shared";
+    static constexpr int num_clients = 3;
+
+    using ClientFunction = std::function<void(int, const colza::DistributedPipelineHandle&)>;
+
+    // runs f in one ULT per client, each with its own handle, returning
+    // the exception each client ended with, if any
+    static std::vector<std::exception_ptr> runClients(const ClientFunction& f) {
+        auto state = std::make_shared<LocalCommunicator::State>();
+        state->size = num_clients;
+        std::vector<std::unique_ptr<LocalCommunicator>> comms;
+        for(int r = 0; r < num_clients; r++)
+            comms.emplace_back(new LocalCommunicator(state, r));
+        std::vector<std::exception_ptr> errors(num_clients);
+        std::vector<tl::managed<tl::thread>> ults;
+        for(int r = 0; r < num_clients; r++) {
+            ults.push_back(engine.get_handler_pool().make_thread([r, &f, &comms, &errors]() {
+                try {
+                    colza::Client client(engine);
+                    auto handle = client.makeDistributedPipelineHandle(
+                        comms[r].get(), ssg_file, 0, pipeline_name);
+                    f(r, handle);
+                } catch(...) {
+                    errors[r] = std::current_exception();
+                }
+            }));
+        }
+        for(auto& ult : ults) ult->join();
+        return errors;
+    }
+
+    public:
+
+    void setUp() {
+        colza::Admin admin(engine);
+        admin.createDistributedPipeline(ssg_file, 0, pipeline_name, pipeline_type, "{}");
+    }
+
+    void tearDown() {
+        colza::Admin admin(engine);
+        admin.destroyDistributedPipeline(ssg_file, 0, pipeline_name);
+    }
+
+    void testCollectiveWait() {
+        std::vector<int32_t> results(num_clients, -1);
+        auto errors = runClients([&results](int rank, const colza::DistributedPipelineHandle& h) {
+            auto handle = h;
+            handle.start(1, { { "data", (uint64_t)rank } });
+            std::vector<double> data(8, (double)rank);
+            handle.stage("data", 1, rank, { 8 }, { (int64_t)(8*rank) },
+                         colza::Type::FLOAT64, data.data());
+            handle.wait(1, &results[rank]);
+            handle.cleanup(1);
+        });
+        for(int r = 0; r < num_clients; r++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "no client should fail",
+                    errors[r] == nullptr);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                    "every client should get the outcome of the execution",
+                    0, results[r]);
+        }
+    }
+
+    void testSharedError() {
+        // the group has fewer servers than there are clients, so only
+        // one client hears from the server, and the others must get
+        // its error through the communicator
+        std::vector<bool> failed(num_clients, false);
+        auto errors = runClients([&failed](int rank, const colza::DistributedPipelineHandle& h) {
+            auto handle = h;
+            handle.start(1);
+            try {
+                handle.wait(1);
+            } catch(const colza::Exception&) {
+                failed[rank] = true;
+            }
+            handle.cleanup(1);
+        });
+        for(int r = 0; r < num_clients; r++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "no client should fail outside of wait",
+                    errors[r] == nullptr);
+            CPPUNIT_ASSERT_MESSAGE(
+                    "every client should get the error of wait",
+                    failed[r]);
+        }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( DistributedPipelineHandleTest );
@@ -0,0 +1,337 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/StagingPipeline.hpp"
+#include <colza/Client.hpp>
+#include <colza/Admin.hpp>
+#include <colza/ClientCommunicator.hpp>
+#include <colza/Exception.hpp>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+extern std::string ssg_file;
+
+namespace tl = thallium;
+
+// rows and columns of the grid staged for the queries
+static const int64_t ROWS = 8;
+static const int64_t COLS = 6;
+// value of the elements that no block should write
+static const double UNSET = -1.0;
+
+// backend keeping the staged blocks, whose execution publishes the
+// number of datasets as results
+class FetchStage : public colza::StagingPipeline {
+
+    public:
+
+    FetchStage(const colza::PipelineFactoryArgs& args)
+    : colza::StagingPipeline(args) {}
+
+    colza::RequestResult<int32_t> execute(uint64_t iteration) override {
+        auto names = globalDatasetNames(communicator(), iteration);
+        publishResults(iteration, { { "datasets", names.size() } }, communicator());
+        return Success();
+    }
+
+    static std::unique_ptr<colza::Backend> create(const colza::PipelineFactoryArgs& args) {
+        return std::unique_ptr<colza::Backend>(new FetchStage(args));
+    }
+};
+
+COLZA_REGISTER_BACKEND(fetch_stage, FetchStage);
+
+// communicator of a single client
+class SingleClientCommunicator : public colza::ClientCommunicator {
+
+    public:
+
+    int size() const override { return 1; }
+
+    int rank() const override { return 0; }
+
+    void barrier() const override {}
+
+    void bcast(void*, int, int) const override {}
+};
+
+class FetchTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( FetchTest );
+    CPPUNIT_TEST( testFetch );
+    CPPUNIT_TEST( testFetchErrors );
+    CPPUNIT_TEST( testBatch );
+    CPPUNIT_TEST( testQueryPlaced );
+    CPPUNIT_TEST( testQueryScattered );
+    CPPUNIT_TEST( testQueryBulk );
+    CPPUNIT_TEST( testQueryErrors );
+    CPPUNIT_TEST( testDistributedQuery );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr const char* pipeline_name = "fetch";
+
+    std::vector<double> m_data;
+
+    colza::PipelineHandle makeHandle() {
+        colza::Client client(engine);
+        return client.makePipelineHandle(engine.self(), 0, pipeline_name);
+    }
+
+    // stages m_data as block 7 of dataset "data" of iteration 1
+    void stage(const colza::PipelineHandle& pipeline) {
+        pipeline.start(1);
+        pipeline.stage("data", 1, 7, { 4, 6 }, { 4, 0 }, colza::Type::FLOAT64, m_data.data());
+    }
+
+    // value of the element (x, y) of the grid
+    static double grid(int64_t x, int64_t y) {
+        return 10.0*x + y;
+    }
+
+    // stages the ROWSxCOLS grid as dataset "grid" of iteration 1, in
+    // blocks of 4 rows, leaving row 4 out if with_gap is set
+    static void stageGrid(const colza::PipelineHandle& pipeline, bool with_gap) {
+        pipeline.start(1);
+        const int64_t rows[2][2] = { { 0, 4 }, { with_gap ? 5 : 4, ROWS } };
+        for(uint64_t b = 0; b < 2; b++) {
+            std::vector<double> data;
+            for(int64_t x = rows[b][0]; x < rows[b][1]; x++)
+                for(int64_t y = 0; y < COLS; y++)
+                    data.push_back(grid(x, y));
+            pipeline.stage("grid", 1, b, { (size_t)(rows[b][1] - rows[b][0]), (size_t)COLS },
+                           { rows[b][0], 0 }, colza::Type::FLOAT64, data.data());
+        }
+    }
+
+    // checks that a buffer covering the region holds the grid, except
+    // for the row left out of it
+    static void checkRegion(const colza::Box& region, const std::vector<double>& out,
+                            int64_t missing_row = -1) {
+        size_t k = 0;
+        for(int64_t x = region.lower[0]; x < region.upper[0]; x++) {
+            for(int64_t y = region.lower[1]; y < region.upper[1]; y++, k++) {
+                if(x == missing_row) {
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                            "elements not covered by any block should be untouched",
+                            UNSET, out[k], 0.0);
+                } else {
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                            "the queried elements should be those of the grid",
+                            grid(x, y), out[k], 0.0);
+                }
+            }
+        }
+    }
+
+    public:
+
+    void setUp() {
+        m_data.resize(24);
+        for(size_t i = 0; i < m_data.size(); i++) m_data[i] = 0.5*i;
+        colza::Admin admin(engine);
+        admin.createPipeline(engine.self(), 0, pipeline_name, "fetch_stage", "{}");
+    }
+
+    void tearDown() {
+        colza::Admin admin(engine);
+        admin.destroyPipeline(engine.self(), 0, pipeline_name);
+    }
+
+    void testFetch() {
+        auto pipeline = makeHandle();
+        stage(pipeline);
+        std::vector<double> out(m_data.size(), -1.0);
+        colza::BlockInfo info;
+        pipeline.fetch("data", 1, 7, out.data(), out.size()*sizeof(double), &info);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the info should describe the staged block",
+                info.dimensions == std::vector<size_t>({ 4, 6 })
+                && info.offsets == std::vector<int64_t>({ 4, 0 })
+                && info.type == colza::Type::FLOAT64
+                && info.size == m_data.size()*sizeof(double));
+        CPPUNIT_ASSERT_MESSAGE(
+                "the fetched data should be the staged data",
+                out == m_data);
+
+        pipeline.execute(1);
+        std::string document(256, '\0');
+        pipeline.fetch("$results", 1, 0, &document[0], document.size(), &info);
+        document.resize(info.size);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the results of an iteration should be fetchable",
+                (size_t)1, nlohmann::json::parse(document)["datasets"].get<size_t>());
+        pipeline.cleanup(1);
+    }
+
+    void testFetchErrors() {
+        auto pipeline = makeHandle();
+        stage(pipeline);
+        std::vector<double> out(m_data.size());
+        colza::BlockInfo info;
+        try {
+            pipeline.fetch("data", 1, 7, out.data(), sizeof(double), &info);
+            CPPUNIT_FAIL("fetching into a buffer too small should throw");
+        } catch(const colza::Exception& ex) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the error should be that the buffer is too small",
+                    ex.code() == colza::ErrorCode::BUFFER_TOO_SMALL);
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                    "the info should give the size of the block",
+                    m_data.size()*sizeof(double), info.size);
+        }
+        try {
+            pipeline.fetch("data", 1, 8, out.data(), out.size()*sizeof(double));
+            CPPUNIT_FAIL("fetching a missing block should throw");
+        } catch(const colza::Exception& ex) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the error should be that the block was not found",
+                    ex.code() == colza::ErrorCode::BLOCK_NOT_FOUND);
+        }
+        pipeline.cleanup(1);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "blocks should not be fetchable after cleanup",
+                pipeline.fetch("data", 1, 7, out.data(), out.size()*sizeof(double)),
+                colza::Exception);
+    }
+
+    void testBatch() {
+        auto pipeline = makeHandle();
+        stage(pipeline);
+        std::vector<double> out(m_data.size()), small(1);
+        std::vector<colza::FetchRequest> requests(3);
+        for(auto& r : requests) {
+            r.dataset_name = "data";
+            r.iteration    = 1;
+            r.block_id     = 7;
+        }
+        requests[0].buffer = out.data();
+        requests[0].size   = out.size()*sizeof(double);
+        requests[1].block_id = 8;
+        requests[1].buffer = out.data();
+        requests[1].size   = out.size()*sizeof(double);
+        requests[2].buffer = small.data();
+        requests[2].size   = small.size()*sizeof(double);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "failures to fetch some blocks should not throw",
+                pipeline.fetch(requests));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a block found should be fetched",
+                0, requests[0].result);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the fetched data should be the staged data",
+                out == m_data);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a missing block should be reported in its request",
+                (int32_t)colza::ErrorCode::BLOCK_NOT_FOUND, requests[1].result);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a buffer too small should be reported in its request",
+                (int32_t)colza::ErrorCode::BUFFER_TOO_SMALL, requests[2].result);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a request with a buffer too small should still describe the block",
+                m_data.size()*sizeof(double), requests[2].info.size);
+        pipeline.cleanup(1);
+    }
+
+    void testQueryPlaced() {
+        auto pipeline = makeHandle();
+        stageGrid(pipeline, false);
+        // full rows from both blocks, which the server assembles into
+        // a single contiguous run of the buffer
+        colza::Box region({ 2, 0 }, { 6, COLS });
+        std::vector<double> out(region.volume(), UNSET);
+        pipeline.query("grid", 1, region, colza::Type::FLOAT64, out.data());
+        checkRegion(region, out);
+        // a region that is not contiguous within any block
+        colza::Box inner({ 1, 1 }, { 7, 5 });
+        out.assign(inner.volume(), UNSET);
+        pipeline.query("grid", 1, inner, colza::Type::FLOAT64, out.data());
+        checkRegion(inner, out);
+        pipeline.cleanup(1);
+    }
+
+    void testQueryScattered() {
+        auto pipeline = makeHandle();
+        stageGrid(pipeline, true);
+        // the parts don't tile their bounding box, so the server packs
+        // them and the client scatters them
+        colza::Box region({ 2, 1 }, { 7, 5 });
+        std::vector<double> out(region.volume(), UNSET);
+        pipeline.query("grid", 1, region, colza::Type::FLOAT64, out.data());
+        checkRegion(region, out, 4);
+        // a region reaching past the grid
+        colza::Box wide({ 6, 2 }, { ROWS + 2, COLS + 2 });
+        out.assign(wide.volume(), UNSET);
+        pipeline.query("grid", 1, wide, colza::Type::FLOAT64, out.data());
+        size_t k = 0;
+        for(int64_t x = wide.lower[0]; x < wide.upper[0]; x++) {
+            for(int64_t y = wide.lower[1]; y < wide.upper[1]; y++, k++) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                        "only the elements within the grid should be written",
+                        x < ROWS && y < COLS ? grid(x, y) : UNSET, out[k], 0.0);
+            }
+        }
+        pipeline.cleanup(1);
+    }
+
+    void testQueryBulk() {
+        auto pipeline = makeHandle();
+        stageGrid(pipeline, true);
+        colza::Box region({ 3, 2 }, { 6, 5 });
+        std::vector<double> out(region.volume(), UNSET);
+        std::vector<std::pair<void*, size_t>> segment = {
+            { out.data(), out.size()*sizeof(double) }
+        };
+        auto bulk = engine.expose(segment, tl::bulk_mode::write_only);
+        pipeline.query("grid", 1, region, colza::Type::FLOAT64, bulk);
+        checkRegion(region, out, 4);
+        pipeline.cleanup(1);
+    }
+
+    void testQueryErrors() {
+        auto pipeline = makeHandle();
+        stageGrid(pipeline, false);
+        colza::Box region({ 0, 0 }, { 2, 2 });
+        std::vector<double> out(region.volume());
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "querying with another type than the dataset's should throw",
+                pipeline.query("grid", 1, region, colza::Type::FLOAT32, out.data()),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "querying an empty region should throw",
+                pipeline.query("grid", 1, colza::Box({ 2, 2 }, { 2, 4 }),
+                               colza::Type::FLOAT64, out.data()),
+                colza::Exception);
+        pipeline.cleanup(1);
+    }
+
+    void testDistributedQuery() {
+        auto pipeline = makeHandle();
+        stageGrid(pipeline, true);
+        SingleClientCommunicator comm;
+        colza::Client client(engine);
+        auto dist = client.makeDistributedPipelineHandle(&comm, ssg_file, 0, pipeline_name);
+        colza::Box region({ 1, 0 }, { 7, COLS });
+        std::vector<double> out(region.volume(), UNSET);
+        dist.query("grid", 1, region, colza::Type::FLOAT64, out.data());
+        checkRegion(region, out, 4);
+
+        dist.loadCatalog("grid", 1);
+        out.assign(region.volume(), UNSET);
+        dist.query("grid", 1, region, colza::Type::FLOAT64, out.data());
+        checkRegion(region, out, 4);
+        // a region that the catalog shows no server holds
+        colza::Box outside({ ROWS, 0 }, { ROWS + 2, COLS });
+        out.assign(outside.volume(), UNSET);
+        dist.query("grid", 1, outside, colza::Type::FLOAT64, out.data());
+        CPPUNIT_ASSERT_MESSAGE(
+                "a region outside of the blocks should leave the buffer untouched",
+                out == std::vector<double>(outside.volume(), UNSET));
+        dist.clearCatalog();
+        pipeline.cleanup(1);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( FetchTest );
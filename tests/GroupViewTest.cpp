@@ -0,0 +1,153 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/GroupState.hpp"
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class GroupViewTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( GroupViewTest );
+    CPPUNIT_TEST( testInitialView );
+    CPPUNIT_TEST( testUnresolvedMember );
+    CPPUNIT_TEST( testDeltas );
+    CPPUNIT_TEST( testEventOrder );
+    CPPUNIT_TEST_SUITE_END();
+
+    using Addresses = std::map<ssg_member_id_t, na_addr_t>;
+    using Members = std::vector<ssg_member_id_t>;
+
+    // views only carry addresses around, any distinct value will do
+    static na_addr_t fakeAddress(ssg_member_id_t member_id) {
+        return reinterpret_cast<na_addr_t>((uintptr_t)(member_id + 1));
+    }
+
+    static Addresses addressesOf(const Members& member_ids) {
+        Addresses addresses;
+        for(auto id : member_ids) addresses[id] = fakeAddress(id);
+        return addresses;
+    }
+
+    static uint64_t hashOf(const Members& member_ids) {
+        uint64_t hash = 0;
+        for(auto id : member_ids) hash = colza::UpdateGroupHash(hash, id);
+        return hash;
+    }
+
+    static std::shared_ptr<colza::GroupView> next(const colza::GroupView& view,
+                                                  const Members& ssg_members,
+                                                  const Addresses& addresses) {
+        return colza::GroupState::NextView(view, ssg_members, addresses);
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testInitialView() {
+        Members members = { 12, 40, 77 };
+        auto view = next(colza::GroupView(), members, addressesOf(members));
+        CPPUNIT_ASSERT_MESSAGE(
+                "the first view should be published",
+                view != nullptr);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the first view should have version 1",
+                (uint64_t)1, view->version);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the members should be in SSG rank order",
+                view->member_ids == members);
+        for(size_t i = 0; i < members.size(); i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "each rank should have the address of its member",
+                    view->addresses[i] == fakeAddress(members[i]));
+        }
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the hash should be that of the members",
+                hashOf(members), view->hash);
+        CPPUNIT_ASSERT_MESSAGE(
+                "all the members of the first view have joined",
+                view->joined == members && view->left.empty() && view->rank_map.empty());
+        CPPUNIT_ASSERT_MESSAGE(
+                "no view should be published if the members did not change",
+                next(*view, members, addressesOf(members)) == nullptr);
+    }
+
+    void testUnresolvedMember() {
+        Members members = { 3, 8, 21 };
+        auto view = next(colza::GroupView(), members, addressesOf({ 3, 21 }));
+        CPPUNIT_ASSERT_MESSAGE(
+                "a member whose address is not resolved should not be in the view",
+                view->member_ids == Members({ 3, 21 }));
+        CPPUNIT_ASSERT_MESSAGE(
+                "the hash of a view missing a member should not be that of the group",
+                view->hash != hashOf(members));
+
+        auto resolved = next(*view, members, addressesOf(members));
+        CPPUNIT_ASSERT_MESSAGE(
+                "the member should join the view once its address is resolved",
+                resolved->member_ids == members && resolved->joined == Members({ 8 }));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the hash should match the group once all the members are in the view",
+                hashOf(members), resolved->hash);
+    }
+
+    void testDeltas() {
+        Members members = { 10, 20, 30, 40 };
+        auto v1 = next(colza::GroupView(), members, addressesOf(members));
+
+        // 20 leaves and 25 joins, between 10 and 30 in SSG rank order
+        Members members2 = { 10, 25, 30, 40 };
+        auto v2 = next(*v1, members2, addressesOf(members2));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "each change should increment the version",
+                (uint64_t)2, v2->version);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the view should report the members that joined and left",
+                v2->joined == Members({ 25 }) && v2->left == Members({ 20 }));
+        CPPUNIT_ASSERT_MESSAGE(
+                "rank_map should map the previous ranks to the new ones",
+                v2->rank_map == std::vector<int>({ 0, -1, 2, 3 }));
+        for(size_t i = 0; i < v1->size(); i++) {
+            if(v2->rank_map[i] == -1) continue;
+            CPPUNIT_ASSERT_MESSAGE(
+                    "a remaining member should keep its address at its new rank",
+                    v2->addresses[v2->rank_map[i]] == v1->addresses[i]);
+        }
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "rankOf should return the rank of a member",
+                1, v2->rankOf(25));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "rankOf should return -1 for a member that left",
+                -1, v2->rankOf(20));
+    }
+
+    void testEventOrder() {
+        // two servers see 50 and 60 join, but resolve their addresses in
+        // opposite orders; ranks follow the SSG rank order given here
+        Members initial = { 5, 15 };
+        Members group = { 5, 50, 15, 60 };
+        auto start = next(colza::GroupView(), initial, addressesOf(initial));
+
+        auto a1 = next(*start, group, addressesOf({ 5, 15, 50 }));
+        auto a2 = next(*a1, group, addressesOf(group));
+        auto b1 = next(*start, group, addressesOf({ 5, 15, 60 }));
+        auto b2 = next(*b1, group, addressesOf(group));
+
+        CPPUNIT_ASSERT_MESSAGE(
+                "intermediate views with different members should have different hashes",
+                a1->hash != b1->hash);
+        CPPUNIT_ASSERT_MESSAGE(
+                "servers with the same members should have the same ranks",
+                a2->member_ids == group && b2->member_ids == group);
+        CPPUNIT_ASSERT_MESSAGE(
+                "servers with the same members should have the same hash",
+                a2->hash == b2->hash && a2->hash == hashOf(group));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( GroupViewTest );
@@ -0,0 +1,122 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/HaloExchange.hpp>
+#include <colza/Exception.hpp>
+#include <vector>
+
+extern thallium::engine engine;
+extern mona_instance_t mona;
+
+// cells per block along each axis
+static const int64_t N = 4;
+// value of the cells that no block should write
+static const double UNSET = -1.0;
+
+class HaloExchangeTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( HaloExchangeTest );
+    CPPUNIT_TEST( testInvalid );
+    CPPUNIT_TEST( testGhostedBoxes );
+    CPPUNIT_TEST( testExchange );
+    CPPUNIT_TEST_SUITE_END();
+
+    colza::Communicator makeCommunicator() {
+        na_addr_t self_addr = NA_ADDR_NULL;
+        mona_addr_self(mona, &self_addr);
+        colza::Communicator comm(mona, { self_addr }, engine.get_handler_pool());
+        mona_addr_free(mona, self_addr);
+        return comm;
+    }
+
+    // the blocks of a 2x2 grid of NxN blocks, in row-major order
+    static std::vector<colza::Box> gridBoxes() {
+        std::vector<colza::Box> boxes;
+        for(int64_t i = 0; i < 2; i++)
+            for(int64_t j = 0; j < 2; j++)
+                boxes.push_back(colza::Box::FromBlock({ N, N }, { i*N, j*N }));
+        return boxes;
+    }
+
+    // value of the cell at global coordinates (x, y)
+    static double value(int64_t x, int64_t y) {
+        return 100.0*x + y;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testInvalid() {
+        colza::HaloExchange halo;
+        CPPUNIT_ASSERT_MESSAGE(
+                "a default-constructed HaloExchange should be invalid",
+                !halo);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "using an invalid HaloExchange should throw",
+                halo.exchange({}),
+                colza::Exception);
+    }
+
+    void testGhostedBoxes() {
+        auto boxes = gridBoxes();
+        colza::HaloExchange halo(makeCommunicator(), boxes, 2, colza::Type::FLOAT64);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, halo.width());
+        for(size_t i = 0; i < boxes.size(); i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "a ghosted box should be the block grown by the width",
+                    halo.ghostedBox(i) == boxes[i].grow(2));
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "blocks that are all local should have no remote neighbor",
+                halo.neighbors().empty());
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "exchange should expect one buffer per block",
+                halo.exchange({ nullptr }),
+                colza::Exception);
+    }
+
+    void testExchange() {
+        auto boxes = gridBoxes();
+        colza::HaloExchange halo(makeCommunicator(), boxes, 1, colza::Type::FLOAT64);
+        // each buffer has its own cells set and its ghost cells unset
+        std::vector<std::vector<double>> buffers;
+        std::vector<void*> data;
+        for(size_t i = 0; i < boxes.size(); i++) {
+            auto g = halo.ghostedBox(i);
+            std::vector<double> buffer;
+            for(int64_t x = g.lower[0]; x < g.upper[0]; x++)
+                for(int64_t y = g.lower[1]; y < g.upper[1]; y++)
+                    buffer.push_back(boxes[i].contains(colza::Box({ x, y }, { x+1, y+1 }))
+                                     ? value(x, y) : UNSET);
+            buffers.push_back(std::move(buffer));
+        }
+        for(auto& buffer : buffers) data.push_back(buffer.data());
+        halo.exchange(data);
+
+        const colza::Box domain({ 0, 0 }, { 2*N, 2*N });
+        for(size_t i = 0; i < boxes.size(); i++) {
+            auto g = halo.ghostedBox(i);
+            size_t k = 0;
+            for(int64_t x = g.lower[0]; x < g.upper[0]; x++) {
+                for(int64_t y = g.lower[1]; y < g.upper[1]; y++, k++) {
+                    if(domain.contains(colza::Box({ x, y }, { x+1, y+1 }))) {
+                        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                                "cells within the domain should hold the value of their owner",
+                                value(x, y), buffers[i][k], 0.0);
+                    } else {
+                        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                                "ghost cells outside of the domain should be untouched",
+                                UNSET, buffers[i][k], 0.0);
+                    }
+                }
+            }
+        }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( HaloExchangeTest );
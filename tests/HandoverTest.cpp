@@ -0,0 +1,124 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/Client.hpp>
+#include <colza/Admin.hpp>
+#include <colza/ClientCommunicator.hpp>
+#include <colza/RequestResult.hpp>
+#include <ssg.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+extern std::string pipeline_type;
+extern std::string ssg_file;
+
+namespace tl = thallium;
+
+// communicator of a single client
+class HandoverCommunicator : public colza::ClientCommunicator {
+
+    public:
+
+    int size() const override { return 1; }
+
+    int rank() const override { return 0; }
+
+    void barrier() const override {}
+
+    void bcast(void*, int, int) const override {}
+};
+
+class HandoverTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( HandoverTest );
+    CPPUNIT_TEST( testHeldExecution );
+    CPPUNIT_TEST( testHandoverAfterExecution );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr const char* pipeline_name = "handover";
+
+    HandoverCommunicator m_comm;
+
+    // the provider's handover RPCs, called as a leaving server would
+    int32_t call(const char* rpc_name, uint64_t iteration, ssg_member_id_t leaver_id) {
+        auto rpc = engine.define(rpc_name);
+        tl::provider_handle ph(engine.self(), 0);
+        colza::RequestResult<int32_t> result = rpc.on(ph)(
+            std::string(pipeline_name), iteration, leaver_id);
+        CPPUNIT_ASSERT_MESSAGE(
+                "handover RPCs should succeed",
+                result.success());
+        return result.value();
+    }
+
+    colza::DistributedPipelineHandle makeHandle() {
+        colza::Client client(engine);
+        return client.makeDistributedPipelineHandle(&m_comm, ssg_file, 0, pipeline_name);
+    }
+
+    public:
+
+    void setUp() {
+        colza::Admin admin(engine);
+        admin.createDistributedPipeline(ssg_file, 0, pipeline_name, pipeline_type, "{}");
+    }
+
+    void tearDown() {
+        colza::Admin admin(engine);
+        admin.destroyDistributedPipeline(ssg_file, 0, pipeline_name);
+    }
+
+    void testHeldExecution() {
+        const ssg_member_id_t leaver = 1234;
+        auto pipeline = makeHandle();
+        pipeline.start(1, { { "data", 0 } });
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a pipeline that has not executed should accept the handover",
+                1, call("colza_begin_handover", 1, leaver));
+
+        std::atomic<bool> done{false};
+        int32_t result = -1;
+        auto ult = engine.get_handler_pool().make_thread([&]() {
+            pipeline.wait(1, &result);
+            done = true;
+        });
+        std::vector<double> data(8, 1.0);
+        pipeline.stage("data", 1, 0, { 8 }, { 0 }, colza::Type::FLOAT64, data.data());
+        tl::thread::sleep(engine, 200);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the execution should be held during the handover",
+                !done);
+
+        call("colza_end_handover", 1, leaver + 1);
+        tl::thread::sleep(engine, 200);
+        CPPUNIT_ASSERT_MESSAGE(
+                "another server ending a handover should not release the execution",
+                !done);
+
+        call("colza_end_handover", 1, leaver);
+        ult->join();
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the execution should complete once the handover is done",
+                0, result);
+        pipeline.cleanup(1);
+    }
+
+    void testHandoverAfterExecution() {
+        auto pipeline = makeHandle();
+        pipeline.start(1);
+        pipeline.execute(1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a pipeline that has executed should decline the handover",
+                0, call("colza_begin_handover", 1, 1234));
+        pipeline.cleanup(1);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "an inactive pipeline should decline the handover",
+                0, call("colza_begin_handover", 1, 1234));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( HandoverTest );
@@ -17,7 +17,9 @@
 namespace tl = thallium;
 
 tl::engine engine;
+mona_instance_t mona;
 std::string pipeline_type = "simple_stager";
+std::string ssg_file = "colza-test.ssg";
 
 int main(int argc, char** argv) {
 
@@ -65,9 +67,10 @@ int main(int argc, char** argv) {
                      1, &group_config,
                      nullptr, nullptr,
                      &gid);
+    ssg_group_id_store(ssg_file.c_str(), gid, SSG_ALL_MEMBERS);
 
     // Create Mona instance
-    mona_instance_t mona = mona_init("ofi+tcp", NA_TRUE, NULL);
+    mona = mona_init("ofi+tcp", NA_TRUE, NULL);
 
     // Initialize the Sonata provider
     colza::Provider provider(engine, gid, false, mona);
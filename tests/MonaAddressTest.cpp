@@ -0,0 +1,82 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/GroupState.hpp"
+#include <algorithm>
+#include <string>
+
+extern thallium::engine engine;
+extern mona_instance_t mona;
+
+namespace tl = thallium;
+
+class MonaAddressTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( MonaAddressTest );
+    CPPUNIT_TEST( testSelfFirst );
+    CPPUNIT_TEST( testPiggyBack );
+    CPPUNIT_TEST_SUITE_END();
+
+    using KnownAddresses = colza::GroupState::KnownAddresses;
+
+    // the provider's address exchange RPC, called as another member would
+    KnownAddresses exchange(ssg_member_id_t caller_id, const std::string& caller_addr) {
+        auto rpc = engine.define("colza_get_mona_addr");
+        tl::provider_handle ph(engine.self(), 0);
+        colza::RequestResult<KnownAddresses> result = rpc.on(ph)(caller_id, caller_addr);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the address exchange should succeed",
+                result.success());
+        return result.value();
+    }
+
+    static std::string selfAddress() {
+        na_addr_t addr;
+        mona_addr_self(mona, &addr);
+        char buf[256];
+        na_size_t buf_size = sizeof(buf);
+        mona_addr_to_string(mona, buf, &buf_size, addr);
+        mona_addr_free(mona, addr);
+        return buf;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testSelfFirst() {
+        auto known = exchange(SSG_MEMBER_ID_INVALID, "");
+        CPPUNIT_ASSERT_MESSAGE(
+                "the server should return at least its own address",
+                !known.empty());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the server's own address should come first",
+                selfAddress(), known[0].second);
+    }
+
+    void testPiggyBack() {
+        const ssg_member_id_t caller = 4242;
+        const std::string caller_addr = "ofi+tcp://caller";
+        auto first = exchange(caller, caller_addr);
+        auto second = exchange(SSG_MEMBER_ID_INVALID, "");
+        CPPUNIT_ASSERT_MESSAGE(
+                "the address of a caller should be shared with later callers",
+                std::find(second.begin(), second.end(),
+                          std::make_pair(caller, caller_addr)) != second.end());
+        CPPUNIT_ASSERT_MESSAGE(
+                "an anonymous caller should not be recorded",
+                std::none_of(second.begin(), second.end(),
+                             [](const std::pair<ssg_member_id_t, std::string>& p) {
+                                 return p.first == SSG_MEMBER_ID_INVALID;
+                             }));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the first caller should not receive more than the second",
+                first.size(), second.size());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( MonaAddressTest );
@@ -0,0 +1,204 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/PyramidPipeline.hpp"
+#include <colza/Exception.hpp>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+extern mona_instance_t mona;
+
+// side of the square field staged in the tests
+static const int64_t SIDE = 8;
+
+class PyramidPipelineTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( PyramidPipelineTest );
+    CPPUNIT_TEST( testConfiguration );
+    CPPUNIT_TEST( testMean );
+    CPPUNIT_TEST( testMax );
+    CPPUNIT_TEST( testStride );
+    CPPUNIT_TEST( testQuery );
+    CPPUNIT_TEST_SUITE_END();
+
+    using json = nlohmann::json;
+    using CellFunction = std::function<double(int64_t, int64_t)>;
+
+    colza::BlockStore m_store;
+
+    static colza::PipelineFactoryArgs makeArgs(json config) {
+        colza::PipelineFactoryArgs args;
+        args.gid    = SSG_GROUP_ID_INVALID;
+        args.engine = engine;
+        args.pool   = engine.get_handler_pool();
+        args.config = std::move(config);
+        return args;
+    }
+
+    static colza::Communicator makeCommunicator() {
+        na_addr_t self_addr = NA_ADDR_NULL;
+        mona_addr_self(mona, &self_addr);
+        colza::Communicator comm(mona, { self_addr }, engine.get_handler_pool());
+        mona_addr_free(mona, self_addr);
+        return comm;
+    }
+
+    // value of the cell (x, y) of the staged field
+    static double field(int64_t x, int64_t y) {
+        return (double)(SIDE*x + y);
+    }
+
+    // stages the SIDExSIDE field of dataset "x" of iteration 1 as two
+    // blocks split at row 3, so that the rows 2 and 3 forming the second
+    // row of level 1 come from different blocks, then executes
+    void stageAndExecute(colza::PyramidPipeline& pipeline) {
+        pipeline.updateCommunicator(makeCommunicator());
+        pipeline.start(1);
+        const int64_t split = 3;
+        const int64_t rows[2][2] = { { 0, split }, { split, SIDE } };
+        for(uint64_t b = 0; b < 2; b++) {
+            std::vector<double> data;
+            for(int64_t x = rows[b][0]; x < rows[b][1]; x++)
+                for(int64_t y = 0; y < SIDE; y++)
+                    data.push_back(field(x, y));
+            auto block = m_store.insert("x", 1, b,
+                                        { (size_t)(rows[b][1] - rows[b][0]), (size_t)SIDE },
+                                        { rows[b][0], 0 }, colza::Type::FLOAT64,
+                                        data.data(), data.size()*sizeof(double));
+            CPPUNIT_ASSERT_MESSAGE(
+                    "staging a block should succeed",
+                    pipeline.stageShared("x", 1, b, block).success());
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "execute should succeed",
+                pipeline.execute(1).success());
+    }
+
+    // fetches the single block of a level and checks each of its cells
+    static void checkLevel(colza::PyramidPipeline& pipeline, size_t level,
+                           const CellFunction& expected) {
+        const int64_t side = SIDE >> level;
+        colza::BlockInfo info;
+        std::vector<double> data;
+        auto result = pipeline.fetch("x/" + std::to_string(level), 1, 0,
+            [&](const colza::BlockInfo& i, const void* d) {
+                info = i;
+                data.resize(i.size/sizeof(double));
+                std::memcpy(data.data(), d, i.size);
+                return colza::RequestResult<int32_t>();
+            });
+        CPPUNIT_ASSERT_MESSAGE(
+                "fetching a level should succeed",
+                result.success());
+        CPPUNIT_ASSERT_MESSAGE(
+                "a level on a single server should be a single block covering its domain",
+                info.dimensions == std::vector<size_t>({ (size_t)side, (size_t)side })
+                && info.offsets == std::vector<int64_t>({ 0, 0 }));
+        for(int64_t i = 0; i < side; i++) {
+            for(int64_t j = 0; j < side; j++) {
+                CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                        "each coarse cell should reduce the fine cells it covers",
+                        expected(i, j), data[i*side + j], 1e-12);
+            }
+        }
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testConfiguration() {
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a factor below 2 should be rejected",
+                colza::PyramidPipeline(makeArgs({ { "factor", 1 } })),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "an unknown method should be rejected",
+                colza::PyramidPipeline(makeArgs({ { "method", "median" } })),
+                colza::Exception);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a pyramid without levels should be rejected",
+                colza::PyramidPipeline(makeArgs({ { "levels", 0 } })),
+                colza::Exception);
+    }
+
+    void testMean() {
+        colza::PyramidPipeline pipeline(makeArgs({ { "method", "mean" }, { "levels", 3 } }));
+        stageAndExecute(pipeline);
+        auto levels = pipeline.results(1)["x"]["levels"];
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the results should describe each level",
+                (size_t)3, levels.size());
+        for(size_t l = 0; l < 3; l++) {
+            CPPUNIT_ASSERT_EQUAL((uint64_t)2 << l, levels[l]["factor"].get<uint64_t>());
+            CPPUNIT_ASSERT_MESSAGE(
+                    "level l should divide each dimension by factor^l",
+                    levels[l]["dimensions"].get<std::vector<size_t>>()
+                    == std::vector<size_t>(2, (size_t)(SIDE >> (l + 1))));
+        }
+        // the mean of a square of f*f cells is the field at its center
+        for(size_t l = 1; l <= 3; l++) {
+            const double f = (double)(1 << l);
+            checkLevel(pipeline, l, [f](int64_t i, int64_t j) {
+                return SIDE*(f*i + (f - 1)/2) + (f*j + (f - 1)/2);
+            });
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "fetching a level beyond the pyramid should fail",
+                !pipeline.fetch("x/4", 1, 0, [](const colza::BlockInfo&, const void*) {
+                    return colza::RequestResult<int32_t>();
+                }).success());
+        pipeline.cleanup(1);
+    }
+
+    void testMax() {
+        colza::PyramidPipeline pipeline(makeArgs({ { "method", "max" }, { "levels", 2 } }));
+        stageAndExecute(pipeline);
+        // the field grows with x and y, so the max is the last cell
+        checkLevel(pipeline, 1, [](int64_t i, int64_t j) { return field(2*i + 1, 2*j + 1); });
+        checkLevel(pipeline, 2, [](int64_t i, int64_t j) { return field(4*i + 3, 4*j + 3); });
+        pipeline.cleanup(1);
+    }
+
+    void testStride() {
+        colza::PyramidPipeline pipeline(makeArgs({ { "method", "stride" }, { "levels", 2 } }));
+        stageAndExecute(pipeline);
+        checkLevel(pipeline, 1, [](int64_t i, int64_t j) { return field(2*i, 2*j); });
+        checkLevel(pipeline, 2, [](int64_t i, int64_t j) { return field(4*i, 4*j); });
+        pipeline.cleanup(1);
+    }
+
+    void testQuery() {
+        colza::PyramidPipeline pipeline(makeArgs({ { "levels", 1 } }));
+        stageAndExecute(pipeline);
+        size_t num_blocks = 0;
+        auto count = [&num_blocks](const colza::BlockInfo&, const void*) {
+            num_blocks += 1;
+            return colza::RequestResult<int32_t>();
+        };
+        CPPUNIT_ASSERT_MESSAGE(
+                "querying a level should succeed",
+                pipeline.query("x/1", 1, colza::Box({ 1, 1 }, { 2, 2 }), count).success());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a region within the level should match its block",
+                (size_t)1, num_blocks);
+        num_blocks = 0;
+        pipeline.query("x/1", 1, colza::Box({ 4, 4 }, { 8, 8 }), count);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a region in the fine index space only should not match the level",
+                (size_t)0, num_blocks);
+        pipeline.cleanup(1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the levels should be released by cleanup",
+                !pipeline.fetch("x/1", 1, 0, count).success());
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( PyramidPipelineTest );
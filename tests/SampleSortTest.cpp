@@ -0,0 +1,176 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/SampleSort.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+extern thallium::engine engine;
+extern mona_instance_t mona;
+
+class SampleSortTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( SampleSortTest );
+    CPPUNIT_TEST( testSignedIntegers );
+    CPPUNIT_TEST( testUnsignedIntegers );
+    CPPUNIT_TEST( testFloat32 );
+    CPPUNIT_TEST( testFloat64 );
+    CPPUNIT_TEST( testValues );
+    CPPUNIT_TEST( testEmpty );
+    CPPUNIT_TEST_SUITE_END();
+
+    // single-member communicator, so that the tests exercise the local
+    // radix sort and the (local) exchange of keys and values
+    colza::Communicator m_comm;
+
+    template<typename T>
+    static std::vector<T> keysOf(const colza::SortedPartition& p) {
+        std::vector<T> keys(p.count);
+        std::memcpy(keys.data(), p.keys.data(), p.count*sizeof(T));
+        return keys;
+    }
+
+    // sorts the keys split into two inputs, and checks the result
+    // against std::sort
+    template<typename T>
+    void checkSort(const std::vector<T>& keys, colza::Type type) {
+        size_t half = keys.size()/2;
+        std::vector<colza::SortInput> inputs(2);
+        inputs[0].keys  = keys.data();
+        inputs[0].count = half;
+        inputs[1].keys  = keys.data() + half;
+        inputs[1].count = keys.size() - half;
+
+        auto partition = colza::SampleSort(m_comm, inputs, type);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "SampleSort should return all the keys",
+                keys.size(), partition.count);
+
+        auto expected = keys;
+        std::sort(expected.begin(), expected.end());
+        auto sorted = keysOf<T>(partition);
+        for(size_t i = 0; i < sorted.size(); i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "SampleSort should sort the keys in increasing order",
+                    sorted[i] == expected[i]);
+        }
+    }
+
+    public:
+
+    void setUp() {
+        na_addr_t self_addr = NA_ADDR_NULL;
+        mona_addr_self(mona, &self_addr);
+        m_comm = colza::Communicator(mona, { self_addr }, engine.get_handler_pool());
+        mona_addr_free(mona, self_addr);
+    }
+
+    void tearDown() {
+        m_comm = colza::Communicator();
+    }
+
+    void testSignedIntegers() {
+        std::vector<int32_t> keys;
+        for(int32_t i = 0; i < 1000; i++)
+            keys.push_back((i*7919) % 2001 - 1000);
+        keys.push_back(std::numeric_limits<int32_t>::min());
+        keys.push_back(std::numeric_limits<int32_t>::max());
+        keys.push_back(-1);
+        keys.push_back(0);
+        checkSort(keys, colza::Type::INT32);
+
+        std::vector<int8_t> small;
+        for(int i = 0; i < 300; i++)
+            small.push_back((int8_t)((i*37) % 256 - 128));
+        checkSort(small, colza::Type::INT8);
+
+        std::vector<int64_t> large;
+        for(int64_t i = 0; i < 500; i++)
+            large.push_back((i % 2 ? -1 : 1)*(i*1000003LL*1000003LL));
+        checkSort(large, colza::Type::INT64);
+    }
+
+    void testUnsignedIntegers() {
+        std::vector<uint16_t> keys;
+        for(uint32_t i = 0; i < 1000; i++)
+            keys.push_back((uint16_t)(i*40503u));
+        keys.push_back(std::numeric_limits<uint16_t>::max());
+        checkSort(keys, colza::Type::UINT16);
+
+        std::vector<uint64_t> large;
+        for(uint64_t i = 0; i < 1000; i++)
+            large.push_back(i*0x9E3779B97F4A7C15ULL);
+        checkSort(large, colza::Type::UINT64);
+    }
+
+    void testFloat32() {
+        std::vector<float> keys;
+        for(int i = 0; i < 1000; i++)
+            keys.push_back(((i*7919) % 2001 - 1000)*0.125f);
+        keys.push_back(-std::numeric_limits<float>::infinity());
+        keys.push_back(std::numeric_limits<float>::infinity());
+        keys.push_back(-std::numeric_limits<float>::denorm_min());
+        keys.push_back(std::numeric_limits<float>::denorm_min());
+        keys.push_back(-0.0f);
+        checkSort(keys, colza::Type::FLOAT32);
+    }
+
+    void testFloat64() {
+        std::vector<double> keys;
+        for(int i = 0; i < 1000; i++)
+            keys.push_back(((i*7919) % 2001 - 1000)*1e-3);
+        keys.push_back(-std::numeric_limits<double>::max());
+        keys.push_back(std::numeric_limits<double>::max());
+        keys.push_back(-std::numeric_limits<double>::infinity());
+        keys.push_back(-1e-300);
+        keys.push_back(1e-300);
+        keys.push_back(-0.0);
+        checkSort(keys, colza::Type::FLOAT64);
+    }
+
+    void testValues() {
+        std::vector<double> keys;
+        std::vector<uint64_t> values;
+        for(uint64_t i = 0; i < 500; i++) {
+            keys.push_back((double)((i*31) % 97) - 48.5);
+            values.push_back(i);
+        }
+        std::vector<colza::SortInput> inputs(1);
+        inputs[0].keys   = keys.data();
+        inputs[0].values = values.data();
+        inputs[0].count  = keys.size();
+
+        auto partition = colza::SampleSort(m_comm, inputs, colza::Type::FLOAT64, sizeof(uint64_t));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "SampleSort should return a value per key",
+                keys.size()*sizeof(uint64_t), partition.values.size());
+
+        auto sorted = keysOf<double>(partition);
+        std::vector<uint64_t> sorted_values(partition.count);
+        std::memcpy(sorted_values.data(), partition.values.data(), partition.values.size());
+        for(size_t i = 0; i < sorted.size(); i++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "values should follow their keys",
+                    keys[sorted_values[i]] == sorted[i]);
+            if(i > 0 && sorted[i] == sorted[i-1]) {
+                CPPUNIT_ASSERT_MESSAGE(
+                        "equal keys should keep the order of their input",
+                        sorted_values[i-1] < sorted_values[i]);
+            }
+        }
+    }
+
+    void testEmpty() {
+        std::vector<colza::SortInput> inputs;
+        auto partition = colza::SampleSort(m_comm, inputs, colza::Type::FLOAT64);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "sorting no key should return no key",
+                (size_t)0, partition.count);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleSortTest );
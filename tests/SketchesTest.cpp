@@ -0,0 +1,162 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/Sketches.hpp"
+#include <algorithm>
+#include <vector>
+
+class SketchesTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( SketchesTest );
+    CPPUNIT_TEST( testQuantiles );
+    CPPUNIT_TEST( testQuantilesMerge );
+    CPPUNIT_TEST( testQuantilesSerialize );
+    CPPUNIT_TEST( testDistinct );
+    CPPUNIT_TEST( testFrequencies );
+    CPPUNIT_TEST( testCandidates );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr size_t N = 100000;
+
+    // values 0 .. N-1 in a scrambled order
+    static std::vector<double> values(size_t begin, size_t end) {
+        std::vector<double> x;
+        for(size_t i = begin; i < end; i++)
+            x.push_back((double)((i*7919) % N));
+        return x;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testQuantiles() {
+        colza::KLLSketch sketch(colza::KLLSketch::KForEpsilon(0.01));
+        auto x = values(0, N);
+        sketch.update(x.data(), x.size());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the sketch should count all the items",
+                (uint64_t)N, sketch.count());
+        std::vector<double> qs = { 0.1, 0.25, 0.5, 0.75, 0.9 };
+        auto result = sketch.quantiles(qs);
+        for(size_t j = 0; j < qs.size(); j++) {
+            CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                    "quantiles should be within the rank error",
+                    qs[j]*N, result[j], 0.03*N);
+        }
+    }
+
+    void testQuantilesMerge() {
+        colza::KLLSketch a(200, 1), b(200, 2);
+        auto xa = values(0, N/2);
+        auto xb = values(N/2, N);
+        a.update(xa.data(), xa.size());
+        b.update(xb.data(), xb.size());
+        a.merge(b);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a merged sketch should count the items of both sketches",
+                (uint64_t)N, a.count());
+        auto median = a.quantiles({ 0.5 })[0];
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                "the median of the merged sketch should be within the rank error",
+                0.5*N, median, 0.03*N);
+    }
+
+    void testQuantilesSerialize() {
+        colza::KLLSketch sketch(200, 3);
+        auto x = values(0, N);
+        sketch.update(x.data(), x.size());
+        std::vector<char> bytes;
+        sketch.serialize(bytes);
+        colza::KLLSketch copy;
+        const char* end = copy.deserialize(bytes.data());
+        CPPUNIT_ASSERT_MESSAGE(
+                "deserialize should consume all the serialized bytes",
+                end == bytes.data() + bytes.size());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "a deserialized sketch should have the same count",
+                sketch.count(), copy.count());
+        std::vector<double> qs = { 0.0, 0.3, 0.6, 1.0 };
+        CPPUNIT_ASSERT_MESSAGE(
+                "a deserialized sketch should have the same quantiles",
+                sketch.quantiles(qs) == copy.quantiles(qs));
+    }
+
+    void testDistinct() {
+        colza::HyperLogLog a(12), b(12);
+        // [0, 0.6N) and [0.4N, N) overlap, N distinct keys in total
+        for(uint64_t i = 0; i < 6*N/10; i++) {
+            a.add(colza::Mix64(i));
+            a.add(colza::Mix64(i)); // duplicates should not count
+        }
+        for(uint64_t i = 4*N/10; i < N; i++)
+            b.add(colza::Mix64(i));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                "the distinct count should be within 5% of the exact count",
+                0.6*N, a.estimate(), 0.05*0.6*N);
+        a.merge(b);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                "the merged distinct count should be within 5% of the exact count",
+                (double)N, a.estimate(), 0.05*N);
+
+        colza::HyperLogLog small(12);
+        for(uint64_t i = 0; i < 100; i++)
+            small.add(colza::Mix64(i));
+        CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE(
+                "small distinct counts should be estimated accurately",
+                100.0, small.estimate(), 5.0);
+    }
+
+    void testFrequencies() {
+        const double epsilon = 0.001;
+        colza::CountMinSketch a(epsilon, 0.01), b(epsilon, 0.01);
+        // key k occurs k times for k in [1, 300), half in each sketch
+        std::vector<uint64_t> counts(300, 0);
+        uint64_t total = 0;
+        for(uint64_t k = 1; k < counts.size(); k++) {
+            for(uint64_t c = 0; c < k; c++) {
+                (c % 2 ? a : b).add(colza::Mix64(k));
+                counts[k] += 1;
+                total += 1;
+            }
+        }
+        a.merge(b);
+        for(uint64_t k = 1; k < counts.size(); k++) {
+            auto e = a.estimate(colza::Mix64(k));
+            CPPUNIT_ASSERT_MESSAGE(
+                    "count-min estimates should never be below the exact count",
+                    e >= counts[k]);
+            CPPUNIT_ASSERT_MESSAGE(
+                    "count-min estimates should be within epsilon*N of the exact count",
+                    e <= counts[k] + (uint64_t)(3*epsilon*total));
+        }
+    }
+
+    void testCandidates() {
+        colza::MisraGries a(8), b(8);
+        // 1000 keys occur once, key 42 occurs 400 times and key 7 200
+        // times, so both occur more than N/(m+1) times
+        for(uint64_t i = 0; i < 1000; i++) {
+            a.add(1000 + i);
+            if(i % 5 < 2) b.add(42);
+            if(i % 5 == 0) b.add(7);
+        }
+        a.merge(b);
+        auto candidates = a.candidates();
+        CPPUNIT_ASSERT_MESSAGE(
+                "a summary should keep at most capacity candidates",
+                candidates.size() <= 8);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the most frequent key should be a candidate",
+                std::count(candidates.begin(), candidates.end(), 42) == 1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "a key occurring more than N/(m+1) times should be a candidate",
+                std::count(candidates.begin(), candidates.end(), 7) == 1);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( SketchesTest );
@@ -0,0 +1,87 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/SpanningTree.hpp"
+#include <vector>
+
+class SpanningTreeTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( SpanningTreeTest );
+    CPPUNIT_TEST( testSubtreeRanges );
+    CPPUNIT_TEST( testTree );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr int32_t FANOUT = 4;
+
+    // visits the subtree rooted at first_rank as the servers do, counting
+    // how many times each rank is reached and the depth of the tree
+    static int32_t visit(int32_t first_rank, int32_t last_rank, std::vector<int>& reached) {
+        reached[first_rank] += 1;
+        int32_t depth = 0;
+        for(auto& range : colza::SubtreeRanges(first_rank, last_rank, FANOUT)) {
+            auto d = visit(range.first_rank, range.last_rank, reached);
+            depth = d + 1 > depth ? d + 1 : depth;
+        }
+        return depth;
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testSubtreeRanges() {
+        CPPUNIT_ASSERT_MESSAGE(
+                "a single rank should have no children",
+                colza::SubtreeRanges(3, 3, FANOUT).empty());
+
+        auto ranges = colza::SubtreeRanges(0, 2, FANOUT);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "fewer ranks than the fanout should give one child per rank",
+                (size_t)2, ranges.size());
+
+        ranges = colza::SubtreeRanges(10, 20, FANOUT);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "there should be at most fanout children",
+                (size_t)FANOUT, ranges.size());
+        int32_t next = 11;
+        for(auto& range : ranges) {
+            CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                    "the children should cover contiguous ranges after the root",
+                    next, range.first_rank);
+            auto size = range.last_rank - range.first_rank + 1;
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the ranges of the children should be balanced",
+                    size == 2 || size == 3);
+            next = range.last_rank + 1;
+        }
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the children should cover all the ranks of the subtree",
+                (int32_t)21, next);
+    }
+
+    void testTree() {
+        for(int32_t size : { 1, 2, 5, 17, 64, 1000, 4096 }) {
+            std::vector<int> reached(size, 0);
+            auto depth = visit(0, size - 1, reached);
+            for(auto r : reached) {
+                CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                        "every rank should be reached exactly once",
+                        1, r);
+            }
+            // the subtrees of the children have at most ceil((size-1)/FANOUT)
+            // ranks, so the depth is logarithmic in the size of the group
+            int32_t max_depth = 0;
+            for(int32_t n = size; n > 1; n = (n - 1 + FANOUT - 1) / FANOUT)
+                max_depth += 1;
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the depth of the tree should be logarithmic in the group size",
+                    depth <= max_depth);
+        }
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( SpanningTreeTest );
@@ -0,0 +1,165 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/StagingPipeline.hpp"
+#include <colza/Client.hpp>
+#include <colza/Admin.hpp>
+#include <colza/Exception.hpp>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+
+// backend keeping the staged blocks
+class SharedStage : public colza::StagingPipeline {
+
+    public:
+
+    SharedStage(const colza::PipelineFactoryArgs& args)
+    : colza::StagingPipeline(args) {}
+
+    colza::RequestResult<int32_t> execute(uint64_t) override {
+        return Success();
+    }
+
+    static std::unique_ptr<colza::Backend> create(const colza::PipelineFactoryArgs& args) {
+        return std::unique_ptr<colza::Backend>(new SharedStage(args));
+    }
+};
+
+COLZA_REGISTER_BACKEND(shared_stage, SharedStage);
+
+class StageSharedTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( StageSharedTest );
+    CPPUNIT_TEST( testStageShared );
+    CPPUNIT_TEST( testStageSharedErrors );
+    CPPUNIT_TEST( testSharedMemory );
+    CPPUNIT_TEST_SUITE_END();
+
+    const std::vector<std::string> m_pipeline_names = { "first", "second" };
+
+    std::vector<double> m_data;
+
+    colza::PipelineHandle makeHandle(const std::string& name) {
+        colza::Client client(engine);
+        return client.makePipelineHandle(engine.self(), 0, name);
+    }
+
+    // fetches block 3 of dataset "data" of iteration 1 from a pipeline
+    std::vector<double> fetch(const colza::PipelineHandle& pipeline) {
+        std::vector<double> out(m_data.size(), -1.0);
+        pipeline.fetch("data", 1, 3, out.data(), out.size()*sizeof(double));
+        return out;
+    }
+
+    public:
+
+    void setUp() {
+        m_data.resize(16);
+        for(size_t i = 0; i < m_data.size(); i++) m_data[i] = 1.5*i;
+        colza::Admin admin(engine);
+        for(auto& name : m_pipeline_names)
+            admin.createPipeline(engine.self(), 0, name, "shared_stage", "{}");
+    }
+
+    void tearDown() {
+        colza::Admin admin(engine);
+        for(auto& name : m_pipeline_names)
+            admin.destroyPipeline(engine.self(), 0, name);
+    }
+
+    void testStageShared() {
+        auto first  = makeHandle("first");
+        auto second = makeHandle("second");
+        first.start(1);
+        second.start(1);
+        first.stageShared({ "second" }, "data", 1, 3, { 4, 4 }, { 0, 4 },
+                          colza::Type::FLOAT64, m_data.data());
+        CPPUNIT_ASSERT_MESSAGE(
+                "the block should be staged into the pipeline of the handle",
+                fetch(first) == m_data);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the block should be staged into the other pipelines",
+                fetch(second) == m_data);
+        first.cleanup(1);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "cleaning up a pipeline should release its block",
+                fetch(first),
+                colza::Exception);
+        CPPUNIT_ASSERT_MESSAGE(
+                "cleaning up a pipeline should not affect the others",
+                fetch(second) == m_data);
+        second.cleanup(1);
+    }
+
+    void testStageSharedErrors() {
+        auto first = makeHandle("first");
+        first.start(1);
+        try {
+            first.stageShared({ "missing" }, "data", 1, 3, { 4, 4 }, { 0, 4 },
+                              colza::Type::FLOAT64, m_data.data());
+            CPPUNIT_FAIL("staging into a missing pipeline should throw");
+        } catch(const colza::Exception& ex) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the error should be that the pipeline was not found",
+                    ex.code() == colza::ErrorCode::INVALID_PIPELINE_NAME);
+        }
+        try {
+            first.stageShared({ "second" }, "data", 1, 3, { 4, 4 }, { 0, 4 },
+                              colza::Type::FLOAT64, m_data.data());
+            CPPUNIT_FAIL("staging into a pipeline that was not started should throw");
+        } catch(const colza::Exception& ex) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the error should be that the pipeline is not active",
+                    ex.code() == colza::ErrorCode::PIPELINE_NOT_ACTIVE);
+        }
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "no pipeline should get the block if one of them cannot",
+                fetch(first),
+                colza::Exception);
+        first.cleanup(1);
+    }
+
+    void testSharedMemory() {
+        colza::PipelineFactoryArgs args;
+        args.gid    = SSG_GROUP_ID_INVALID;
+        args.engine = engine;
+        args.pool   = engine.get_handler_pool();
+        args.config = nlohmann::json::object();
+        SharedStage first(args), second(args);
+        first.start(1);
+        second.start(1);
+        colza::BlockStore store;
+        auto block = store.insert("data", 1, 3, { 4, 4 }, { 0, 4 }, colza::Type::FLOAT64,
+                                  m_data.data(), m_data.size()*sizeof(double));
+        CPPUNIT_ASSERT(first.stageShared("data", 1, 3, block).success());
+        CPPUNIT_ASSERT(second.stageShared("data", 1, 3, block).success());
+        for(auto* pipeline : { &first, &second }) {
+            const void* staged = nullptr;
+            pipeline->fetch("data", 1, 3,
+                [&staged](const colza::BlockInfo&, const void* data) {
+                    staged = data;
+                    return colza::RequestResult<int32_t>();
+                });
+            CPPUNIT_ASSERT_MESSAGE(
+                    "the pipelines should share the memory of the block",
+                    staged == block->data);
+        }
+        const auto num_refs = block.use_count();
+        first.cleanup(1);
+        CPPUNIT_ASSERT_MESSAGE(
+                "cleaning up a pipeline should drop its references to the block",
+                block.use_count() < num_refs);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the other pipeline should still hold the block",
+                second.fetch("data", 1, 3, [](const colza::BlockInfo&, const void*) {
+                    return colza::RequestResult<int32_t>();
+                }).success());
+        second.cleanup(1);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( StageSharedTest );
@@ -0,0 +1,113 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "../src/backends/StatisticsPipeline.hpp"
+#include <limits>
+#include <numeric>
+#include <vector>
+
+extern thallium::engine engine;
+
+class StatisticsPipelineTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( StatisticsPipelineTest );
+    CPPUNIT_TEST( testMoments );
+    CPPUNIT_TEST( testNaNs );
+    CPPUNIT_TEST( testOnlyNaNs );
+    CPPUNIT_TEST_SUITE_END();
+
+    using json = nlohmann::json;
+
+    colza::BlockStore m_store;
+
+    static colza::PipelineFactoryArgs makeArgs() {
+        colza::PipelineFactoryArgs args;
+        args.gid    = SSG_GROUP_ID_INVALID;
+        args.engine = engine;
+        args.pool   = engine.get_handler_pool();
+        args.config = { { "histogram", { { "bins", 4 } } } };
+        return args;
+    }
+
+    // stages the values as a single block of dataset "x" of iteration 1,
+    // executes the pipeline, and returns the statistics of "x"
+    template<typename T>
+    json compute(const std::vector<T>& values, colza::Type type) {
+        colza::StatisticsPipeline pipeline(makeArgs());
+        pipeline.start(1);
+        auto block = m_store.insert("x", 1, 0, { values.size() }, { 0 }, type,
+                                    values.data(), values.size()*sizeof(T));
+        CPPUNIT_ASSERT_MESSAGE(
+                "staging a block should succeed",
+                pipeline.stageShared("x", 1, 0, block).success());
+        CPPUNIT_ASSERT_MESSAGE(
+                "execute should succeed",
+                pipeline.execute(1).success());
+        auto stats = pipeline.results(1)["x"];
+        pipeline.cleanup(1);
+        return stats;
+    }
+
+    static uint64_t histogramCount(const json& stats) {
+        auto bins = stats["histogram"]["bins"].get<std::vector<uint64_t>>();
+        return std::accumulate(bins.begin(), bins.end(), (uint64_t)0)
+             + stats["histogram"]["underflow"].get<uint64_t>()
+             + stats["histogram"]["overflow"].get<uint64_t>();
+    }
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testMoments() {
+        // enough values to go through the vectorized loops and their tail
+        std::vector<int32_t> values(21);
+        std::iota(values.begin(), values.end(), -10);
+        auto stats = compute(values, colza::Type::INT32);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)21, stats["count"].get<uint64_t>());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, stats["nans"].get<uint64_t>());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(-10.0, stats["min"].get<double>(), 0.0);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(10.0, stats["max"].get<double>(), 0.0);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, stats["mean"].get<double>(), 1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(770.0/21.0, stats["variance"].get<double>(), 1e-9);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)21, histogramCount(stats));
+    }
+
+    void testNaNs() {
+        // a NaN in first position used to seed the min and max
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        std::vector<double> values = { nan, 1.0, 2.0, nan, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, nan };
+        auto stats = compute(values, colza::Type::FLOAT64);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "NaNs should not be counted with the values",
+                (uint64_t)8, stats["count"].get<uint64_t>());
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "NaNs should be counted separately",
+                (uint64_t)3, stats["nans"].get<uint64_t>());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, stats["min"].get<double>(), 0.0);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(8.0, stats["max"].get<double>(), 0.0);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(36.0, stats["sum"].get<double>(), 1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(4.5, stats["mean"].get<double>(), 1e-12);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(5.25, stats["variance"].get<double>(), 1e-12);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the histogram should hold as many values as the count",
+                stats["count"].get<uint64_t>(), histogramCount(stats));
+    }
+
+    void testOnlyNaNs() {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        std::vector<float> values(5, nan);
+        auto stats = compute(values, colza::Type::FLOAT32);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, stats["count"].get<uint64_t>());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)5, stats["nans"].get<uint64_t>());
+        CPPUNIT_ASSERT_MESSAGE(
+                "a dataset without values should have no min, max or histogram",
+                !stats.contains("min") && !stats.contains("max") && !stats.contains("histogram"));
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( StatisticsPipelineTest );
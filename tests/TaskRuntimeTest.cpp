@@ -0,0 +1,225 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/TaskRuntime.hpp>
+#include <colza/Exception.hpp>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern thallium::engine engine;
+
+class TaskRuntimeTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TaskRuntimeTest );
+    CPPUNIT_TEST( testParallelFor );
+    CPPUNIT_TEST( testParallelForError );
+    CPPUNIT_TEST( testGraph );
+    CPPUNIT_TEST( testGraphError );
+    CPPUNIT_TEST( testNested );
+    CPPUNIT_TEST_SUITE_END();
+
+    // number of times each index was processed
+    struct Hits {
+        thallium::mutex  mtx;
+        std::vector<int> counts;
+
+        Hits(size_t n) : counts(n, 0) {}
+
+        void add(size_t b, size_t e) {
+            std::lock_guard<thallium::mutex> lock(mtx);
+            for(size_t i = b; i < e; i++) counts[i] += 1;
+        }
+
+        bool once(size_t begin, size_t end) const {
+            for(size_t i = 0; i < counts.size(); i++)
+                if(counts[i] != (i >= begin && i < end ? 1 : 0)) return false;
+            return true;
+        }
+    };
+
+    // order in which the tasks of a graph completed
+    struct Trace {
+        thallium::mutex  mtx;
+        std::vector<int> order;
+
+        void add(int task) {
+            std::lock_guard<thallium::mutex> lock(mtx);
+            order.push_back(task);
+        }
+
+        int position(int task) const {
+            for(size_t i = 0; i < order.size(); i++)
+                if(order[i] == task) return (int)i;
+            return -1;
+        }
+    };
+
+    public:
+
+    void setUp() {}
+
+    void tearDown() {}
+
+    void testParallelFor() {
+        colza::TaskRuntime tasks(engine.get_handler_pool(), 4);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "concurrency should be the requested one",
+                (size_t)4, tasks.concurrency());
+
+        for(size_t grain : { (size_t)0, (size_t)1, (size_t)7, (size_t)1000 }) {
+            Hits hits(120);
+            tasks.parallelFor(3, 110, grain, [&hits](size_t b, size_t e) { hits.add(b, e); });
+            CPPUNIT_ASSERT_MESSAGE(
+                    "parallelFor should process each index of the range exactly once",
+                    hits.once(3, 110));
+        }
+
+        Hits none(10);
+        tasks.parallelFor(5, 5, 0, [&none](size_t b, size_t e) { none.add(b, e); });
+        CPPUNIT_ASSERT_MESSAGE(
+                "parallelFor should not call body on an empty range",
+                none.once(0, 0));
+
+        std::vector<int> items = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        Hits item_hits(items.size());
+        tasks.parallelFor(items, [&item_hits](int item) { item_hits.add(item, item + 1); });
+        CPPUNIT_ASSERT_MESSAGE(
+                "parallelFor should call body on each item exactly once",
+                item_hits.once(0, items.size()));
+    }
+
+    void testParallelForError() {
+        colza::TaskRuntime tasks(engine.get_handler_pool(), 4);
+        bool caught = false;
+        std::string message;
+        try {
+            tasks.parallelFor(0, 100, 1, [](size_t b, size_t) {
+                if(b == 42)
+                    throw colza::Exception(colza::ErrorCode::OTHER_ERROR, "chunk 42 failed");
+            });
+        } catch(const colza::Exception& ex) {
+            caught = true;
+            message = ex.what();
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "parallelFor should rethrow the exception thrown by a chunk",
+                caught);
+        CPPUNIT_ASSERT_MESSAGE(
+                "parallelFor should rethrow the original exception",
+                message.find("chunk 42 failed") != std::string::npos);
+
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "parallelFor should preserve the type of the exception",
+                tasks.parallelFor(0, 10, 0, [](size_t, size_t) {
+                    throw std::out_of_range("out of range");
+                }),
+                std::out_of_range);
+
+        Hits hits(50);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "the runtime should remain usable after an error",
+                tasks.parallelFor(0, 50, 0, [&hits](size_t b, size_t e) { hits.add(b, e); }));
+        CPPUNIT_ASSERT_MESSAGE(
+                "the runtime should process all the indices after an error",
+                hits.once(0, 50));
+    }
+
+    void testGraph() {
+        colza::TaskRuntime tasks(engine.get_handler_pool(), 3);
+        Trace trace;
+        // diamond: 0 -> {1, 2} -> 3, and 4 independent of the others
+        colza::TaskGraph graph;
+        auto t0 = graph.add([&trace]() { trace.add(0); });
+        auto t1 = graph.add([&trace]() { trace.add(1); }, { t0 });
+        auto t2 = graph.add([&trace]() { trace.add(2); }, { t0 });
+        graph.add([&trace]() { trace.add(3); }, { t1, t2 });
+        graph.add([&trace]() { trace.add(4); });
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the graph should have all the tasks added",
+                (size_t)5, graph.size());
+
+        tasks.run(graph);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "run should run every task once",
+                (size_t)5, trace.order.size());
+        for(int t = 0; t < 5; t++) {
+            CPPUNIT_ASSERT_MESSAGE(
+                    "run should run every task",
+                    trace.position(t) >= 0);
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "a task should run after the tasks it depends on",
+                trace.position(0) < trace.position(1)
+                && trace.position(0) < trace.position(2)
+                && trace.position(1) < trace.position(3)
+                && trace.position(2) < trace.position(3));
+
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "a task should not depend on a task that is not in the graph",
+                graph.add([]() {}, { 10 }),
+                colza::Exception);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "running an empty graph should do nothing",
+                tasks.run(colza::TaskGraph()));
+    }
+
+    void testGraphError() {
+        colza::TaskRuntime tasks(engine.get_handler_pool(), 2);
+        Trace trace;
+        colza::TaskGraph graph;
+        auto t0 = graph.add([&trace]() { trace.add(0); });
+        auto t1 = graph.add([]() {
+            throw colza::Exception(colza::ErrorCode::OTHER_ERROR, "task 1 failed");
+        }, { t0 });
+        auto t2 = graph.add([&trace]() { trace.add(2); }, { t1 });
+        graph.add([&trace]() { trace.add(3); }, { t2 });
+
+        bool caught = false;
+        try {
+            tasks.run(graph);
+        } catch(const colza::Exception& ex) {
+            caught = std::string(ex.what()).find("task 1 failed") != std::string::npos;
+        }
+        CPPUNIT_ASSERT_MESSAGE(
+                "run should rethrow the exception thrown by a task",
+                caught);
+        CPPUNIT_ASSERT_MESSAGE(
+                "the tasks depending on a failed task should not run",
+                trace.position(0) == 0 && trace.position(2) < 0 && trace.position(3) < 0);
+    }
+
+    void testNested() {
+        colza::TaskRuntime tasks(engine.get_handler_pool(), 4);
+        Hits hits(4*64);
+        colza::TaskGraph graph;
+        for(size_t t = 0; t < 4; t++) {
+            graph.add([&tasks, &hits, t]() {
+                tasks.parallelFor(t*64, (t+1)*64, 0,
+                    [&hits](size_t b, size_t e) { hits.add(b, e); });
+            });
+        }
+        tasks.run(graph);
+        CPPUNIT_ASSERT_MESSAGE(
+                "loops nested in tasks should process each index exactly once",
+                hits.once(0, 4*64));
+
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "an error in a nested loop should propagate out of the graph",
+                tasks.run([&tasks]() {
+                    colza::TaskGraph g;
+                    g.add([&tasks]() {
+                        tasks.parallelFor(0, 16, 1, [](size_t b, size_t) {
+                            if(b == 5) throw std::runtime_error("nested loop failed");
+                        });
+                    });
+                    return g;
+                }()),
+                std::runtime_error);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( TaskRuntimeTest );
@@ -0,0 +1,121 @@
+/*
+ * (C) 2020 The University of Chicago
+ *
+ * See COPYRIGHT in top-level directory.
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include <colza/Client.hpp>
+#include <colza/Admin.hpp>
+#include <colza/ClientCommunicator.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern thallium::engine engine;
+extern std::string pipeline_type;
+extern std::string ssg_file;
+
+// communicator of a single client
+class SelfCommunicator : public colza::ClientCommunicator {
+
+    public:
+
+    int size() const override { return 1; }
+
+    int rank() const override { return 0; }
+
+    void barrier() const override {}
+
+    void bcast(void*, int, int) const override {}
+};
+
+class TriggerTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TriggerTest );
+    CPPUNIT_TEST( testTriggeredExecution );
+    CPPUNIT_TEST( testTriggerWithoutBlocks );
+    CPPUNIT_TEST( testWaitWithoutTrigger );
+    CPPUNIT_TEST_SUITE_END();
+
+    static constexpr const char* pipeline_name = "triggered";
+
+    SelfCommunicator m_comm;
+
+    colza::DistributedPipelineHandle makeHandle() {
+        colza::Client client(engine);
+        return client.makeDistributedPipelineHandle(&m_comm, ssg_file, 0, pipeline_name);
+    }
+
+    static void stageBlock(const colza::DistributedPipelineHandle& pipeline,
+                           uint64_t iteration, uint64_t block_id) {
+        std::vector<double> data(16, (double)block_id);
+        int32_t result = -1;
+        pipeline.stage("data", iteration, block_id, { 16 }, { (int64_t)(16*block_id) },
+                       colza::Type::FLOAT64, data.data(), &result);
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "staging a block should succeed",
+                0, result);
+    }
+
+    public:
+
+    void setUp() {
+        colza::Admin admin(engine);
+        admin.createDistributedPipeline(ssg_file, 0, pipeline_name, pipeline_type, "{}");
+    }
+
+    void tearDown() {
+        colza::Admin admin(engine);
+        admin.destroyDistributedPipeline(ssg_file, 0, pipeline_name);
+    }
+
+    void testTriggeredExecution() {
+        auto pipeline = makeHandle();
+        pipeline.start(1, { { "data", 0 }, { "data", 1 } });
+        stageBlock(pipeline, 1, 0);
+        stageBlock(pipeline, 1, 1);
+        int32_t result = -1;
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "wait should return once the last expected block is staged",
+                pipeline.wait(1, &result));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the triggered execution should succeed",
+                0, result);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "the iteration should still be active without autoCleanup",
+                pipeline.cleanup(1));
+    }
+
+    void testTriggerWithoutBlocks() {
+        auto pipeline = makeHandle();
+        pipeline.start(1, {}, true);
+        int32_t result = -1;
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "an iteration expecting no block should execute right away",
+                pipeline.wait(1, &result));
+        CPPUNIT_ASSERT_EQUAL_MESSAGE(
+                "the triggered execution should succeed",
+                0, result);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "the iteration should have been cleaned up with autoCleanup",
+                pipeline.cleanup(1),
+                colza::Exception);
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "the next iteration should start once the previous one is cleaned up",
+                pipeline.start(2, {}, true));
+        CPPUNIT_ASSERT_NO_THROW_MESSAGE(
+                "the next iteration should execute by itself too",
+                pipeline.wait(2, &result));
+    }
+
+    void testWaitWithoutTrigger() {
+        auto pipeline = makeHandle();
+        pipeline.start(1);
+        CPPUNIT_ASSERT_THROW_MESSAGE(
+                "wait should throw for an iteration started without blocks",
+                pipeline.wait(1),
+                colza::Exception);
+        pipeline.cleanup(1);
+    }
+};
+CPPUNIT_TEST_SUITE_REGISTRATION( TriggerTest );